@@ -9,23 +9,79 @@
 
 #pragma once
 
+#include <array>
 #include <chrono>
 #include <cstdint>
 #include <future>
+#include <map>
+#include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include "kvik/client_config.hpp"
+#include "kvik/delta_codec.hpp"
 #include "kvik/errors.hpp"
 #include "kvik/layers.hpp"
 #include "kvik/local_peer.hpp"
+#include "kvik/mutex.hpp"
 #include "kvik/node.hpp"
 #include "kvik/pub_sub_struct.hpp"
+#include "kvik/stream.hpp"
 #include "kvik/timer.hpp"
+#include "kvik/topic.hpp"
 #include "kvik/wildcard_trie.hpp"
 
+#ifndef KVIK_RETAINED_SUBS_MAX
+/**
+ * @brief Capacity of retained subscription table
+ *
+ * Disabled by default, so `ClientRetainedData` stays small on devices which
+ * don't retain subscriptions (see `ClientConfig::SubDB::retainSubs`).
+ */
+#define KVIK_RETAINED_SUBS_MAX 0
+#endif
+
+#ifndef KVIK_RETAINED_TOPIC_MAX_LEN
+//! Maximum topic length in retained subscription table
+#define KVIK_RETAINED_TOPIC_MAX_LEN 64
+#endif
+
+static_assert(KVIK_RETAINED_TOPIC_MAX_LEN <= UINT8_MAX,
+              "Retained topic length must fit in RetainedSub::topicLen");
+
 namespace kvik
 {
+    /**
+     * @brief Retained subscription
+     */
+    struct RetainedSub
+    {
+        std::array<char, KVIK_RETAINED_TOPIC_MAX_LEN> topic = {};
+        uint8_t topicLen = 0;
+    };
+
+    /**
+     * @brief Retained subscription table
+     *
+     * Fixed-capacity table of subscribed topics (see
+     * `ClientConfig::SubDB::retainSubs`). Topics which don't fit aren't
+     * retained.
+     */
+    struct RetainedSubs
+    {
+        std::array<RetainedSub, KVIK_RETAINED_SUBS_MAX> subs = {};
+        uint8_t cnt = 0;
+
+        /**
+         * @brief Expiration of subscriptions at gateway
+         *
+         * Milliseconds since Unix epoch (system clock, which keeps running
+         * during deep sleep). Value 0 means no valid lease.
+         */
+        int64_t leaseExpiry = 0;
+    };
+
     /**
      * @brief Client retained data
      *
@@ -41,6 +97,7 @@ namespace kvik
         RetainedLocalPeer gw;
         uint16_t msgsFailCnt;
         uint16_t timeSyncNoRespCnt;
+        RetainedSubs subs;
     };
 
     /**
@@ -65,14 +122,27 @@ namespace kvik
             LocalMsgVector resps;           //!< Responses
         };
 
-        std::mutex m_mutex;          //!< Mutex to prevent race conditions
-        std::mutex m_dscvSyncMutex;  //!< Mutex for GW discovery/time sync
-        ClientConfig m_conf;         //!< Configuration
-        ILocalLayer *m_ll;           //!< Local layer
+        Mutex m_mutex{"Client"};                  //!< Mutex to prevent race conditions
+        Mutex m_dscvSyncMutex{"Client/dscvSync"}; //!< Mutex for GW discovery/time sync
+        ClientConfig m_conf;                      //!< Configuration
+        ILocalLayer *m_ll;                        //!< Local layer
         WildcardTrie<SubCb> m_subDB; //!< Subscription database
+
+        //! Stream acknowledgements pending for sending (latest by ack topic
+        //! and transfer ID), declared before timers to outlive them
+        std::map<std::pair<std::string, uint32_t>, std::string> m_streamAcks;
+
         Timer m_subDBTimer;          //!< Sub DB timer
         Timer m_timeSyncTimer;       //!< Time synchronization timer
+        Timer m_groupAckTimer;       //!< Group data acknowledgement timer
+        Timer m_streamAckTimer;      //!< Stream acknowledgement timer
         LocalPeer m_gw;              //!< Gateway
+        DeltaCodec m_deltaTx;        //!< Delta codec of publications
+        DeltaCodec m_deltaRx;        //!< Delta codec of received data
+        double m_streamLossRate = 0; //!< Loss rate of last stream transfer
+
+        //! Filters of urgent publications (see `ClientConfig::Slotted`)
+        std::vector<Filter> m_urgentFilters;
 
         //! Messages pending for responses
         std::unordered_map<uint16_t, PendingMsg> m_pendingMsgs;
@@ -83,6 +153,12 @@ namespace kvik
         //! Counter of recently failed time sync attempts
         uint16_t m_timeSyncNoRespCnt = 0;
 
+        //! Expiration of subscriptions at gateway (system clock)
+        std::chrono::system_clock::time_point m_subsLeaseExpiry = {};
+
+        //! Restored subscriptions not yet claimed by `subscribe()`
+        std::unordered_set<std::string> m_restoredSubs;
+
         /**
          * @brief Ignore invalid message timestamp
          *
@@ -91,18 +167,44 @@ namespace kvik
          */
         bool m_ignoreInvalidMsgTs = false;
 
+        //! Whether group data acknowledgement is scheduled
+        bool m_groupAckScheduled = false;
+
         //! Gateway discovery loop run flag
         bool m_dscvLoopRun = true;
 
         //! Gateway discovery loop conditional variable
-        std::condition_variable m_dscvLoopCv;
+        CondVar m_dscvLoopCv;
 
         //! Gateway watchdog conditional variable
-        std::condition_variable m_gwWdCv;
+        CondVar m_gwWdCv;
 
         //! Gateway watchdog thread
         std::thread m_gwWdThread;
 
+        //! Whether gateway has been acquired
+        bool m_ready = false;
+
+        //! Readiness conditional variable
+        CondVar m_readyCv;
+
+        //! Readiness promise
+        std::promise<ErrCode> m_readyPromise;
+
+        //! Readiness future
+        std::shared_future<ErrCode> m_readyFuture;
+
+        //! Background gateway acquisition thread (asynchronous start only)
+        std::thread m_acquireThread;
+
+        /**
+         * @brief ID of thread acquiring gateway
+         *
+         * Background acquisition thread, or constructing thread while
+         * synchronous constructor acquires gateway.
+         */
+        std::thread::id m_acquireThreadId;
+
     public:
         /**
          * @brief Constructs a new client node
@@ -112,6 +214,9 @@ namespace kvik
          * isn't empty and responds to probe requests, only time
          * synchronization is performed.
          *
+         * With `ClientConfig::Startup::async`, all of this happens in
+         * background and constructor doesn't throw on acquisition failure.
+         *
          * @param conf Configuration
          * @param ll Local layer (must be valid during whole `Client`'s
          * lifetime)
@@ -139,6 +244,7 @@ namespace kvik
          * @param subs Vector of unsubscription requests
          * @retval INVALID_SIZE Supplied data is too big for processing
          * @retval TIMEOUT Timeout while waiting for response
+         * @retval NO_GATEWAY Gateway not acquired yet
          * @retval MSG_PROCESSING_FAILED Gateway processing failed
          * @retval SUCCESS Successful action
          */
@@ -150,6 +256,7 @@ namespace kvik
          * @brief Unsubscribes from all topics
          * @retval INVALID_SIZE Supplied data is too big for processing
          * @retval TIMEOUT Timeout while waiting for response
+         * @retval NO_GATEWAY Gateway not acquired yet
          * @retval MSG_PROCESSING_FAILED Gateway processing failed
          * @retval SUCCESS Successful action
          */
@@ -159,6 +266,7 @@ namespace kvik
          * @brief Resubscribes to all topics
          * @retval INVALID_SIZE Supplied data is too big for processing
          * @retval TIMEOUT Timeout while waiting for response
+         * @retval NO_GATEWAY Gateway not acquired yet
          * @retval MSG_PROCESSING_FAILED Gateway processing failed
          * @retval SUCCESS Successful action
          */
@@ -203,7 +311,70 @@ namespace kvik
          */
         const ClientRetainedData retain();
 
+        /**
+         * @brief Checks whether gateway has been acquired
+         * @return true Client is ready
+         * @return false Gateway acquisition is still in progress
+         */
+        bool isReady();
+
+        /**
+         * @brief Returns readiness future
+         *
+         * Resolves with `SUCCESS` once gateway is acquired, or with
+         * `NO_GATEWAY` if client is destroyed before that.
+         * Always resolved after synchronous construction.
+         *
+         * @return Readiness future
+         */
+        std::shared_future<ErrCode> getReadyFuture() const;
+
+        /**
+         * @brief Publishes data too big for single message
+         *
+         * Data are split into chunks published to `topic` without waiting
+         * for gateway's responses. Receiver acknowledges them end-to-end on
+         * `topic` + level separator + `STREAM_ACK_LEVEL` (see
+         * `subscribeStream()`), lost chunks are retransmitted selectively.
+         * Number of chunks in flight is limited by
+         * `ClientConfig::Stream::window`.
+         *
+         * Failed transfer can be resumed by calling this method again with
+         * the same `transferId` (e.g. after reboot or gateway change). Only
+         * chunks receiver doesn't have are sent then.
+         *
+         * Blocks until whole transfer is acknowledged.
+         *
+         * @param topic Topic
+         * @param data Data
+         * @param transferId Transfer ID (0 to start new transfer, in which
+         * case it's set to generated ID)
+         * @retval INVALID_ARG Invalid topic
+         * @retval NO_GATEWAY Gateway not acquired yet
+         * @retval TIMEOUT Transfer not acknowledged in
+         * `ClientConfig::Stream::timeout`
+         * @retval * Any other code returned by `subscribe()` or local layer
+         */
+        ErrCode publishStream(const std::string &topic, const std::string &data,
+                              uint32_t &transferId);
+
+        /**
+         * @brief Subscribes to data published by `publishStream()`
+         *
+         * Chunks are reassembled and acknowledged, `cb` is called once
+         * whole data are received. Chunks of incomplete transfers are
+         * kept, so sender can resume them.
+         *
+         * @param topic Topic (or filter)
+         * @param cb Callback for received data
+         * @return Error code returned by `subscribe()`
+         */
+        ErrCode subscribeStream(const std::string &topic, StreamCb cb);
+
     protected:
+        ErrCode subscribeFilter(const Filter &filter, SubCb cb) override;
+        ErrCode unsubscribeFilter(const Filter &filter) override;
+
         /**
          * @brief Sends local message and waits for the response
          *
@@ -229,12 +400,30 @@ namespace kvik
          * @param msg Message to send (prepared in-place)
          * @param respMsg Response message (modified in-place)
          * @param noResp Send without waiting for response
+         * @param waitSlot Defer message to its uplink slot (should be false
+         * on receive and timer threads)
          * @retval TIMEOUT Timeout while waiting for the response
          * @retval NO_GATEWAY No gateway
          * @retval SUCCESS Successfully delivered
          */
         ErrCode sendLocalUnchecked(LocalMsg &msg, LocalMsg &respMsg,
-                                   bool noResp = false);
+                                   bool noResp = false, bool waitSlot = true);
+
+        /**
+         * @brief Publishes data without waiting for gateway's response
+         *
+         * Used for stream chunks and acknowledgements, which are
+         * acknowledged end-to-end.
+         *
+         * @param topic Topic
+         * @param payload Payload
+         * @param waitSlot Defer message to its uplink slot
+         * @retval NO_GATEWAY No gateway
+         * @retval * Any other code returned by local layer
+         */
+        ErrCode publishUnacked(const std::string &topic,
+                               const std::string &payload,
+                               bool waitSlot = true);
 
         /**
          * @brief Sends local broadcast message and waits for any responses
@@ -246,10 +435,22 @@ namespace kvik
          *
          * @param msg Message to send (prepared in-place)
          * @param respMsgs Response messages (modified in-place)
+         * @param waitOp Operation to account waiting for responses as
          * @retval SUCCESS Always
          */
-        ErrCode sendLocalUncheckedBroadcast(LocalMsg &msg,
-                                            LocalMsgVector &respMsgs);
+        ErrCode sendLocalUncheckedBroadcast(
+            LocalMsg &msg, LocalMsgVector &respMsgs,
+            EnergyOp waitOp = EnergyOp::BROADCAST_WAIT);
+
+        /**
+         * @brief Sends message over local layer
+         *
+         * Accounts transmission in energy accounting.
+         *
+         * @param msg Prepared message
+         * @return Error code returned by local layer
+         */
+        ErrCode transmit(const LocalMsg &msg);
 
         /**
          * @brief Sets all common message fields for transmission
@@ -276,6 +477,87 @@ namespace kvik
                                 uint16_t channel);
 
     private:
+        /**
+         * @brief Acquires gateway
+         *
+         * Time syncs with retained gateway (if any), falls back to gateway
+         * discovery.
+         *
+         * @param retainedData Retained data
+         * @param maxAttempts Maximum number of discovery attempts (value 0
+         * means infinity)
+         * @retval TOO_MANY_FAILED_ATTEMPTS Acquisition failed
+         * @retval SUCCESS Gateway acquired (or cancelled by destructor)
+         */
+        ErrCode acquireGateway(const ClientRetainedData &retainedData,
+                               size_t maxAttempts);
+
+        /**
+         * @brief Background gateway acquisition thread handler
+         * @param retainedData Retained data
+         */
+        void acquireHandler(ClientRetainedData retainedData);
+
+        /**
+         * @brief Restores subscription database from retained data
+         *
+         * Restored topics have no callbacks until claimed by
+         * `subscribe()`. Does nothing if lease already expired.
+         *
+         * @param subs Retained subscriptions
+         */
+        void restoreSubs(const RetainedSubs &subs);
+
+        /**
+         * @brief Dumps subscription database to retained table
+         *
+         * Must be called with `m_mutex` locked.
+         *
+         * @return Retained subscriptions
+         */
+        RetainedSubs retainSubs();
+
+        /**
+         * @brief Marks client as ready and notifies all waiters
+         */
+        void setReady();
+
+        /**
+         * @brief Applies early operation policy
+         *
+         * Calls from background acquisition itself (e.g. RSSI reports)
+         * are never blocked.
+         *
+         * @retval NO_GATEWAY Not ready (fail-fast policy or destroyed)
+         * @retval TIMEOUT Not ready in time (wait policy)
+         * @retval SUCCESS Client is ready
+         */
+        ErrCode waitReady();
+
+        /**
+         * @brief Renews all subscriptions at gateway
+         *
+         * Uses subscription set digest if enabled in configuration.
+         *
+         * @retval INVALID_SIZE Supplied data is too big for processing
+         * @retval TIMEOUT Timeout while waiting for response
+         * @retval MSG_PROCESSING_FAILED Gateway processing failed
+         * @retval SUCCESS Successful action
+         */
+        ErrCode renewSubs();
+
+        /**
+         * @brief Collects all subscribed topics
+         *
+         * Including restored subscriptions not yet claimed by
+         * `subscribe()`, which are still held by gateway.
+         *
+         * Not multithread safe.
+         *
+         * @return Topics
+         */
+        std::vector<std::string> getSubTopics();
+
         /**
          * @brief Subscription DB timer tick callback
          *
@@ -320,6 +602,32 @@ namespace kvik
          */
         ErrCode recvLocalResp(const LocalMsg &msg);
 
+        /**
+         * @brief Implementation of `pubSubUnsubBulk()`
+         *
+         * @param pubs Vector of data to publish
+         * @param subs Vector of subscription requests
+         * @param unsubs Vector of unsubscription requests
+         * @param filter Precompiled filter of one of `subs` or `unsubs`
+         * (optional, its levels are used in subscription database)
+         * @return See `pubSubUnsubBulk()`
+         */
+        ErrCode pubSubUnsub(const std::vector<PubData> &pubs,
+                            const std::vector<SubReq> &subs,
+                            const std::vector<std::string> &unsubs,
+                            const Filter *filter);
+
+        /**
+         * @brief Receives subscription data piggybacked on OK
+         *
+         * Acknowledgement is withheld if data can't be decoded.
+         *
+         * @param msg Received OK (already validated)
+         * @retval MSG_PROCESSING_FAILED Delta-encoded data can't be decoded
+         * @retval SUCCESS Successfully processed
+         */
+        ErrCode recvPiggybackedData(const LocalMsg &msg);
+
         /**
          * @brief Receives local subscription data
          *
@@ -331,6 +639,15 @@ namespace kvik
          */
         ErrCode recvLocalSubData(const LocalMsg &msg);
 
+        /**
+         * @brief Calls user callbacks for received subscription data
+         *
+         * @param addr Sender address
+         * @param subsData Subscription data
+         */
+        void dispatchSubData(const LocalAddr &addr,
+                             const std::vector<SubData> &subsData);
+
         /**
          * @brief Reports gateway RSSI values after successful discovery
          *
@@ -341,5 +658,101 @@ namespace kvik
          * @retval * Any other code returned by `publishBulk`
          */
         ErrCode reportGwDscvRssi(const LocalPeerSet &gws);
+
+        /**
+         * @brief Checks whether group-addressed data should be delivered
+         *
+         * Must be called with `m_mutex` locked.
+         *
+         * @param msg Group-addressed SUB_DATA
+         * @retval NOT_FOUND Client isn't recipient (or has no sync point)
+         * @retval MSG_DUP_ID Data were already received
+         * @retval SUCCESS Data should be delivered
+         */
+        ErrCode checkGroupSeq(const LocalMsg &msg) const;
+
+        /**
+         * @brief Processes sequence number of group-addressed data
+         *
+         * Updates window of received group data and schedules
+         * acknowledgement.
+         *
+         * @param msg Group-addressed SUB_DATA
+         * @retval NOT_FOUND Client isn't recipient (or has no sync point)
+         * @retval MSG_DUP_ID Data were already received
+         * @retval SUCCESS Data should be delivered
+         */
+        ErrCode processGroupSeq(const LocalMsg &msg);
+
+        /**
+         * @brief Finds oldest missing group data
+         *
+         * Must be called with `m_mutex` locked.
+         *
+         * @param seq Sequence number of missing data (modified in-place)
+         * @return true Gap found
+         * @return false No gap in received group data
+         */
+        bool findGroupSeqGap(uint16_t &seq) const;
+
+        /**
+         * @brief Sends acknowledgement of group-addressed data
+         *
+         * FAIL with `GROUP_SEQ_GAP` if some data are missing, cumulative
+         * OK otherwise (if enabled).
+         */
+        void sendGroupAck();
+
+        /**
+         * @brief Sends pending stream acknowledgements
+         *
+         * Called by stream acknowledgement timer, so that stream
+         * subscription callbacks don't send from receive thread.
+         */
+        void sendStreamAcks();
+
+        /**
+         * @brief Delta-encodes payloads of publications (if enabled)
+         * @param msg PUB_SUB_UNSUB message (modified in-place)
+         * @return true Some payloads are sent as delta
+         * @return false All payloads are sent in full (or not encoded)
+         */
+        bool deltaEncodePubs(LocalMsg &msg);
+
+        /**
+         * @brief Updates delta codec after delivery of publications
+         * @param msg Sent PUB_SUB_UNSUB message
+         * @param delivered Whether message was delivered
+         */
+        void deltaFinishPubs(const LocalMsg &msg, bool delivered);
+
+        /**
+         * @brief Decodes delta-encoded received data
+         * @param msg SUB_DATA message
+         * @param subsData Decoded data (modified in-place)
+         * @retval INVALID_ARG Malformed frame
+         * @retval NOT_FOUND Base of delta frame is unknown
+         * @retval SUCCESS Decoded
+         */
+        ErrCode deltaDecodeSubs(const LocalMsg &msg,
+                                std::vector<SubData> &subsData);
+
+        /**
+         * @brief Waits for uplink slot of the message
+         *
+         * Returns immediately if slotted access isn't used, no slot is
+         * assigned, the message is a response or destructor was called.
+         *
+         * @param msg Message to send
+         */
+        void waitUplinkSlot(const LocalMsg &msg);
+
+        /**
+         * @brief Checks whether message contains urgent publication
+         * @param msg PUB_SUB_UNSUB message
+         * @return true Message is urgent
+         * @return false Message isn't urgent
+         */
+        bool isUrgent(const LocalMsg &msg) const;
     };
 } // namespace kvik
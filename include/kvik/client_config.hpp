@@ -11,6 +11,9 @@
 
 #include <chrono>
 #include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
 
 #include "kvik/node.hpp"
 #include "kvik/node_config.hpp"
@@ -113,6 +116,41 @@ namespace kvik
              * (default is 15 minutes).
              */
             std::chrono::milliseconds subLifetime = std::chrono::minutes(10);
+
+            /**
+             * @brief Renew subscriptions using subscription set digest
+             *
+             * When enabled, renewals (`resubscribeAll()` and periodic
+             * renewals) first send only a compact digest of subscribed
+             * topics. Full topics are sent only if gateway reports it
+             * doesn't hold matching subscription set.
+             * Digest is also attached to time synchronization probes; on
+             * mismatch, client resubscribes immediately (e.g. after
+             * gateway restart).
+             *
+             * Gateway not supporting digests is detected by its response
+             * to full subscriptions (which doesn't report a match). Digests
+             * aren't sent to that gateway anymore, so only the first
+             * renewal costs an additional message.
+             */
+            bool digestRenewal = false;
+
+            /**
+             * @brief Retain subscriptions across deep sleep
+             *
+             * When enabled, `Client::retain()` stores subscribed topics
+             * (up to `KVIK_RETAINED_SUBS_MAX` topics of at most
+             * `KVIK_RETAINED_TOPIC_MAX_LEN` characters) together with
+             * their lease at gateway. Requires `KVIK_RETAINED_SUBS_MAX` to
+             * be defined to non-zero capacity for the whole build, otherwise
+             * no topics are retained. Constructor restores them without any
+             * network traffic while the lease is valid, so `subscribe()`
+             * of a restored topic only sets its callback locally.
+             *
+             * If gateway changes after wake up, restored subscriptions are
+             * renewed at the new gateway.
+             */
+            bool retainSubs = false;
         };
 
         struct TimeSync
@@ -147,10 +185,182 @@ namespace kvik
                 std::chrono::minutes(60);
         };
 
+        struct GroupData
+        {
+            /**
+             * @brief Acknowledge group-addressed data positively
+             *
+             * Group-addressed data (single broadcast SUB_DATA for many
+             * clients) aren't acknowledged immediately by each recipient.
+             *
+             * When set to `true`, client sends single cumulative OK after
+             * random delay (up to `ackJitter`), covering all group data
+             * received in the meantime.
+             * When set to `false`, client sends only negative
+             * acknowledgements when gap in sequence is detected.
+             */
+            bool positiveAcks = true;
+
+            //! Maximum random delay of cumulative acknowledgement
+            std::chrono::milliseconds ackJitter =
+                std::chrono::milliseconds(200);
+        };
+
+        struct Startup
+        {
+            /**
+             * @brief Policy for operations issued before gateway is
+             * acquired
+             */
+            enum class EarlyOpPolicy : uint8_t
+            {
+                FAIL_FAST = 0, //!< Return `NO_GATEWAY` immediately
+                WAIT,          //!< Block until gateway is acquired
+            };
+
+            /**
+             * @brief Acquire gateway in background
+             *
+             * When set to `false`, constructor blocks until time sync with
+             * retained gateway or gateway discovery (up to
+             * `GatewayDiscovery::initialDscvFailThres` attempts) succeeds
+             * and throws on failure.
+             *
+             * When set to `true`, constructor returns immediately and
+             * acquisition continues in background thread, retrying
+             * indefinitely. Readiness is reported by
+             * `Client::getReadyFuture()` and `readyCb`.
+             */
+            bool async = false;
+
+            //! Policy for publications and (un)subscriptions before readiness
+            EarlyOpPolicy earlyOps = EarlyOpPolicy::FAIL_FAST;
+
+            /**
+             * @brief Maximum blocking time of early operations
+             *
+             * Used only with `EarlyOpPolicy::WAIT`. Operations waiting
+             * longer return `TIMEOUT`.
+             */
+            std::chrono::milliseconds earlyOpTimeout = std::chrono::seconds(30);
+
+            /**
+             * @brief Readiness callback
+             *
+             * Called once gateway is acquired and client is ready, before
+             * ready future is set (from background thread in asynchronous
+             * mode), so it can already publish and subscribe.
+             */
+            std::function<void()> readyCb = nullptr;
+        };
+
+        struct Stream
+        {
+            /**
+             * @brief Maximum length of chunk data
+             *
+             * Chunk header (15 bytes) and topic have to fit into single
+             * local frame along with it.
+             */
+            uint16_t chunkSize = 180;
+
+            //! Maximum number of chunks in flight
+            size_t window = 8;
+
+            /**
+             * @brief Retransmission timeout
+             *
+             * Unacknowledged chunks are sent again after this time. Chunks
+             * overtaken by acknowledged ones are retransmitted immediately.
+             */
+            std::chrono::milliseconds rto = std::chrono::milliseconds(500);
+
+            //! Maximum duration of whole transfer
+            std::chrono::milliseconds timeout = std::chrono::seconds(60);
+
+            //! Maximum number of incomplete received transfers per topic
+            size_t maxRecvTransfers = 2;
+
+            //! Maximum length of received data
+            size_t maxRecvLen = 64 * 1024;
+
+            /**
+             * @brief Number of chunks protected by common parity (0 disables
+             * forward error correction)
+             *
+             * Parity chunks (Reed-Solomon) are sent only when receiver
+             * reports losses and their number adapts to measured loss rate.
+             */
+            size_t fecGroup = 0;
+
+            //! Maximum number of parity chunks per group
+            size_t fecMaxParity = 4;
+
+            /**
+             * @brief Idle timeout of incomplete received transfers
+             *
+             * Transfers without any chunk for this long are dropped (and
+             * can't be resumed anymore), so abandoned transfers don't
+             * block new ones.
+             */
+            std::chrono::milliseconds recvIdleTimeout = std::chrono::minutes(5);
+        };
+
+        struct Delta
+        {
+            /**
+             * @brief Publish payloads delta-encoded
+             *
+             * Payloads are sent as difference against the last payload of
+             * the same topic acknowledged by gateway (see `DeltaCodec`).
+             * Gateway must support delta frames.
+             *
+             * Received delta-encoded data are decoded regardless of this
+             * setting.
+             */
+            bool enable = false;
+
+            //! Maximum number of tracked topics (per direction)
+            size_t maxTopics = 16;
+
+            //! Maximum length of tracked payload
+            size_t maxPayloadLen = 250;
+        };
+
+        struct Slotted
+        {
+            /**
+             * @brief Use uplink slots assigned by gateway
+             *
+             * When enabled and gateway assigns a slot (see `UplinkSlot`),
+             * requests are deferred to the next occurrence of client's
+             * slot, so clients on the same channel don't collide.
+             * Time synchronization probes and publications of
+             * `urgentTopics` are sent in the next contention slot instead.
+             * Responses to gateway are never deferred.
+             *
+             * Without assigned slot, messages are sent immediately.
+             */
+            bool enable = false;
+
+            /**
+             * @brief Topic filters of urgent publications
+             *
+             * Requests containing publication matching any of the filters
+             * use the contention slot.
+             */
+            std::vector<std::string> urgentTopics;
+        };
+
         NodeConfig nodeConf;
         GatewayDiscovery gwDscv;
         Reporting reporting;
         SubDB subDB;
         TimeSync timeSync;
+        GroupData groupData;
+        Startup startup;
+        Stream stream;
+        Delta delta;
+        Slotted slotted;
     };
 } // namespace kvik
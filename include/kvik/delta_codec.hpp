@@ -0,0 +1,160 @@
+/**
+ * @file delta_codec.hpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Stateful per-topic delta encoding of payloads
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#include "kvik/errors.hpp"
+#include "kvik/local_addr.hpp"
+
+namespace kvik
+{
+    /**
+     * @brief Stateful per-topic delta encoding of payloads
+     *
+     * Successive payloads of the same topic are often nearly identical
+     * (counters, slowly changing JSON). Both ends of a link keep the last
+     * acknowledged payload (base) of each topic and publications carry
+     * only XOR of the new payload and the base, with zero runs collapsed.
+     *
+     * Frames:
+     * - full: `0x00 | seq | payload`,
+     * - delta: `0x01 | base seq | seq | varint length | ops`, where each
+     *   op is `varint zero run | varint literal length | literal XOR bytes`
+     *   (trailing zeros are omitted).
+     *
+     * Full frame is sent whenever there's no confirmed base or delta frame
+     * wouldn't be shorter. Receiver decoding delta against unknown base
+     * fails and sender falls back to full frame after `invalidate()`.
+     *
+     * Single instance holds state of single direction of a link to single
+     * peer (see `bindPeer()`). Memory is bounded by number of tracked
+     * topics (least recently used ones are evicted) and payload length
+     * (longer payloads are always sent in full).
+     *
+     * Not multithread safe.
+     */
+    class DeltaCodec
+    {
+        /**
+         * @brief State of single topic
+         */
+        struct Entry
+        {
+            std::string topic;
+            std::string base;        //!< Last acknowledged payload
+            uint8_t baseSeq = 0;     //!< Sequence number of base
+            bool hasBase = false;    //!< Whether base is valid
+            std::string pending;     //!< Last sent unacknowledged payload
+            uint8_t pendingSeq = 0;  //!< Sequence number of pending payload
+            bool hasPending = false; //!< Whether pending payload is valid
+            uint8_t nextSeq = 0;     //!< Next sequence number (sender only)
+        };
+
+        size_t m_maxTopics;
+        size_t m_maxPayloadLen;
+        LocalAddr m_peer = {};
+
+        //! Entries, most recently used first
+        std::list<Entry> m_entries;
+        std::unordered_map<std::string, std::list<Entry>::iterator> m_index;
+
+    public:
+        /**
+         * @brief Constructs a new codec
+         * @param maxTopics Maximum number of tracked topics
+         * @param maxPayloadLen Maximum length of tracked payload
+         */
+        DeltaCodec(size_t maxTopics = 16, size_t maxPayloadLen = 250);
+
+        /**
+         * @brief Binds codec to peer
+         *
+         * All state is dropped if peer changes (e.g. after gateway
+         * change), so next frames are sent in full.
+         *
+         * @param peer Peer address
+         */
+        void bindPeer(const LocalAddr &peer);
+
+        /**
+         * @brief Encodes payload (sender)
+         *
+         * Payload becomes pending until `confirm()` or `invalidate()`.
+         *
+         * @param topic Topic
+         * @param payload Payload
+         * @return Frame
+         */
+        std::string encode(const std::string &topic,
+                           const std::string &payload);
+
+        /**
+         * @brief Confirms delivery of last encoded payload (sender)
+         *
+         * Confirmed payload becomes base of next delta frames.
+         *
+         * @param topic Topic
+         */
+        void confirm(const std::string &topic);
+
+        /**
+         * @brief Invalidates state of topic after delivery failure
+         *
+         * Next frame of topic is sent in full.
+         *
+         * @param topic Topic
+         */
+        void invalidate(const std::string &topic);
+
+        /**
+         * @brief Decodes frame (receiver)
+         * @param topic Topic
+         * @param frame Frame
+         * @param payload Decoded payload (modified in-place)
+         * @retval INVALID_ARG Malformed frame
+         * @retval NOT_FOUND Base of delta frame is unknown
+         * @retval SUCCESS Decoded
+         */
+        ErrCode decode(const std::string &topic, const std::string &frame,
+                       std::string &payload);
+
+        /**
+         * @brief Checks whether frame is delta frame
+         * @param frame Frame
+         * @return true Delta frame
+         * @return false Full or malformed frame
+         */
+        static bool isDelta(const std::string &frame);
+
+        /**
+         * @brief Drops all state
+         */
+        void clear();
+
+        /**
+         * @brief Returns number of tracked topics
+         * @return Number of topics
+         */
+        size_t size() const;
+
+    private:
+        /**
+         * @brief Finds entry of topic and marks it most recently used
+         * @param topic Topic
+         * @param insert Whether to insert missing entry
+         * @return Entry (`nullptr` if not found and not inserted)
+         */
+        Entry *touch(const std::string &topic, bool insert);
+    };
+} // namespace kvik
@@ -0,0 +1,199 @@
+/**
+ * @file downlink_scheduler.hpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Fair downlink scheduler for Kvik
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "kvik/errors.hpp"
+#include "kvik/layers.hpp"
+#include "kvik/local_addr.hpp"
+#include "kvik/local_msg.hpp"
+#include "kvik/mutex.hpp"
+
+namespace kvik
+{
+    /**
+     * @brief Downlink scheduler configuration
+     */
+    struct DownlinkSchedulerConfig
+    {
+        /**
+         * @brief Quantum of deficit round robin (in bytes)
+         *
+         * Each client's queue of given class may send this many bytes
+         * multiplied by class weight in every round.
+         */
+        size_t quantum = 256;
+
+        /**
+         * @brief Maximum number of queued messages per client
+         *
+         * Further messages are rejected with `QUEUE_FULL`.
+         * Keeps tail latency of all other clients bounded.
+         */
+        size_t maxClientQueueLen = 16;
+
+        /**
+         * @brief Weights of traffic classes
+         *
+         * Class index is position in vector. `send()` uses class 0 for
+         * responses (OK, FAIL, PROBE_RES) and class 1 for everything else
+         * (SUB_DATA), if present.
+         * Weights must be nonzero.
+         */
+        std::vector<uint8_t> classWeights = {4, 1};
+    };
+
+    /**
+     * @brief Fair downlink scheduler
+     *
+     * Local layer decorator scheduling outgoing messages using deficit
+     * round robin keyed by destination address and traffic class.
+     * A client receiving burst of messages can't starve other clients'
+     * deliveries on the shared medium.
+     *
+     * Messages are sent from scheduler's own thread. Receiving and
+     * channel operations are passed through to the underlying layer.
+     *
+     * All public methods are multithread safe.
+     */
+    class DownlinkScheduler : public ILocalLayer
+    {
+        using FlowKey = std::pair<LocalAddr, uint8_t>;
+
+        /**
+         * @brief Queue of single client and class
+         */
+        struct Flow
+        {
+            std::deque<LocalMsg> queue; //!< Queued messages
+            size_t deficit = 0;         //!< Deficit counter (bytes)
+            bool active = false;        //!< Whether flow is in active list
+            bool quantumGiven = false;  //!< Whether quantum was given in current turn
+        };
+
+        /**
+         * @brief Queues of single client
+         */
+        struct ClientQueues
+        {
+            std::vector<Flow> flows; //!< Flows by class
+            size_t queuedCnt = 0;    //!< Number of queued messages
+        };
+
+        DownlinkSchedulerConfig m_conf;
+        ILocalLayer *m_ll;
+
+        Mutex m_mutex{"DownlinkScheduler"};
+        CondVar m_cv;     //!< Wakes up sender thread
+        CondVar m_idleCv; //!< Notifies `flush()`
+        std::unordered_map<LocalAddr, ClientQueues> m_clients;
+        std::deque<FlowKey> m_active; //!< Active flows in round robin order
+        size_t m_queuedCnt = 0;       //!< Total number of queued messages
+        bool m_sending = false;       //!< Whether a message is being sent
+        bool m_run = true;
+        std::thread m_thread;
+
+    public:
+        /**
+         * @brief Constructs a new downlink scheduler
+         * @param conf Configuration
+         * @param ll Underlying local layer (must be valid during whole
+         * scheduler's lifetime)
+         * @throw kvik::Exception Invalid parameters
+         */
+        DownlinkScheduler(DownlinkSchedulerConfig conf, ILocalLayer *ll);
+
+        /**
+         * @brief Destroys the scheduler
+         *
+         * Messages still queued are dropped.
+         */
+        ~DownlinkScheduler();
+
+        /**
+         * @brief Enqueues message for sending
+         *
+         * Class is chosen by message type (see
+         * `DownlinkSchedulerConfig::classWeights`).
+         *
+         * @param msg Message
+         * @retval QUEUE_FULL Destination client's queue is full
+         * @retval SUCCESS Message enqueued
+         */
+        ErrCode send(const LocalMsg &msg);
+
+        /**
+         * @brief Enqueues message for sending in given class
+         * @param msg Message
+         * @param cls Traffic class
+         * @retval INVALID_ARG Invalid class
+         * @retval QUEUE_FULL Destination client's queue is full
+         * @retval SUCCESS Message enqueued
+         */
+        ErrCode send(const LocalMsg &msg, uint8_t cls);
+
+        const Channels &getChannels();
+        ErrCode setChannel(uint16_t ch);
+
+        /**
+         * @brief Estimates airtime of the message
+         *
+         * Time spent in queue isn't included.
+         *
+         * @param msg Message
+         * @return Estimate of underlying layer
+         */
+        std::chrono::microseconds estimateAirtime(const LocalMsg &msg);
+
+        /**
+         * @brief Returns number of queued messages
+         * @return Number of queued messages
+         */
+        size_t queuedCnt();
+
+        /**
+         * @brief Waits until all queued messages are sent
+         */
+        void flush();
+
+    private:
+        /**
+         * @brief Sender thread handler
+         */
+        void senderThread();
+
+        /**
+         * @brief Picks next message to send using deficit round robin
+         *
+         * Not multithread safe.
+         *
+         * @param msg Message (modified in-place)
+         * @return true Message picked
+         * @return false Nothing to send
+         */
+        bool pickNext(LocalMsg &msg);
+
+        /**
+         * @brief Estimates transmission cost of message
+         * @param msg Message
+         * @return Cost in bytes
+         */
+        static size_t msgCost(const LocalMsg &msg);
+    };
+} // namespace kvik
@@ -0,0 +1,191 @@
+/**
+ * @file energy_meter.hpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Radio-on time and energy accounting
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include "kvik/mutex.hpp"
+
+namespace kvik
+{
+    /**
+     * @brief Radio state
+     */
+    enum class RadioState : uint8_t
+    {
+        TX = 0, //!< Transmitting
+        RX,     //!< Receiving or listening
+    };
+
+    /**
+     * @brief Accounted radio operation
+     */
+    enum class EnergyOp : uint8_t
+    {
+        TX = 0,         //!< Message transmission
+        RESP_WAIT,      //!< Waiting for unicast response
+        BROADCAST_WAIT, //!< Waiting for responses to broadcast
+        CHANNEL_SCAN,   //!< Switching and probing channels during discovery
+        COUNT,          //!< Number of operations (not an operation)
+    };
+
+    /**
+     * @brief Converts energy operation to string
+     * @param op Operation
+     * @return Operation name
+     */
+    const char *energyOpToStr(EnergyOp op);
+
+    /**
+     * @brief Interface for radio power model
+     */
+    class IPowerModel
+    {
+    public:
+        virtual ~IPowerModel() = default;
+
+        /**
+         * @brief Returns power draw in given radio state
+         * @param state Radio state
+         * @return Power in watts
+         */
+        virtual double power(RadioState state) const = 0;
+    };
+
+    /**
+     * @brief Power model with constant power draw per radio state
+     */
+    class ConstPowerModel : public IPowerModel
+    {
+        double m_txPower;
+        double m_rxPower;
+
+    public:
+        /**
+         * @brief Constructs power model
+         *
+         * Defaults approximate ESP32 Wi-Fi radio at 3.3 V.
+         *
+         * @param txPower Power while transmitting (watts)
+         * @param rxPower Power while receiving or listening (watts)
+         */
+        ConstPowerModel(double txPower = 0.6, double rxPower = 0.33)
+            : m_txPower{txPower}, m_rxPower{rxPower}
+        {
+        }
+
+        double power(RadioState state) const
+        {
+            return state == RadioState::TX ? m_txPower : m_rxPower;
+        }
+    };
+
+    /**
+     * @brief Accumulates radio-on time and energy of node operations
+     *
+     * Energy of each operation is its duration multiplied by power of
+     * corresponding radio state (transmission draws TX power, everything
+     * else RX power).
+     *
+     * All public methods are multithread safe.
+     */
+    class EnergyMeter
+    {
+    public:
+        /**
+         * @brief Totals of single operation
+         */
+        struct OpStats
+        {
+            uint64_t cnt = 0;                  //!< Number of records
+            std::chrono::microseconds time{0}; //!< Total radio-on time
+            double energy = 0.0;               //!< Total energy (joules)
+        };
+
+        /**
+         * @brief Energy snapshot
+         */
+        struct Snapshot
+        {
+            //! Totals per operation (indexed by `EnergyOp`)
+            std::array<OpStats, static_cast<size_t>(EnergyOp::COUNT)> ops;
+
+            uint64_t delivered = 0; //!< Number of delivered messages
+
+            /**
+             * @brief Returns totals of operation
+             * @param op Operation
+             * @return Totals
+             */
+            const OpStats &op(EnergyOp op) const
+            {
+                return ops[static_cast<size_t>(op)];
+            }
+
+            /**
+             * @brief Returns total radio-on time
+             * @return Time
+             */
+            std::chrono::microseconds totalTime() const;
+
+            /**
+             * @brief Returns total energy
+             * @return Energy (joules)
+             */
+            double totalEnergy() const;
+
+            /**
+             * @brief Returns energy per delivered message
+             * @return Energy (joules), 0 if nothing was delivered
+             */
+            double energyPerDelivered() const;
+        };
+
+    private:
+        mutable Mutex m_mutex{"EnergyMeter"};
+        std::shared_ptr<const IPowerModel> m_powerModel;
+        Snapshot m_snap;
+
+    public:
+        /**
+         * @brief Constructs energy meter
+         * @param powerModel Power model (`nullptr` for default
+         * `ConstPowerModel`)
+         */
+        EnergyMeter(std::shared_ptr<const IPowerModel> powerModel = nullptr);
+
+        /**
+         * @brief Records operation
+         * @param op Operation
+         * @param time Radio-on time
+         */
+        void record(EnergyOp op, std::chrono::microseconds time);
+
+        /**
+         * @brief Records delivered message
+         */
+        void recordDelivered();
+
+        /**
+         * @brief Takes snapshot of totals
+         * @return Snapshot
+         */
+        Snapshot snapshot() const;
+
+        /**
+         * @brief Clears all totals
+         */
+        void clear();
+    };
+} // namespace kvik
@@ -36,6 +36,7 @@ namespace kvik
         TIMEOUT = 0x14,
         TOO_MANY_FAILED_ATTEMPTS = 0x15,
         NO_GATEWAY = 0x16,
+        QUEUE_FULL = 0x17,
 
         // Error codes corresponding to `LocalMsgFailReason`
         MSG_DUP_ID = 0x101,
@@ -0,0 +1,72 @@
+/**
+ * @file fec.hpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Forward error correction (Reed-Solomon erasure code)
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "kvik/errors.hpp"
+
+namespace kvik
+{
+    //! Maximum number of data and parity shards of single group
+    constexpr size_t FEC_MAX_SHARDS = 255;
+
+    /**
+     * @brief Computes parity shards of group of data shards
+     *
+     * Systematic Reed-Solomon erasure code over GF(2^8) using Cauchy
+     * matrix: any `data.size()` of data and parity shards are enough to
+     * reconstruct the data.
+     *
+     * Parity shard `j` depends only on data shards and `j`, so parity
+     * count can be chosen freely per group (and receiver doesn't need to
+     * know it).
+     *
+     * @param data Data shards (of equal length)
+     * @param parityCnt Number of parity shards
+     * @param parity Parity shards (cleared and filled in-place)
+     * @retval INVALID_ARG No data shards or too many shards
+     * @retval INVALID_SIZE Data shards of different lengths
+     * @retval SUCCESS Parity computed
+     */
+    ErrCode fecEncode(const std::vector<std::string> &data, size_t parityCnt,
+                      std::vector<std::string> &parity);
+
+    /**
+     * @brief Reconstructs missing data shards
+     * @param data Data shards (missing ones are filled in-place)
+     * @param present Whether data shard was received
+     * @param parity Received parity shards (by parity index)
+     * @retval INVALID_ARG Inconsistent arguments or too many shards
+     * @retval INVALID_SIZE Shards of different lengths
+     * @retval NOT_FOUND Not enough shards to reconstruct
+     * @retval SUCCESS All data shards present or reconstructed
+     */
+    ErrCode fecDecode(std::vector<std::string> &data,
+                      const std::vector<bool> &present,
+                      const std::map<size_t, std::string> &parity);
+
+    /**
+     * @brief Chooses number of parity shards for measured loss rate
+     *
+     * Covers expected number of lost shards plus two standard deviations,
+     * so groups are very likely recoverable without retransmissions.
+     * Lossless link gets no parity at all.
+     *
+     * @param dataCnt Number of data shards
+     * @param lossRate Measured loss rate (0 to 1)
+     * @param maxParityCnt Maximum number of parity shards
+     * @return Number of parity shards
+     */
+    size_t fecParityCnt(size_t dataCnt, double lossRate, size_t maxParityCnt);
+} // namespace kvik
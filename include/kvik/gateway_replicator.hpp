@@ -0,0 +1,438 @@
+/**
+ * @file gateway_replicator.hpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Hot-standby replication of gateway state
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "kvik/errors.hpp"
+#include "kvik/local_addr.hpp"
+#include "kvik/mutex.hpp"
+#include "kvik/session_table.hpp"
+#include "kvik/sub_lease_table.hpp"
+
+namespace kvik
+{
+    /**
+     * @brief Interface for replication channel between gateway pair
+     *
+     * Carries opaque frames between active and standby gateway. Frames
+     * may be lost (replicas resynchronize), but mustn't be reordered.
+     */
+    class IReplicationChannel
+    {
+    public:
+        using RecvCb = std::function<void(const std::string &)>;
+
+    protected:
+        RecvCb m_recvCb = nullptr;
+
+    public:
+        /**
+         * @brief Sends frame to peer
+         * @param frame Frame
+         * @retval SUCCESS Successfully sent
+         * @retval * Any other protocol-specific code
+         */
+        virtual ErrCode send(const std::string &frame) = 0;
+
+        /**
+         * @brief Sets receive callback
+         * @param cb Callback
+         */
+        void setRecvCb(RecvCb cb)
+        {
+            m_recvCb = cb;
+        }
+    };
+
+    /**
+     * @brief In-process replication channel
+     *
+     * Delivers frames synchronously to connected peer channel. Suitable
+     * for gateway pairs sharing a process (e.g. serving different radios)
+     * and for testing.
+     */
+    class LoopbackReplicationChannel : public IReplicationChannel
+    {
+        Mutex m_mutex{"LoopbackReplicationChannel"};
+        LoopbackReplicationChannel *m_peer = nullptr;
+        bool m_up = true;
+
+    public:
+        /**
+         * @brief Connects two channels together
+         * @param a First channel
+         * @param b Second channel
+         */
+        static void connect(LoopbackReplicationChannel &a,
+                            LoopbackReplicationChannel &b);
+
+        /**
+         * @brief Sets link state
+         *
+         * Frames sent over link which is down are lost.
+         *
+         * @param up Whether link is up
+         */
+        void setUp(bool up);
+
+        /**
+         * @brief Sends frame to peer
+         * @param frame Frame
+         * @retval NOT_FOUND Not connected
+         * @retval SUCCESS Delivered or lost (link is down)
+         */
+        ErrCode send(const std::string &frame) override;
+    };
+
+    /**
+     * @brief Configuration of `GatewayReplicator`
+     */
+    struct GatewayReplicatorConfig
+    {
+        //! Lifetime of subscription lease
+        std::chrono::milliseconds subLifetime = std::chrono::minutes(15);
+
+        //! Expiration resolution of subscription leases
+        std::chrono::milliseconds leaseResolution = std::chrono::seconds(1);
+
+        //! Maximum number of filters in upstream unsubscription batch
+        size_t unsubBatchSize = 32;
+
+        //! Heartbeat interval of active gateway
+        std::chrono::milliseconds heartbeat = std::chrono::seconds(1);
+
+        //! Silence of active gateway after which it's considered lost
+        std::chrono::milliseconds failoverTimeout = std::chrono::seconds(3);
+
+        //! Maximum length of replication frame
+        size_t maxFrameLen = 1400;
+    };
+
+    /**
+     * @brief Hot-standby replication of gateway state
+     *
+     * Holds state of gateway needed to serve its clients without them
+     * noticing gateway change: client sessions (message ID windows, time
+     * differences, session leases) and subscription leases. Active
+     * gateway streams deltas of this state to standby, which can take
+     * over the same role (and address) with warm state, so clients don't
+     * have to rediscover the gateway and resubscribe.
+     *
+     * Replication frames: `seq (4 B) | records`, each record is
+     * `type (1 B) | length (2 B) | body`. Frame with no records is a
+     * heartbeat. Lease expirations are sent as time remaining, so clocks
+     * of gateways don't have to be synchronized. Subscription changes are
+     * queued in order, changed sessions are coalesced and sent once per
+     * flush.
+     *
+     * Standby requests full snapshot when it starts and whenever it
+     * misses a frame. Standby expires leases only after a grace period,
+     * so renewals delayed by replication don't get lost.
+     *
+     * Received frames are only queued by the receive callback and applied
+     * by `tick()` (all time-dependent logic uses its `now`). All sending
+     * happens in `flush()` / `tick()` too, so channels may deliver frames
+     * synchronously.
+     *
+     * Multithread safe.
+     */
+    class GatewayReplicator
+    {
+    public:
+        using ConsumerId = SubLeaseTable::ConsumerId;
+
+        /**
+         * @brief Role of gateway
+         */
+        enum class Role
+        {
+            ACTIVE,
+            STANDBY,
+        };
+
+        using Config = GatewayReplicatorConfig;
+
+    private:
+        mutable Mutex m_mutex{"GatewayReplicator"};  //!< Mutex guarding state
+        Mutex m_sendMutex{"GatewayReplicator/send"}; //!< Mutex keeping frames in order
+        Config m_conf;                               //!< Configuration
+        IReplicationChannel *m_chan;                 //!< Replication channel
+        Role m_role;                                 //!< Current role
+
+        SessionTable<PeerSession> m_sessions; //!< Client sessions
+        SubLeaseTable m_subs;                 //!< Subscription leases
+        SubLeaseTable::UnsubCb m_unsubCb;     //!< Upstream unsubscriptions
+
+        // Active gateway
+        uint32_t m_txSeq = 0;                  //!< Next frame sequence
+        std::vector<std::string> m_records;    //!< Queued records
+        std::unordered_set<LocalAddr> m_dirty; //!< Changed sessions
+        bool m_snapshotRequested = false;      //!< Standby wants snapshot
+        std::chrono::steady_clock::time_point m_lastTx = {};
+
+        // Standby gateway
+        std::vector<std::string> m_inbox; //!< Received frames
+        uint32_t m_rxSeq = 0;             //!< Expected frame sequence
+        bool m_syncing = false;           //!< Snapshot is being received
+        bool m_synced = false;            //!< State is complete
+        std::chrono::steady_clock::time_point m_lastRx = {};
+        std::chrono::steady_clock::time_point m_lastSyncReq = {};
+
+    public:
+        /**
+         * @brief Constructs a new replicator
+         * @param role Initial role
+         * @param chan Replication channel
+         * @param unsubCb Callback for batch of upstream unsubscriptions
+         * (called only in active role)
+         * @param conf Configuration
+         * @throw kvik::Exception Invalid parameters
+         */
+        GatewayReplicator(Role role, IReplicationChannel *chan,
+                          SubLeaseTable::UnsubCb unsubCb,
+                          const Config &conf = {});
+
+        /**
+         * @brief Destroys the replicator
+         */
+        ~GatewayReplicator();
+
+        GatewayReplicator(const GatewayReplicator &) = delete;
+        GatewayReplicator &operator=(const GatewayReplicator &) = delete;
+
+        /**
+         * @brief Returns current role
+         * @return Role
+         */
+        Role role() const;
+
+        /**
+         * @brief Creates or updates session of client
+         * @param addr Address of client
+         * @param session Session
+         * @retval NOT_SUPPORTED Not active
+         * @retval INVALID_SIZE Address is too long
+         * @retval SUCCESS Updated
+         */
+        ErrCode updateSession(const LocalAddr &addr,
+                              const PeerSession &session);
+
+        /**
+         * @brief Removes session of client
+         * @param addr Address of client
+         * @retval NOT_SUPPORTED Not active
+         * @retval NOT_FOUND Session doesn't exist
+         * @retval SUCCESS Removed
+         */
+        ErrCode removeSession(const LocalAddr &addr);
+
+        /**
+         * @brief Returns copy of session of client
+         * @param addr Address of client
+         * @param session Session (modified in-place)
+         * @retval NOT_FOUND Session doesn't exist
+         * @retval SUCCESS Session returned
+         */
+        ErrCode getSession(const LocalAddr &addr, PeerSession &session) const;
+
+        /**
+         * @brief Subscribes consumer (or renews its lease)
+         *
+         * See `SubLeaseTable::subscribe()`.
+         *
+         * @param consumer Consumer
+         * @param filter Ordinary or shared filter
+         * @param now Current time
+         * @param newUpstream Whether upstream subscription must be made
+         * (modified in-place)
+         * @retval NOT_SUPPORTED Not active
+         * @retval INVALID_ARG Invalid shared filter
+         * @retval SUCCESS Subscribed or renewed
+         */
+        ErrCode subscribe(ConsumerId consumer, const std::string &filter,
+                          std::chrono::steady_clock::time_point now,
+                          bool &newUpstream);
+
+        /**
+         * @brief Renews all leases of consumer
+         * @param consumer Consumer
+         * @param now Current time
+         * @retval NOT_SUPPORTED Not active
+         * @retval NOT_FOUND Consumer has no subscriptions
+         * @retval SUCCESS Renewed
+         */
+        ErrCode renewAll(ConsumerId consumer,
+                         std::chrono::steady_clock::time_point now);
+
+        /**
+         * @brief Unsubscribes consumer
+         * @param consumer Consumer
+         * @param filter Ordinary or shared filter
+         * @retval NOT_SUPPORTED Not active
+         * @retval NOT_FOUND Not subscribed
+         * @retval SUCCESS Unsubscribed
+         */
+        ErrCode unsubscribe(ConsumerId consumer, const std::string &filter);
+
+        /**
+         * @brief Removes all subscriptions of consumer
+         * @param consumer Consumer
+         * @retval NOT_SUPPORTED Not active
+         * @retval SUCCESS Removed
+         */
+        ErrCode removeConsumer(ConsumerId consumer);
+
+        /**
+         * @brief Finds consumers of message
+         *
+         * See `SubLeaseTable::match()`.
+         *
+         * @param topic Topic of message
+         * @param consumers Consumers (cleared and filled in-place)
+         */
+        void match(const std::string &topic,
+                   std::vector<ConsumerId> &consumers);
+
+        /**
+         * @brief Sends queued deltas to standby (active role)
+         * @param now Current time
+         * @return Error code returned by channel
+         */
+        ErrCode flush(std::chrono::steady_clock::time_point now =
+                          std::chrono::steady_clock::now());
+
+        /**
+         * @brief Performs periodic work
+         *
+         * Active gateway expires leases, sends deltas (or heartbeat) and
+         * snapshot requested by standby. Standby gateway expires leases
+         * (after grace period) and requests snapshot if it's out of sync.
+         *
+         * Call periodically, ideally once per lease resolution.
+         *
+         * @param now Current time
+         * @return Error code returned by channel
+         */
+        ErrCode tick(std::chrono::steady_clock::time_point now =
+                         std::chrono::steady_clock::now());
+
+        /**
+         * @brief Checks whether standby holds complete state
+         * @return true Synchronized with active gateway
+         * @return false Snapshot not received yet
+         */
+        bool synced() const;
+
+        /**
+         * @brief Checks whether active gateway stopped responding
+         * @param now Current time
+         * @return true Standby should take over
+         * @return false Active gateway alive (or not standby)
+         */
+        bool activeLost(std::chrono::steady_clock::time_point now =
+                            std::chrono::steady_clock::now()) const;
+
+        /**
+         * @brief Takes over role of active gateway
+         *
+         * Gateway should subscribe returned filters upstream and start
+         * serving clients with address of former active gateway.
+         *
+         * @param upstream Upstream filters (cleared and filled in-place)
+         * @param now Current time
+         * @retval NOT_SUPPORTED Already active
+         * @retval SUCCESS Promoted
+         */
+        ErrCode promote(std::vector<std::string> &upstream,
+                        std::chrono::steady_clock::time_point now =
+                            std::chrono::steady_clock::now());
+
+        /**
+         * @brief Returns number of sessions
+         * @return Number of sessions
+         */
+        size_t sessionCnt() const;
+
+        /**
+         * @brief Returns number of subscription leases
+         * @return Number of leases
+         */
+        size_t subCnt() const;
+
+    private:
+        /**
+         * @brief Queues received frame
+         * @param frame Frame
+         */
+        void recv(const std::string &frame);
+
+        /**
+         * @brief Applies received frames (standby role)
+         * @param now Current time
+         */
+        void applyInbox(std::chrono::steady_clock::time_point now);
+
+        /**
+         * @brief Drops state and waits for snapshot (standby role)
+         */
+        void desync();
+
+        /**
+         * @brief Applies record to state (standby role)
+         * @param type Record type
+         * @param body Record body
+         * @param now Current time
+         * @return true Applied
+         * @return false Malformed record
+         */
+        bool applyRecord(uint8_t type, const std::string &body,
+                         std::chrono::steady_clock::time_point now);
+
+        /**
+         * @brief Queues record of subscription lease
+         * @param consumer Consumer
+         * @param filter Filter
+         * @param expiry Expiration of lease
+         * @param now Current time
+         */
+        void queueSub(ConsumerId consumer, const std::string &filter,
+                      std::chrono::steady_clock::time_point expiry,
+                      std::chrono::steady_clock::time_point now);
+
+        /**
+         * @brief Queues snapshot of whole state
+         * @param now Current time
+         */
+        void queueSnapshot(std::chrono::steady_clock::time_point now);
+
+        /**
+         * @brief Builds frames of queued records
+         * @param now Current time
+         * @param heartbeat Whether to build heartbeat if nothing is queued
+         * @param frames Frames (cleared and filled in-place)
+         */
+        void buildFrames(std::chrono::steady_clock::time_point now,
+                         bool heartbeat, std::vector<std::string> &frames);
+
+        /**
+         * @brief Sends frames
+         * @param frames Frames
+         * @return Error code returned by channel
+         */
+        ErrCode sendFrames(const std::vector<std::string> &frames);
+    };
+} // namespace kvik
@@ -0,0 +1,214 @@
+/**
+ * @file group_downlink.hpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Group-addressed downlink of subscription data
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include "kvik/errors.hpp"
+#include "kvik/limits.hpp"
+#include "kvik/local_addr.hpp"
+#include "kvik/local_msg.hpp"
+#include "kvik/pub_sub_struct.hpp"
+
+namespace kvik
+{
+    /**
+     * @brief Checks whether recipient is set in group recipients bitmap
+     * @param bitmap Recipients bitmap
+     * @param idx Group index of recipient
+     * @return true Recipient is set
+     * @return false Recipient isn't set
+     */
+    inline bool groupRecipientsHas(const std::vector<uint8_t> &bitmap,
+                                   uint16_t idx)
+    {
+        return idx != GROUP_IDX_NONE && idx / 8 < bitmap.size() &&
+               (bitmap[idx / 8] & (1 << (idx % 8))) != 0;
+    }
+
+    /**
+     * @brief Sets recipient in group recipients bitmap
+     *
+     * Bitmap is extended as needed.
+     *
+     * @param bitmap Recipients bitmap
+     * @param idx Group index of recipient (not `GROUP_IDX_NONE`)
+     */
+    inline void groupRecipientsSet(std::vector<uint8_t> &bitmap, uint16_t idx)
+    {
+        if (idx / 8 >= bitmap.size()) {
+            bitmap.resize(idx / 8 + 1);
+        }
+        bitmap[idx / 8] |= 1 << (idx % 8);
+    }
+
+    /**
+     * @brief Gateway-side builder of group-addressed SUB_DATA
+     *
+     * Collects subscription data destined for clients (on the same
+     * channel) and sends identical data for many clients just once, as
+     * broadcast SUB_DATA with recipients bitmap. Data for a single client
+     * (or for clients without assigned group index) stay unicast.
+     *
+     * Recipients acknowledge group data cumulatively (OK with last
+     * in-order `groupSeq`) or only negatively (FAIL with `GROUP_SEQ_GAP`).
+     * They track only group data sent after the sync point attached to
+     * PROBE_RES by `attach()`, so acknowledgements never cover data sent
+     * before the client got its group index.
+     * Recently sent group data are kept in history, so missing data can
+     * be retransmitted to the client as unicast.
+     *
+     * Each instance should serve clients on a single channel.
+     *
+     * Not multithread safe.
+     */
+    class GroupDownlink
+    {
+        /**
+         * @brief Data pending for sending
+         */
+        struct Pending
+        {
+            SubData data;                     //!< Data
+            uint64_t hash;                    //!< Hash of topic and payload
+            std::vector<uint8_t> recipients;  //!< Recipients bitmap
+            std::vector<LocalAddr> addrs;     //!< Recipient addresses
+        };
+
+        /**
+         * @brief Sent group data
+         */
+        struct HistoryEntry
+        {
+            uint16_t seq;                    //!< Sequence number
+            SubData data;                    //!< Data
+            std::vector<uint8_t> recipients; //!< Recipients bitmap
+            std::vector<uint8_t> acked;      //!< Acknowledged recipients bitmap
+        };
+
+        size_t m_minRecipients;
+        size_t m_historyLen;
+        uint16_t m_nextSeq = 0;
+
+        std::vector<Pending> m_pending;
+        std::unordered_map<uint64_t, size_t> m_pendingIdxs; //!< Hash -> index
+        std::vector<LocalMsg> m_unicasts;                   //!< Pending unicast data
+        std::deque<HistoryEntry> m_history;
+
+        //! Group index -> sequence number of its sync point
+        std::unordered_map<uint16_t, uint16_t> m_syncPoints;
+
+    public:
+        /**
+         * @brief Constructs group downlink builder
+         * @param minRecipients Minimum number of recipients for data to be
+         * group-addressed
+         * @param historyLen Number of recently sent group data kept for
+         * retransmissions
+         * @throw kvik::Exception Invalid parameters
+         */
+        GroupDownlink(size_t minRecipients = 2, size_t historyLen = 16);
+
+        /**
+         * @brief Enqueues data for client
+         * @param addr Client address
+         * @param groupIdx Client's group index (`GROUP_IDX_NONE` to always
+         * send unicast)
+         * @param data Subscription data
+         */
+        void enqueue(const LocalAddr &addr, uint16_t groupIdx,
+                     const SubData &data);
+
+        /**
+         * @brief Builds messages from enqueued data
+         *
+         * Enqueued data are cleared afterwards.
+         *
+         * @return SUB_DATA messages (broadcast ones have empty address)
+         */
+        std::vector<LocalMsg> build();
+
+        /**
+         * @brief Attaches sync point of group data to response
+         *
+         * Sync point is the last group data sent so far. Recipient with
+         * the group index tracks (and acknowledges) only newer data.
+         *
+         * @param resp PROBE_RES response (with `groupIdx` set)
+         * @retval INVALID_ARG Response of different type or without group
+         * index
+         * @retval SUCCESS Sync point attached
+         */
+        ErrCode attach(LocalMsg &resp);
+
+        /**
+         * @brief Processes cumulative acknowledgement
+         * @param groupIdx Client's group index
+         * @param msg OK message with `groupSeq`
+         */
+        void processAck(uint16_t groupIdx, const LocalMsg &msg);
+
+        /**
+         * @brief Processes negative acknowledgement
+         *
+         * Unacknowledged data addressed to the client since the first
+         * missing one are returned as unicast SUB_DATA messages. They keep
+         * their group sequence number, so client discards those it already
+         * has.
+         *
+         * @param addr Client address
+         * @param groupIdx Client's group index
+         * @param msg FAIL message with `GROUP_SEQ_GAP` reason
+         * @param msgs Retransmissions (modified in-place)
+         * @retval INVALID_ARG Message isn't group NACK
+         * @retval NOT_FOUND Some missing data are no longer in history
+         * @retval SUCCESS All missing data found
+         */
+        ErrCode processNack(const LocalAddr &addr, uint16_t groupIdx,
+                            const LocalMsg &msg, std::vector<LocalMsg> &msgs);
+
+        /**
+         * @brief Returns recipients which haven't acknowledged group data
+         * @param seq Sequence number of group data
+         * @param groupIdxs Group indexes (modified in-place)
+         * @retval NOT_FOUND Sequence number isn't in history
+         * @retval SUCCESS Group indexes returned
+         */
+        ErrCode unacked(uint16_t seq, std::vector<uint16_t> &groupIdxs) const;
+
+    private:
+        /**
+         * @brief Checks whether group data preceded sync point of recipient
+         * @param groupIdx Recipient's group index
+         * @param seq Sequence number of group data
+         * @return true Data were sent before the sync point
+         * @return false Data were sent after it (or there's none)
+         */
+        bool beforeSync(uint16_t groupIdx, uint16_t seq) const;
+
+        /**
+         * @brief Checks whether sequence number `a` precedes `b`
+         *
+         * Serial number arithmetic (wrap-around safe).
+         *
+         * @param a Sequence number
+         * @param b Sequence number
+         * @return true `a` precedes `b`
+         * @return false `a` doesn't precede `b`
+         */
+        static bool seqBefore(uint16_t a, uint16_t b)
+        {
+            return static_cast<int16_t>(a - b) < 0;
+        }
+    };
+} // namespace kvik
@@ -0,0 +1,51 @@
+/**
+ * @file hash.hpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Stable hash functions
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace kvik
+{
+    /**
+     * @brief 64-bit FNV-1a hash
+     *
+     * Unlike `std::hash`, result is the same on all platforms and standard
+     * library implementations, so it can be exchanged between nodes.
+     *
+     * @param data Data
+     * @param len Data length
+     * @param seed Initial value (use result of previous call to hash
+     * multiple buffers as one)
+     * @return Hash
+     */
+    inline uint64_t fnv1a64(const void *data, size_t len,
+                            uint64_t seed = 0xcbf29ce484222325ULL)
+    {
+        auto bytes = static_cast<const uint8_t *>(data);
+        uint64_t hash = seed;
+        for (size_t i = 0; i < len; i++) {
+            hash ^= bytes[i];
+            hash *= 0x100000001b3ULL;
+        }
+        return hash;
+    }
+
+    /**
+     * @brief 64-bit FNV-1a hash of string
+     * @param str String
+     * @return Hash
+     */
+    inline uint64_t fnv1a64(const std::string &str)
+    {
+        return fnv1a64(str.data(), str.size());
+    }
+} // namespace kvik
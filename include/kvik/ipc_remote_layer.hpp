@@ -0,0 +1,286 @@
+/**
+ * @file ipc_remote_layer.hpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Inter-process remote layer (Linux only)
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "kvik/errors.hpp"
+#include "kvik/layers.hpp"
+#include "kvik/mutex.hpp"
+#include "kvik/node_config.hpp"
+#include "kvik/pub_sub_struct.hpp"
+#include "kvik/wildcard_trie.hpp"
+
+namespace kvik
+{
+    class IpcConn;
+
+    /**
+     * @brief Remote layer for processes on the same host
+     *
+     * Lets node (e.g. radio-facing gateway process) exchange data with
+     * other processes (business logic) without any broker in between.
+     * Other processes use `IpcCompanion` to connect.
+     *
+     * Control messages (handshake, subscriptions, notifications) go over
+     * Unix domain socket, data go over pair of shared memory rings per
+     * companion (see `IpcRing`), whose descriptors are passed over the
+     * socket. Notification is sent only when the consumer sleeps, so a
+     * burst of messages costs single wake-up.
+     *
+     * Node's subscriptions are announced to companions, which send only
+     * matching data. Node's publications are sent only to companions
+     * subscribed to them. Full ring is reported as `QUEUE_FULL`.
+     *
+     * All public methods are multithread safe.
+     */
+    class IpcRemoteLayer : public IRemoteLayer
+    {
+        Mutex m_mutex{"IpcRemoteLayer"};
+        std::string m_path;
+        size_t m_ringCapacity;
+        NodeConfig::TopicSeparators m_sep;
+        int m_listenFd = -1;
+        int m_wakeFd = -1;
+        std::atomic<bool> m_stop = false;
+        std::thread m_thread;
+
+        std::vector<std::shared_ptr<IpcConn>> m_conns; //!< Companions
+        WildcardTrie<bool> m_subs;                     //!< Node's filters
+
+    public:
+        /**
+         * @brief Constructs a new layer and starts listening
+         *
+         * Existing socket file is replaced.
+         *
+         * @param path Path of Unix domain socket
+         * @param ringCapacity Capacity of each ring in bytes
+         * @param sep Topic separators
+         * @throw kvik::Exception Socket couldn't be created
+         */
+        IpcRemoteLayer(const std::string &path,
+                       size_t ringCapacity = 1024 * 1024,
+                       const NodeConfig::TopicSeparators &sep = {});
+
+        /**
+         * @brief Disconnects all companions and removes socket file
+         */
+        ~IpcRemoteLayer();
+
+        IpcRemoteLayer(const IpcRemoteLayer &) = delete;
+        IpcRemoteLayer &operator=(const IpcRemoteLayer &) = delete;
+
+        /**
+         * @brief Publishes data to subscribed companions
+         *
+         * Should be used by `INode` only!
+         *
+         * @param data Data to publish
+         * @retval QUEUE_FULL Ring of some companion is full
+         * @retval INVALID_SIZE Data too large for the ring
+         * @retval SUCCESS Published (or no companion subscribed)
+         */
+        ErrCode publish(const PubData &data);
+
+        /**
+         * @brief Subscribes to data published by companions
+         *
+         * Should be used by `INode` only!
+         *
+         * @param topic Filter
+         * @retval INVALID_ARG Invalid filter
+         * @retval SUCCESS Subscribed
+         */
+        ErrCode subscribe(const std::string &topic);
+
+        /**
+         * @brief Unsubscribes from data published by companions
+         *
+         * Should be used by `INode` only!
+         *
+         * @param topic Filter
+         * @retval NOT_FOUND Not subscribed
+         * @retval SUCCESS Unsubscribed
+         */
+        ErrCode unsubscribe(const std::string &topic);
+
+        /**
+         * @brief Returns number of connected companions
+         * @return Number of companions
+         */
+        size_t companionCnt();
+
+    private:
+        /**
+         * @brief Event loop (accepts companions and receives their data)
+         */
+        void loop();
+
+        /**
+         * @brief Processes control message of companion
+         * @param conn Companion
+         * @return true Message processed
+         * @return false Companion disconnected or misbehaved
+         */
+        bool processCtrl(const std::shared_ptr<IpcConn> &conn);
+
+        /**
+         * @brief Delivers data of companion to node
+         * @param conn Companion
+         * @return true Ring drained
+         * @return false Ring is corrupted
+         */
+        bool drain(const std::shared_ptr<IpcConn> &conn);
+
+        /**
+         * @brief Sends control message to all companions
+         *
+         * Must be called with `m_mutex` locked, so messages are ordered.
+         *
+         * @param type Message type
+         * @param body Message body
+         */
+        void broadcastCtrl(uint8_t type, const std::string &body);
+    };
+
+    /**
+     * @brief Companion of `IpcRemoteLayer` in another process
+     *
+     * Received data are passed to callback as views into shared memory
+     * (valid only during the call), so they're never copied. Payload can
+     * be written directly into shared memory too (see `publish()` with
+     * fill function).
+     *
+     * Callback is called from companion's own thread.
+     *
+     * All public methods are multithread safe.
+     */
+    class IpcCompanion
+    {
+    public:
+        /**
+         * @brief Callback for received data
+         */
+        using RecvCb =
+            std::function<void(std::string_view topic, std::string_view payload)>;
+
+        /**
+         * @brief Function writing payload of given length to buffer
+         */
+        using FillFn = std::function<void(char *buf)>;
+
+    private:
+        Mutex m_mutex{"IpcCompanion"};
+        NodeConfig::TopicSeparators m_sep;
+        std::shared_ptr<IpcConn> m_conn;
+        int m_wakeFd = -1;
+        std::atomic<bool> m_stop = false;
+        std::atomic<bool> m_connected = false;
+        std::thread m_thread;
+        RecvCb m_recvCb;
+
+        WildcardTrie<bool> m_nodeSubs; //!< Filters subscribed by node
+
+    public:
+        /**
+         * @brief Connects to `IpcRemoteLayer`
+         * @param path Path of Unix domain socket
+         * @param recvCb Callback for received data
+         * @param ringCapacity Capacity of ring to node in bytes
+         * @param sep Topic separators
+         * @throw kvik::Exception Connection failed
+         */
+        IpcCompanion(const std::string &path, RecvCb recvCb,
+                     size_t ringCapacity = 1024 * 1024,
+                     const NodeConfig::TopicSeparators &sep = {});
+
+        /**
+         * @brief Disconnects from node
+         */
+        ~IpcCompanion();
+
+        IpcCompanion(const IpcCompanion &) = delete;
+        IpcCompanion &operator=(const IpcCompanion &) = delete;
+
+        /**
+         * @brief Publishes data to node
+         * @param topic Topic
+         * @param payload Payload
+         * @retval NO_GATEWAY Disconnected from node
+         * @retval QUEUE_FULL Ring is full
+         * @retval INVALID_SIZE Data too large for the ring
+         * @retval SUCCESS Published (or node not subscribed)
+         */
+        ErrCode publish(std::string_view topic, std::string_view payload);
+
+        /**
+         * @brief Publishes data to node without copying the payload
+         * @param topic Topic
+         * @param payloadLen Length of payload
+         * @param fill Function writing payload directly to shared memory
+         * (not called if node isn't subscribed)
+         * @retval NO_GATEWAY Disconnected from node
+         * @retval QUEUE_FULL Ring is full
+         * @retval INVALID_SIZE Data too large for the ring
+         * @retval SUCCESS Published (or node not subscribed)
+         */
+        ErrCode publish(std::string_view topic, size_t payloadLen,
+                        const FillFn &fill);
+
+        /**
+         * @brief Subscribes to data published by node
+         * @param filter Filter
+         * @retval INVALID_ARG Invalid filter
+         * @retval NO_GATEWAY Disconnected from node
+         * @retval QUEUE_FULL Node doesn't keep up, try again later
+         * @retval SUCCESS Subscription sent
+         */
+        ErrCode subscribe(const std::string &filter);
+
+        /**
+         * @brief Unsubscribes from data published by node
+         * @param filter Filter
+         * @retval NO_GATEWAY Disconnected from node
+         * @retval QUEUE_FULL Node doesn't keep up, try again later
+         * @retval SUCCESS Unsubscription sent
+         */
+        ErrCode unsubscribe(const std::string &filter);
+
+        /**
+         * @brief Checks whether node subscribes topic
+         * @param topic Topic
+         * @return true Data of topic are delivered to node
+         * @return false Data of topic are dropped
+         */
+        bool nodeSubscribed(const std::string &topic);
+
+        /**
+         * @brief Checks whether companion is connected
+         * @return true Connected
+         * @return false Node closed the connection
+         */
+        bool connected() const { return m_connected; }
+
+    private:
+        /**
+         * @brief Event loop (receives data and control messages)
+         */
+        void loop();
+    };
+} // namespace kvik
@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <chrono>
 #include <functional>
 
 #include "kvik/errors.hpp"
@@ -66,6 +67,21 @@ namespace kvik
          */
         virtual ErrCode setChannel(uint16_t ch) = 0;
 
+        /**
+         * @brief Estimates airtime of the message
+         *
+         * Used for energy accounting. Protocols knowing their frame format
+         * and bitrate should override it.
+         *
+         * @param msg Message
+         * @return Estimated airtime (0 if unknown, in which case duration
+         * of `send` call is used)
+         */
+        virtual std::chrono::microseconds estimateAirtime(const LocalMsg &)
+        {
+            return std::chrono::microseconds(0);
+        }
+
         /**
          * @brief Sets receive callback
          * @param cb Callback
@@ -19,4 +19,7 @@ namespace kvik
 
     //! RSSI "unknown" value
     constexpr int16_t RSSI_UNKNOWN = INT16_MIN;
+
+    //! Group-addressed data index "none" value
+    constexpr uint16_t GROUP_IDX_NONE = UINT16_MAX;
 } // namespace kvik
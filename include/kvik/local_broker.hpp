@@ -11,11 +11,14 @@
 
 #include <mutex>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "kvik/errors.hpp"
 #include "kvik/layers.hpp"
+#include "kvik/mutex.hpp"
 #include "kvik/pub_sub_struct.hpp"
-#include "kvik/wildcard_trie.hpp"
+#include "kvik/shared_sub_index.hpp"
 
 namespace kvik
 {
@@ -23,18 +26,38 @@ namespace kvik
      * @brief Local broker remote layer
      *
      * Acts as local MQTT server.
+     *
+     * Besides the node using it as remote layer, in-process consumers can
+     * be attached with `addConsumer()`. Consumers subscribed with
+     * `$share/<group>/<filter>` divide matching messages among themselves
+     * (see `SharedSubIndex`).
      */
     class LocalBroker : public IRemoteLayer
     {
-        std::mutex m_mutex;
-        kvik::WildcardTrie<bool> m_subs; //!< Subscriptions
-        std::string m_topicPrefix;       //!< Topic prefix for publishing
+    public:
+        using ConsumerId = SharedSubIndex::ConsumerId;
+
+        //! Consumer ID of the node using broker as remote layer
+        static constexpr ConsumerId NODE_CONSUMER = 0;
+
+    private:
+        Mutex m_mutex{"LocalBroker"};
+        SharedSubIndex m_subs;     //!< Subscriptions
+        std::string m_topicPrefix; //!< Topic prefix for publishing
+
+        //! In-process consumers
+        std::unordered_map<ConsumerId, RecvCb> m_consumers;
+
+        //! Next in-process consumer ID
+        ConsumerId m_nextConsumer = NODE_CONSUMER + 1;
 
     public:
         /**
          * @brief Constructs a new local broker object
+         * @param policy Selection of shared subscription group member
          */
-        LocalBroker();
+        LocalBroker(SharedSubIndex::Policy policy =
+                        SharedSubIndex::Policy::ROUND_ROBIN);
 
         /**
          * @brief Destroys local broker layer object
@@ -47,10 +70,10 @@ namespace kvik
          * Should be used by `INode` only!
          *
          * If subscription for topic exists, immediately calls receive
-         * callback (from current thread).
+         * callbacks of subscribed consumers (from current thread).
          *
          * @param data Data to publish
-         * @retval SUCCESS No error from receive callback
+         * @retval SUCCESS No error from receive callbacks
          * @retval * Any error code returned by receive callback
          */
         ErrCode publish(const PubData &data);
@@ -60,8 +83,9 @@ namespace kvik
          *
          * Should be used by `INode` only!
          *
-         * @param topic Topic
-         * @retval SUCCESS Always
+         * @param topic Topic (or shared filter)
+         * @retval INVALID_ARG Invalid shared filter
+         * @retval SUCCESS Subscribed
          */
         ErrCode subscribe(const std::string &topic);
 
@@ -75,5 +99,39 @@ namespace kvik
          * @retval NOT_FOUND Entry doesn't exist
          */
         ErrCode unsubscribe(const std::string &topic);
+
+        /**
+         * @brief Attaches in-process consumer
+         * @param cb Receive callback
+         * @return Consumer ID
+         */
+        ConsumerId addConsumer(RecvCb cb);
+
+        /**
+         * @brief Detaches in-process consumer with all its subscriptions
+         * @param consumer Consumer ID
+         * @retval NOT_FOUND Unknown consumer
+         * @retval SUCCESS Consumer removed
+         */
+        ErrCode removeConsumer(ConsumerId consumer);
+
+        /**
+         * @brief Subscribes consumer to given topic
+         * @param consumer Consumer ID
+         * @param topic Topic (or shared filter)
+         * @retval NOT_FOUND Unknown consumer
+         * @retval INVALID_ARG Invalid shared filter
+         * @retval SUCCESS Subscribed
+         */
+        ErrCode subscribe(ConsumerId consumer, const std::string &topic);
+
+        /**
+         * @brief Unsubscribes consumer from given topic
+         * @param consumer Consumer ID
+         * @param topic Topic (or shared filter)
+         * @retval NOT_FOUND Subscription doesn't exist
+         * @retval SUCCESS Unsubscribed
+         */
+        ErrCode unsubscribe(ConsumerId consumer, const std::string &topic);
     };
 } // namespace kvik
@@ -19,6 +19,8 @@
 #include "kvik/local_addr.hpp"
 #include "kvik/node_types.hpp"
 #include "kvik/pub_sub_struct.hpp"
+#include "kvik/subs_digest.hpp"
+#include "kvik/uplink_slot.hpp"
 
 namespace kvik
 {
@@ -74,6 +76,14 @@ namespace kvik
          * Currently unused in FAIL messages.
          */
         UNKNOWN_SENDER = 0x04,
+
+        /**
+         * @brief Gap in sequence of group-addressed data
+         *
+         * Negative acknowledgement of group-addressed SUB_DATA. `groupSeq`
+         * contains first missing sequence number.
+         */
+        GROUP_SEQ_GAP = 0x05,
     };
 
     /**
@@ -107,7 +117,7 @@ namespace kvik
         std::vector<PubData> pubs;              //!< Publications (PUB_SUB_UNSUB only)
         std::vector<std::string> subs;          //!< Topics of subscriptions (PUB_SUB_UNSUB only)
         std::vector<std::string> unsubs;        //!< Topics of unsubscriptions (PUB_SUB_UNSUB only)
-        std::vector<SubData> subsData;          //!< Subscriptions data (SUB_DATA only)
+        std::vector<SubData> subsData;          //!< Subscriptions data (SUB_DATA, piggybacked on OK)
 
         // Additional data
         uint16_t id = 0;                                          //!< Message ID
@@ -151,6 +161,97 @@ namespace kvik
          */
         std::chrono::milliseconds tsDiff = std::chrono::milliseconds(0);
 
+        /**
+         * @brief Digest of sender's subscription set
+         *
+         * Used to renew subscriptions without sending all topics.
+         * Empty if not used.
+         *
+         * PROBE_REQ and PUB_SUB_UNSUB only.
+         */
+        SubsDigest subsDigest = {};
+
+        /**
+         * @brief Whether receiver of `subsDigest` holds matching
+         * subscription set
+         *
+         * Gateway supporting digests always sets it in response to
+         * PUB_SUB_UNSUB with full subscriptions and digest. Its absence
+         * there means that digests aren't supported.
+         *
+         * OK and PROBE_RES only.
+         */
+        bool subsDigestMatch = false;
+
+        /**
+         * @brief Index of receiver in gateway's group-addressed data
+         * bitmaps
+         *
+         * Assigned by gateway, `GROUP_IDX_NONE` if not used.
+         *
+         * PROBE_RES only.
+         */
+        uint16_t groupIdx = GROUP_IDX_NONE;
+
+        /**
+         * @brief Recipients bitmap of group-addressed data
+         *
+         * Bit `groupIdx % 8` of byte `groupIdx / 8` is set for each
+         * recipient. Empty for regular (unicast) data.
+         *
+         * SUB_DATA only.
+         */
+        std::vector<uint8_t> groupRecipients;
+
+        /**
+         * @brief Sequence number of group-addressed data
+         *
+         * SUB_DATA: sequence number of group-addressed data,
+         * OK: last in-order received sequence number (cumulative ack),
+         * FAIL (`GROUP_SEQ_GAP`): first missing sequence number,
+         * PROBE_RES (with `groupIdx`): sequence number of last group data
+         * sent so far (sync point, receiver tracks only newer data).
+         */
+        uint16_t groupSeq = 0;
+
+        /**
+         * @brief Whether payloads are delta codec frames
+         *
+         * See `DeltaCodec`.
+         *
+         * PUB_SUB_UNSUB and SUB_DATA only.
+         */
+        bool deltaPayloads = false;
+
+        /**
+         * @brief Whether `piggybackAckId` is valid
+         *
+         * PUB_SUB_UNSUB only.
+         */
+        bool piggybackAck = false;
+
+        /**
+         * @brief Message ID of last received OK carrying subscription data
+         *
+         * Gateway may piggyback pending subscription data on OK (in
+         * `subsData`). Client doesn't acknowledge them separately, but
+         * echoes ID of that OK in its next request instead (see
+         * `PiggybackDownlink`).
+         *
+         * PUB_SUB_UNSUB only.
+         */
+        uint16_t piggybackAckId = 0;
+
+        /**
+         * @brief Uplink slot assigned to receiver
+         *
+         * Assigned by gateway, not assigned if slotted access isn't used.
+         * OK carries it only as response to subscription renewal.
+         *
+         * PROBE_RES and OK only.
+         */
+        UplinkSlot uplinkSlot = {};
+
         bool operator==(const LocalMsg &other) const;
         bool operator!=(const LocalMsg &other) const;
 
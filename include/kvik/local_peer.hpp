@@ -15,6 +15,7 @@
 
 #include "kvik/limits.hpp"
 #include "kvik/local_addr.hpp"
+#include "kvik/uplink_slot.hpp"
 
 namespace kvik
 {
@@ -87,6 +88,47 @@ namespace kvik
          */
         std::chrono::milliseconds tsDiff = std::chrono::milliseconds(0);
 
+        /**
+         * @brief Index of this node in peer's group-addressed data bitmaps
+         *
+         * Assigned by gateway in PROBE_RES.
+         */
+        uint16_t groupIdx = GROUP_IDX_NONE;
+
+        /**
+         * @brief Highest sequence number of group-addressed data from peer
+         *
+         * Starts at sync point from PROBE_RES.
+         */
+        uint16_t groupSeq = 0;
+
+        /**
+         * @brief Window of received group-addressed data
+         *
+         * Bit `i` is set if data with sequence number `groupSeq - i` was
+         * received (or precedes the sync point).
+         */
+        uint32_t groupSeqWindow = 0;
+
+        //! Whether window of group-addressed data has a sync point
+        bool groupSeqValid = false;
+
+        //! ID of last OK from peer with piggybacked data (to acknowledge)
+        uint16_t piggybackAckId = 0;
+
+        //! Whether any OK with piggybacked data was received from peer
+        bool piggybackAckValid = false;
+
+        /**
+         * @brief Uplink slot assigned by peer
+         *
+         * Assigned by gateway in PROBE_RES (or OK to subscription renewal).
+         */
+        UplinkSlot uplinkSlot = {};
+
+        //! Whether peer is known not to support subscription set digests
+        bool subsDigestUnsupported = false;
+
         bool operator==(const LocalPeer &other) const
         {
             return addr == other.addr;
@@ -0,0 +1,288 @@
+/**
+ * @file multi_link_layer.hpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Client local layer using multiple links to gateway
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "kvik/errors.hpp"
+#include "kvik/layers.hpp"
+#include "kvik/limits.hpp"
+#include "kvik/local_addr.hpp"
+#include "kvik/local_msg.hpp"
+#include "kvik/mutex.hpp"
+
+namespace kvik
+{
+    /**
+     * @brief Policy of link selection
+     */
+    enum class LinkPolicy
+    {
+        FALLBACK,       //!< First available link in configured order
+        LOWEST_LATENCY, //!< Link with lowest round trip time
+        LOWEST_ENERGY,  //!< Link with lowest transmission energy
+    };
+
+    /**
+     * @brief Link of `MultiLinkLayer`
+     */
+    struct LinkConfig
+    {
+        ILocalLayer *ll = nullptr; //!< Local layer
+
+        /**
+         * @brief Transmission power in mW
+         *
+         * Energy of message is estimated as power times airtime reported
+         * by local layer (`LinkPolicy::LOWEST_ENERGY`).
+         */
+        double txPower = 0;
+    };
+
+    /**
+     * @brief Configuration of `MultiLinkLayer`
+     */
+    struct MultiLinkLayerConfig
+    {
+        LinkPolicy policy = LinkPolicy::FALLBACK; //!< Link selection policy
+
+        //! Time after which unanswered request counts as link failure
+        std::chrono::milliseconds respTimeout = std::chrono::seconds(3);
+
+        //! Number of consecutive failures after which link is down
+        uint16_t failThres = 2;
+
+        //! Time after which link which is down is tried again
+        std::chrono::milliseconds retryInterval = std::chrono::seconds(30);
+    };
+
+    /**
+     * @brief Client local layer using multiple links to gateway
+     *
+     * Allows single `Client` (with single subscription database) to hold
+     * session with gateway over several local layers at once, e.g. fast
+     * short-range and slow long-range radio. Client-side counterpart of
+     * `MultiLocalLayer`.
+     *
+     * Broadcasts (gateway discovery) are sent over all links. Gateway
+     * with highest preference responding on each link becomes gateway
+     * endpoint of that link. Once client talks to any of the endpoints,
+     * each unicast message is sent over link chosen by `LinkPolicy` and
+     * addressed to that link's endpoint. Received messages from endpoints
+     * are presented to client as coming from the gateway it talks to, so
+     * switching links is transparent.
+     *
+     * Link is down once its `send()` fails (message is sent over next
+     * link right away) or when `MultiLinkLayerConfig::failThres`
+     * consecutive requests aren't answered. Links which are down are tried
+     * again after `MultiLinkLayerConfig::retryInterval`, so preferred link
+     * is used again once it's available. No gateway rediscovery is needed
+     * for any of this.
+     *
+     * Links are expected to reach the same gateway node (e.g. one using
+     * `MultiLocalLayer`), which recognizes the client on all of them.
+     * Channel switching isn't supported.
+     *
+     * All public methods are multithread safe.
+     */
+    class MultiLinkLayer : public ILocalLayer
+    {
+    public:
+        /**
+         * @brief State of link
+         */
+        struct LinkState
+        {
+            LocalAddr gw;          //!< Gateway endpoint (empty if none)
+            bool up = true;        //!< Whether link is usable
+            uint16_t failCnt = 0;  //!< Consecutive failures
+
+            //! Smoothed round trip time (measured since discovery)
+            std::chrono::microseconds rtt = std::chrono::microseconds(0);
+        };
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        /**
+         * @brief Link with its state
+         */
+        struct Link
+        {
+            LinkConfig conf;
+            LinkState state = {};
+            int16_t gwPref = PREF_UNKNOWN;  //!< Preference of endpoint
+            bool gwFresh = false;           //!< Endpoint found in discovery
+            Clock::time_point retryAt = {}; //!< When to try link again
+        };
+
+        /**
+         * @brief Request waiting for response
+         */
+        struct PendingReq
+        {
+            size_t link;            //!< Index of link
+            Clock::time_point sent; //!< Time of sending
+        };
+
+        MultiLinkLayerConfig m_conf;
+        std::vector<Link> m_links;
+        Channels m_channels; //!< Always empty
+
+        Mutex m_mutex{"MultiLinkLayer"};
+
+        //! Gateway address client talks to (empty if not known yet)
+        LocalAddr m_sessionAddr;
+
+        //! Requests waiting for responses (by message ID)
+        std::unordered_map<uint16_t, PendingReq> m_pending;
+
+        uint16_t m_dscvId = 0;        //!< ID of last broadcast probe
+        bool m_dscvIdValid = false;   //!< Whether `m_dscvId` is valid
+        Clock::time_point m_dscvSent; //!< Time of last broadcast probe
+        size_t m_lastRxLink = 0;      //!< Link gateway was last heard on
+        uint16_t m_lastTxId = 0;      //!< ID of last sent unicast message
+        size_t m_lastTxLink = 0;      //!< Link of last sent unicast message
+
+    public:
+        /**
+         * @brief Constructs a new multi-link layer
+         * @param links Links in fallback order (their local layers must be
+         * valid during whole object's lifetime)
+         * @param conf Configuration
+         * @throw kvik::Exception Invalid parameters
+         */
+        MultiLinkLayer(const std::vector<LinkConfig> &links,
+                       MultiLinkLayerConfig conf = {});
+
+        /**
+         * @brief Destroys the layer
+         */
+        ~MultiLinkLayer();
+
+        /**
+         * @brief Sends message
+         *
+         * Broadcasts are sent over all links. Unicasts to gateway endpoint
+         * are sent over link chosen by policy (falling back to other
+         * links if send fails), unicasts to unknown addresses over first
+         * link accepting them.
+         *
+         * @param msg Message
+         * @retval NOT_FOUND No link is available
+         * @retval * Error code of last failed link (if all failed)
+         * @retval SUCCESS Message sent (over at least one link)
+         */
+        ErrCode send(const LocalMsg &msg);
+
+        /**
+         * @brief Gives list of possible channels
+         * @return Empty vector (channel switching isn't supported)
+         */
+        const Channels &getChannels();
+
+        /**
+         * @brief Sets channel
+         * @param ch Channel number
+         * @retval NOT_SUPPORTED Always
+         */
+        ErrCode setChannel(uint16_t ch);
+
+        /**
+         * @brief Estimates airtime of the message
+         *
+         * Broadcasts are sent over all links, so their estimates are
+         * summed. Unicasts use estimate of the link they were (or would
+         * be) sent over.
+         *
+         * @param msg Message
+         * @return Estimated airtime (0 if unknown)
+         */
+        std::chrono::microseconds estimateAirtime(const LocalMsg &msg);
+
+        /**
+         * @brief Sets link selection policy
+         * @param policy Policy
+         */
+        void setPolicy(LinkPolicy policy);
+
+        /**
+         * @brief Returns number of links
+         * @return Number of links
+         */
+        size_t linkCnt() const;
+
+        /**
+         * @brief Returns state of link
+         * @param idx Index of link
+         * @param state State (modified in-place)
+         * @retval INVALID_ARG Invalid index
+         * @retval SUCCESS State returned
+         */
+        ErrCode getLinkState(size_t idx, LinkState &state);
+
+        /**
+         * @brief Returns index of link unicast message would be sent over
+         * @param msg Message
+         * @param idx Index of link (modified in-place)
+         * @retval NOT_FOUND No link is available
+         * @retval SUCCESS Link found
+         */
+        ErrCode selectLink(const LocalMsg &msg, size_t &idx);
+
+    private:
+        /**
+         * @brief Receives message from link
+         * @param idx Index of link
+         * @param msg Message
+         * @return Error code returned by receive callback
+         */
+        ErrCode recvFrom(size_t idx, LocalMsg msg);
+
+        /**
+         * @brief Orders links usable for unicast to gateway by preference
+         *
+         * Must be called with `m_mutex` locked.
+         *
+         * @param airtimes Airtime estimates of message on each link
+         * @return Indices of links (most preferred first)
+         */
+        std::vector<size_t> rankLinks(
+            const std::vector<std::chrono::microseconds> &airtimes);
+
+        /**
+         * @brief Estimates airtime of message on each link
+         * @param msg Message
+         * @return Airtime estimates
+         */
+        std::vector<std::chrono::microseconds> estimateAirtimes(
+            const LocalMsg &msg);
+
+        /**
+         * @brief Records failure of link
+         *
+         * Must be called with `m_mutex` locked.
+         *
+         * @param idx Index of link
+         * @param down Whether to put link down right away
+         */
+        void linkFailed(size_t idx, bool down);
+
+        /**
+         * @brief Counts expired pending requests as link failures
+         *
+         * Must be called with `m_mutex` locked.
+         */
+        void expirePending();
+    };
+} // namespace kvik
@@ -0,0 +1,208 @@
+/**
+ * @file multi_local_layer.hpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Local layer aggregating multiple local layers
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "kvik/errors.hpp"
+#include "kvik/layers.hpp"
+#include "kvik/local_addr.hpp"
+#include "kvik/local_msg.hpp"
+#include "kvik/mutex.hpp"
+
+namespace kvik
+{
+    /**
+     * @brief Local layer aggregating multiple local layers
+     *
+     * Allows single gateway node (with single subscription and client
+     * state store) to serve multiple radios at once, e.g. one radio per
+     * channel.
+     *
+     * Each underlying layer gets its own send queue and receive queue,
+     * both processed by layer's own threads, so slow radio doesn't block
+     * the others. Unicast messages are routed to the layer where
+     * destination was last seen, broadcasts are sent over all layers.
+     * Routing table is bounded, least recently seen addresses are
+     * evicted.
+     *
+     * Underlying layers are expected to stay on their own channel, so
+     * channel switching isn't supported.
+     *
+     * All public methods are multithread safe.
+     */
+    class MultiLocalLayer : public ILocalLayer
+    {
+        /**
+         * @brief Underlying layer with its queues and threads
+         */
+        struct Member
+        {
+            ILocalLayer *ll;                  //!< Underlying layer
+            Mutex mutex{"MultiLocalLayer/member"}; //!< Mutex for queues
+            CondVar sendCv;                       //!< Send queue notification
+            CondVar recvCv;                       //!< Receive queue notification
+            CondVar idleCv;                       //!< Empty queues notification
+            std::deque<LocalMsg> sendQueue;   //!< Messages to send
+            std::deque<LocalMsg> recvQueue;   //!< Received messages
+            size_t inFlight = 0;              //!< Messages being processed
+            bool run = true;                  //!< Whether to continue running
+            std::thread sendThread;           //!< Send thread
+            std::thread recvThread;           //!< Receive thread
+        };
+
+        /**
+         * @brief Routing table entry
+         */
+        struct Route
+        {
+            LocalAddr addr;  //!< Address
+            size_t layerIdx; //!< Index of layer where it was last seen
+        };
+
+        std::vector<std::unique_ptr<Member>> m_members;
+        size_t m_maxQueueLen;
+        size_t m_maxRoutes;
+        Channels m_channels; //!< Always empty
+
+        Mutex m_mutex{"MultiLocalLayer"}; //!< Mutex for routing table
+
+        //! Routing table, most recently seen first
+        std::list<Route> m_routes;
+        std::unordered_map<LocalAddr, std::list<Route>::iterator> m_routeIdx;
+
+    public:
+        /**
+         * @brief Constructs a new aggregating local layer
+         * @param layers Underlying layers (must be valid during whole
+         * object's lifetime)
+         * @param maxQueueLen Maximum length of each send and receive queue
+         * @param maxRoutes Maximum number of addresses in routing table
+         * @throw kvik::Exception Invalid parameters
+         */
+        MultiLocalLayer(const std::vector<ILocalLayer *> &layers,
+                        size_t maxQueueLen = 64, size_t maxRoutes = 256);
+
+        /**
+         * @brief Destroys the local layer
+         *
+         * Queued messages are dropped.
+         */
+        ~MultiLocalLayer();
+
+        /**
+         * @brief Enqueues message for sending
+         *
+         * Unicast messages are sent over layer where destination was last
+         * seen, broadcasts (empty address) over all layers.
+         *
+         * @param msg Message
+         * @retval NOT_FOUND Destination wasn't seen on any layer yet
+         * @retval QUEUE_FULL Send queue of the layer is full
+         * @retval SUCCESS Message enqueued
+         */
+        ErrCode send(const LocalMsg &msg);
+
+        /**
+         * @brief Gives list of possible channels
+         * @return Empty vector (channel switching isn't supported)
+         */
+        const Channels &getChannels();
+
+        /**
+         * @brief Sets channel
+         * @param ch Channel number
+         * @retval NOT_SUPPORTED Always
+         */
+        ErrCode setChannel(uint16_t ch);
+
+        /**
+         * @brief Estimates airtime of the message
+         *
+         * Broadcasts are sent over all layers, so their estimates are
+         * summed. Unicasts use estimate of the routed layer.
+         *
+         * @param msg Message
+         * @return Estimated airtime (0 if unknown)
+         */
+        std::chrono::microseconds estimateAirtime(const LocalMsg &msg);
+
+        /**
+         * @brief Returns number of underlying layers
+         * @return Number of layers
+         */
+        size_t layerCnt() const;
+
+        /**
+         * @brief Finds layer where address was last seen
+         * @param addr Address
+         * @param layerIdx Index of layer (modified in-place)
+         * @retval NOT_FOUND Address wasn't seen yet
+         * @retval SUCCESS Layer found
+         */
+        ErrCode getRoute(const LocalAddr &addr, size_t &layerIdx);
+
+        /**
+         * @brief Waits until all queues are empty
+         */
+        void flush();
+
+    private:
+        /**
+         * @brief Remembers layer where address was seen
+         *
+         * Least recently seen address is evicted if routing table is full.
+         * Must be called with `m_mutex` held.
+         *
+         * @param addr Address
+         * @param layerIdx Index of layer
+         */
+        void updateRoute(const LocalAddr &addr, size_t layerIdx);
+
+        /**
+         * @brief Receives message from underlying layer
+         * @param idx Layer index
+         * @param msg Message
+         * @retval QUEUE_FULL Receive queue is full
+         * @retval SUCCESS Message enqueued
+         */
+        ErrCode recvFrom(size_t idx, LocalMsg msg);
+
+        /**
+         * @brief Enqueues message to layer's send queue
+         * @param idx Layer index
+         * @param msg Message
+         * @retval QUEUE_FULL Send queue is full
+         * @retval SUCCESS Message enqueued
+         */
+        ErrCode enqueueSend(size_t idx, const LocalMsg &msg);
+
+        /**
+         * @brief Send thread handler
+         * @param member Layer
+         */
+        void sendThread(Member &member);
+
+        /**
+         * @brief Receive thread handler
+         * @param member Layer
+         */
+        void recvThread(Member &member);
+    };
+} // namespace kvik
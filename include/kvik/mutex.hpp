@@ -0,0 +1,222 @@
+/**
+ * @file mutex.hpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Mutexes with optional contention profiling
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "kvik/errors.hpp"
+
+#ifndef KVIK_MUTEX_PROFILING
+/**
+ * @brief Use `InstrumentedMutex` for all mutexes of the library
+ *
+ * Must be set equally for the whole build (library and its users).
+ */
+#define KVIK_MUTEX_PROFILING 0
+#endif
+
+#if KVIK_MUTEX_PROFILING
+/**
+ * @brief Marks call site of lock acquisition
+ *
+ * Wraps mutex passed to a lock (e.g.
+ * `const std::scoped_lock lock(KVIK_SITE(m_mutex));`).
+ * Expands to just the mutex if profiling is disabled.
+ */
+#define KVIK_SITE(m) \
+    (::kvik::markLockSite(__FILE__ ":" KVIK_STRINGIZE(__LINE__)), (m))
+#else
+#define KVIK_SITE(m) (m)
+#endif
+
+namespace kvik
+{
+    /**
+     * @brief Number of buckets of mutex time histograms
+     *
+     * Bucket 0 counts durations below 1 us, bucket `i` durations in
+     * `[2^(i-1), 2^i)` us, the last one everything longer.
+     */
+    constexpr size_t MUTEX_HIST_BUCKETS = 20;
+
+    //! Number of longest holds kept per mutex
+    constexpr size_t MUTEX_TOP_HOLDS = 8;
+
+    /**
+     * @brief Statistics of mutex (or all mutexes of the same name)
+     */
+    struct MutexStats
+    {
+        using Histogram = std::array<uint64_t, MUTEX_HIST_BUCKETS>;
+
+        /**
+         * @brief Hold of mutex
+         */
+        struct Hold
+        {
+            const char *site = nullptr;        //!< Call site (`nullptr` if unknown)
+            std::chrono::microseconds time{0}; //!< Hold time
+        };
+
+        std::string name;                         //!< Mutex name
+        uint64_t acquisitions = 0;                //!< Number of acquisitions
+        uint64_t contended = 0;                   //!< Acquisitions which had to wait
+        std::chrono::microseconds totalWait{0};   //!< Total wait time
+        std::chrono::microseconds totalHold{0};   //!< Total hold time
+        Histogram waitHist = {};                  //!< Wait time histogram
+        Histogram holdHist = {};                  //!< Hold time histogram
+        std::vector<Hold> longestHolds;           //!< Longest hold of up to `MUTEX_TOP_HOLDS` call sites
+
+        /**
+         * @brief Merges statistics of another mutex
+         * @param other Statistics
+         */
+        void merge(const MutexStats &other);
+
+        /**
+         * @brief Records hold
+         * @param site Call site
+         * @param time Hold time
+         */
+        void recordHold(const char *site, std::chrono::microseconds time);
+
+        /**
+         * @brief Returns histogram bucket of duration
+         * @param time Duration
+         * @return Bucket index
+         */
+        static size_t bucket(std::chrono::microseconds time);
+
+        /**
+         * @brief Converts statistics to printable string
+         * @return Multi-line string representation
+         */
+        std::string toString() const;
+    };
+
+    /**
+     * @brief Marks call site of next lock acquisition on this thread
+     *
+     * Used by `KVIK_SITE`. Site is consumed by the next acquisition, so
+     * later acquisitions without marked site (including re-locks by
+     * condition variables) are attributed to unknown site.
+     *
+     * @param site Call site (string literal)
+     */
+    void markLockSite(const char *site) noexcept;
+
+    /**
+     * @brief Mutex recording its contention
+     *
+     * Drop-in replacement of `std::mutex` (with `std::scoped_lock`,
+     * `std::unique_lock` and `std::condition_variable_any`). Records
+     * number of acquisitions, histograms of wait and hold times and call
+     * sites (see `KVIK_SITE`) of the longest holds. Statistics are guarded
+     * by separate internal mutex, so they can be read while the mutex is
+     * held by someone else.
+     *
+     * All mutexes are registered, so statistics of the whole process can
+     * be taken at runtime (`mutexStatsSnapshot()`, `mutexStatsDump()`).
+     * Statistics of destroyed mutexes are kept under their name.
+     */
+    class InstrumentedMutex
+    {
+        using Clock = std::chrono::steady_clock;
+
+        std::mutex m_mutex;
+        std::mutex m_statsMutex; //!< Guards `m_stats`
+        MutexStats m_stats;
+        Clock::time_point m_acquired; //!< Time of current acquisition
+        const char *m_site = nullptr; //!< Call site of current acquisition
+
+    public:
+        /**
+         * @brief Constructs and registers mutex
+         * @param name Name (statistics of mutexes with equal names are
+         * merged in snapshots)
+         */
+        explicit InstrumentedMutex(const char *name = "unnamed");
+
+        /**
+         * @brief Unregisters mutex (its statistics are kept)
+         */
+        ~InstrumentedMutex();
+
+        InstrumentedMutex(const InstrumentedMutex &) = delete;
+        InstrumentedMutex &operator=(const InstrumentedMutex &) = delete;
+
+        void lock();
+        bool try_lock();
+        void unlock();
+
+        /**
+         * @brief Returns statistics of this mutex
+         * @return Statistics
+         */
+        MutexStats stats();
+
+        /**
+         * @brief Clears statistics of this mutex
+         */
+        void resetStats();
+
+    private:
+        /**
+         * @brief Records acquisition (called with `m_mutex` locked)
+         * @param start Time when acquisition started
+         * @param contended Whether acquisition had to wait
+         */
+        void acquired(Clock::time_point start, bool contended);
+    };
+
+    /**
+     * @brief Returns statistics of all mutexes (merged by name)
+     * @return Statistics sorted by total hold time (longest first)
+     */
+    std::vector<MutexStats> mutexStatsSnapshot();
+
+    /**
+     * @brief Returns printable statistics of all mutexes
+     * @return Multi-line string (empty if there are no statistics)
+     */
+    std::string mutexStatsDump();
+
+    /**
+     * @brief Clears statistics of all mutexes
+     */
+    void mutexStatsReset();
+
+#if KVIK_MUTEX_PROFILING
+    using Mutex = InstrumentedMutex;
+    using UniqueLock = std::unique_lock<InstrumentedMutex>;
+    using CondVar = std::condition_variable_any;
+#else
+    /**
+     * @brief Mutex used by the library
+     *
+     * `std::mutex` taking (and ignoring) a name, so declarations are the
+     * same as with profiling enabled.
+     */
+    class Mutex : public std::mutex
+    {
+    public:
+        explicit Mutex(const char * = nullptr) noexcept {}
+    };
+
+    using UniqueLock = std::unique_lock<std::mutex>;
+    using CondVar = std::condition_variable;
+#endif
+} // namespace kvik
@@ -10,13 +10,18 @@
 #pragma once
 
 #include <functional>
+#include <memory>
 #include <vector>
 
+#include "kvik/energy_meter.hpp"
 #include "kvik/errors.hpp"
 #include "kvik/local_addr.hpp"
 #include "kvik/local_msg_id_cache.hpp"
 #include "kvik/node_config.hpp"
 #include "kvik/pub_sub_struct.hpp"
+#include "kvik/topic.hpp"
+#include "kvik/traffic_stats.hpp"
+#include "kvik/typed_payload.hpp"
 
 namespace kvik
 {
@@ -29,6 +34,12 @@ namespace kvik
         uint16_t m_msgId;
         LocalMsgIdCache m_msgIdCache;
 
+        //! Traffic statistics (`nullptr` if disabled)
+        std::unique_ptr<TrafficStats> m_trafficStats;
+
+        //! Energy meter (`nullptr` if disabled)
+        std::unique_ptr<EnergyMeter> m_energyMeter;
+
     public:
         /**
          * @brief Constructs a new generic node
@@ -60,6 +71,130 @@ namespace kvik
             });
         }
 
+        /**
+         * @brief Publishes payload to precompiled topic
+         *
+         * Topic was already validated during its construction.
+         *
+         * @param topic Topic
+         * @param payload Payload
+         * @retval INVALID_ARG Topic uses different separators than node
+         * @return Error code (node-specific)
+         */
+        ErrCode publish(const Topic &topic, const std::string &payload)
+        {
+            if (!this->topicCompatible(topic)) {
+                return ErrCode::INVALID_ARG;
+            }
+            return this->publish(topic.str(), payload);
+        }
+
+        /**
+         * @brief Publishes compactly encoded integer to topic
+         *
+         * See `typed_payload.hpp` for encoding details.
+         * Receivers can decode value using `SubData::toInt()`.
+         *
+         * @param topic Topic
+         * @param val Value
+         * @return Error code (node-specific)
+         */
+        ErrCode publishInt(const std::string &topic, int64_t val)
+        {
+            return this->publish(topic, typedPayloadFromInt(val));
+        }
+
+        /**
+         * @brief Publishes compactly encoded float to topic
+         *
+         * See `typed_payload.hpp` for encoding details.
+         * Receivers can decode value using `SubData::toFloat()`.
+         *
+         * @param topic Topic
+         * @param val Value
+         * @param half Use half precision
+         * @return Error code (node-specific)
+         */
+        ErrCode publishFloat(const std::string &topic, float val,
+                             bool half = false)
+        {
+            return this->publish(topic, typedPayloadFromFloat(val, half));
+        }
+
+        /**
+         * @brief Publishes compactly encoded boolean to topic
+         *
+         * See `typed_payload.hpp` for encoding details.
+         * Receivers can decode value using `SubData::toBool()`.
+         *
+         * @param topic Topic
+         * @param val Value
+         * @return Error code (node-specific)
+         */
+        ErrCode publishBool(const std::string &topic, bool val)
+        {
+            return this->publish(topic, typedPayloadFromBool(val));
+        }
+
+        /**
+         * @brief Publishes compactly encoded array of integers to topic
+         *
+         * See `typed_payload.hpp` for encoding details.
+         * Receivers can decode value using `SubData::toIntArray()`.
+         *
+         * @param topic Topic
+         * @param vals Values
+         * @retval INVALID_SIZE Too many items
+         * @return Error code (node-specific)
+         */
+        ErrCode publishIntArray(const std::string &topic,
+                                const std::vector<int64_t> &vals)
+        {
+            std::string payload;
+            KVIK_RETURN_ERROR(typedPayloadFromIntArray(vals, payload));
+            return this->publish(topic, payload);
+        }
+
+        /**
+         * @brief Publishes compactly encoded array of floats to topic
+         *
+         * See `typed_payload.hpp` for encoding details.
+         * Receivers can decode value using `SubData::toFloatArray()`.
+         *
+         * @param topic Topic
+         * @param vals Values
+         * @param half Use half precision
+         * @retval INVALID_SIZE Too many items
+         * @return Error code (node-specific)
+         */
+        ErrCode publishFloatArray(const std::string &topic,
+                                  const std::vector<float> &vals,
+                                  bool half = false)
+        {
+            std::string payload;
+            KVIK_RETURN_ERROR(typedPayloadFromFloatArray(vals, payload, half));
+            return this->publish(topic, payload);
+        }
+
+        /**
+         * @brief Publishes compactly encoded array of booleans to topic
+         *
+         * See `typed_payload.hpp` for encoding details.
+         * Receivers can decode value using `SubData::toBoolArray()`.
+         *
+         * @param topic Topic
+         * @param vals Values
+         * @retval INVALID_SIZE Too many items
+         * @return Error code (node-specific)
+         */
+        ErrCode publishBoolArray(const std::string &topic,
+                                 const std::vector<bool> &vals)
+        {
+            std::string payload;
+            KVIK_RETURN_ERROR(typedPayloadFromBoolArray(vals, payload));
+            return this->publish(topic, payload);
+        }
+
         /**
          * @brief Publishes payload to topic
          *
@@ -97,6 +232,24 @@ namespace kvik
             return this->subscribeBulk({{topic, cb}});
         }
 
+        /**
+         * @brief Subscribes to precompiled topic filter
+         *
+         * Filter was already validated during its construction.
+         *
+         * @param filter Topic filter
+         * @param cb Callback function
+         * @retval INVALID_ARG Filter uses different separators than node
+         * @return Error code (node-specific)
+         */
+        ErrCode subscribe(const Filter &filter, SubCb cb)
+        {
+            if (!this->topicCompatible(filter)) {
+                return ErrCode::INVALID_ARG;
+            }
+            return this->subscribeFilter(filter, cb);
+        }
+
         /**
          * @brief Subscribes to topics in bulk
          * @param subs Vector of subscription requests
@@ -120,6 +273,21 @@ namespace kvik
             return this->unsubscribeBulk({topic});
         }
 
+        /**
+         * @brief Unsubscribes from precompiled topic filter
+         *
+         * @param filter Topic filter
+         * @retval INVALID_ARG Filter uses different separators than node
+         * @return Error code (node-specific)
+         */
+        ErrCode unsubscribe(const Filter &filter)
+        {
+            if (!this->topicCompatible(filter)) {
+                return ErrCode::INVALID_ARG;
+            }
+            return this->unsubscribeFilter(filter);
+        }
+
         /**
          * @brief Unsubscribes from topics in bulk
          * @param topics Topics
@@ -159,7 +327,58 @@ namespace kvik
          */
         virtual ErrCode resubscribeAll() = 0;
 
+        /**
+         * @brief Takes snapshot of traffic statistics
+         *
+         * Multithread safe.
+         *
+         * @param snap Snapshot (modified in-place)
+         * @retval NOT_SUPPORTED Statistics are disabled in configuration
+         * @retval SUCCESS Snapshot taken
+         */
+        ErrCode getTrafficStats(TrafficStats::Snapshot &snap) const;
+
+        /**
+         * @brief Takes snapshot of radio-on time and energy totals
+         *
+         * Multithread safe.
+         *
+         * @param snap Snapshot (modified in-place)
+         * @retval NOT_SUPPORTED Energy accounting is disabled in
+         * configuration
+         * @retval SUCCESS Snapshot taken
+         */
+        ErrCode getEnergyStats(EnergyMeter::Snapshot &snap) const;
+
     protected:
+        /**
+         * @brief Subscribes to precompiled (compatible) topic filter
+         *
+         * Nodes keeping subscriptions in `WildcardTrie` should override
+         * this, so that filter's levels aren't split again.
+         *
+         * @param filter Topic filter
+         * @param cb Callback function
+         * @return Error code (node-specific)
+         */
+        virtual ErrCode subscribeFilter(const Filter &filter, SubCb cb)
+        {
+            return this->subscribe(filter.str(), cb);
+        }
+
+        /**
+         * @brief Unsubscribes from precompiled (compatible) topic filter
+         *
+         * See `subscribeFilter()`.
+         *
+         * @param filter Topic filter
+         * @return Error code (node-specific)
+         */
+        virtual ErrCode unsubscribeFilter(const Filter &filter)
+        {
+            return this->unsubscribe(filter.str());
+        }
+
         /**
          * @brief Generates new message ID for a local message transmission
          *
@@ -197,11 +416,67 @@ namespace kvik
             uint16_t ts,
             std::chrono::milliseconds tsDiff = std::chrono::milliseconds(0));
         
+        /**
+         * @brief Records message in traffic statistics
+         *
+         * Does nothing if statistics are disabled.
+         * Multithread safe.
+         *
+         * @param src Source address (empty for locally originated messages)
+         * @param topic Topic
+         * @param bytes Payload size
+         */
+        void recordTraffic(const LocalAddr &src, const std::string &topic,
+                           size_t bytes);
+
+        /**
+         * @brief Records radio operation in energy accounting
+         *
+         * Does nothing if energy accounting is disabled.
+         * Multithread safe.
+         *
+         * @param op Operation
+         * @param time Radio-on time
+         */
+        void recordEnergy(EnergyOp op, std::chrono::microseconds time);
+
+        /**
+         * @brief Records delivered message in energy accounting
+         *
+         * Does nothing if energy accounting is disabled.
+         * Multithread safe.
+         */
+        void recordDelivered();
+
         /**
          * @brief Builds RSSI report topic
          * @param addr Peer address
          * @return RSSI report topic
          */
         std::string buildReportRssiTopic(const LocalAddr &peer) const;
+
+        /**
+         * @brief Builds RSSI report payload
+         *
+         * Encoding is selected by `NodeConfig::Reporting::typedPayloads`.
+         *
+         * @param rssi RSSI
+         * @return RSSI report payload
+         */
+        std::string buildReportRssiPayload(int16_t rssi) const;
+
+        /**
+         * @brief Checks whether topic handle uses node's separators
+         * @param handle Topic or filter handle
+         * @return true Separators match
+         * @return false Separators differ
+         */
+        bool topicCompatible(const TopicHandle &handle) const
+        {
+            return handle.usesSeparators(
+                m_nodeConf.topicSep.levelSeparator,
+                m_nodeConf.topicSep.singleLevelWildcard,
+                m_nodeConf.topicSep.multiLevelWildcard);
+        }
     };
 } // namespace kvik
@@ -11,8 +11,11 @@
 
 #include <chrono>
 #include <cstdint>
+#include <memory>
 #include <string>
 
+#include "kvik/energy_meter.hpp"
+
 namespace kvik
 {
     /**
@@ -68,6 +71,16 @@ namespace kvik
         {
             std::string baseTopic = "_report"; //!< Base topic for reporting purposes
             std::string rssiSubtopic = "rssi"; //!< Subtopic for RSSI reporting
+
+            /**
+             * @brief Use typed payloads for reports
+             *
+             * When set to `true`, reported values are compactly encoded
+             * typed payloads (see `typed_payload.hpp`) instead of decimal
+             * text. This saves bytes on air and string formatting, but all
+             * consumers of reports must decode them.
+             */
+            bool typedPayloads = false;
         };
 
         struct TopicSeparators
@@ -77,9 +90,54 @@ namespace kvik
             std::string multiLevelWildcard = "#";  //!< Token used as multi level wildcard
         };
 
+        struct Stats
+        {
+            /**
+             * @brief Enable streaming traffic statistics
+             *
+             * Tracks heaviest topics and source addresses on receive and
+             * publish paths with constant memory usage (see
+             * `TrafficStats`).
+             */
+            bool enabled = false;
+
+            //! Count-min sketch width (counters per row)
+            uint16_t sketchWidth = 256;
+
+            //! Count-min sketch depth (number of rows)
+            uint8_t sketchDepth = 4;
+
+            //! Number of tracked heaviest topics and source addresses
+            uint8_t topK = 8;
+
+            //! Half-life of decayed message and byte rates
+            std::chrono::milliseconds rateHalfLife = std::chrono::minutes(1);
+        };
+
+        struct Energy
+        {
+            /**
+             * @brief Enable radio-on time and energy accounting
+             *
+             * Accumulates time spent transmitting, waiting for responses
+             * and scanning channels, converted to energy by power model
+             * (see `EnergyMeter`).
+             */
+            bool enabled = false;
+
+            /**
+             * @brief Radio power model
+             *
+             * `nullptr` means default `ConstPowerModel`.
+             */
+            std::shared_ptr<const IPowerModel> powerModel = nullptr;
+        };
+
         LocalDelivery localDelivery;
         MsgIdCache msgIdCache;
         Reporting reporting;
         TopicSeparators topicSep;
+        Stats stats;
+        Energy energy;
     };
 } // namespace kvik
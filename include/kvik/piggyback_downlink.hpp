@@ -0,0 +1,167 @@
+/**
+ * @file piggyback_downlink.hpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Subscription data piggybacked on responses
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include "kvik/errors.hpp"
+#include "kvik/local_addr.hpp"
+#include "kvik/local_msg.hpp"
+#include "kvik/pub_sub_struct.hpp"
+
+namespace kvik
+{
+    /**
+     * @brief Piggyback downlink configuration
+     */
+    struct PiggybackDownlinkConfig
+    {
+        /**
+         * @brief Maximum size of data attached to single response
+         *
+         * Sum of topic and payload lengths. Larger data can't be held.
+         */
+        size_t maxLen = 200;
+
+        /**
+         * @brief Maximum time data are held for client
+         *
+         * Data waiting longer for a response to attach to (or for
+         * acknowledgement of the response) are sent as separate SUB_DATA.
+         * Should be close to request period of clients.
+         */
+        std::chrono::milliseconds maxHold = std::chrono::seconds(10);
+
+        /**
+         * @brief Maximum number of held data per client
+         *
+         * Further data are rejected with `QUEUE_FULL`.
+         */
+        size_t maxClientQueueLen = 16;
+    };
+
+    /**
+     * @brief Gateway-side holder of subscription data piggybacked on
+     * responses
+     *
+     * Data for a client are held until the client sends a request and are
+     * attached to the OK response (in `subsData`), instead of being sent
+     * as separate SUB_DATA acknowledged by client's own OK. Client
+     * acknowledges them implicitly by echoing ID of that OK in its next
+     * request. Publish-and-receive cycle of duty-cycled client thus takes
+     * two frames instead of four.
+     *
+     * Each request of client must be passed to `processRequest()` before
+     * `attach()` to its response. Data not acknowledged are attached again
+     * (ahead of newer data). Data held for too long are returned by
+     * `takeExpired()`. Like regular SUB_DATA, delivery is at-least-once.
+     *
+     * Not multithread safe.
+     */
+    class PiggybackDownlink
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+    private:
+        /**
+         * @brief Held data
+         */
+        struct Held
+        {
+            SubData data;            //!< Data
+            Clock::time_point since; //!< Time of enqueuing
+        };
+
+        /**
+         * @brief Held data of single client
+         */
+        struct ClientQueue
+        {
+            std::deque<Held> pending;        //!< Waiting for response
+            std::vector<Held> inFlight;      //!< Attached, not acknowledged
+            uint16_t inFlightId = 0;         //!< ID of response with `inFlight`
+            Clock::time_point inFlightSince; //!< Time of attaching
+        };
+
+        PiggybackDownlinkConfig m_conf;
+        std::unordered_map<LocalAddr, ClientQueue> m_clients;
+
+    public:
+        /**
+         * @brief Constructs piggyback downlink
+         * @param conf Configuration
+         * @throw kvik::Exception Invalid parameters
+         */
+        PiggybackDownlink(const PiggybackDownlinkConfig &conf = {});
+
+        /**
+         * @brief Holds data for client
+         * @param addr Client address
+         * @param data Subscription data
+         * @param now Current time
+         * @retval INVALID_SIZE Data exceed `maxLen`
+         * @retval QUEUE_FULL Client's queue is full
+         * @retval SUCCESS Data held
+         */
+        ErrCode enqueue(const LocalAddr &addr, const SubData &data,
+                        Clock::time_point now = Clock::now());
+
+        /**
+         * @brief Processes implicit acknowledgement in client's request
+         *
+         * Acknowledged data are released, unacknowledged ones are returned
+         * to client's queue.
+         *
+         * @param req Request (PUB_SUB_UNSUB) of client
+         */
+        void processRequest(const LocalMsg &req);
+
+        /**
+         * @brief Attaches held data to OK response
+         *
+         * Nothing is attached while previously attached data aren't
+         * resolved by `processRequest()`.
+         *
+         * @param resp OK response (with address and ID set)
+         * @param now Current time
+         * @return Number of attached data
+         */
+        size_t attach(LocalMsg &resp, Clock::time_point now = Clock::now());
+
+        /**
+         * @brief Takes data held for too long
+         *
+         * Whole queue of client is taken once its oldest data expire.
+         *
+         * @param now Current time
+         * @return SUB_DATA messages
+         */
+        std::vector<LocalMsg> takeExpired(Clock::time_point now = Clock::now());
+
+        /**
+         * @brief Returns number of data held for client
+         * @param addr Client address
+         * @return Number of pending and attached data
+         */
+        size_t heldCnt(const LocalAddr &addr) const;
+
+    private:
+        /**
+         * @brief Returns attached data back to front of queue
+         * @param queue Client's queue
+         */
+        static void requeue(ClientQueue &queue);
+    };
+} // namespace kvik
@@ -9,8 +9,13 @@
 
 #pragma once
 
+#include <cstdint>
 #include <functional>
 #include <string>
+#include <vector>
+
+#include "kvik/errors.hpp"
+#include "kvik/typed_payload.hpp"
 
 namespace kvik
 {
@@ -36,6 +41,84 @@ namespace kvik
          * @return String representation of contained data
          */
         std::string toString() const;
+
+        /**
+         * @brief Determines type of typed payload
+         *
+         * See `typed_payload.hpp` for details.
+         *
+         * @return Payload type (`RAW` if payload isn't typed)
+         */
+        PayloadType payloadType() const
+        {
+            return typedPayloadType(payload);
+        }
+
+        /**
+         * @brief Decodes typed integer payload
+         * @param val Value (modified in-place)
+         * @retval INVALID_ARG Payload isn't valid integer payload
+         * @retval SUCCESS Successfully decoded
+         */
+        ErrCode toInt(int64_t &val) const
+        {
+            return typedPayloadToInt(payload, val);
+        }
+
+        /**
+         * @brief Decodes typed float payload (any precision)
+         * @param val Value (modified in-place)
+         * @retval INVALID_ARG Payload isn't valid float payload
+         * @retval SUCCESS Successfully decoded
+         */
+        ErrCode toFloat(float &val) const
+        {
+            return typedPayloadToFloat(payload, val);
+        }
+
+        /**
+         * @brief Decodes typed boolean payload
+         * @param val Value (modified in-place)
+         * @retval INVALID_ARG Payload isn't valid boolean payload
+         * @retval SUCCESS Successfully decoded
+         */
+        ErrCode toBool(bool &val) const
+        {
+            return typedPayloadToBool(payload, val);
+        }
+
+        /**
+         * @brief Decodes typed integer array payload
+         * @param vals Values (modified in-place)
+         * @retval INVALID_ARG Payload isn't valid integer array payload
+         * @retval SUCCESS Successfully decoded
+         */
+        ErrCode toIntArray(std::vector<int64_t> &vals) const
+        {
+            return typedPayloadToIntArray(payload, vals);
+        }
+
+        /**
+         * @brief Decodes typed float array payload (any precision)
+         * @param vals Values (modified in-place)
+         * @retval INVALID_ARG Payload isn't valid float array payload
+         * @retval SUCCESS Successfully decoded
+         */
+        ErrCode toFloatArray(std::vector<float> &vals) const
+        {
+            return typedPayloadToFloatArray(payload, vals);
+        }
+
+        /**
+         * @brief Decodes typed boolean array payload
+         * @param vals Values (modified in-place)
+         * @retval INVALID_ARG Payload isn't valid boolean array payload
+         * @retval SUCCESS Successfully decoded
+         */
+        ErrCode toBoolArray(std::vector<bool> &vals) const
+        {
+            return typedPayloadToBoolArray(payload, vals);
+        }
     };
 
     /**
@@ -0,0 +1,269 @@
+/**
+ * @file remote_layer_pool.hpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Remote layer distributing traffic over pool of remote layers
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "kvik/errors.hpp"
+#include "kvik/layers.hpp"
+#include "kvik/mutex.hpp"
+#include "kvik/pub_sub_struct.hpp"
+
+namespace kvik
+{
+    /**
+     * @brief Remote layer distributing traffic over pool of remote layers
+     *
+     * Lifts per-connection limits of upstream brokers by spreading the
+     * traffic over multiple connections.
+     *
+     * Publications are sharded by topic using rendezvous hashing, so all
+     * data of single topic go over the same connection (and keep their
+     * order), and failure of one connection moves only its own topics.
+     * Each subscription is held by single connection, received data of
+     * all connections are merged into single receive callback.
+     *
+     * Connection failing `failThres` consecutive operations is marked
+     * unhealthy: its topics are published over the next connection in
+     * rendezvous order and its subscriptions are moved to healthy
+     * connections. After `retryInterval`, it's tried again. Reconnection
+     * of underlying layer marks it healthy immediately. Subscriptions moved
+     * away are unsubscribed from the failed connection (once it recovers,
+     * if it can't be done right away), so data aren't received twice.
+     *
+     * Rankings of topics are cached until health of some layer changes.
+     *
+     * All public methods are multithread safe.
+     */
+    class RemoteLayerPool : public IRemoteLayer
+    {
+        /**
+         * @brief Underlying layer with its health
+         */
+        struct Member
+        {
+            IRemoteLayer *rl;    //!< Underlying layer
+            bool healthy = true; //!< Whether layer is healthy
+            size_t failCnt = 0;  //!< Consecutive failures
+            uint64_t seed = 0;   //!< Rendezvous hashing seed
+
+            //! Time of last failure while unhealthy
+            std::chrono::steady_clock::time_point downSince;
+
+            //! Subscriptions moved away, still to be unsubscribed
+            std::vector<std::string> staleSubs;
+        };
+
+        /**
+         * @brief Change of layer health caused by operation result
+         */
+        enum class HealthChange : uint8_t
+        {
+            NONE = 0, //!< Health unchanged
+            DOWN,     //!< Layer has just become unhealthy
+            UP,       //!< Layer has just become healthy again
+        };
+
+        Mutex m_mutex{"RemoteLayerPool"};
+        std::vector<Member> m_members;
+        size_t m_failThres;
+        std::chrono::milliseconds m_retryInterval;
+
+        //! Subscriptions (topic -> index of layer holding it)
+        std::unordered_map<std::string, size_t> m_subs;
+
+        //! Cached rankings of topics (see `rank()`)
+        std::unordered_map<std::string, std::vector<size_t>> m_rankCache;
+
+        //! Time some unhealthy layer becomes due for retry (cache expiry)
+        std::chrono::steady_clock::time_point m_rankExpiry =
+            std::chrono::steady_clock::time_point::max();
+
+    public:
+        /**
+         * @brief Constructs a new pool
+         * @param layers Underlying layers (must be valid during whole
+         * object's lifetime)
+         * @param failThres Number of consecutive failures marking layer
+         * unhealthy
+         * @param retryInterval Delay before unhealthy layer is tried again
+         * @throw kvik::Exception Invalid parameters
+         */
+        RemoteLayerPool(const std::vector<IRemoteLayer *> &layers,
+                        size_t failThres = 3,
+                        std::chrono::milliseconds retryInterval =
+                            std::chrono::seconds(5));
+
+        /**
+         * @brief Destroys the pool
+         */
+        ~RemoteLayerPool();
+
+        /**
+         * @brief Publishes data over layer owning the topic
+         *
+         * Should be used by `INode` only!
+         *
+         * Fails over to next layers in rendezvous order.
+         *
+         * @param data Data to publish
+         * @retval SUCCESS Published
+         * @retval * Error code of last tried layer
+         */
+        ErrCode publish(const PubData &data);
+
+        /**
+         * @brief Subscribes to given topic over single layer
+         *
+         * Should be used by `INode` only!
+         *
+         * @param topic Topic
+         * @retval SUCCESS Subscribed
+         * @retval * Error code of last tried layer
+         */
+        ErrCode subscribe(const std::string &topic);
+
+        /**
+         * @brief Unsubscribes from given topic
+         *
+         * Should be used by `INode` only!
+         *
+         * @param topic Topic
+         * @retval NOT_FOUND Not subscribed
+         * @retval * Error code returned by layer holding subscription
+         */
+        ErrCode unsubscribe(const std::string &topic);
+
+        /**
+         * @brief Returns number of underlying layers
+         * @return Number of layers
+         */
+        size_t layerCnt() const;
+
+        /**
+         * @brief Checks health of layer
+         * @param idx Layer index
+         * @return true Layer is healthy
+         * @return false Layer is unhealthy (or index is invalid)
+         */
+        bool isHealthy(size_t idx);
+
+        /**
+         * @brief Returns layer currently used for publishing to topic
+         * @param topic Topic
+         * @return Layer index
+         */
+        size_t getPubRoute(const std::string &topic);
+
+        /**
+         * @brief Returns layer holding subscription
+         * @param topic Topic
+         * @param idx Layer index (modified in-place)
+         * @retval NOT_FOUND Not subscribed
+         * @retval SUCCESS Layer found
+         */
+        ErrCode getSubRoute(const std::string &topic, size_t &idx);
+
+    private:
+        /**
+         * @brief Orders usable layers for topic
+         *
+         * Healthy layers (and unhealthy ones due for retry) come first in
+         * rendezvous order, then the remaining ones.
+         *
+         * Cached until health of some layer changes (or unhealthy layer
+         * becomes due for retry).
+         *
+         * Must be called with locked mutex.
+         *
+         * @param topic Topic
+         * @return Layer indices
+         */
+        std::vector<size_t> rank(const std::string &topic);
+
+        /**
+         * @brief Drops cached rankings
+         *
+         * Must be called with locked mutex.
+         */
+        void invalidateRanks();
+
+        /**
+         * @brief Records result of operation on layer
+         *
+         * Must be called with locked mutex.
+         *
+         * @param idx Layer index
+         * @param err Error code of operation
+         * @return Change of layer health
+         */
+        HealthChange recordResult(size_t idx, ErrCode err);
+
+        /**
+         * @brief Records result of operation on layer and handles health
+         * change
+         * @param idx Layer index
+         * @param err Error code of operation
+         */
+        void handleResult(size_t idx, ErrCode err);
+
+        /**
+         * @brief Moves subscriptions away from unhealthy layer
+         *
+         * Moved subscriptions are unsubscribed from the layer, or later by
+         * `removeStaleSubs()` if it fails.
+         *
+         * @param idx Layer index
+         */
+        void migrateSubs(size_t idx);
+
+        /**
+         * @brief Unsubscribes subscriptions moved away from recovered layer
+         * @param idx Layer index
+         */
+        void removeStaleSubs(size_t idx);
+
+        /**
+         * @brief Runs operation over layers ranked for topic until success
+         * @param topic Topic
+         * @param op Operation
+         * @param usedIdx Index of successful layer (modified in-place)
+         * @return Error code of successful or last tried layer
+         */
+        ErrCode runRanked(const std::string &topic,
+                          const std::function<ErrCode(IRemoteLayer *)> &op,
+                          size_t &usedIdx);
+
+        /**
+         * @brief Receives data from underlying layer
+         * @param data Data
+         * @return Error code returned by receive callback
+         */
+        ErrCode recvFrom(const SubData &data);
+
+        /**
+         * @brief Handles reconnection of underlying layer
+         *
+         * Marks layer healthy, restores its subscriptions and calls
+         * pool's own reconnect callback.
+         *
+         * @param idx Layer index
+         * @return Error code of reconnect callback or of last failed
+         * resubscription
+         */
+        ErrCode reconnectFrom(size_t idx);
+    };
+} // namespace kvik
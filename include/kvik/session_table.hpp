@@ -0,0 +1,578 @@
+/**
+ * @file session_table.hpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Open-addressing table of peer sessions
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#include "kvik/errors.hpp"
+#include "kvik/hash.hpp"
+#include "kvik/local_addr.hpp"
+
+namespace kvik
+{
+    /**
+     * @brief Per-peer session state
+     *
+     * Plain data stored inline in `SessionTable`.
+     */
+    struct PeerSession
+    {
+        uint16_t lastMsgId = 0;   //!< Highest accepted message ID
+        uint64_t msgIdWindow = 0; //!< Bit `i` set if `lastMsgId - i` was accepted
+
+        //! Peer's time difference
+        std::chrono::milliseconds tsDiff = std::chrono::milliseconds(0);
+
+        //! Expiration of session lease
+        std::chrono::steady_clock::time_point leaseExpiry = {};
+
+        uint32_t rxMsgs = 0;  //!< Number of received messages
+        uint32_t txMsgs = 0;  //!< Number of sent messages
+        uint16_t failCnt = 0; //!< Number of recently failed messages
+
+        /**
+         * @brief Checks and records message ID
+         *
+         * Sliding window replay protection: IDs older than 64 messages
+         * than the highest accepted ID are rejected.
+         *
+         * @param id Message ID
+         * @return true ID accepted (recorded)
+         * @return false Duplicate or too old ID
+         */
+        bool checkMsgId(uint16_t id);
+    };
+
+    /**
+     * @brief Open-addressing hash table keyed by local address
+     *
+     * Designed for gateways serving very large number of peers:
+     * - keys (addresses up to `MaxAddrLen` bytes) and values are stored
+     *   inline in a flat array, so lookup doesn't allocate and typically
+     *   touches one group of control bytes and one slot,
+     * - control bytes hold 7 bits of hash of each slot and are probed 8 at
+     *   a time (SWAR, works on any 32/64-bit CPU without SIMD extensions),
+     * - growth is incremental: old table is migrated a few slots per
+     *   mutating operation, so there are no latency spikes.
+     *
+     * Pointers to values are invalidated by any mutating operation.
+     * Not multithread safe.
+     *
+     * @tparam TValue Type of value (default constructible)
+     * @tparam MaxAddrLen Maximum address length
+     */
+    template <typename TValue, size_t MaxAddrLen = 8>
+    class SessionTable
+    {
+        static constexpr uint8_t CTRL_EMPTY = 0x80;   //!< Never used slot
+        static constexpr uint8_t CTRL_DELETED = 0xfe; //!< Removed slot
+        static constexpr size_t GROUP_SIZE = 8;       //!< Slots per probe group
+        static constexpr size_t REHASH_STEP = 16;     //!< Slots migrated per operation
+        static constexpr uint64_t LSBS = 0x0101010101010101ULL;
+        static constexpr uint64_t MSBS = 0x8080808080808080ULL;
+
+        /**
+         * @brief Inline address key
+         */
+        struct Key
+        {
+            std::array<uint8_t, MaxAddrLen> addr = {};
+            uint8_t len = 0;
+
+            bool operator==(const Key &other) const
+            {
+                return len == other.len &&
+                       std::memcmp(addr.data(), other.addr.data(), len) == 0;
+            }
+        };
+
+        /**
+         * @brief Table slot
+         */
+        struct Slot
+        {
+            Key key;
+            TValue value;
+        };
+
+        /**
+         * @brief Single generation of table
+         */
+        struct Table
+        {
+            std::vector<uint8_t> ctrl; //!< Control bytes
+            std::vector<Slot> slots;   //!< Slots
+            size_t size = 0;           //!< Number of full slots
+            size_t used = 0;           //!< Number of full and deleted slots
+
+            size_t capacity() const { return slots.size(); }
+        };
+
+        Table m_cur;            //!< Current table
+        Table m_old;            //!< Table being migrated (empty if none)
+        size_t m_migratePos = 0; //!< Next slot of `m_old` to migrate
+
+    public:
+        /**
+         * @brief Constructs empty table
+         * @param capacity Initial capacity (rounded up to power of 2, at
+         * least 8)
+         */
+        SessionTable(size_t capacity = 64)
+        {
+            size_t cap = GROUP_SIZE;
+            while (cap < capacity) {
+                cap *= 2;
+            }
+            m_cur = this->makeTable(cap);
+        }
+
+        /**
+         * @brief Finds session of address
+         * @param addr Address
+         * @return Pointer to value, nullptr if not found
+         */
+        TValue *find(const LocalAddr &addr)
+        {
+            Key key;
+            if (!this->makeKey(addr, key)) {
+                return nullptr;
+            }
+
+            uint64_t hash = this->hashKey(key);
+            size_t idx;
+            if (this->findIn(m_cur, key, hash, idx)) {
+                return &m_cur.slots[idx].value;
+            }
+            if (this->rehashing() && this->findIn(m_old, key, hash, idx)) {
+                return &m_old.slots[idx].value;
+            }
+            return nullptr;
+        }
+
+        /**
+         * @brief Finds session of address
+         * @param addr Address
+         * @return Pointer to value, nullptr if not found
+         */
+        const TValue *find(const LocalAddr &addr) const
+        {
+            return const_cast<SessionTable *>(this)->find(addr);
+        }
+
+        /**
+         * @brief Finds session of address or inserts default one
+         * @param addr Address
+         * @param value Pointer to value (modified in-place)
+         * @retval INVALID_SIZE Address is too long
+         * @retval SUCCESS Value found or inserted
+         */
+        ErrCode getOrInsert(const LocalAddr &addr, TValue *&value)
+        {
+            Key key;
+            if (!this->makeKey(addr, key)) {
+                return ErrCode::INVALID_SIZE;
+            }
+
+            this->migrateStep();
+
+            uint64_t hash = this->hashKey(key);
+            size_t idx;
+            if (this->findIn(m_cur, key, hash, idx)) {
+                value = &m_cur.slots[idx].value;
+                return ErrCode::SUCCESS;
+            }
+
+            TValue initValue{};
+            if (this->rehashing() && this->findIn(m_old, key, hash, idx)) {
+                // Move entry to current table right away
+                initValue = std::move(m_old.slots[idx].value);
+                this->eraseAt(m_old, idx);
+            }
+
+            if ((m_cur.used + 1) * 8 > m_cur.capacity() * 7) {
+                this->grow();
+            }
+
+            idx = this->insertIn(m_cur, key, hash, std::move(initValue));
+            value = &m_cur.slots[idx].value;
+            return ErrCode::SUCCESS;
+        }
+
+        /**
+         * @brief Removes session of address
+         * @param addr Address
+         * @return true Session removed
+         * @return false Session doesn't exist
+         */
+        bool erase(const LocalAddr &addr)
+        {
+            Key key;
+            if (!this->makeKey(addr, key)) {
+                return false;
+            }
+
+            this->migrateStep();
+
+            uint64_t hash = this->hashKey(key);
+            size_t idx;
+            if (this->findIn(m_cur, key, hash, idx)) {
+                this->eraseAt(m_cur, idx);
+                return true;
+            }
+            if (this->rehashing() && this->findIn(m_old, key, hash, idx)) {
+                this->eraseAt(m_old, idx);
+                return true;
+            }
+            return false;
+        }
+
+        /**
+         * @brief Calls function for each session
+         *
+         * Address passed to `f` is only valid during the call.
+         *
+         * @param f Function to call
+         */
+        void forEach(std::function<void(const LocalAddr &addr, TValue &value)> f)
+        {
+            LocalAddr addr;
+            for (Table *table : {&m_cur, &m_old}) {
+                for (size_t i = 0; i < table->capacity(); i++) {
+                    if (!this->isFull(table->ctrl[i])) {
+                        continue;
+                    }
+
+                    const auto &key = table->slots[i].key;
+                    addr.addr.assign(key.addr.begin(),
+                                     key.addr.begin() + key.len);
+                    f(addr, table->slots[i].value);
+                }
+            }
+        }
+
+        /**
+         * @brief Returns number of sessions
+         * @return Number of sessions
+         */
+        size_t size() const
+        {
+            return m_cur.size + m_old.size;
+        }
+
+        /**
+         * @brief Empty predicate
+         * @return true Table is empty
+         * @return false Table is not empty
+         */
+        bool empty() const
+        {
+            return this->size() == 0;
+        }
+
+        /**
+         * @brief Returns capacity of current table
+         * @return Capacity
+         */
+        size_t capacity() const
+        {
+            return m_cur.capacity();
+        }
+
+        /**
+         * @brief Checks whether incremental rehash is in progress
+         * @return true Old table is being migrated
+         * @return false No rehash in progress
+         */
+        bool rehashing() const
+        {
+            return !m_old.slots.empty();
+        }
+
+        /**
+         * @brief Removes all sessions
+         */
+        void clear()
+        {
+            m_cur = this->makeTable(m_cur.capacity());
+            m_old = {};
+            m_migratePos = 0;
+        }
+
+    private:
+        /**
+         * @brief Creates empty table
+         * @param capacity Capacity (power of 2, at least `GROUP_SIZE`)
+         * @return Table
+         */
+        static Table makeTable(size_t capacity)
+        {
+            Table table;
+            table.ctrl.assign(capacity, CTRL_EMPTY);
+            table.slots.resize(capacity);
+            return table;
+        }
+
+        /**
+         * @brief Converts address to inline key
+         * @param addr Address
+         * @param key Key (modified in-place)
+         * @return true Success
+         * @return false Address is too long
+         */
+        static bool makeKey(const LocalAddr &addr, Key &key)
+        {
+            if (addr.addr.size() > MaxAddrLen) {
+                return false;
+            }
+            std::copy(addr.addr.begin(), addr.addr.end(), key.addr.begin());
+            key.len = addr.addr.size();
+            return true;
+        }
+
+        /**
+         * @brief Hashes key
+         * @param key Key
+         * @return Hash
+         */
+        static uint64_t hashKey(const Key &key)
+        {
+            return fnv1a64(key.addr.data(), key.len);
+        }
+
+        /**
+         * @brief Returns 7-bit control value of hash
+         * @param hash Hash
+         * @return Control value
+         */
+        static uint8_t h2(uint64_t hash)
+        {
+            return hash & 0x7f;
+        }
+
+        /**
+         * @brief Checks whether control byte marks full slot
+         * @param ctrl Control byte
+         * @return true Slot is full
+         * @return false Slot is empty or deleted
+         */
+        static bool isFull(uint8_t ctrl)
+        {
+            return (ctrl & 0x80) == 0;
+        }
+
+        /**
+         * @brief Loads group of control bytes as little endian word
+         * @param ctrl Pointer to first control byte
+         * @return Group word (byte `i` is control byte of slot `i`)
+         */
+        static uint64_t loadGroup(const uint8_t *ctrl)
+        {
+            uint64_t word = 0;
+            for (size_t i = 0; i < GROUP_SIZE; i++) {
+                word |= static_cast<uint64_t>(ctrl[i]) << (i * 8);
+            }
+            return word;
+        }
+
+        /**
+         * @brief Finds bytes of group equal to control value
+         *
+         * May contain false positives (keys are compared anyway).
+         *
+         * @param group Group word
+         * @param h2 Control value
+         * @return Mask with MSB set in each matching byte
+         */
+        static uint64_t matchH2(uint64_t group, uint8_t h2)
+        {
+            uint64_t x = group ^ (LSBS * h2);
+            return (x - LSBS) & ~x & MSBS;
+        }
+
+        /**
+         * @brief Finds empty bytes of group
+         * @param group Group word
+         * @return Mask with MSB set in each empty byte
+         */
+        static uint64_t matchEmpty(uint64_t group)
+        {
+            // Only empty control byte has MSB set and bit 6 cleared
+            return group & ~(group << 1) & MSBS;
+        }
+
+        /**
+         * @brief Finds empty or deleted bytes of group
+         * @param group Group word
+         * @return Mask with MSB set in each empty or deleted byte
+         */
+        static uint64_t matchFree(uint64_t group)
+        {
+            return group & MSBS;
+        }
+
+        /**
+         * @brief Returns index of lowest byte set in mask
+         * @param mask Mask from `match*` functions (non-zero)
+         * @return Byte index
+         */
+        static size_t lowestByte(uint64_t mask)
+        {
+            size_t idx = 0;
+            while ((mask & 0x80) == 0) {
+                mask >>= 8;
+                idx++;
+            }
+            return idx;
+        }
+
+        /**
+         * @brief Finds key in table
+         * @param table Table
+         * @param key Key
+         * @param hash Hash of key
+         * @param idx Slot index (modified in-place)
+         * @return true Key found
+         * @return false Key not found
+         */
+        bool findIn(const Table &table, const Key &key, uint64_t hash,
+                    size_t &idx) const
+        {
+            size_t groups = table.capacity() / GROUP_SIZE;
+            size_t group = (hash >> 7) & (groups - 1);
+
+            // Triangular probing visits all groups
+            for (size_t probe = 1; probe <= groups; probe++) {
+                uint64_t word = loadGroup(&table.ctrl[group * GROUP_SIZE]);
+
+                for (uint64_t m = matchH2(word, h2(hash)); m != 0;
+                     m &= m - 1) {
+                    size_t i = group * GROUP_SIZE + lowestByte(m);
+                    if (isFull(table.ctrl[i]) && table.slots[i].key == key) {
+                        idx = i;
+                        return true;
+                    }
+                }
+
+                if (matchEmpty(word) != 0) {
+                    return false;
+                }
+
+                group = (group + probe) & (groups - 1);
+            }
+
+            return false;
+        }
+
+        /**
+         * @brief Inserts key, which isn't present, to table
+         * @param table Table (with at least one free slot)
+         * @param key Key
+         * @param hash Hash of key
+         * @param value Value
+         * @return Slot index
+         */
+        size_t insertIn(Table &table, const Key &key, uint64_t hash,
+                        TValue &&value)
+        {
+            size_t groups = table.capacity() / GROUP_SIZE;
+            size_t group = (hash >> 7) & (groups - 1);
+
+            for (size_t probe = 1;; probe++) {
+                uint64_t word = loadGroup(&table.ctrl[group * GROUP_SIZE]);
+                uint64_t m = matchFree(word);
+                if (m != 0) {
+                    size_t i = group * GROUP_SIZE + lowestByte(m);
+                    if (table.ctrl[i] == CTRL_EMPTY) {
+                        table.used++;
+                    }
+                    table.ctrl[i] = h2(hash);
+                    table.slots[i] = {key, std::move(value)};
+                    table.size++;
+                    return i;
+                }
+
+                group = (group + probe) & (groups - 1);
+            }
+        }
+
+        /**
+         * @brief Removes slot from table
+         *
+         * Slot becomes tombstone, so probe sequences stay intact.
+         *
+         * @param table Table
+         * @param idx Slot index
+         */
+        void eraseAt(Table &table, size_t idx)
+        {
+            table.ctrl[idx] = CTRL_DELETED;
+            table.slots[idx] = {};
+            table.size--;
+        }
+
+        /**
+         * @brief Starts incremental rehash into bigger table
+         *
+         * If previous rehash is still in progress, it's finished first.
+         * Table is only cleaned of tombstones (not grown) if it's mostly
+         * deleted slots.
+         */
+        void grow()
+        {
+            while (this->rehashing()) {
+                this->migrateStep();
+            }
+
+            size_t cap = m_cur.capacity();
+            if (m_cur.size * 2 >= cap) {
+                cap *= 2;
+            }
+
+            m_old = std::move(m_cur);
+            m_cur = this->makeTable(cap);
+            m_migratePos = 0;
+        }
+
+        /**
+         * @brief Migrates a few slots from old table
+         */
+        void migrateStep()
+        {
+            if (!this->rehashing()) {
+                return;
+            }
+
+            size_t end = std::min(m_migratePos + REHASH_STEP,
+                                  m_old.capacity());
+            for (; m_migratePos < end; m_migratePos++) {
+                if (!isFull(m_old.ctrl[m_migratePos])) {
+                    continue;
+                }
+
+                auto &slot = m_old.slots[m_migratePos];
+                this->insertIn(m_cur, slot.key, this->hashKey(slot.key),
+                               std::move(slot.value));
+                this->eraseAt(m_old, m_migratePos);
+            }
+
+            if (m_migratePos == m_old.capacity()) {
+                m_old = {};
+                m_migratePos = 0;
+            }
+        }
+    };
+} // namespace kvik
@@ -0,0 +1,187 @@
+/**
+ * @file shared_sub_index.hpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Subscription index with shared (load-balanced) subscriptions
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "kvik/errors.hpp"
+#include "kvik/node_config.hpp"
+#include "kvik/wildcard_trie.hpp"
+
+namespace kvik
+{
+    //! Prefix of shared subscription filters (`$share/<group>/<filter>`)
+    constexpr const char *SHARED_SUB_PREFIX = "$share";
+
+    /**
+     * @brief Subscription index with shared (load-balanced) subscriptions
+     *
+     * Maps topic filters to consumers (in-process subscribers, clients of
+     * gateway, ...). Ordinary subscriptions receive every matching message.
+     * Filters in form `$share/<group>/<filter>` (as in MQTT 5) form
+     * consumer groups and each matching message is delivered to single
+     * member of each group, so consumers can divide the work.
+     *
+     * Not multithread safe.
+     */
+    class SharedSubIndex
+    {
+    public:
+        using ConsumerId = uint64_t;
+
+        /**
+         * @brief Selection of group member
+         */
+        enum class Policy : uint8_t
+        {
+            ROUND_ROBIN = 0, //!< Members take turns
+            LEAST_LOADED,    //!< Member with fewest unreleased messages
+        };
+
+    private:
+        /**
+         * @brief Consumer group
+         */
+        struct Group
+        {
+            std::vector<ConsumerId> members;
+            mutable size_t next = 0; //!< Round-robin position
+        };
+
+        /**
+         * @brief Subscriptions of single filter
+         */
+        struct Entry
+        {
+            std::vector<ConsumerId> consumers;   //!< Ordinary subscribers
+            std::map<std::string, Group> groups; //!< Groups by name
+
+            bool empty() const { return consumers.empty() && groups.empty(); }
+        };
+
+        Policy m_policy;
+        NodeConfig::TopicSeparators m_sep;
+        WildcardTrie<Entry> m_trie;
+        std::string m_levelBuf;
+
+        //! Unreleased messages delivered through groups (per consumer)
+        std::unordered_map<ConsumerId, size_t> m_load;
+
+        //! Filters of each consumer (for removal)
+        std::unordered_map<ConsumerId, std::vector<std::string>> m_consumerSubs;
+
+    public:
+        /**
+         * @brief Constructs a new index
+         * @param policy Selection of group member
+         * @param sep Topic separators
+         * @throw kvik::Exception Invalid separators
+         */
+        SharedSubIndex(Policy policy = Policy::ROUND_ROBIN,
+                       const NodeConfig::TopicSeparators &sep = {});
+
+        /**
+         * @brief Parses shared subscription filter
+         * @param filter Filter (`$share/<group>/<filter>`)
+         * @param group Group name (modified in-place)
+         * @param realFilter Filter without prefix and group (modified
+         * in-place)
+         * @retval NOT_FOUND Not a shared subscription
+         * @retval INVALID_ARG Empty or wildcard group name, or empty filter
+         * @retval SUCCESS Parsed
+         */
+        ErrCode parseShared(const std::string &filter, std::string &group,
+                            std::string &realFilter) const;
+
+        /**
+         * @brief Subscribes consumer to filter
+         *
+         * Repeated subscription does nothing.
+         *
+         * @param consumer Consumer
+         * @param filter Ordinary or shared filter
+         * @retval INVALID_ARG Invalid shared filter
+         * @retval SUCCESS Subscribed
+         */
+        ErrCode subscribe(ConsumerId consumer, const std::string &filter);
+
+        /**
+         * @brief Unsubscribes consumer from filter
+         * @param consumer Consumer
+         * @param filter Ordinary or shared filter
+         * @retval INVALID_ARG Invalid shared filter
+         * @retval NOT_FOUND Not subscribed
+         * @retval SUCCESS Unsubscribed
+         */
+        ErrCode unsubscribe(ConsumerId consumer, const std::string &filter);
+
+        /**
+         * @brief Removes all subscriptions of consumer
+         * @param consumer Consumer
+         */
+        void removeConsumer(ConsumerId consumer);
+
+        /**
+         * @brief Finds consumers of message
+         *
+         * Every consumer is listed once, even if multiple filters match.
+         *
+         * If `selected` is given, members selected from groups are listed
+         * in it too and their load is incremented. Each of them must be
+         * released by `release()` once it processes the message. Without
+         * it, load isn't tracked (so `LEAST_LOADED` balances only by
+         * turns).
+         *
+         * @param topic Topic of message
+         * @param consumers Consumers (cleared and filled in-place)
+         * @param selected Consumers selected from groups (cleared and
+         * filled in-place, optional)
+         */
+        void match(const std::string &topic,
+                   std::vector<ConsumerId> &consumers,
+                   std::vector<ConsumerId> *selected = nullptr);
+
+        /**
+         * @brief Releases load of consumer
+         *
+         * Call once consumer listed in `selected` by `match()` processes
+         * the message.
+         *
+         * @param consumer Consumer
+         */
+        void release(ConsumerId consumer);
+
+        /**
+         * @brief Returns load of consumer
+         * @param consumer Consumer
+         * @return Number of unreleased messages delivered through groups
+         */
+        size_t load(ConsumerId consumer) const;
+
+        /**
+         * @brief Checks whether there are no subscriptions
+         * @return true No subscriptions
+         * @return false Some subscriptions
+         */
+        bool empty() const;
+
+    private:
+        /**
+         * @brief Selects member of group
+         * @param group Group
+         * @return Selected member
+         */
+        ConsumerId select(const Group &group) const;
+    };
+} // namespace kvik
@@ -0,0 +1,152 @@
+/**
+ * @file slot_scheduler.hpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Gateway-side assignment of uplink slots
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "kvik/errors.hpp"
+#include "kvik/local_addr.hpp"
+#include "kvik/local_msg.hpp"
+#include "kvik/uplink_slot.hpp"
+
+namespace kvik
+{
+    /**
+     * @brief Slot scheduler configuration
+     */
+    struct SlotSchedulerConfig
+    {
+        /**
+         * @brief Length of slot
+         *
+         * Must cover airtime of the longest uplink message plus clock
+         * synchronization error of clients.
+         */
+        std::chrono::milliseconds slotLen = std::chrono::milliseconds(100);
+
+        /**
+         * @brief Number of slots in frame
+         *
+         * Including contention slot, so `frameLen - 1` clients get a slot
+         * of their own. Frame length is the maximum deferral of uplink.
+         */
+        uint16_t frameLen = 32;
+
+        /**
+         * @brief Lifetime of assignment
+         *
+         * Assignment is renewed by every PROBE_RES or renewal OK carrying
+         * it, so should be longer than subscription renewal period of
+         * clients.
+         */
+        std::chrono::milliseconds lease = std::chrono::minutes(15);
+    };
+
+    /**
+     * @brief Gateway-side assignment of periodic uplink slots to clients
+     *
+     * Each client gets its own slot while there are free ones. Once all
+     * are taken, clients share the least loaded slots, so they collide
+     * only when transmitting in the same frame.
+     *
+     * Assignment is attached to responses (PROBE_RES or OK to subscription
+     * renewal) by `attach()`, which also renews its lease. Assignments of
+     * clients which disappeared are released by `expire()`.
+     *
+     * Each instance should serve clients on a single channel.
+     *
+     * Not multithread safe.
+     */
+    class SlotScheduler
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+    private:
+        /**
+         * @brief Assignment of client
+         */
+        struct Assignment
+        {
+            uint16_t idx;             //!< Slot
+            Clock::time_point expiry; //!< Expiration of lease
+        };
+
+        SlotSchedulerConfig m_conf;
+        std::unordered_map<LocalAddr, Assignment> m_assignments;
+        std::vector<uint16_t> m_load; //!< Number of clients by slot
+
+    public:
+        /**
+         * @brief Constructs slot scheduler
+         * @param conf Configuration
+         * @throw kvik::Exception Invalid parameters
+         */
+        SlotScheduler(const SlotSchedulerConfig &conf = {});
+
+        /**
+         * @brief Assigns slot to client (or renews its assignment)
+         * @param addr Client address
+         * @param now Current time
+         * @return Assigned slot
+         */
+        UplinkSlot assign(const LocalAddr &addr,
+                          Clock::time_point now = Clock::now());
+
+        /**
+         * @brief Attaches client's slot to response
+         *
+         * Slot is assigned if client doesn't have one yet.
+         *
+         * @param resp PROBE_RES or OK response (with address set)
+         * @param now Current time
+         * @retval INVALID_ARG Response of different type or without address
+         * @retval SUCCESS Slot attached
+         */
+        ErrCode attach(LocalMsg &resp, Clock::time_point now = Clock::now());
+
+        /**
+         * @brief Releases slot of client
+         * @param addr Client address
+         */
+        void release(const LocalAddr &addr);
+
+        /**
+         * @brief Releases assignments with expired lease
+         * @param now Current time
+         * @return Number of released assignments
+         */
+        size_t expire(Clock::time_point now = Clock::now());
+
+        /**
+         * @brief Returns number of clients with assigned slot
+         * @return Number of clients
+         */
+        size_t assignedCnt() const;
+
+        /**
+         * @brief Returns number of clients sharing slot
+         * @param idx Slot
+         * @return Number of clients (0 for invalid slot)
+         */
+        uint16_t slotLoad(uint16_t idx) const;
+
+    private:
+        /**
+         * @brief Builds slot description
+         * @param idx Slot
+         * @return Slot
+         */
+        UplinkSlot makeSlot(uint16_t idx) const;
+    };
+} // namespace kvik
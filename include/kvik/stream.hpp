@@ -0,0 +1,481 @@
+/**
+ * @file stream.hpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Chunked streaming transfer of large payloads
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "kvik/errors.hpp"
+
+namespace kvik
+{
+    //! Chunk index of state probe (asks receiver for acknowledgement only)
+    constexpr uint32_t STREAM_PROBE_IDX = UINT32_MAX;
+
+    //! Topic level appended to stream topic for acknowledgements
+    constexpr const char *STREAM_ACK_LEVEL = "_ack";
+
+    //! Callback for completely received stream
+    using StreamCb =
+        std::function<void(const std::string &topic, const std::string &data)>;
+
+    /**
+     * @brief Single chunk of streamed data
+     */
+    struct StreamChunk
+    {
+        uint32_t transferId = 0; //!< Transfer ID
+        uint32_t totalLen = 0;   //!< Length of whole transferred data
+        uint32_t idx = 0;        //!< Chunk index (or `STREAM_PROBE_IDX`)
+        uint16_t chunkSize = 0;  //!< Length of every chunk except the last one
+        std::string data;        //!< Chunk data
+
+        /**
+         * @brief Number of data chunks of FEC group (parity chunks only)
+         *
+         * Parity chunk protects chunks `idx` to `idx + fecK - 1`, its data
+         * are always `chunkSize` long (shorter last chunk is zero-padded).
+         * 0 for data chunks.
+         */
+        uint8_t fecK = 0;
+        uint8_t fecIdx = 0; //!< Parity index within FEC group
+
+        /**
+         * @brief Returns number of chunks of the transfer
+         * @return Number of chunks
+         */
+        uint32_t chunkCnt() const;
+
+        /**
+         * @brief Encodes chunk to payload
+         * @return Payload
+         */
+        std::string encode() const;
+
+        /**
+         * @brief Decodes chunk from payload
+         * @param payload Payload
+         * @param chunk Chunk (modified in-place)
+         * @retval INVALID_ARG Payload isn't a stream chunk
+         * @retval INVALID_SIZE Inconsistent lengths
+         * @retval SUCCESS Chunk decoded
+         */
+        static ErrCode decode(const std::string &payload, StreamChunk &chunk);
+    };
+
+    /**
+     * @brief Acknowledgement of streamed data
+     *
+     * Cumulative acknowledgement with selective acknowledgement bitmap of
+     * up to 64 following chunks.
+     */
+    struct StreamAck
+    {
+        uint32_t transferId = 0; //!< Transfer ID
+        uint32_t cumAck = 0;     //!< Number of contiguously received chunks
+        uint64_t sack = 0;       //!< Bit `i` set if chunk `cumAck + 1 + i` was received
+        bool complete = false;   //!< Whole transfer received
+        uint8_t lossRate = 0;    //!< Receiver's measured loss rate (x/255)
+
+        bool operator==(const StreamAck &other) const
+        {
+            return transferId == other.transferId && cumAck == other.cumAck &&
+                   sack == other.sack && complete == other.complete &&
+                   lossRate == other.lossRate;
+        }
+
+        /**
+         * @brief Encodes acknowledgement to payload
+         * @return Payload
+         */
+        std::string encode() const;
+
+        /**
+         * @brief Decodes acknowledgement from payload
+         * @param payload Payload
+         * @param ack Acknowledgement (modified in-place)
+         * @retval INVALID_ARG Payload isn't a stream acknowledgement
+         * @retval SUCCESS Acknowledgement decoded
+         */
+        static ErrCode decode(const std::string &payload, StreamAck &ack);
+    };
+
+    /**
+     * @brief Sending side of streaming transfer
+     *
+     * Splits data to chunks and keeps up to `window` of them in flight.
+     * Chunks are retransmitted selectively: as soon as a chunk sent later
+     * is acknowledged (RACK-style), or after retransmission timeout.
+     *
+     * Transfer can be resumed (e.g. after reboot or gateway change) by
+     * constructing sender with the same transfer ID and starting it with
+     * `resume`. Only chunks receiver doesn't have are sent then.
+     *
+     * Optional forward error correction: after every `fecGroup` chunks,
+     * Reed-Solomon parity chunks are sent (see `fecEncode()`), so
+     * receiver can recover lost chunks without waiting for
+     * retransmission. Number of parity chunks follows loss rate reported
+     * by receiver (none on lossless link). Chunks of FEC group aren't
+     * considered lost until chunk sent after group's parity is
+     * acknowledged.
+     *
+     * Transport-agnostic, payloads are passed to `SendFn`. Works in both
+     * directions (client to gateway and back).
+     *
+     * Not multithread safe.
+     */
+    class StreamSender
+    {
+    public:
+        using SendFn = std::function<ErrCode(const std::string &payload)>;
+
+    private:
+        /**
+         * @brief State of single chunk
+         */
+        enum class ChunkState : uint8_t
+        {
+            PENDING = 0, //!< Not sent yet (or lost)
+            IN_FLIGHT,   //!< Sent, not acknowledged
+            ACKED,       //!< Acknowledged
+        };
+
+        uint32_t m_transferId;
+        std::string m_data;
+        uint16_t m_chunkSize;
+        size_t m_window;
+        std::chrono::milliseconds m_rto;
+        SendFn m_send;
+
+        std::vector<ChunkState> m_states;
+        std::vector<std::chrono::steady_clock::time_point> m_sentAt;
+        std::vector<uint64_t> m_sentSeq; //!< Transmission order (0 = never sent)
+        uint64_t m_sendSeq = 0;
+        size_t m_base = 0; //!< First unacknowledged chunk
+        size_t m_inFlight = 0;
+        size_t m_ackedCnt = 0;
+        bool m_probing = false; //!< Waiting for acknowledgement of probe
+        std::chrono::steady_clock::time_point m_probeSentAt;
+        uint64_t m_retransmits = 0;
+        bool m_complete = false;
+
+        size_t m_fecGroup;     //!< Data chunks per FEC group
+        size_t m_fecMaxParity; //!< Maximum parity chunks per group
+        double m_lossRate = 0; //!< Loss rate reported by receiver
+
+        //! Transmission order of group's last parity chunk (0 = none)
+        std::vector<uint64_t> m_paritySeq;
+        uint64_t m_paritySent = 0;
+
+    public:
+        /**
+         * @brief Constructs stream sender
+         * @param transferId Transfer ID
+         * @param data Data to transfer
+         * @param chunkSize Maximum length of chunk data
+         * @param window Maximum number of chunks in flight
+         * @param rto Retransmission timeout
+         * @param send Function sending payload
+         * @param fecGroup Data chunks per FEC group (0 disables FEC)
+         * @param fecMaxParity Maximum parity chunks per FEC group
+         * @throw kvik::Exception Invalid parameters
+         */
+        StreamSender(uint32_t transferId, std::string data,
+                     uint16_t chunkSize, size_t window,
+                     std::chrono::milliseconds rto, SendFn send,
+                     size_t fecGroup = 0, size_t fecMaxParity = 4);
+
+        /**
+         * @brief Starts transfer
+         * @param resume Ask receiver for its state first
+         * @return Error code returned by `SendFn`
+         */
+        ErrCode start(bool resume = false);
+
+        /**
+         * @brief Processes acknowledgement and sends more chunks
+         * @param ack Acknowledgement
+         * @retval INVALID_ARG Acknowledgement of different transfer
+         * @retval * Error code returned by `SendFn`
+         */
+        ErrCode processAck(const StreamAck &ack);
+
+        /**
+         * @brief Retransmits timed out chunks
+         * @param now Current time
+         * @return Error code returned by `SendFn`
+         */
+        ErrCode tick(std::chrono::steady_clock::time_point now =
+                         std::chrono::steady_clock::now());
+
+        /**
+         * @brief Checks whether receiver has all data
+         * @return true Transfer complete
+         * @return false Transfer in progress
+         */
+        bool done() const { return m_complete; }
+
+        /**
+         * @brief Returns transfer ID
+         * @return Transfer ID
+         */
+        uint32_t transferId() const { return m_transferId; }
+
+        /**
+         * @brief Returns number of chunks
+         * @return Number of chunks
+         */
+        size_t chunkCnt() const { return m_states.size(); }
+
+        /**
+         * @brief Returns number of acknowledged chunks
+         * @return Number of acknowledged chunks
+         */
+        size_t ackedCnt() const { return m_ackedCnt; }
+
+        /**
+         * @brief Returns number of retransmitted chunks
+         * @return Number of retransmissions
+         */
+        uint64_t retransmits() const { return m_retransmits; }
+
+        /**
+         * @brief Returns number of sent parity chunks
+         * @return Number of parity chunks
+         */
+        uint64_t paritySent() const { return m_paritySent; }
+
+        /**
+         * @brief Returns loss rate used for FEC redundancy
+         * @return Loss rate (0 to 1)
+         */
+        double lossRate() const { return m_lossRate; }
+
+        /**
+         * @brief Sets initial loss rate (e.g. measured by previous transfer)
+         *
+         * Overwritten by acknowledgements.
+         *
+         * @param lossRate Loss rate (0 to 1)
+         */
+        void setLossRate(double lossRate) { m_lossRate = lossRate; }
+
+    private:
+        /**
+         * @brief Sends pending chunks while window allows
+         * @return Error code returned by `SendFn`
+         */
+        ErrCode pump();
+
+        /**
+         * @brief Sends chunk
+         * @param idx Chunk index
+         * @return Error code returned by `SendFn`
+         */
+        ErrCode sendChunk(size_t idx);
+
+        /**
+         * @brief Sends parity chunks of FEC group
+         * @param group Group index
+         * @return Error code returned by `SendFn`
+         */
+        ErrCode sendParity(size_t group);
+
+        /**
+         * @brief Returns chunk data padded to chunk size
+         * @param idx Chunk index
+         * @return Padded data
+         */
+        std::string paddedChunk(size_t idx) const;
+
+        /**
+         * @brief Marks chunk as acknowledged
+         * @param idx Chunk index
+         */
+        void markAcked(size_t idx);
+    };
+
+    /**
+     * @brief Receiving side of streaming transfers
+     *
+     * Reassembles chunks of concurrent transfers (keyed by transfer ID)
+     * and produces acknowledgements. State of incomplete transfers is kept,
+     * so senders can resume them, until no chunk arrives for the idle
+     * timeout.
+     *
+     * Lost chunks are recovered from FEC parity chunks, if sent. Loss rate
+     * is measured from gaps in first transmissions and reported back, so
+     * sender can adapt redundancy.
+     *
+     * Not multithread safe.
+     */
+    class StreamReceiver
+    {
+    public:
+        using CompleteCb =
+            std::function<void(uint32_t transferId, const std::string &data)>;
+
+    private:
+        /**
+         * @brief Received parity chunks of FEC group
+         */
+        struct FecGroup
+        {
+            uint8_t k = 0;                         //!< Number of data chunks
+            std::map<size_t, std::string> parity; //!< Parity by index
+        };
+
+        /**
+         * @brief Incomplete transfer
+         */
+        struct Transfer
+        {
+            std::string data;
+            uint16_t chunkSize = 0;
+            std::vector<bool> received;
+            uint32_t receivedCnt = 0;
+            uint32_t cumAck = 0;
+            uint32_t nextIdx = 0; //!< Next chunk expected in order
+
+            //! Parity chunks by first chunk of FEC group
+            std::map<uint32_t, FecGroup> fecGroups;
+
+            //! Time of last received chunk
+            std::chrono::steady_clock::time_point lastActivity;
+        };
+
+        size_t m_maxTransfers;
+        size_t m_maxLen;
+        std::chrono::milliseconds m_idleTimeout;
+        CompleteCb m_completeCb;
+        std::unordered_map<uint32_t, Transfer> m_transfers;
+        std::deque<uint32_t> m_completed; //!< Recently completed transfers
+        double m_lossRate = 0;            //!< Measured loss rate (EWMA)
+
+    public:
+        /**
+         * @brief Constructs stream receiver
+         * @param completeCb Callback for completed transfers
+         * @param maxTransfers Maximum number of concurrent transfers
+         * @param maxLen Maximum length of transferred data
+         * @param idleTimeout Time after which incomplete transfer without
+         * any received chunk is dropped
+         */
+        StreamReceiver(CompleteCb completeCb, size_t maxTransfers = 4,
+                       size_t maxLen = 1024 * 1024,
+                       std::chrono::milliseconds idleTimeout =
+                           std::chrono::minutes(5));
+
+        /**
+         * @brief Processes received chunk
+         *
+         * Completion callback is called synchronously when the last
+         * missing chunk arrives.
+         *
+         * @param chunk Chunk
+         * @param ack Acknowledgement to send back (modified in-place)
+         * @param now Current time
+         * @retval INVALID_SIZE Transfer is too big
+         * @retval INVALID_ARG Chunk inconsistent with transfer
+         * @retval QUEUE_FULL Too many concurrent transfers
+         * @retval SUCCESS Chunk processed
+         */
+        ErrCode processChunk(const StreamChunk &chunk, StreamAck &ack,
+                             std::chrono::steady_clock::time_point now =
+                                 std::chrono::steady_clock::now());
+
+        /**
+         * @brief Returns acknowledgement of transfer's current state
+         * @param transferId Transfer ID
+         * @param ack Acknowledgement (modified in-place)
+         * @retval NOT_FOUND Unknown transfer
+         * @retval SUCCESS Acknowledgement returned
+         */
+        ErrCode getAck(uint32_t transferId, StreamAck &ack) const;
+
+        /**
+         * @brief Drops incomplete transfer
+         * @param transferId Transfer ID
+         * @return true Transfer dropped
+         * @return false Unknown transfer
+         */
+        bool abort(uint32_t transferId);
+
+        /**
+         * @brief Drops incomplete transfers idle for too long
+         *
+         * Called by `processChunk()` before a new transfer is started.
+         *
+         * @param now Current time
+         * @return Number of dropped transfers
+         */
+        size_t expireIdle(std::chrono::steady_clock::time_point now =
+                              std::chrono::steady_clock::now());
+
+        /**
+         * @brief Returns number of incomplete transfers
+         * @return Number of transfers
+         */
+        size_t transferCnt() const { return m_transfers.size(); }
+
+        /**
+         * @brief Returns measured loss rate
+         * @return Loss rate (0 to 1)
+         */
+        double lossRate() const { return m_lossRate; }
+
+    private:
+        /**
+         * @brief Builds acknowledgement of transfer
+         * @param transferId Transfer ID
+         * @param transfer Transfer
+         * @return Acknowledgement
+         */
+        StreamAck buildAck(uint32_t transferId,
+                           const Transfer &transfer) const;
+
+        /**
+         * @brief Stores chunk data
+         * @param transfer Transfer
+         * @param idx Chunk index
+         * @param data Chunk data
+         */
+        static void storeChunk(Transfer &transfer, size_t idx,
+                               const std::string &data);
+
+        /**
+         * @brief Updates loss rate with chunk received for the first time
+         * @param transfer Transfer
+         * @param idx Chunk index
+         */
+        void updateLossRate(Transfer &transfer, size_t idx);
+
+        /**
+         * @brief Recovers lost chunks of FEC group, if possible
+         * @param transfer Transfer
+         * @param start First chunk of group
+         */
+        static void recoverGroup(Transfer &transfer, uint32_t start);
+
+        /**
+         * @brief Checks whether transfer was recently completed
+         * @param transferId Transfer ID
+         * @return true Transfer completed
+         * @return false Transfer not completed (or long ago)
+         */
+        bool isCompleted(uint32_t transferId) const;
+    };
+} // namespace kvik
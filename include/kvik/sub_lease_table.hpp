@@ -0,0 +1,277 @@
+/**
+ * @file sub_lease_table.hpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Gateway-side subscriptions with expiring leases
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "kvik/errors.hpp"
+#include "kvik/hash.hpp"
+#include "kvik/node_config.hpp"
+#include "kvik/shared_sub_index.hpp"
+#include "kvik/timing_wheel.hpp"
+
+namespace kvik
+{
+    /**
+     * @brief Gateway-side subscriptions with expiring leases
+     *
+     * Clients renew their subscriptions periodically (see
+     * `ClientConfig::SubDB::subLifetime`), gateway drops subscriptions
+     * not renewed within its own lifetime.
+     *
+     * Leases are tracked in a hierarchical timing wheel, so subscription
+     * and renewal are O(1) and `tick()` touches only expiring leases, no
+     * matter how many subscriptions are held.
+     *
+     * Subscriptions of all consumers are aggregated to upstream
+     * subscriptions (shared subscriptions use the filter without
+     * `$share/<group>/` prefix). Once the last lease of upstream
+     * subscription expires or is removed, the filter is unsubscribed
+     * upstream. Unsubscriptions are emitted in batches by `tick()`.
+     *
+     * Not multithread safe.
+     */
+    class SubLeaseTable
+    {
+    public:
+        using ConsumerId = SharedSubIndex::ConsumerId;
+
+        /**
+         * @brief Callback for batch of upstream unsubscriptions
+         */
+        using UnsubCb = std::function<void(const std::vector<std::string> &)>;
+
+    private:
+        /**
+         * @brief Lease of single subscription
+         */
+        struct Lease
+        {
+            ConsumerId consumer = 0;
+            std::string filter;
+
+            bool operator==(const Lease &other) const
+            {
+                return consumer == other.consumer && filter == other.filter;
+            }
+        };
+
+        /**
+         * @brief Hash of lease
+         */
+        struct LeaseHash
+        {
+            size_t operator()(const Lease &lease) const
+            {
+                return fnv1a64(lease.filter) ^
+                       (lease.consumer * 0x9E3779B97F4A7C15);
+            }
+        };
+
+        std::chrono::milliseconds m_lifetime;
+        std::chrono::milliseconds m_resolution;
+        std::chrono::steady_clock::time_point m_epoch; //!< Tick 0
+        UnsubCb m_unsubCb;
+        size_t m_batchSize;
+
+        SharedSubIndex m_index;
+        TimingWheel<Lease, LeaseHash> m_wheel;
+        std::vector<Lease> m_expired;
+
+        //! Filters of each consumer
+        std::unordered_map<ConsumerId, std::vector<std::string>> m_consumerSubs;
+
+        //! Number of leases of each upstream filter
+        std::unordered_map<std::string, size_t> m_upstream;
+
+        //! Upstream filters waiting for unsubscription
+        std::unordered_set<std::string> m_pendingUnsubs;
+
+    public:
+        /**
+         * @brief Constructs a new table
+         * @param lifetime Lifetime of lease
+         * @param unsubCb Callback for batch of upstream unsubscriptions
+         * @param batchSize Maximum number of filters in batch
+         * @param resolution Expiration resolution (leases may live up to
+         * one resolution longer)
+         * @param policy Selection of shared subscription group member
+         * @param sep Topic separators
+         * @throw kvik::Exception Invalid parameters
+         */
+        SubLeaseTable(std::chrono::milliseconds lifetime, UnsubCb unsubCb,
+                      size_t batchSize = 32,
+                      std::chrono::milliseconds resolution =
+                          std::chrono::seconds(1),
+                      SharedSubIndex::Policy policy =
+                          SharedSubIndex::Policy::ROUND_ROBIN,
+                      const NodeConfig::TopicSeparators &sep = {});
+
+        /**
+         * @brief Subscribes consumer (or renews its lease)
+         * @param consumer Consumer
+         * @param filter Ordinary or shared filter
+         * @param now Current time
+         * @param newUpstream Whether upstream subscription must be made
+         * (modified in-place)
+         * @retval INVALID_ARG Invalid shared filter
+         * @retval SUCCESS Subscribed or renewed
+         */
+        ErrCode subscribe(ConsumerId consumer, const std::string &filter,
+                          std::chrono::steady_clock::time_point now,
+                          bool &newUpstream);
+
+        /**
+         * @brief Subscribes consumer with explicit lease expiration
+         *
+         * Used to restore leases (e.g. replicated from another gateway).
+         *
+         * @param consumer Consumer
+         * @param filter Ordinary or shared filter
+         * @param expiry Expiration of lease
+         * @param newUpstream Whether upstream subscription must be made
+         * (modified in-place)
+         * @retval INVALID_ARG Invalid shared filter
+         * @retval SUCCESS Subscribed or renewed
+         */
+        ErrCode subscribeUntil(ConsumerId consumer, const std::string &filter,
+                               std::chrono::steady_clock::time_point expiry,
+                               bool &newUpstream);
+
+        /**
+         * @brief Renews all leases of consumer
+         * @param consumer Consumer
+         * @param now Current time
+         * @return Number of renewed leases
+         */
+        size_t renewAll(ConsumerId consumer,
+                        std::chrono::steady_clock::time_point now);
+
+        /**
+         * @brief Unsubscribes consumer
+         *
+         * Upstream unsubscription (if any) is emitted by next `tick()`.
+         *
+         * @param consumer Consumer
+         * @param filter Ordinary or shared filter
+         * @retval NOT_FOUND Not subscribed
+         * @retval SUCCESS Unsubscribed
+         */
+        ErrCode unsubscribe(ConsumerId consumer, const std::string &filter);
+
+        /**
+         * @brief Removes all subscriptions of consumer
+         *
+         * Upstream unsubscriptions (if any) are emitted by next `tick()`.
+         *
+         * @param consumer Consumer
+         */
+        void removeConsumer(ConsumerId consumer);
+
+        /**
+         * @brief Finds consumers of message
+         *
+         * See `SharedSubIndex::match()`.
+         *
+         * @param topic Topic of message
+         * @param consumers Consumers (cleared and filled in-place)
+         * @param selected Consumers selected from groups (cleared and
+         * filled in-place, optional)
+         */
+        void match(const std::string &topic,
+                   std::vector<ConsumerId> &consumers,
+                   std::vector<ConsumerId> *selected = nullptr);
+
+        /**
+         * @brief Releases load of consumer
+         *
+         * See `SharedSubIndex::release()`.
+         *
+         * @param consumer Consumer
+         */
+        void release(ConsumerId consumer);
+
+        /**
+         * @brief Expires leases and emits upstream unsubscriptions
+         *
+         * Call periodically, ideally once per resolution.
+         *
+         * @param now Current time
+         * @return Number of expired leases
+         */
+        size_t tick(std::chrono::steady_clock::time_point now);
+
+        /**
+         * @brief Calls function for each lease
+         *
+         * Expiration is rounded up to resolution.
+         *
+         * @param f Function to call
+         */
+        void forEach(std::function<void(ConsumerId consumer,
+                                        const std::string &filter,
+                                        std::chrono::steady_clock::time_point
+                                            expiry)>
+                         f) const;
+
+        /**
+         * @brief Returns all upstream filters
+         * @param filters Filters (cleared and filled in-place)
+         */
+        void upstreamFilters(std::vector<std::string> &filters) const;
+
+        /**
+         * @brief Returns number of leases
+         * @return Number of leases
+         */
+        size_t size() const;
+
+        /**
+         * @brief Returns number of upstream subscriptions
+         * @return Number of filters
+         */
+        size_t upstreamCnt() const;
+
+    private:
+        /**
+         * @brief Converts time to wheel tick (rounded up)
+         * @param time Time
+         * @return Tick
+         */
+        uint64_t toTick(std::chrono::steady_clock::time_point time) const;
+
+        /**
+         * @brief Returns upstream filter of subscription
+         * @param filter Ordinary or shared filter
+         * @param upstream Upstream filter (modified in-place)
+         * @retval INVALID_ARG Invalid shared filter
+         * @retval SUCCESS Upstream filter returned
+         */
+        ErrCode upstreamFilter(const std::string &filter,
+                               std::string &upstream) const;
+
+        /**
+         * @brief Removes subscription (without touching the wheel)
+         * @param lease Lease
+         */
+        void removeSub(const Lease &lease);
+
+        /**
+         * @brief Emits pending upstream unsubscriptions
+         */
+        void flushUnsubs();
+    };
+} // namespace kvik
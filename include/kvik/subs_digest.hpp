@@ -0,0 +1,73 @@
+/**
+ * @file subs_digest.hpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Subscription set digest
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace kvik
+{
+    /**
+     * @brief Compact digest of subscription set
+     *
+     * Sent by client instead of full list of subscribed topics during
+     * subscription renewals. Gateway compares it with digest of
+     * subscriptions it holds for the client and tells whether they match.
+     * Full topics are transmitted only on mismatch.
+     *
+     * Digest doesn't depend on order of topics.
+     */
+    struct SubsDigest
+    {
+        uint32_t hash = 0; //!< Order-independent hash of all topics
+        uint32_t cnt = 0;  //!< Number of topics
+
+        bool operator==(const SubsDigest &other) const
+        {
+            return hash == other.hash && cnt == other.cnt;
+        }
+
+        bool operator!=(const SubsDigest &other) const
+        {
+            return !this->operator==(other);
+        }
+
+        /**
+         * @brief Checks whether the digest is empty
+         *
+         * Empty digest means no digest (not even empty set) is present.
+         *
+         * @return true Digest is empty
+         * @return false Digest is not empty
+         */
+        bool empty() const
+        {
+            return cnt == 0;
+        }
+
+        /**
+         * @brief Converts `SubsDigest` to printable string
+         * @return String representation
+         */
+        std::string toString() const;
+    };
+
+    /**
+     * @brief Calculates digest of subscription set
+     *
+     * Uses platform-stable hash, so digests calculated by different nodes
+     * are comparable.
+     *
+     * @param topics Topics (order doesn't matter, must be unique)
+     * @return Digest
+     */
+    SubsDigest calcSubsDigest(const std::vector<std::string> &topics);
+} // namespace kvik
@@ -16,6 +16,8 @@
 #include <mutex>
 #include <thread>
 
+#include "kvik/mutex.hpp"
+
 namespace kvik
 {
     /**
@@ -25,12 +27,12 @@ namespace kvik
      */
     class Timer
     {
-        std::mutex m_mutex;                               //!< Mutex for conditional variable
+        Mutex m_mutex{"Timer"};                           //!< Mutex for conditional variable
         std::chrono::milliseconds m_interval;             //!< Timer interval
         std::chrono::steady_clock::time_point m_nextExec; //!< Next execution time point
         bool m_run;                                       //!< Whether to continue running
         std::function<void()> m_cb;                       //!< Callback
-        std::condition_variable m_cv;                     //!< Conditional variable (to sync destruction of handler thread)
+        CondVar m_cv;                                     //!< Conditional variable (to sync destruction of handler thread)
         std::thread m_thread;                             //!< Handler thread
 
     public:
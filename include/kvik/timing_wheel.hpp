@@ -0,0 +1,365 @@
+/**
+ * @file timing_wheel.hpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Hierarchical timing wheel
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "kvik/errors.hpp"
+
+namespace kvik
+{
+    /**
+     * @brief Hierarchical timing wheel
+     *
+     * Tracks expiration of very large number of keys:
+     * - schedule, reschedule (renew) and cancel are O(1),
+     * - advancing costs O(1) per 64 ticks plus O(1) per expired key, empty
+     *   slots are skipped using occupancy bitmaps,
+     * - each key is moved between levels at most `LEVELS - 1` times.
+     *
+     * Time is measured in abstract ticks (caller chooses resolution).
+     * Level `l` has 64 slots of 64^l ticks each, so 4 levels cover
+     * 16.7 million ticks (194 days at 1 s resolution). Keys scheduled
+     * further are parked in the top level and rescheduled when reached.
+     *
+     * Not multithread safe.
+     *
+     * @tparam TKey Type of key (default constructible, hashable)
+     * @tparam THash Hash of key
+     */
+    template <typename TKey, typename THash = std::hash<TKey>>
+    class TimingWheel
+    {
+        static constexpr unsigned SLOT_BITS = 6;
+        static constexpr size_t SLOTS = size_t(1) << SLOT_BITS;
+        static constexpr uint64_t SLOT_MASK = SLOTS - 1;
+        static constexpr size_t LEVELS = 4;
+        static constexpr uint32_t NIL = UINT32_MAX;
+
+        /**
+         * @brief Scheduled key (node of intrusive list of its slot)
+         */
+        struct Node
+        {
+            TKey key;
+            uint64_t expiry = 0; //!< Expiration tick
+            uint32_t prev = NIL;
+            uint32_t next = NIL;
+            uint8_t level = 0;
+            uint8_t slot = 0;
+        };
+
+        std::vector<Node> m_nodes;
+        std::vector<uint32_t> m_freeNodes;
+        std::array<std::array<uint32_t, SLOTS>, LEVELS> m_heads;
+        std::array<uint64_t, LEVELS> m_occupied = {}; //!< Non-empty slots
+        std::unordered_map<TKey, uint32_t, THash> m_index;
+        uint64_t m_now = 0; //!< Last processed tick
+
+    public:
+        /**
+         * @brief Constructs a new timing wheel
+         * @param now Initial tick
+         */
+        TimingWheel(uint64_t now = 0) : m_now{now}
+        {
+            for (auto &level : m_heads) {
+                level.fill(NIL);
+            }
+        }
+
+        /**
+         * @brief Schedules (or reschedules) expiration of key
+         *
+         * Expiration in the past expires with the next tick.
+         *
+         * @param key Key
+         * @param expiry Expiration tick
+         */
+        void schedule(const TKey &key, uint64_t expiry)
+        {
+            auto [it, inserted] = m_index.try_emplace(key, NIL);
+            if (inserted) {
+                it->second = this->allocNode(key);
+            } else {
+                this->unlink(it->second);
+            }
+
+            m_nodes[it->second].expiry = std::max(expiry, m_now + 1);
+            this->link(it->second);
+        }
+
+        /**
+         * @brief Cancels expiration of key
+         * @param key Key
+         * @retval NOT_FOUND Key isn't scheduled
+         * @retval SUCCESS Cancelled
+         */
+        ErrCode cancel(const TKey &key)
+        {
+            auto it = m_index.find(key);
+            if (it == m_index.end()) {
+                return ErrCode::NOT_FOUND;
+            }
+
+            this->unlink(it->second);
+            this->freeNode(it->second);
+            m_index.erase(it);
+            return ErrCode::SUCCESS;
+        }
+
+        /**
+         * @brief Returns expiration of key
+         * @param key Key
+         * @param expiry Expiration tick (modified in-place)
+         * @retval NOT_FOUND Key isn't scheduled
+         * @retval SUCCESS Expiration returned
+         */
+        ErrCode getExpiry(const TKey &key, uint64_t &expiry) const
+        {
+            auto it = m_index.find(key);
+            if (it == m_index.end()) {
+                return ErrCode::NOT_FOUND;
+            }
+            expiry = m_nodes[it->second].expiry;
+            return ErrCode::SUCCESS;
+        }
+
+        /**
+         * @brief Advances time and collects expired keys
+         *
+         * Expired keys are unscheduled. Order of keys expiring in the
+         * same tick is unspecified.
+         *
+         * @param now Current tick (ignored if in the past)
+         * @param expired Expired keys (appended)
+         */
+        void advance(uint64_t now, std::vector<TKey> &expired)
+        {
+            if (m_index.empty()) {
+                m_now = std::max(m_now, now);
+                return;
+            }
+
+            while (m_now < now) {
+                // Expire level 0 up to next revolution (or `now`)
+                uint64_t revEnd = m_now | SLOT_MASK;
+                uint64_t limit = std::min(now, revEnd);
+                if (limit > m_now) {
+                    uint64_t first = (m_now + 1) & SLOT_MASK;
+                    uint64_t last = limit & SLOT_MASK;
+                    uint64_t range = (last == SLOT_MASK
+                                          ? ~uint64_t(0)
+                                          : (uint64_t(1) << (last + 1)) - 1) &
+                                     ~((uint64_t(1) << first) - 1);
+                    uint64_t due = m_occupied[0] & range;
+                    while (due != 0) {
+                        this->expireSlot(ctz(due), expired);
+                        due &= due - 1;
+                    }
+                    m_now = limit;
+                }
+
+                if (m_now < now) {
+                    // New revolution of level 0, cascade from upper levels
+                    m_now++;
+                    this->cascade();
+                    if (m_occupied[0] & 1) {
+                        this->expireSlot(0, expired);
+                    }
+                }
+
+                if (m_index.empty()) {
+                    m_now = now;
+                }
+            }
+        }
+
+        /**
+         * @brief Returns last processed tick
+         * @return Tick
+         */
+        uint64_t now() const { return m_now; }
+
+        /**
+         * @brief Returns number of scheduled keys
+         * @return Number of keys
+         */
+        size_t size() const { return m_index.size(); }
+
+        /**
+         * @brief Checks whether no key is scheduled
+         * @return true No key scheduled
+         * @return false Some keys scheduled
+         */
+        bool empty() const { return m_index.empty(); }
+
+    private:
+        /**
+         * @brief Counts trailing zero bits
+         * @param x Value (non-zero)
+         * @return Number of trailing zeros
+         */
+        static unsigned ctz(uint64_t x)
+        {
+            unsigned n = 0;
+            while ((x & 1) == 0) {
+                x >>= 1;
+                n++;
+            }
+            return n;
+        }
+
+        /**
+         * @brief Takes node from free list (or allocates new one)
+         * @param key Key
+         * @return Node index
+         */
+        uint32_t allocNode(const TKey &key)
+        {
+            uint32_t idx;
+            if (!m_freeNodes.empty()) {
+                idx = m_freeNodes.back();
+                m_freeNodes.pop_back();
+            } else {
+                idx = m_nodes.size();
+                m_nodes.emplace_back();
+            }
+            m_nodes[idx].key = key;
+            return idx;
+        }
+
+        /**
+         * @brief Returns node to free list
+         * @param idx Node index
+         */
+        void freeNode(uint32_t idx)
+        {
+            m_nodes[idx].key = TKey{};
+            m_freeNodes.push_back(idx);
+        }
+
+        /**
+         * @brief Inserts node to slot corresponding to its expiration
+         * @param idx Node index
+         */
+        void link(uint32_t idx)
+        {
+            auto &node = m_nodes[idx];
+            uint64_t delta = node.expiry - m_now;
+
+            size_t level = 0;
+            while (level < LEVELS - 1 &&
+                   delta >= (uint64_t(1) << (SLOT_BITS * (level + 1)))) {
+                level++;
+            }
+
+            uint64_t slotTick = node.expiry;
+            if (level == LEVELS - 1 &&
+                delta >= (uint64_t(1) << (SLOT_BITS * LEVELS))) {
+                // Out of range, park in the furthest slot
+                slotTick = m_now + (SLOT_MASK << (SLOT_BITS * level));
+            }
+
+            node.level = level;
+            node.slot = (slotTick >> (SLOT_BITS * level)) & SLOT_MASK;
+            node.prev = NIL;
+            node.next = m_heads[level][node.slot];
+            if (node.next != NIL) {
+                m_nodes[node.next].prev = idx;
+            }
+            m_heads[level][node.slot] = idx;
+            m_occupied[level] |= uint64_t(1) << node.slot;
+        }
+
+        /**
+         * @brief Removes node from its slot
+         * @param idx Node index
+         */
+        void unlink(uint32_t idx)
+        {
+            auto &node = m_nodes[idx];
+            if (node.prev != NIL) {
+                m_nodes[node.prev].next = node.next;
+            } else {
+                m_heads[node.level][node.slot] = node.next;
+                if (node.next == NIL) {
+                    m_occupied[node.level] &= ~(uint64_t(1) << node.slot);
+                }
+            }
+            if (node.next != NIL) {
+                m_nodes[node.next].prev = node.prev;
+            }
+            node.prev = node.next = NIL;
+        }
+
+        /**
+         * @brief Detaches whole slot
+         * @param level Level
+         * @param slot Slot
+         * @return Index of first node of detached list
+         */
+        uint32_t takeSlot(size_t level, size_t slot)
+        {
+            uint32_t head = m_heads[level][slot];
+            m_heads[level][slot] = NIL;
+            m_occupied[level] &= ~(uint64_t(1) << slot);
+            return head;
+        }
+
+        /**
+         * @brief Expires all keys of level 0 slot
+         * @param slot Slot
+         * @param expired Expired keys (appended)
+         */
+        void expireSlot(size_t slot, std::vector<TKey> &expired)
+        {
+            uint32_t idx = this->takeSlot(0, slot);
+            while (idx != NIL) {
+                uint32_t next = m_nodes[idx].next;
+                expired.push_back(std::move(m_nodes[idx].key));
+                m_index.erase(expired.back());
+                this->freeNode(idx);
+                idx = next;
+            }
+        }
+
+        /**
+         * @brief Moves keys of reached upper level slots to lower levels
+         *
+         * Called when `m_now` starts new revolution of level 0. Highest
+         * reached level is cascaded first, so its keys can cascade
+         * further in the same tick.
+         */
+        void cascade()
+        {
+            for (size_t level = LEVELS - 1; level >= 1; level--) {
+                // Level `level` starts new slot only if all lower bits are 0
+                uint64_t lowMask = (uint64_t(1) << (SLOT_BITS * level)) - 1;
+                if ((m_now & lowMask) != 0) {
+                    continue;
+                }
+
+                size_t slot = (m_now >> (SLOT_BITS * level)) & SLOT_MASK;
+                uint32_t idx = this->takeSlot(level, slot);
+                while (idx != NIL) {
+                    uint32_t next = m_nodes[idx].next;
+                    this->link(idx);
+                    idx = next;
+                }
+            }
+        }
+    };
+} // namespace kvik
@@ -0,0 +1,219 @@
+/**
+ * @file topic.hpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Precompiled topic and topic filter handles
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "kvik/node_config.hpp"
+
+namespace kvik
+{
+    using TopicSeparators = NodeConfig::TopicSeparators;
+
+    /**
+     * @brief Common part of `Topic` and `Filter`
+     *
+     * Holds topic string together with its levels and stable hash, all
+     * computed once during construction. Immutable.
+     */
+    class TopicHandle
+    {
+    protected:
+        std::string m_str;                 //!< Topic string
+        std::vector<std::string> m_levels; //!< Levels of topic
+        uint64_t m_hash;                   //!< FNV-1a hash of topic string
+        TopicSeparators m_sep;             //!< Separators used for splitting
+
+        /**
+         * @brief Splits topic to levels and calculates hash
+         * @param str Topic string
+         * @param sep Topic separators
+         */
+        TopicHandle(const std::string &str, const TopicSeparators &sep);
+
+    public:
+        /**
+         * @brief Returns topic string
+         * @return Topic string
+         */
+        const std::string &str() const { return m_str; }
+
+        /**
+         * @brief Returns topic levels
+         * @return Levels
+         */
+        const std::vector<std::string> &levels() const { return m_levels; }
+
+        /**
+         * @brief Returns stable hash of topic string
+         *
+         * Equal to `fnv1a64(str())`.
+         *
+         * @return Hash
+         */
+        uint64_t hash() const { return m_hash; }
+
+        /**
+         * @brief Returns separators used for splitting
+         * @return Topic separators
+         */
+        const TopicSeparators &separators() const { return m_sep; }
+
+        /**
+         * @brief Checks whether handle was split using given separators
+         *
+         * @param levelSeparator Level separator
+         * @param singleLevelWildcard Single-level wildcard token
+         * @param multiLevelWildcard Multi-level wildcard token
+         * @return true Separators match
+         * @return false Separators differ
+         */
+        bool usesSeparators(const std::string &levelSeparator,
+                            const std::string &singleLevelWildcard,
+                            const std::string &multiLevelWildcard) const
+        {
+            return m_sep.levelSeparator == levelSeparator &&
+                   m_sep.singleLevelWildcard == singleLevelWildcard &&
+                   m_sep.multiLevelWildcard == multiLevelWildcard;
+        }
+
+        bool operator==(const TopicHandle &other) const
+        {
+            return m_hash == other.m_hash && m_str == other.m_str;
+        }
+
+        bool operator!=(const TopicHandle &other) const
+        {
+            return !this->operator==(other);
+        }
+    };
+
+    /**
+     * @brief Precompiled topic name (without wildcards)
+     *
+     * Topic is validated, split to levels and hashed only once, so
+     * publishing to the same topic repeatedly doesn't pay for parsing
+     * again.
+     */
+    class Topic : public TopicHandle
+    {
+    public:
+        /**
+         * @brief Constructs topic handle
+         * @param str Topic string
+         * @param sep Topic separators (must match the node's)
+         * @throw kvik::Exception Invalid topic
+         */
+        explicit Topic(const std::string &str,
+                       const TopicSeparators &sep = {});
+
+        /**
+         * @brief Checks whether topic string is valid
+         *
+         * Topic must be non-empty and mustn't contain wildcard tokens.
+         *
+         * @param str Topic string
+         * @param sep Topic separators
+         * @return true Topic is valid
+         * @return false Topic is invalid
+         */
+        static bool isValid(const std::string &str,
+                            const TopicSeparators &sep = {});
+    };
+
+    /**
+     * @brief Precompiled topic filter (may contain wildcards)
+     *
+     * Like `Topic`, validated, split to levels and hashed only once.
+     */
+    class Filter : public TopicHandle
+    {
+        bool m_singleWild = false; //!< Contains single-level wildcard
+        bool m_multiWild = false;  //!< Contains multi-level wildcard
+
+    public:
+        /**
+         * @brief Constructs filter handle
+         * @param str Filter string
+         * @param sep Topic separators (must match the node's)
+         * @throw kvik::Exception Invalid filter
+         */
+        explicit Filter(const std::string &str,
+                        const TopicSeparators &sep = {});
+
+        /**
+         * @brief Checks whether filter string is valid
+         *
+         * Filter must be non-empty, wildcard tokens must take whole level
+         * and multi-level wildcard must be the last level.
+         *
+         * @param str Filter string
+         * @param sep Topic separators
+         * @return true Filter is valid
+         * @return false Filter is invalid
+         */
+        static bool isValid(const std::string &str,
+                            const TopicSeparators &sep = {});
+
+        /**
+         * @brief Checks whether filter contains any wildcard
+         * @return true Filter contains wildcard
+         * @return false Filter is plain topic
+         */
+        bool hasWildcard() const { return m_singleWild || m_multiWild; }
+
+        /**
+         * @brief Checks whether filter contains single-level wildcard
+         * @return true Filter contains single-level wildcard
+         * @return false Filter doesn't contain single-level wildcard
+         */
+        bool hasSingleLevelWildcard() const { return m_singleWild; }
+
+        /**
+         * @brief Checks whether filter contains multi-level wildcard
+         * @return true Filter contains multi-level wildcard
+         * @return false Filter doesn't contain multi-level wildcard
+         */
+        bool hasMultiLevelWildcard() const { return m_multiWild; }
+
+        /**
+         * @brief Checks whether topic matches the filter
+         *
+         * Semantics are the same as of `WildcardTrie::find`.
+         *
+         * @param topic Topic
+         * @return true Topic matches
+         * @return false Topic doesn't match
+         */
+        bool matches(const Topic &topic) const;
+    };
+} // namespace kvik
+
+// Define hasher functions
+template <>
+struct std::hash<kvik::Topic>
+{
+    std::size_t operator()(kvik::Topic const &topic) const noexcept
+    {
+        return topic.hash();
+    }
+};
+
+template <>
+struct std::hash<kvik::Filter>
+{
+    std::size_t operator()(kvik::Filter const &filter) const noexcept
+    {
+        return filter.hash();
+    }
+};
@@ -0,0 +1,308 @@
+/**
+ * @file topic_acl.hpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Topic access control lists
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "kvik/errors.hpp"
+#include "kvik/hash.hpp"
+#include "kvik/local_addr.hpp"
+#include "kvik/mutex.hpp"
+#include "kvik/node_config.hpp"
+#include "kvik/wildcard_trie.hpp"
+
+namespace kvik
+{
+    /**
+     * @brief Access type (bit flags)
+     */
+    enum class AclAccess : uint8_t
+    {
+        PUB = 0x01,     //!< Publishing
+        SUB = 0x02,     //!< Subscribing
+        PUB_SUB = 0x03, //!< Both publishing and subscribing
+    };
+
+    //! Maximum length of client address and topic to be cached together
+    constexpr size_t TOPIC_ACL_CACHE_KEY_LEN = 64;
+
+    /**
+     * @brief Topic access control lists
+     *
+     * Evaluates allow and deny topic filters (with wildcards) of
+     * individual clients and client groups. Deny rules always take
+     * precedence over allow rules. If no rule matches, default policy
+     * is used.
+     *
+     * Rules of each client and group are stored in `WildcardTrie`, so
+     * evaluation cost depends on topic depth rather than number of rules.
+     * Results are cached per (client, topic, access) in fixed-size
+     * direct-mapped cache, which is invalidated by any ACL change.
+     *
+     * Authorization doesn't allocate memory (once the internal level
+     * buffer grows to the longest topic level).
+     *
+     * All public methods are multithread safe.
+     */
+    class TopicAcl
+    {
+    public:
+        /**
+         * @brief Cache statistics
+         */
+        struct CacheStats
+        {
+            uint64_t hits = 0;   //!< Number of cache hits
+            uint64_t misses = 0; //!< Number of cache misses
+        };
+
+    private:
+        /**
+         * @brief Access bits of single filter
+         */
+        struct Rule
+        {
+            uint8_t allow = 0; //!< Allowed access bits
+            uint8_t deny = 0;  //!< Denied access bits
+        };
+
+        using RuleTrie = WildcardTrie<Rule>;
+
+        /**
+         * @brief Allocation-free hasher of local addresses
+         */
+        struct AddrHash
+        {
+            size_t operator()(const LocalAddr &addr) const noexcept
+            {
+                return fnv1a64(addr.addr.data(), addr.addr.size());
+            }
+        };
+
+        /**
+         * @brief Rules and group membership of client
+         */
+        struct ClientEntry
+        {
+            RuleTrie rules;             //!< Client's own rules
+            std::vector<size_t> groups; //!< Indexes of groups
+        };
+
+        /**
+         * @brief Cached authorization result
+         */
+        struct CacheEntry
+        {
+            uint64_t hash = 0;                   //!< Hash of the key
+            uint32_t gen = 0;                    //!< ACL generation
+            uint8_t access = 0;                  //!< Access bits
+            bool result = false;                 //!< Authorization result
+            uint8_t addrLen = 0;                 //!< Length of address
+            uint8_t topicLen = 0;                //!< Length of topic
+            char key[TOPIC_ACL_CACHE_KEY_LEN];   //!< Address followed by topic
+        };
+
+        mutable Mutex m_mutex{"TopicAcl"};
+        bool m_defaultAllow;
+        NodeConfig::TopicSeparators m_sep;
+
+        std::unordered_map<LocalAddr, ClientEntry, AddrHash> m_clients;
+        std::unordered_map<std::string, size_t> m_groupIdxs;
+        std::deque<RuleTrie> m_groups;
+        size_t m_ruleCnt = 0;
+
+        std::vector<CacheEntry> m_cache;
+        uint32_t m_gen = 1; //!< ACL generation (0 marks empty cache entry)
+        CacheStats m_cacheStats;
+
+        std::string m_levelBuf; //!< Scratch buffer for trie lookups
+
+    public:
+        /**
+         * @brief Constructs empty ACL
+         * @param defaultAllow Whether to allow access if no rule matches
+         * @param cacheSize Number of cache entries (power of 2, 0 disables
+         * cache)
+         * @param sep Topic separators
+         * @throw kvik::Exception Invalid cache size or separators
+         */
+        TopicAcl(bool defaultAllow = false, size_t cacheSize = 256,
+                 const NodeConfig::TopicSeparators &sep = {});
+
+        /**
+         * @brief Allows access of client to topics matching filter
+         * @param client Client address
+         * @param filter Topic filter (may contain wildcards)
+         * @param access Access type
+         * @retval INVALID_ARG Empty filter
+         * @retval SUCCESS Rule added
+         */
+        ErrCode allow(const LocalAddr &client, const std::string &filter,
+                      AclAccess access);
+
+        /**
+         * @brief Denies access of client to topics matching filter
+         * @param client Client address
+         * @param filter Topic filter (may contain wildcards)
+         * @param access Access type
+         * @retval INVALID_ARG Empty filter
+         * @retval SUCCESS Rule added
+         */
+        ErrCode deny(const LocalAddr &client, const std::string &filter,
+                     AclAccess access);
+
+        /**
+         * @brief Allows access of group members to topics matching filter
+         * @param group Group name
+         * @param filter Topic filter (may contain wildcards)
+         * @param access Access type
+         * @retval INVALID_ARG Empty filter
+         * @retval SUCCESS Rule added
+         */
+        ErrCode allowGroup(const std::string &group, const std::string &filter,
+                           AclAccess access);
+
+        /**
+         * @brief Denies access of group members to topics matching filter
+         * @param group Group name
+         * @param filter Topic filter (may contain wildcards)
+         * @param access Access type
+         * @retval INVALID_ARG Empty filter
+         * @retval SUCCESS Rule added
+         */
+        ErrCode denyGroup(const std::string &group, const std::string &filter,
+                          AclAccess access);
+
+        /**
+         * @brief Removes all client's rules for filter
+         * @param client Client address
+         * @param filter Topic filter
+         * @retval NOT_FOUND Rule doesn't exist
+         * @retval SUCCESS Rule removed
+         */
+        ErrCode removeRule(const LocalAddr &client, const std::string &filter);
+
+        /**
+         * @brief Removes all group's rules for filter
+         * @param group Group name
+         * @param filter Topic filter
+         * @retval NOT_FOUND Rule doesn't exist
+         * @retval SUCCESS Rule removed
+         */
+        ErrCode removeGroupRule(const std::string &group,
+                                const std::string &filter);
+
+        /**
+         * @brief Adds client to group
+         * @param client Client address
+         * @param group Group name
+         */
+        void addToGroup(const LocalAddr &client, const std::string &group);
+
+        /**
+         * @brief Removes client from group
+         * @param client Client address
+         * @param group Group name
+         * @retval NOT_FOUND Client isn't member of the group
+         * @retval SUCCESS Client removed from group
+         */
+        ErrCode removeFromGroup(const LocalAddr &client,
+                                const std::string &group);
+
+        /**
+         * @brief Removes all rules and group memberships of client
+         * @param client Client address
+         */
+        void removeClient(const LocalAddr &client);
+
+        /**
+         * @brief Removes all rules, groups and cached results
+         */
+        void clear();
+
+        /**
+         * @brief Returns total number of rules (filters)
+         * @return Number of rules
+         */
+        size_t ruleCnt() const;
+
+        /**
+         * @brief Authorizes access of client to topic
+         * @param client Client address
+         * @param topic Topic (without wildcards)
+         * @param access Access type (all bits must be granted)
+         * @return true Access granted
+         * @return false Access denied
+         */
+        bool authorize(const LocalAddr &client, std::string_view topic,
+                       AclAccess access);
+
+        /**
+         * @brief Returns cache statistics
+         * @return Cache statistics
+         */
+        CacheStats cacheStats() const;
+
+    private:
+        /**
+         * @brief Adds access bits to rule
+         * @param rules Rule trie
+         * @param filter Topic filter
+         * @param access Access type
+         * @param deny Whether to add deny bits (or allow bits)
+         * @retval INVALID_ARG Empty filter
+         * @retval SUCCESS Rule added
+         */
+        ErrCode addRule(RuleTrie &rules, const std::string &filter,
+                        AclAccess access, bool deny);
+
+        /**
+         * @brief Gets index of group, creates group if it doesn't exist
+         * @param group Group name
+         * @return Index of group
+         */
+        size_t getGroupIdx(const std::string &group);
+
+        /**
+         * @brief Gets entry of client, creates it if it doesn't exist
+         * @param client Client address
+         * @return Client entry
+         */
+        ClientEntry &getClient(const LocalAddr &client);
+
+        /**
+         * @brief Creates empty rule trie using ACL's topic separators
+         * @return Rule trie
+         */
+        RuleTrie newRules() const;
+
+        /**
+         * @brief Evaluates rules (without cache)
+         * @param client Client address
+         * @param topic Topic
+         * @param access Access bits
+         * @return true Access granted
+         * @return false Access denied
+         */
+        bool evaluate(const LocalAddr &client, std::string_view topic,
+                      uint8_t access);
+
+        /**
+         * @brief Invalidates all cached results
+         */
+        void invalidateCache();
+    };
+} // namespace kvik
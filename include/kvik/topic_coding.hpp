@@ -0,0 +1,53 @@
+/**
+ * @file topic_coding.hpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Front coding of topic lists
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "kvik/errors.hpp"
+
+namespace kvik
+{
+    /**
+     * @brief Encodes list of topics using front coding
+     *
+     * Used for topics of bulk frames (publications, subscriptions,
+     * unsubscriptions, subscription data), which often share long
+     * prefixes. Encoding is self-contained, no state is shared between
+     * peers.
+     *
+     * Topics are sorted and each stores only length of prefix shared with
+     * the previous one and the rest (suffix). Original order is kept by
+     * index of each topic:
+     * `varint count | entries`, entry:
+     * `varint index | varint prefix length | varint suffix length | suffix`.
+     *
+     * @param topics Topics
+     * @param out Output buffer (encoding is appended)
+     */
+    void frontEncodeTopics(const std::vector<std::string> &topics,
+                           std::string &out);
+
+    /**
+     * @brief Decodes list of topics encoded by `frontEncodeTopics()`
+     *
+     * Input is fully validated, so it's safe to use on received frames.
+     *
+     * @param in Input buffer
+     * @param pos Position of encoding in `in` (advanced past it in-place)
+     * @param topics Topics in original order (modified in-place)
+     * @retval INVALID_ARG Malformed encoding
+     * @retval SUCCESS Successfully decoded
+     */
+    ErrCode frontDecodeTopics(const std::string &in, size_t &pos,
+                              std::vector<std::string> &topics);
+} // namespace kvik
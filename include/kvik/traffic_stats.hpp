@@ -0,0 +1,227 @@
+/**
+ * @file traffic_stats.hpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Streaming traffic statistics
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "kvik/local_addr.hpp"
+#include "kvik/mutex.hpp"
+
+namespace kvik
+{
+    /**
+     * @brief Exponentially decayed rate
+     *
+     * Counts events with weights halving every `halfLife`. Rate is then
+     * derived from the decayed sum.
+     */
+    struct DecayedRate
+    {
+        double value = 0;                                    //!< Decayed sum
+        std::chrono::steady_clock::time_point lastUpdate{}; //!< Time of last update
+
+        /**
+         * @brief Adds event
+         * @param weight Weight of the event
+         * @param now Current time
+         * @param halfLife Half-life of event weights
+         */
+        void add(double weight, std::chrono::steady_clock::time_point now,
+                 std::chrono::milliseconds halfLife);
+
+        /**
+         * @brief Calculates rate
+         * @param now Current time
+         * @param halfLife Half-life of event weights
+         * @return Rate per second
+         */
+        double rate(std::chrono::steady_clock::time_point now,
+                    std::chrono::milliseconds halfLife) const;
+    };
+
+    /**
+     * @brief Heavy hitter entry
+     */
+    struct HeavyHitter
+    {
+        std::string key;       //!< Key (topic or hexdump of address)
+        uint64_t msgs = 0;     //!< Estimated total number of messages
+        uint64_t bytes = 0;    //!< Estimated total number of payload bytes
+        double msgRate = 0.0;  //!< Decayed message rate (per second)
+        double byteRate = 0.0; //!< Decayed byte rate (per second)
+    };
+
+    /**
+     * @brief Fixed-memory heavy hitters tracker
+     *
+     * Combination of count-min sketch (frequency estimates of all keys)
+     * and `k` tracked top keys. Key which isn't tracked replaces the least
+     * frequent tracked key as soon as its estimated frequency exceeds it.
+     *
+     * Memory usage is fixed after construction (except for key strings of
+     * tracked entries). Not multithread safe.
+     */
+    class HeavyHitters
+    {
+        struct Entry
+        {
+            std::string key;
+            uint64_t msgs = 0;
+            uint64_t bytes = 0;
+            DecayedRate msgRate;
+            DecayedRate byteRate;
+        };
+
+        size_t m_width;
+        size_t m_depth;
+        std::chrono::milliseconds m_halfLife;
+        std::vector<uint32_t> m_msgsSketch;  //!< Count-min sketch of messages
+        std::vector<uint32_t> m_bytesSketch; //!< Count-min sketch of bytes
+        std::vector<Entry> m_top;            //!< Tracked top keys (fixed size)
+
+    public:
+        /**
+         * @brief Constructs heavy hitters tracker
+         * @param width Count-min sketch width
+         * @param depth Count-min sketch depth
+         * @param k Number of tracked top keys
+         * @param halfLife Half-life of decayed rates
+         */
+        HeavyHitters(size_t width, size_t depth, size_t k,
+                     std::chrono::milliseconds halfLife);
+
+        /**
+         * @brief Records message
+         * @param key Key
+         * @param bytes Payload size
+         * @param now Current time
+         */
+        void record(const std::string &key, size_t bytes,
+                    std::chrono::steady_clock::time_point now);
+
+        /**
+         * @brief Estimates number of messages of any key
+         *
+         * Never underestimates.
+         *
+         * @param key Key
+         * @return Estimated number of messages
+         */
+        uint64_t estimate(const std::string &key) const;
+
+        /**
+         * @brief Returns tracked top keys
+         * @param now Current time (for rate calculation)
+         * @return Heavy hitters sorted by number of messages (descending)
+         */
+        std::vector<HeavyHitter> top(
+            std::chrono::steady_clock::time_point now) const;
+
+        /**
+         * @brief Clears all data
+         */
+        void clear();
+
+    private:
+        /**
+         * @brief Increments sketch by `inc` and returns new estimate
+         * @param sketch Sketch
+         * @param hash Hash of key
+         * @param inc Increment
+         * @return Estimate after increment
+         */
+        uint64_t sketchAdd(std::vector<uint32_t> &sketch, uint64_t hash,
+                           uint32_t inc);
+
+        /**
+         * @brief Returns estimate from sketch
+         * @param sketch Sketch
+         * @param hash Hash of key
+         * @return Estimate
+         */
+        uint64_t sketchGet(const std::vector<uint32_t> &sketch,
+                           uint64_t hash) const;
+    };
+
+    /**
+     * @brief Streaming traffic statistics of node
+     *
+     * Tracks heavy hitters per topic and per source address with decayed
+     * message and byte rates. Memory usage is constant.
+     *
+     * All public methods are multithread safe.
+     */
+    class TrafficStats
+    {
+    public:
+        /**
+         * @brief Statistics snapshot
+         */
+        struct Snapshot
+        {
+            uint64_t msgs = 0;                   //!< Total number of messages
+            uint64_t bytes = 0;                  //!< Total number of payload bytes
+            double msgRate = 0.0;                //!< Decayed message rate (per second)
+            double byteRate = 0.0;               //!< Decayed byte rate (per second)
+            std::vector<HeavyHitter> topTopics;  //!< Heaviest topics
+            std::vector<HeavyHitter> topSources; //!< Heaviest source addresses
+        };
+
+    private:
+        mutable Mutex m_mutex{"TrafficStats"};
+        std::chrono::milliseconds m_halfLife;
+        HeavyHitters m_topics;
+        HeavyHitters m_sources;
+        uint64_t m_msgs = 0;
+        uint64_t m_bytes = 0;
+        DecayedRate m_msgRate;
+        DecayedRate m_byteRate;
+
+    public:
+        /**
+         * @brief Constructs traffic statistics
+         * @param width Count-min sketch width
+         * @param depth Count-min sketch depth
+         * @param k Number of tracked top keys
+         * @param halfLife Half-life of decayed rates
+         */
+        TrafficStats(size_t width, size_t depth, size_t k,
+                     std::chrono::milliseconds halfLife);
+
+        /**
+         * @brief Records message
+         * @param src Source address (empty for locally originated messages)
+         * @param topic Topic
+         * @param bytes Payload size
+         * @param now Current time
+         */
+        void record(const LocalAddr &src, const std::string &topic,
+                    size_t bytes,
+                    std::chrono::steady_clock::time_point now =
+                        std::chrono::steady_clock::now());
+
+        /**
+         * @brief Takes snapshot of statistics
+         * @param now Current time (for rate calculation)
+         * @return Snapshot
+         */
+        Snapshot snapshot(std::chrono::steady_clock::time_point now =
+                              std::chrono::steady_clock::now()) const;
+
+        /**
+         * @brief Clears all statistics
+         */
+        void clear();
+    };
+} // namespace kvik
@@ -0,0 +1,188 @@
+/**
+ * @file typed_payload.hpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Compact encoding of typed payloads
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "kvik/errors.hpp"
+
+namespace kvik
+{
+    /**
+     * @brief Type tag of typed payload
+     *
+     * Typed payload consists of single tag byte followed by compactly
+     * encoded value:
+     * - integers as zigzag varints,
+     * - floats as little endian IEEE 754 half or single precision numbers,
+     * - booleans as single byte (arrays are bit-packed),
+     * - arrays as 1 byte item count followed by items.
+     *
+     * Tags are chosen from ASCII control characters, so they don't collide
+     * with usual textual payloads.
+     */
+    enum class PayloadType : uint8_t
+    {
+        RAW = 0x00, //!< Not a typed payload (e.g. text)
+        INT = 0x01,
+        FLOAT16 = 0x02,
+        FLOAT32 = 0x03,
+        BOOL = 0x04,
+        INT_ARRAY = 0x11,
+        FLOAT16_ARRAY = 0x12,
+        FLOAT32_ARRAY = 0x13,
+        BOOL_ARRAY = 0x14,
+    };
+
+    //! Maximum number of items in typed payload array
+    constexpr size_t TYPED_PAYLOAD_MAX_ARRAY_LEN = UINT8_MAX;
+
+    /**
+     * @brief Helper to convert `PayloadType` to string representation.
+     *
+     * @param pt Payload type
+     * @return String representation
+     */
+    const char *payloadTypeToStr(PayloadType pt) noexcept;
+
+    /**
+     * @brief Determines type of payload
+     *
+     * Only the tag is checked, use decoding functions for full validation.
+     *
+     * @param payload Payload
+     * @return Payload type (`RAW` for empty or untagged payload)
+     */
+    PayloadType typedPayloadType(const std::string &payload) noexcept;
+
+    /**
+     * @brief Encodes integer
+     * @param val Value
+     * @return Payload
+     */
+    std::string typedPayloadFromInt(int64_t val);
+
+    /**
+     * @brief Encodes float
+     *
+     * Half precision has 11 significant bits (~3 decimal digits) and range
+     * up to 65504, which is enough for most sensor readings.
+     *
+     * @param val Value
+     * @param half Use half precision (2 bytes) instead of single precision
+     * (4 bytes)
+     * @return Payload
+     */
+    std::string typedPayloadFromFloat(float val, bool half = false);
+
+    /**
+     * @brief Encodes boolean
+     * @param val Value
+     * @return Payload
+     */
+    std::string typedPayloadFromBool(bool val);
+
+    /**
+     * @brief Encodes array of integers
+     * @param vals Values
+     * @param payload Payload (modified in-place)
+     * @retval INVALID_SIZE Too many items
+     * @retval SUCCESS Successfully encoded
+     */
+    ErrCode typedPayloadFromIntArray(const std::vector<int64_t> &vals,
+                                     std::string &payload);
+
+    /**
+     * @brief Encodes array of floats
+     * @param vals Values
+     * @param payload Payload (modified in-place)
+     * @param half Use half precision (see `typedPayloadFromFloat`)
+     * @retval INVALID_SIZE Too many items
+     * @retval SUCCESS Successfully encoded
+     */
+    ErrCode typedPayloadFromFloatArray(const std::vector<float> &vals,
+                                       std::string &payload,
+                                       bool half = false);
+
+    /**
+     * @brief Encodes array of booleans
+     * @param vals Values
+     * @param payload Payload (modified in-place)
+     * @retval INVALID_SIZE Too many items
+     * @retval SUCCESS Successfully encoded
+     */
+    ErrCode typedPayloadFromBoolArray(const std::vector<bool> &vals,
+                                      std::string &payload);
+
+    /**
+     * @brief Decodes integer
+     * @param payload Payload
+     * @param val Value (modified in-place)
+     * @retval INVALID_ARG Payload isn't valid integer payload
+     * @retval SUCCESS Successfully decoded
+     */
+    ErrCode typedPayloadToInt(const std::string &payload, int64_t &val);
+
+    /**
+     * @brief Decodes float
+     *
+     * Accepts both half and single precision payloads.
+     *
+     * @param payload Payload
+     * @param val Value (modified in-place)
+     * @retval INVALID_ARG Payload isn't valid float payload
+     * @retval SUCCESS Successfully decoded
+     */
+    ErrCode typedPayloadToFloat(const std::string &payload, float &val);
+
+    /**
+     * @brief Decodes boolean
+     * @param payload Payload
+     * @param val Value (modified in-place)
+     * @retval INVALID_ARG Payload isn't valid boolean payload
+     * @retval SUCCESS Successfully decoded
+     */
+    ErrCode typedPayloadToBool(const std::string &payload, bool &val);
+
+    /**
+     * @brief Decodes array of integers
+     * @param payload Payload
+     * @param vals Values (modified in-place)
+     * @retval INVALID_ARG Payload isn't valid integer array payload
+     * @retval SUCCESS Successfully decoded
+     */
+    ErrCode typedPayloadToIntArray(const std::string &payload,
+                                   std::vector<int64_t> &vals);
+
+    /**
+     * @brief Decodes array of floats
+     *
+     * Accepts both half and single precision payloads.
+     *
+     * @param payload Payload
+     * @param vals Values (modified in-place)
+     * @retval INVALID_ARG Payload isn't valid float array payload
+     * @retval SUCCESS Successfully decoded
+     */
+    ErrCode typedPayloadToFloatArray(const std::string &payload,
+                                     std::vector<float> &vals);
+
+    /**
+     * @brief Decodes array of booleans
+     * @param payload Payload
+     * @param vals Values (modified in-place)
+     * @retval INVALID_ARG Payload isn't valid boolean array payload
+     * @retval SUCCESS Successfully decoded
+     */
+    ErrCode typedPayloadToBoolArray(const std::string &payload,
+                                    std::vector<bool> &vals);
+} // namespace kvik
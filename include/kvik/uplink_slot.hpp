@@ -0,0 +1,79 @@
+/**
+ * @file uplink_slot.hpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Time-slotted uplink access
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace kvik
+{
+    /**
+     * @brief Uplink slot assigned by gateway
+     *
+     * Gateway time (see `LocalPeer::tsDiff`) is divided into frames of
+     * `frameLen` slots, each `slotLen` long. Frames start at multiples of
+     * `frameLen * slotLen` (counted from gateway clock's epoch). Slot 0 is
+     * contention slot shared by all clients for urgent traffic, the others
+     * are assigned to clients for their regular uplink.
+     *
+     * Transmission starts at the beginning of slot and must fit into it
+     * (including clock synchronization error).
+     */
+    struct UplinkSlot
+    {
+        uint16_t idx = 0;      //!< Assigned slot (1 to `frameLen - 1`)
+        uint16_t frameLen = 0; //!< Number of slots in frame (0 if none assigned)
+
+        //! Length of slot
+        std::chrono::milliseconds slotLen = std::chrono::milliseconds(0);
+
+        /**
+         * @brief Checks whether slot is assigned (and valid)
+         * @return true Slot is assigned
+         * @return false Slot isn't assigned
+         */
+        bool assigned() const
+        {
+            return frameLen > 1 && slotLen.count() > 0 && idx > 0 &&
+                   idx < frameLen;
+        }
+
+        /**
+         * @brief Returns start of next occurrence of the slot
+         *
+         * Slot starting exactly at `gwTime` is returned as is.
+         *
+         * @param gwTime Current gateway time
+         * @param contention Whether to look for contention slot instead
+         * @return Gateway time of slot start (`gwTime` if slot isn't
+         * assigned)
+         */
+        std::chrono::milliseconds nextStart(std::chrono::milliseconds gwTime,
+                                            bool contention = false) const;
+
+        bool operator==(const UplinkSlot &other) const
+        {
+            return idx == other.idx && frameLen == other.frameLen &&
+                   slotLen == other.slotLen;
+        }
+
+        bool operator!=(const UplinkSlot &other) const
+        {
+            return !this->operator==(other);
+        }
+
+        /**
+         * @brief Converts `UplinkSlot` to printable string
+         * @return String representation
+         */
+        std::string toString() const;
+    };
+} // namespace kvik
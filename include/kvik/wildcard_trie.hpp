@@ -13,10 +13,12 @@
 #include <memory>
 #include <queue>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
 #include "kvik/errors.hpp"
+#include "kvik/topic.hpp"
 
 namespace kvik
 {
@@ -88,9 +90,221 @@ namespace kvik
          * @return Current value reference
          */
         TValue &operator[](const std::string &key)
+        {
+            return this->getOrInsert(this->splitToLevels(key));
+        }
+
+        /**
+         * @brief Gets/inserts current value of precompiled filter
+         *
+         * Filter's levels are used directly if it was split using the
+         * same separators as the trie's.
+         *
+         * @param filter Filter
+         * @return Current value reference
+         */
+        TValue &operator[](const Filter &filter)
+        {
+            if (!this->compatible(filter)) {
+                return (*this)[filter.str()];
+            }
+            return this->getOrInsert(filter.levels());
+        }
+
+        /**
+         * @brief Inserts (or updates) `key`-`value` pair
+         *
+         * @param key Key
+         * @param value Value
+         */
+        void insert(const std::string &key, const TValue &value)
+        {
+            (*this)[key] = value;
+        }
+
+        /**
+         * @brief Inserts (or updates) `filter`-`value` pair
+         *
+         * @param filter Filter
+         * @param value Value
+         */
+        void insert(const Filter &filter, const TValue &value)
+        {
+            (*this)[filter] = value;
+        }
+
+        /**
+         * @brief Removes `key` from trie
+         *
+         * @param key Key
+         * @return true Node removed successfully
+         * @return false Node doesn't exist
+         */
+        bool remove(const std::string &key)
+        {
+            return this->removeLevels(this->splitToLevels(key));
+        }
+
+        /**
+         * @brief Removes precompiled filter from trie
+         *
+         * @param filter Filter
+         * @return true Node removed successfully
+         * @return false Node doesn't exist
+         */
+        bool remove(const Filter &filter)
+        {
+            if (!this->compatible(filter)) {
+                return this->remove(filter.str());
+            }
+            return this->removeLevels(filter.levels());
+        }
+
+        using FindReturnT = std::unordered_map<std::string, const TValue &>;
+
+        /**
+         * @brief Finds `key` in trie
+         *
+         * @param key Key
+         * @return Vector of values from matching keys (empty if not found)
+         */
+        const FindReturnT find(const std::string &key) const
+        {
+            return this->findLevels(this->splitToLevels(key));
+        }
+
+        /**
+         * @brief Finds precompiled topic in trie
+         *
+         * @param topic Topic
+         * @return Vector of values from matching keys (empty if not found)
+         */
+        const FindReturnT find(const Topic &topic) const
+        {
+            if (!this->compatible(topic)) {
+                return this->find(topic.str());
+            }
+            return this->findLevels(topic.levels());
+        }
+
+        /**
+         * @brief Visits values of all keys matching `key`
+         *
+         * Unlike `find`, doesn't build result container and doesn't
+         * allocate, as long as `levelBuf` has enough capacity for the
+         * longest level of `key`.
+         *
+         * Visiting stops as soon as `visitor` returns true.
+         *
+         * @tparam TVisitor Callable with signature `bool(const TValue &)`
+         * @param key Key
+         * @param visitor Function called for each matching value
+         * @param levelBuf Scratch buffer used for child lookups
+         * @return true Visiting was stopped by `visitor`
+         * @return false All matching values were visited
+         */
+        template <typename TVisitor>
+        bool visitMatches(std::string_view key, TVisitor &&visitor,
+                          std::string &levelBuf) const
+        {
+            return this->visitMatchesFrom(&m_root, key, 0, false, visitor,
+                                          levelBuf);
+        }
+
+        /**
+         * @brief Visits values of all keys matching precompiled topic
+         *
+         * Like `visitMatches(key, ...)`, but uses topic's levels directly
+         * (no scratch buffer needed).
+         *
+         * @tparam TVisitor Callable with signature `bool(const TValue &)`
+         * @param topic Topic
+         * @param visitor Function called for each matching value
+         * @return true Visiting was stopped by `visitor`
+         * @return false All matching values were visited
+         */
+        template <typename TVisitor>
+        bool visitMatches(const Topic &topic, TVisitor &&visitor) const
+        {
+            if (!this->compatible(topic)) {
+                std::string levelBuf;
+                return this->visitMatches(topic.str(), visitor, levelBuf);
+            }
+            return this->visitLevelsFrom(&m_root, topic.levels(), 0, visitor);
+        }
+
+        /**
+         * @brief Iterates through each item in trie and calls callback
+         *        on each one
+         *
+         * @param f Function to call
+         */
+        void forEach(std::function<void(const std::string &key, const TValue &value)> f)
+        {
+            // Queue for to-be-processed nodes
+            BFSQueueT nodeQueue;
+            nodeQueue.push({"", &m_root});
+
+            while (!nodeQueue.empty()) {
+                auto [nodeKey, node] = nodeQueue.front();
+
+                // Call function
+                if (node->isLeaf) {
+                    f(nodeKey, node->value);
+                }
+
+                // Enqueue children
+                for (auto &[childLevel, childNode] : node->childs) {
+                    std::string childKey = nodeKey == ""
+                                               ? childLevel
+                                               : nodeKey + m_lSep + childLevel;
+                    nodeQueue.push({childKey, childNode.get()});
+                }
+
+                nodeQueue.pop();
+            }
+        }
+
+        /**
+         * @brief Empty predicate
+         *
+         * @return true Trie is empty
+         * @return false Trie is not empty
+         */
+        bool empty() const
+        {
+            return m_root.childs.empty();
+        }
+
+        /**
+         * @brief Clears the trie structure
+         */
+        void clear()
+        {
+            m_root = {};
+        }
+
+    protected:
+        /**
+         * @brief Checks whether handle's levels can be used directly
+         * @param handle Topic or filter handle
+         * @return true Handle uses the same separators as the trie
+         * @return false Handle must be split again
+         */
+        bool compatible(const TopicHandle &handle) const
+        {
+            return handle.usesSeparators(m_lSep, m_lSingleWild, m_lMultiWild);
+        }
+
+        /**
+         * @brief Gets/inserts value of key given by levels
+         *
+         * @param levels Levels of key
+         * @return Current value reference
+         */
+        TValue &getOrInsert(const std::vector<std::string> &levels)
         {
             Node *cur = &m_root;
-            auto levels = this->splitToLevels(key);
 
             // Get or create child on each level
             for (size_t i = 0; i < levels.size(); i++) {
@@ -112,27 +326,15 @@ namespace kvik
         }
 
         /**
-         * @brief Inserts (or updates) `key`-`value` pair
+         * @brief Removes key given by levels
          *
-         * @param key Key
-         * @param value Value
-         */
-        void insert(const std::string &key, const TValue &value)
-        {
-            (*this)[key] = value;
-        }
-
-        /**
-         * @brief Removes `key` from trie
-         *
-         * @param key Key
+         * @param levels Levels of key
          * @return true Node removed successfully
          * @return false Node doesn't exist
          */
-        bool remove(const std::string &key)
+        bool removeLevels(const std::vector<std::string> &levels)
         {
             Node *cur = &m_root;
-            auto levels = this->splitToLevels(key);
 
             std::vector<Node *> nodeStack;
 
@@ -171,18 +373,14 @@ namespace kvik
             return true;
         }
 
-        using FindReturnT = std::unordered_map<std::string, const TValue &>;
-
         /**
-         * @brief Finds `key` in trie
+         * @brief Finds key given by levels
          *
-         * @param key Key
+         * @param levels Levels of key
          * @return Vector of values from matching keys (empty if not found)
          */
-        const FindReturnT find(const std::string &key) const
+        const FindReturnT findLevels(const std::vector<std::string> &levels) const
         {
-            auto levels = this->splitToLevels(key);
-
             FindReturnT values;
 
             // Queue for to-be-processed nodes
@@ -221,57 +419,113 @@ namespace kvik
         }
 
         /**
-         * @brief Iterates through each item in trie and calls callback
-         *        on each one
+         * @brief Recursive part of `visitMatches` for precompiled topic
          *
-         * @param f Function to call
+         * @param node Current node
+         * @param levels Levels of topic
+         * @param idx Index of current level
+         * @param visitor Function called for each matching value
+         * @return true Visiting was stopped by `visitor`
+         * @return false All matching values were visited
          */
-        void forEach(std::function<void(const std::string &key, const TValue &value)> f)
+        template <typename TVisitor>
+        bool visitLevelsFrom(const Node *node,
+                             const std::vector<std::string> &levels,
+                             size_t idx, TVisitor &visitor) const
         {
-            // Queue for to-be-processed nodes
-            BFSQueueT nodeQueue;
-            nodeQueue.push({"", &m_root});
+            if (idx == levels.size()) {
+                return node->isLeaf && visitor(node->value);
+            }
 
-            while (!nodeQueue.empty()) {
-                auto [nodeKey, node] = nodeQueue.front();
+            const auto &level = levels[idx];
 
-                // Call function
-                if (node->isLeaf) {
-                    f(nodeKey, node->value);
+            // Multi-level wildcard
+            if (level != m_lMultiWild) {
+                auto it = node->childs.find(m_lMultiWild);
+                if (it != node->childs.end() && it->second->isLeaf &&
+                    visitor(it->second->value)) {
+                    return true;
                 }
+            }
 
-                // Enqueue children
-                for (auto &[childLevel, childNode] : node->childs) {
-                    std::string childKey = nodeKey == ""
-                                               ? childLevel
-                                               : nodeKey + m_lSep + childLevel;
-                    nodeQueue.push({childKey, childNode.get()});
-                }
+            // Exact match
+            auto it = node->childs.find(level);
+            if (it != node->childs.end() &&
+                this->visitLevelsFrom(it->second.get(), levels, idx + 1,
+                                      visitor)) {
+                return true;
+            }
 
-                nodeQueue.pop();
+            // Single-level wildcard
+            if (level != m_lSingleWild) {
+                it = node->childs.find(m_lSingleWild);
+                if (it != node->childs.end() &&
+                    this->visitLevelsFrom(it->second.get(), levels, idx + 1,
+                                          visitor)) {
+                    return true;
+                }
             }
+
+            return false;
         }
 
         /**
-         * @brief Empty predicate
+         * @brief Recursive part of `visitMatches`
          *
-         * @return true Trie is empty
-         * @return false Trie is not empty
+         * @param node Current node
+         * @param key Key
+         * @param pos Position of current level in `key`
+         * @param done Whether all levels of `key` were consumed
+         * @param visitor Function called for each matching value
+         * @param levelBuf Scratch buffer used for child lookups
+         * @return true Visiting was stopped by `visitor`
+         * @return false All matching values were visited
          */
-        bool empty() const
+        template <typename TVisitor>
+        bool visitMatchesFrom(const Node *node, std::string_view key,
+                              size_t pos, bool done, TVisitor &visitor,
+                              std::string &levelBuf) const
         {
-            return m_root.childs.empty();
-        }
+            if (done) {
+                return node->isLeaf && visitor(node->value);
+            }
 
-        /**
-         * @brief Clears the trie structure
-         */
-        void clear()
-        {
-            m_root = {};
+            size_t end = key.find(m_lSep, pos);
+            std::string_view level = key.substr(pos, end - pos);
+            bool nextDone = end == std::string_view::npos;
+            size_t nextPos = nextDone ? end : end + m_lSep.length();
+
+            // Multi-level wildcard
+            if (level != m_lMultiWild) {
+                auto it = node->childs.find(m_lMultiWild);
+                if (it != node->childs.end() && it->second->isLeaf &&
+                    visitor(it->second->value)) {
+                    return true;
+                }
+            }
+
+            // Exact match
+            levelBuf.assign(level.data(), level.size());
+            auto it = node->childs.find(levelBuf);
+            if (it != node->childs.end() &&
+                this->visitMatchesFrom(it->second.get(), key, nextPos,
+                                       nextDone, visitor, levelBuf)) {
+                return true;
+            }
+
+            // Single-level wildcard
+            if (level != m_lSingleWild) {
+                it = node->childs.find(m_lSingleWild);
+                if (it != node->childs.end() &&
+                    this->visitMatchesFrom(it->second.get(), key, nextPos,
+                                           nextDone, visitor, levelBuf)) {
+                    return true;
+                }
+            }
+
+            return false;
         }
 
-    protected:
         /**
          * @brief Splits `key` to levels
          *
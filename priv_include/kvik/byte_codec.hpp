@@ -0,0 +1,88 @@
+/**
+ * @file byte_codec.hpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Integer encoding helpers for binary formats
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace kvik
+{
+    /**
+     * @brief Appends little-endian integer to `out`
+     * @param out Output buffer
+     * @param val Value
+     * @param len Number of bytes
+     */
+    inline void putLE(std::string &out, uint64_t val, size_t len)
+    {
+        for (size_t i = 0; i < len; i++) {
+            out += static_cast<char>((val >> (8 * i)) & 0xFF);
+        }
+    }
+
+    /**
+     * @brief Reads little-endian integer from `in` at `pos`
+     *
+     * Caller is responsible for bounds checking.
+     *
+     * @param in Input buffer
+     * @param pos Position (advanced in-place)
+     * @param len Number of bytes
+     * @return Value
+     */
+    inline uint64_t getLE(const std::string &in, size_t &pos, size_t len)
+    {
+        uint64_t val = 0;
+        for (size_t i = 0; i < len; i++) {
+            val |= static_cast<uint64_t>(static_cast<uint8_t>(in[pos++]))
+                   << (8 * i);
+        }
+        return val;
+    }
+
+    /**
+     * @brief Appends unsigned varint to `out`
+     * @param out Output buffer
+     * @param val Value
+     */
+    inline void putVarint(std::string &out, uint64_t val)
+    {
+        while (val >= 0x80) {
+            out += static_cast<char>((val & 0x7F) | 0x80);
+            val >>= 7;
+        }
+        out += static_cast<char>(val);
+    }
+
+    /**
+     * @brief Reads unsigned varint from `in` at `pos`
+     * @param in Input buffer
+     * @param pos Position (advanced in-place)
+     * @param val Value (modified in-place)
+     * @return true Successfully read
+     * @return false Truncated or too long varint
+     */
+    inline bool getVarint(const std::string &in, size_t &pos, uint64_t &val)
+    {
+        val = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            if (pos >= in.size()) {
+                return false;
+            }
+            uint8_t byte = in[pos++];
+            val |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+} // namespace kvik
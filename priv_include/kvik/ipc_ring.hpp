@@ -0,0 +1,193 @@
+/**
+ * @file ipc_ring.hpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Single-producer single-consumer ring in shared memory
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+
+#include "kvik/errors.hpp"
+
+namespace kvik
+{
+    /**
+     * @brief Single-producer single-consumer ring in shared memory
+     *
+     * Ring lives in anonymous shared memory (memfd), which can be passed
+     * to another process and mapped there (`attach()`). Each process owns
+     * one end of the ring.
+     *
+     * Records: `length (4 B) | type (1 B) | flags (1 B) | topic length
+     * (2 B) | payload length (4 B) | topic | payload`, aligned to 8 B.
+     * Record never wraps around the end of the ring, padding record fills
+     * the rest instead.
+     *
+     * Consumer marks itself waiting before it goes to sleep and producer
+     * clears the mark when it writes, so it knows whether the consumer
+     * has to be woken up. Any number of records written meanwhile costs
+     * single notification.
+     *
+     * Not multithread safe (except for the producer and the consumer
+     * running concurrently).
+     */
+    class IpcRing
+    {
+    public:
+        /**
+         * @brief Record read from ring
+         *
+         * Views point directly into shared memory and are valid only
+         * during consumer callback.
+         */
+        struct Record
+        {
+            uint8_t type = 0;
+            uint8_t flags = 0;
+            std::string_view topic;
+            std::string_view payload;
+        };
+
+        using FillFn = std::function<void(char *buf)>;
+
+    private:
+        /**
+         * @brief Header of ring in shared memory
+         *
+         * Producer and consumer positions are on separate cache lines.
+         */
+        struct Header
+        {
+            uint64_t magic;
+            uint64_t capacity;
+            alignas(64) std::atomic<uint64_t> head; //!< Producer position
+            alignas(64) std::atomic<uint64_t> tail; //!< Consumer position
+            std::atomic<uint32_t> waiting;          //!< Consumer sleeps
+        };
+
+        static_assert(std::atomic<uint64_t>::is_always_lock_free &&
+                          std::atomic<uint32_t>::is_always_lock_free,
+                      "Shared memory atomics must be lock-free");
+
+        int m_fd = -1;
+        void *m_mem = nullptr;
+        size_t m_mapLen = 0;
+        Header *m_hdr = nullptr;
+        char *m_data = nullptr;
+        uint64_t m_mask = 0;
+
+    public:
+        IpcRing() = default;
+        ~IpcRing();
+
+        IpcRing(const IpcRing &) = delete;
+        IpcRing &operator=(const IpcRing &) = delete;
+
+        /**
+         * @brief Creates new ring
+         * @param capacity Capacity in bytes (rounded up to power of 2)
+         * @retval INVALID_ARG Ring already open
+         * @retval GENERIC_FAILURE Shared memory couldn't be created
+         * @retval SUCCESS Ring created
+         */
+        ErrCode create(size_t capacity);
+
+        /**
+         * @brief Attaches to ring created by another process
+         *
+         * Ring takes ownership of the descriptor, even on failure.
+         *
+         * @param fd File descriptor of shared memory
+         * @retval INVALID_ARG Ring already open or not a ring
+         * @retval GENERIC_FAILURE Shared memory couldn't be mapped
+         * @retval SUCCESS Attached
+         */
+        ErrCode attach(int fd);
+
+        /**
+         * @brief Returns file descriptor of shared memory
+         * @return File descriptor (-1 if not open)
+         */
+        int fd() const { return m_fd; }
+
+        /**
+         * @brief Returns capacity
+         * @return Capacity in bytes
+         */
+        size_t capacity() const { return m_mask + 1; }
+
+        /**
+         * @brief Writes record (producer)
+         *
+         * Payload is written directly to shared memory by `fill`, so it
+         * doesn't have to be copied (zero-copy hand-off).
+         *
+         * @param type Record type
+         * @param flags Record flags
+         * @param topic Topic
+         * @param payloadLen Length of payload
+         * @param fill Function writing payload to given buffer
+         * @param notify Whether consumer has to be woken up (modified
+         * in-place)
+         * @retval INVALID_SIZE Record is larger than half of the ring
+         * @retval QUEUE_FULL Not enough free space
+         * @retval SUCCESS Written
+         */
+        ErrCode push(uint8_t type, uint8_t flags, std::string_view topic,
+                     size_t payloadLen, const FillFn &fill, bool &notify);
+
+        /**
+         * @brief Writes record (producer)
+         * @param type Record type
+         * @param flags Record flags
+         * @param topic Topic
+         * @param payload Payload
+         * @param notify Whether consumer has to be woken up (modified
+         * in-place)
+         * @retval INVALID_SIZE Record is larger than half of the ring
+         * @retval QUEUE_FULL Not enough free space
+         * @retval SUCCESS Written
+         */
+        ErrCode push(uint8_t type, uint8_t flags, std::string_view topic,
+                     std::string_view payload, bool &notify);
+
+        /**
+         * @brief Reads all available records (consumer)
+         *
+         * Space of each record is released after `f` returns.
+         *
+         * @param f Function to call for each record
+         * @return Number of records read (-1 if ring is corrupted)
+         */
+        int drain(const std::function<void(const Record &)> &f);
+
+        /**
+         * @brief Marks consumer waiting for notification (consumer)
+         * @return true Consumer may sleep until notified
+         * @return false Records available, consumer has to drain them
+         */
+        bool prepareWait();
+
+    private:
+        /**
+         * @brief Maps shared memory of `m_fd`
+         * @param len Length
+         * @return true Mapped
+         * @return false Mapping failed
+         */
+        bool map(size_t len);
+
+        /**
+         * @brief Unmaps shared memory and closes descriptor
+         */
+        void close();
+    };
+} // namespace kvik
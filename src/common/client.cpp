@@ -7,17 +7,22 @@
  *
  */
 
+#include <algorithm>
 #include <cinttypes>
 #include <sys/time.h> // Unix and ESP
 
 #include "kvik/client.hpp"
 #include "kvik/client_config.hpp"
 #include "kvik/errors.hpp"
+#include "kvik/group_downlink.hpp"
 #include "kvik/layers.hpp"
 #include "kvik/limits.hpp"
 #include "kvik/logger.hpp"
 #include "kvik/node.hpp"
 #include "kvik/pub_sub_struct.hpp"
+#include "kvik/random.hpp"
+#include "kvik/stream.hpp"
+#include "kvik/subs_digest.hpp"
 #include "kvik/timer.hpp"
 #include "kvik/wildcard_trie.hpp"
 
@@ -28,6 +33,16 @@ using namespace std::chrono_literals;
 
 namespace kvik
 {
+    //! Interval of group data acknowledgement timer when nothing is scheduled
+    static constexpr auto GROUP_ACK_IDLE_INTERVAL = std::chrono::hours(1);
+
+    //! Interval of stream acknowledgement timer when nothing is pending
+    static constexpr auto STREAM_ACK_IDLE_INTERVAL = std::chrono::hours(1);
+
+    //! Renewal of restored subscriptions precedes lease expiry by
+    //! `subLifetime / SUB_RENEWAL_MARGIN_DIV`
+    static constexpr int SUB_RENEWAL_MARGIN_DIV = 10;
+
     Client::Client(ClientConfig conf, ILocalLayer *ll,
                    ClientRetainedData retainedData)
         : INode{conf.nodeConf}, m_conf{conf}, m_ll{ll},
@@ -37,23 +52,105 @@ namespace kvik
           m_subDBTimer{conf.subDB.subLifetime,
                        std::bind(&Client::subDBTick, this)},
           m_timeSyncTimer{conf.timeSync.reprobeGatewayInterval,
-                          std::bind(&Client::syncTime, this)}
+                          std::bind(&Client::syncTime, this)},
+          m_groupAckTimer{GROUP_ACK_IDLE_INTERVAL,
+                          std::bind(&Client::sendGroupAck, this)},
+          m_streamAckTimer{STREAM_ACK_IDLE_INTERVAL,
+                           std::bind(&Client::sendStreamAcks, this)},
+          m_deltaTx{conf.delta.maxTopics, conf.delta.maxPayloadLen},
+          m_deltaRx{conf.delta.maxTopics, conf.delta.maxPayloadLen}
     {
         if (m_ll == nullptr) {
             KVIK_THROW_EXC("Invalid local layer parameter");
         }
 
+        for (const auto &filter : m_conf.slotted.urgentTopics) {
+            m_urgentFilters.emplace_back(filter, m_conf.nodeConf.topicSep);
+        }
+
+        m_readyFuture = m_readyPromise.get_future().share();
+
         // Set receive callback
         m_ll->setRecvCb(
             std::bind(&Client::recvLocal, this, std::placeholders::_1));
 
+        if (retainedData.gw.addrLen > 0) {
+            this->restoreSubs(retainedData.subs);
+        }
+
+        if (m_conf.startup.async) {
+            // Spawn gateway watchdog and acquire gateway in background
+            m_gwWdThread = std::thread(&Client::gwWatchdogHandler, this);
+            m_acquireThread =
+                std::thread(&Client::acquireHandler, this, retainedData);
+            KVIK_LOGI("Acquiring gateway in background");
+            return;
+        }
+
+        {
+            // Internal sends during acquisition (RSSI reports) don't wait
+            // for readiness
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            m_acquireThreadId = std::this_thread::get_id();
+        }
+
+        ErrCode err = this->acquireGateway(retainedData,
+                                           m_conf.gwDscv.initialDscvFailThres);
+        {
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            m_acquireThreadId = {};
+        }
+        if (err != ErrCode::SUCCESS) {
+            KVIK_THROW_EXC("Gateway discovery failed");
+        }
+
+        KVIK_LOGI("Initialized");
+        this->setReady();
+
+        // Spawn gateway watchdog
+        m_gwWdThread = std::thread(&Client::gwWatchdogHandler, this);
+    }
+
+    Client::~Client()
+    {
+        {
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            m_dscvLoopRun = false;
+        }
+
+        // Wait for cancellation of currently running gateway discovery
+        KVIK_LOGD("Waiting for gateway discovery thread...");
+        m_dscvLoopCv.notify_all();
+        m_gwWdCv.notify_one();
+        m_readyCv.notify_all();
+        if (m_acquireThread.joinable()) {
+            m_acquireThread.join();
+        }
+        m_gwWdThread.join();
+
+        // Unset receive callback
+        m_ll->setRecvCb(nullptr);
+
+        // Wait for all actions
+        const std::scoped_lock lock(KVIK_SITE(m_mutex),
+                                    KVIK_SITE(m_dscvSyncMutex));
+
+        KVIK_LOGI("Deinitialized");
+    }
+
+    ErrCode Client::acquireGateway(const ClientRetainedData &retainedData,
+                                   size_t maxAttempts)
+    {
         m_ignoreInvalidMsgTs = true;
 
         if (retainedData.gw.addrLen > 0) {
             // Restore retained data
-            m_gw = retainedData.gw.unretain();
-            m_msgsFailCnt = retainedData.msgsFailCnt;
-            m_timeSyncNoRespCnt = retainedData.timeSyncNoRespCnt;
+            {
+                const std::scoped_lock lock(KVIK_SITE(m_mutex));
+                m_gw = retainedData.gw.unretain();
+                m_msgsFailCnt = retainedData.msgsFailCnt;
+                m_timeSyncNoRespCnt = retainedData.timeSyncNoRespCnt;
+            }
 
             KVIK_LOGD("Using retained data");
 
@@ -71,54 +168,330 @@ namespace kvik
             if (channelOk && this->syncTime() == ErrCode::SUCCESS) {
                 KVIK_LOGI("Time sync successful, GW: %s",
                           m_gw.toString().c_str());
-                goto initialized;
+                m_ignoreInvalidMsgTs = false;
+                return ErrCode::SUCCESS;
             }
 
             KVIK_LOGW("Time sync failed, doing gateway discovery");
         }
 
-        if (this->discoverGateway(m_conf.gwDscv.initialDscvFailThres) ==
-            ErrCode::SUCCESS) {
+        if (this->discoverGateway(maxAttempts) == ErrCode::SUCCESS) {
             KVIK_LOGI("Gateway discovery successful, new GW: %s",
                       m_gw.toString().c_str());
-            goto initialized;
+            m_ignoreInvalidMsgTs = false;
+
+            // Restored subscriptions are held by previous gateway only
+            bool restored;
+            {
+                const std::scoped_lock lock(KVIK_SITE(m_mutex));
+                restored = !m_restoredSubs.empty();
+            }
+            if (restored && this->renewSubs() != ErrCode::SUCCESS) {
+                KVIK_LOGW("Renewal of restored subscriptions failed");
+                const std::scoped_lock lock(KVIK_SITE(m_mutex));
+                m_restoredSubs.clear();
+            }
+
+            return ErrCode::SUCCESS;
+        }
+
+        return ErrCode::TOO_MANY_FAILED_ATTEMPTS;
+    }
+
+    void Client::acquireHandler(ClientRetainedData retainedData)
+    {
+        {
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            m_acquireThreadId = std::this_thread::get_id();
+        }
+
+        // Retry indefinitely, destructor cancels discovery
+        ErrCode err = this->acquireGateway(retainedData, 0);
+
+        bool cancelled;
+        {
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            cancelled = !m_dscvLoopRun;
         }
 
-        KVIK_THROW_EXC("Gateway discovery failed");
+        if (cancelled || err != ErrCode::SUCCESS) {
+            KVIK_LOGD("Cancelled by destructor call");
+            m_readyPromise.set_value(ErrCode::NO_GATEWAY);
+            return;
+        }
 
-    initialized:
         KVIK_LOGI("Initialized");
-        m_ignoreInvalidMsgTs = false;
+        this->setReady();
+    }
 
-        // Spawn gateway watchdog
-        m_gwWdThread = std::thread(&Client::gwWatchdogHandler, this);
+    void Client::setReady()
+    {
+        // Ready callback may already publish
+        {
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            m_ready = true;
+        }
+        m_readyCv.notify_all();
+
+        if (m_conf.startup.readyCb) {
+            m_conf.startup.readyCb();
+        }
+        m_readyPromise.set_value(ErrCode::SUCCESS);
     }
 
-    Client::~Client()
+    bool Client::isReady()
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        return m_ready;
+    }
+
+    std::shared_future<ErrCode> Client::getReadyFuture() const
+    {
+        return m_readyFuture;
+    }
+
+    ErrCode Client::publishStream(const std::string &topic,
+                                  const std::string &data,
+                                  uint32_t &transferId)
     {
+        if (m_conf.stream.chunkSize == 0 || m_conf.stream.window == 0) {
+            return ErrCode::INVALID_ARG;
+        }
+        if (data.size() > UINT32_MAX) {
+            return ErrCode::INVALID_SIZE;
+        }
+        KVIK_RETURN_ERROR(this->waitReady());
+
+        bool resume = transferId != 0;
+        while (transferId == 0) {
+            getRandomBytes(&transferId, sizeof(transferId));
+        }
+
+        /**
+         * @brief State shared with acknowledgement callback
+         */
+        struct SendState
         {
-            const std::scoped_lock lock(m_mutex);
-            m_dscvLoopRun = false;
+            Mutex mutex{"Client/streamSend"};
+            CondVar cv;
+            std::unique_ptr<StreamSender> sender;
+            std::vector<std::string> outbox; //!< Chunks to send
+        };
+
+        // Chunks are only collected under the lock (also by acknowledgement
+        // callback on receive thread) and sent by this thread after
+        // unlocking. Failed sends are recovered by retransmission.
+        auto state = std::make_shared<SendState>();
+        auto outbox = &state->outbox;
+        state->sender = std::make_unique<StreamSender>(
+            transferId, data, m_conf.stream.chunkSize, m_conf.stream.window,
+            m_conf.stream.rto,
+            [outbox](const std::string &payload) {
+                outbox->push_back(payload);
+                return ErrCode::SUCCESS;
+            },
+            m_conf.stream.fecGroup, m_conf.stream.fecMaxParity);
+        {
+            // Start with redundancy of previous transfer
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            state->sender->setLossRate(m_streamLossRate);
         }
 
-        // Wait for cancellation of currently running gateway discovery
-        KVIK_LOGD("Waiting for gateway discovery thread...");
-        m_dscvLoopCv.notify_one();
-        m_gwWdCv.notify_one();
-        m_gwWdThread.join();
+        std::string ackTopic = topic +
+                               m_conf.nodeConf.topicSep.levelSeparator +
+                               STREAM_ACK_LEVEL;
+        KVIK_RETURN_ERROR(
+            this->subscribe(ackTopic, [state](const SubData &subData) {
+                StreamAck ack;
+                if (StreamAck::decode(subData.payload, ack) !=
+                    ErrCode::SUCCESS) {
+                    return;
+                }
 
-        // Unset receive callback
-        m_ll->setRecvCb(nullptr);
+                const std::scoped_lock lock(KVIK_SITE(state->mutex));
+                state->sender->processAck(ack);
+                state->cv.notify_all();
+            }));
 
-        // Wait for all actions
-        const std::scoped_lock lock(m_mutex, m_dscvSyncMutex);
+        KVIK_LOGD("Streaming %zu B to '%s' (transfer=%" PRIu32 ", resume=%d)",
+                  data.size(), topic.c_str(), transferId, resume);
 
-        KVIK_LOGI("Deinitialized");
+        ErrCode res;
+        double lossRate;
+        auto deadline = std::chrono::steady_clock::now() + m_conf.stream.timeout;
+        {
+            UniqueLock lock(KVIK_SITE(state->mutex));
+            res = state->sender->start(resume);
+            bool started = false;
+            while (true) {
+                if (!state->outbox.empty()) {
+                    std::vector<std::string> chunks;
+                    chunks.swap(state->outbox);
+                    lock.unlock();
+
+                    ErrCode sendRes = ErrCode::SUCCESS;
+                    for (const auto &chunk : chunks) {
+                        ErrCode chunkRes = this->publishUnacked(topic, chunk);
+                        if (chunkRes != ErrCode::SUCCESS) {
+                            sendRes = chunkRes;
+                        }
+                    }
+
+                    lock.lock();
+                    if (!started && res == ErrCode::SUCCESS) {
+                        // Transfer can't even start
+                        res = sendRes;
+                    }
+                    started = true;
+                    continue;
+                }
+
+                if (res != ErrCode::SUCCESS || state->sender->done()) {
+                    break;
+                }
+                if (std::chrono::steady_clock::now() >= deadline) {
+                    KVIK_LOGW("Stream transfer %" PRIu32 " timed out (%zu/%zu "
+                              "chunks acknowledged)",
+                              transferId, state->sender->ackedCnt(),
+                              state->sender->chunkCnt());
+                    res = ErrCode::TIMEOUT;
+                    break;
+                }
+
+                if (state->cv.wait_for(lock, m_conf.stream.rto) ==
+                    std::cv_status::timeout) {
+                    state->sender->tick();
+                }
+            }
+
+            KVIK_LOGD("Stream transfer %" PRIu32 " finished, %" PRIu64
+                      " retransmissions, %" PRIu64 " parity chunks",
+                      transferId, state->sender->retransmits(),
+                      state->sender->paritySent());
+            lossRate = state->sender->lossRate();
+        }
+
+        {
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            m_streamLossRate = lossRate;
+        }
+
+        ErrCode unsubRes = this->unsubscribe(ackTopic);
+        if (res == ErrCode::SUCCESS) {
+            this->recordDelivered();
+            res = unsubRes;
+        }
+        return res;
+    }
+
+    ErrCode Client::subscribeStream(const std::string &topic, StreamCb cb)
+    {
+        /**
+         * @brief State shared by chunks of all transfers on the topic
+         */
+        struct RecvState
+        {
+            Mutex mutex{"Client/streamRecv"};
+            std::vector<std::string> completed;
+            StreamReceiver receiver;
+
+            RecvState(size_t maxTransfers, size_t maxLen,
+                      std::chrono::milliseconds idleTimeout)
+                : receiver{[this](uint32_t, const std::string &data) {
+                               completed.push_back(data);
+                           },
+                           maxTransfers, maxLen, idleTimeout}
+            {
+            }
+        };
+
+        auto state = std::make_shared<RecvState>(
+            m_conf.stream.maxRecvTransfers, m_conf.stream.maxRecvLen,
+            m_conf.stream.recvIdleTimeout);
+
+        return this->subscribe(topic, [this, state,
+                                       cb](const SubData &subData) {
+            StreamChunk chunk;
+            if (StreamChunk::decode(subData.payload, chunk) !=
+                ErrCode::SUCCESS) {
+                KVIK_LOGD("Not a stream chunk on '%s'", subData.topic.c_str());
+                return;
+            }
+
+            StreamAck ack;
+            std::vector<std::string> completed;
+            {
+                const std::scoped_lock lock(KVIK_SITE(state->mutex));
+                ErrCode res = state->receiver.processChunk(chunk, ack);
+                if (res != ErrCode::SUCCESS) {
+                    KVIK_LOGW("Dropping chunk of stream transfer %" PRIu32
+                              " on '%s'",
+                              chunk.transferId, subData.topic.c_str());
+                    return;
+                }
+                completed.swap(state->completed);
+            }
+
+            // Sent by timer thread, so receiving isn't blocked
+            {
+                const std::scoped_lock lock(KVIK_SITE(m_mutex));
+                m_streamAcks[{subData.topic +
+                                  m_conf.nodeConf.topicSep.levelSeparator +
+                                  STREAM_ACK_LEVEL,
+                              chunk.transferId}] = ack.encode();
+            }
+            m_streamAckTimer.setNextExec(std::chrono::steady_clock::now());
+
+            for (const auto &data : completed) {
+                cb(subData.topic, data);
+            }
+        });
+    }
+
+    ErrCode Client::waitReady()
+    {
+        UniqueLock lock{KVIK_SITE(m_mutex)};
+        if (m_ready || std::this_thread::get_id() == m_acquireThreadId) {
+            return ErrCode::SUCCESS;
+        }
+
+        if (m_conf.startup.earlyOps ==
+            ClientConfig::Startup::EarlyOpPolicy::FAIL_FAST) {
+            KVIK_LOGD("Gateway not acquired yet");
+            return ErrCode::NO_GATEWAY;
+        }
+
+        if (!m_readyCv.wait_for(lock, m_conf.startup.earlyOpTimeout, [this]() {
+                return m_ready || !m_dscvLoopRun;
+            })) {
+            KVIK_LOGW("Gateway not acquired in time");
+            return ErrCode::TIMEOUT;
+        }
+
+        return m_ready ? ErrCode::SUCCESS : ErrCode::NO_GATEWAY;
     }
 
     ErrCode Client::pubSubUnsubBulk(const std::vector<PubData> &pubs,
                                     const std::vector<SubReq> &subs,
                                     const std::vector<std::string> &unsubs)
+    {
+        return this->pubSubUnsub(pubs, subs, unsubs, nullptr);
+    }
+
+    ErrCode Client::subscribeFilter(const Filter &filter, SubCb cb)
+    {
+        return this->pubSubUnsub({}, {{filter.str(), cb}}, {}, &filter);
+    }
+
+    ErrCode Client::unsubscribeFilter(const Filter &filter)
+    {
+        return this->pubSubUnsub({}, {}, {filter.str()}, &filter);
+    }
+
+    ErrCode Client::pubSubUnsub(const std::vector<PubData> &pubs,
+                                const std::vector<SubReq> &subs,
+                                const std::vector<std::string> &unsubs,
+                                const Filter *filter)
     {
         if (pubs.size() == 0 && subs.size() == 0 && unsubs.size() == 0) {
             // Nothing to do
@@ -135,27 +508,66 @@ namespace kvik
 
         // Copy items
         msg.pubs.insert(msg.pubs.end(), pubs.begin(), pubs.end());
-        for (const auto &sub : subs) {
-            msg.subs.push_back(sub.topic);
+        {
+            // Restored subscriptions with valid lease are still held by
+            // gateway, only callback has to be set
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            bool leaseValid =
+                std::chrono::system_clock::now() < m_subsLeaseExpiry;
+            for (const auto &sub : subs) {
+                if (!leaseValid || m_restoredSubs.count(sub.topic) == 0) {
+                    msg.subs.push_back(sub.topic);
+                }
+            }
         }
         msg.unsubs.insert(msg.unsubs.end(), unsubs.begin(), unsubs.end());
 
-        // Send the message
-        LocalMsg respMsg;
-        KVIK_RETURN_ERROR(this->sendLocal(msg, respMsg));
-        if (respMsg.type != LocalMsgType::OK) {
-            // Defensive check (already handled by `sendLocal()`)
-            KVIK_LOGW("Received non-OK response");
-            return ErrCode::MSG_PROCESSING_FAILED;
+        if (!msg.pubs.empty() || !msg.subs.empty() || !msg.unsubs.empty()) {
+            KVIK_RETURN_ERROR(this->waitReady());
+
+            // Send the message
+            LocalMsg respMsg;
+            bool deltaUsed = this->deltaEncodePubs(msg);
+            ErrCode res = this->sendLocal(msg, respMsg);
+            this->deltaFinishPubs(msg, res == ErrCode::SUCCESS);
+            if (res == ErrCode::MSG_PROCESSING_FAILED && deltaUsed) {
+                // Gateway may have lost the base, fall back to full payloads
+                KVIK_LOGD("Retrying without delta-encoded payloads");
+                msg.pubs.assign(pubs.begin(), pubs.end());
+                this->deltaEncodePubs(msg);
+                res = this->sendLocal(msg, respMsg);
+                this->deltaFinishPubs(msg, res == ErrCode::SUCCESS);
+            }
+            KVIK_RETURN_ERROR(res);
+            if (respMsg.type != LocalMsgType::OK) {
+                // Defensive check (already handled by `sendLocal()`)
+                KVIK_LOGW("Received non-OK response");
+                return ErrCode::MSG_PROCESSING_FAILED;
+            }
+        } else {
+            KVIK_LOGD("Only restored subscriptions, nothing to send");
         }
 
         // Modify local data
         {
-            const std::scoped_lock lock(m_mutex);
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+
+            if (!msg.subs.empty() &&
+                m_subsLeaseExpiry == std::chrono::system_clock::time_point{}) {
+                m_subsLeaseExpiry =
+                    std::chrono::system_clock::now() + m_conf.subDB.subLifetime;
+            }
+
+            // Precompiled filter is used as is
+            auto precompiled = [filter](const std::string &topic) {
+                return filter != nullptr && filter->str() == topic;
+            };
 
             // Remove subscriptions from database
             for (const auto &topic : unsubs) {
-                if (!m_subDB.remove(topic)) {
+                if (!(precompiled(topic) ? m_subDB.remove(*filter)
+                                         : m_subDB.remove(topic)) &&
+                    m_restoredSubs.count(topic) == 0) {
                     // Not subscribed to this topic
                     KVIK_LOGD(
                         "Can't unsubscribe from not-subscribed topic '%s'",
@@ -165,8 +577,20 @@ namespace kvik
 
             // Insert subscriptions into database
             for (const auto &sub : subs) {
-                m_subDB.insert(sub.topic, sub.cb);
+                if (precompiled(sub.topic)) {
+                    m_subDB.insert(*filter, sub.cb);
+                } else {
+                    m_subDB.insert(sub.topic, sub.cb);
+                }
+                m_restoredSubs.erase(sub.topic);
             }
+            for (const auto &topic : unsubs) {
+                m_restoredSubs.erase(topic);
+            }
+        }
+
+        for (const auto &pub : pubs) {
+            this->recordTraffic({}, pub.topic, pub.payload.size());
         }
 
         return ErrCode::SUCCESS;
@@ -174,15 +598,15 @@ namespace kvik
 
     ErrCode Client::unsubscribeAll()
     {
+        KVIK_RETURN_ERROR(this->waitReady());
+
         LocalMsg msg;
         msg.type = LocalMsgType::PUB_SUB_UNSUB;
 
         // Populate data
         {
-            const std::scoped_lock lock(m_mutex);
-            m_subDB.forEach([&msg](const std::string &topic, const SubCb &) {
-                msg.unsubs.push_back(topic);
-            });
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            msg.unsubs = this->getSubTopics();
         }
 
         if (msg.unsubs.size() == 0) {
@@ -201,24 +625,33 @@ namespace kvik
 
         // Modify local data
         {
-            const std::scoped_lock lock(m_mutex);
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
             m_subDB.clear();
+            m_restoredSubs.clear();
+            m_subsLeaseExpiry = {};
         }
 
         return ErrCode::SUCCESS;
     }
 
     ErrCode Client::resubscribeAll()
+    {
+        KVIK_RETURN_ERROR(this->waitReady());
+        return this->renewSubs();
+    }
+
+    ErrCode Client::renewSubs()
     {
         LocalMsg msg;
         msg.type = LocalMsgType::PUB_SUB_UNSUB;
 
         // Populate data
+        bool useDigest;
         {
-            const std::scoped_lock lock(m_mutex);
-            m_subDB.forEach([&msg](const std::string &topic, const SubCb &) {
-                msg.subs.push_back(topic);
-            });
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            msg.subs = this->getSubTopics();
+            useDigest = m_conf.subDB.digestRenewal &&
+                        !m_gw.subsDigestUnsupported;
         }
 
         if (msg.subs.size() == 0) {
@@ -226,18 +659,63 @@ namespace kvik
             return ErrCode::SUCCESS;
         }
 
-        // Send the message
         LocalMsg respMsg;
+
+        if (useDigest) {
+            // Try renewal using digest only
+            LocalMsg digestMsg;
+            digestMsg.type = LocalMsgType::PUB_SUB_UNSUB;
+            digestMsg.subsDigest = calcSubsDigest(msg.subs);
+
+            KVIK_RETURN_ERROR(this->sendLocal(digestMsg, respMsg));
+            if (respMsg.type == LocalMsgType::OK && respMsg.subsDigestMatch) {
+                KVIK_LOGD("Gateway holds matching subscriptions");
+                goto renewed;
+            }
+
+            // Send full subscriptions with digest, so gateway can
+            // validate them
+            KVIK_LOGD("Subscriptions digest mismatch, sending all topics");
+            msg.subsDigest = digestMsg.subsDigest;
+        }
+
+        // Send the message
         KVIK_RETURN_ERROR(this->sendLocal(msg, respMsg));
         if (respMsg.type != LocalMsgType::OK) {
             // Defensive check (already handled by `sendLocal()`)
             KVIK_LOGW("Received non-OK response");
             return ErrCode::MSG_PROCESSING_FAILED;
         }
+        if (useDigest && !respMsg.subsDigestMatch) {
+            // Gateway would report match if it supported digests
+            KVIK_LOGI("Gateway doesn't support subscriptions digest");
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            m_gw.subsDigestUnsupported = true;
+        }
 
+    renewed:
+        {
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            if (respMsg.uplinkSlot.assigned()) {
+                m_gw.uplinkSlot = respMsg.uplinkSlot;
+            }
+            m_subsLeaseExpiry =
+                std::chrono::system_clock::now() + m_conf.subDB.subLifetime;
+        }
         return ErrCode::SUCCESS;
     }
 
+    std::vector<std::string> Client::getSubTopics()
+    {
+        std::vector<std::string> topics;
+        m_subDB.forEach([&topics](const std::string &topic, const SubCb &) {
+            topics.push_back(topic);
+        });
+        topics.insert(topics.end(), m_restoredSubs.begin(),
+                      m_restoredSubs.end());
+        return topics;
+    }
+
     ErrCode Client::discoverGateway(size_t maxAttempts)
     {
         size_t attemptsCnt = 0;
@@ -256,7 +734,7 @@ namespace kvik
             KVIK_LOGD("Attempt %zu started", attemptsCnt + 1);
 
             {
-                const std::scoped_lock dscvSyncLock(m_dscvSyncMutex);
+                const std::scoped_lock dscvSyncLock(KVIK_SITE(m_dscvSyncMutex));
 
                 // Modified only by `discoverGateway` and constructor
                 // `m_dscvSyncMutex` lock is enough.
@@ -270,7 +748,15 @@ namespace kvik
                     // Iterate all possible channels and discover all possible
                     // gateways
                     for (const auto &ch : channels) {
-                        if (m_ll->setChannel(ch) != ErrCode::SUCCESS) {
+                        auto switchStart = std::chrono::steady_clock::now();
+                        auto switchErr = m_ll->setChannel(ch);
+                        this->recordEnergy(
+                            EnergyOp::CHANNEL_SCAN,
+                            std::chrono::duration_cast<
+                                std::chrono::microseconds>(
+                                std::chrono::steady_clock::now() -
+                                switchStart));
+                        if (switchErr != ErrCode::SUCCESS) {
                             KVIK_LOGW("Can't set channel %u, skipping it", ch);
                             continue;
                         }
@@ -292,7 +778,7 @@ namespace kvik
 
                     // Set new best gateway
                     {
-                        const std::scoped_lock lock(m_mutex);
+                        const std::scoped_lock lock(KVIK_SITE(m_mutex));
                         if (!channels.empty()) {
                             m_ll->setChannel(bestGw.channel);
                         }
@@ -312,7 +798,7 @@ namespace kvik
                     return ErrCode::SUCCESS;
                 } else {
                     // Reset gateway
-                    const std::scoped_lock lock(m_mutex);
+                    const std::scoped_lock lock(KVIK_SITE(m_mutex));
                     m_gw = {};
                 }
             }
@@ -321,7 +807,7 @@ namespace kvik
 
             {
                 // Sleep with possible destructor interrupt
-                std::unique_lock lock{m_mutex};
+                UniqueLock lock{KVIK_SITE(m_mutex)};
                 if (m_dscvLoopCv.wait_for(lock, delay,
                                           [this]() { return !m_dscvLoopRun; })) {
                     // Destructor has been called
@@ -350,7 +836,8 @@ namespace kvik
     {
         // Broadcast probe
         LocalMsgVector responses;
-        this->sendLocalUncheckedBroadcast(msg, responses);
+        this->sendLocalUncheckedBroadcast(msg, responses,
+                                          EnergyOp::CHANNEL_SCAN);
 
         for (const auto &resp : responses) {
             LocalPeer peer;
@@ -359,6 +846,15 @@ namespace kvik
             peer.pref = resp.pref;
             peer.rssi = resp.rssi;
             peer.tsDiff = resp.tsDiff;
+            peer.groupIdx = resp.groupIdx;
+            if (resp.groupIdx != GROUP_IDX_NONE) {
+                // Window starts at gateway's sync point, older data
+                // count as received
+                peer.groupSeq = resp.groupSeq;
+                peer.groupSeqWindow = UINT32_MAX;
+                peer.groupSeqValid = true;
+            }
+            peer.uplinkSlot = resp.uplinkSlot;
             gws.insert(peer);
         }
     }
@@ -380,7 +876,7 @@ namespace kvik
 
             pubs.push_back({
                 .topic = this->buildReportRssiTopic(gw.addr),
-                .payload = std::to_string(gw.rssi),
+                .payload = this->buildReportRssiPayload(gw.rssi),
             });
         }
 
@@ -396,7 +892,7 @@ namespace kvik
     void Client::gwWatchdogHandler()
     {
         {
-            const std::scoped_lock lock(m_mutex);
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
             if (!m_dscvLoopRun) {
                 KVIK_LOGD("Cancelled early by destructor call");
                 return;
@@ -405,7 +901,7 @@ namespace kvik
 
         while (true) {
             {
-                std::unique_lock lock{m_mutex};
+                UniqueLock lock{KVIK_SITE(m_mutex)};
                 m_gwWdCv.wait(lock);
                 if (!m_dscvLoopRun) {
                     KVIK_LOGD("Cancelled by destructor call");
@@ -419,7 +915,7 @@ namespace kvik
 
     ErrCode Client::syncTime()
     {
-        const std::scoped_lock dscvSyncLock(m_dscvSyncMutex);
+        const std::scoped_lock dscvSyncLock(KVIK_SITE(m_dscvSyncMutex));
 
         ErrCode err;
         LocalMsg msg;
@@ -427,6 +923,13 @@ namespace kvik
 
         KVIK_LOGD("Started");
 
+        if (m_conf.subDB.digestRenewal) {
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            if (!m_gw.subsDigestUnsupported) {
+                msg.subsDigest = calcSubsDigest(this->getSubTopics());
+            }
+        }
+
         // Behind `m_dscvSyncMutex`, no need for `m_mutex` lock
         m_timeSyncTimer.setNextExec(
             std::chrono::steady_clock::now() +
@@ -468,17 +971,38 @@ namespace kvik
 
         // Store the result
         {
-            const std::scoped_lock lock(m_mutex);
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
             m_gw.tsDiff = respMsg.tsDiff;
             m_timeSyncNoRespCnt = 0;
+
+            // Gateway may have restarted, group sequence starts over at
+            // its sync point
+            if (m_gw.groupIdx != respMsg.groupIdx) {
+                m_gw.groupIdx = respMsg.groupIdx;
+                m_gw.groupSeq = respMsg.groupSeq;
+                m_gw.groupSeqValid = respMsg.groupIdx != GROUP_IDX_NONE;
+                m_gw.groupSeqWindow = m_gw.groupSeqValid ? UINT32_MAX : 0;
+            }
+            if (respMsg.uplinkSlot.assigned()) {
+                m_gw.uplinkSlot = respMsg.uplinkSlot;
+            }
             KVIK_LOGD("Successful (tsDiff=%zu ms)", m_gw.tsDiff.count());
         }
 
+        // Check whether gateway still holds our subscriptions
+        if (!msg.subsDigest.empty() && !respMsg.subsDigestMatch) {
+            KVIK_LOGI("Gateway doesn't hold matching subscriptions, "
+                      "resubscribing");
+            if (this->renewSubs() != ErrCode::SUCCESS) {
+                KVIK_LOGW("Resubscription failed");
+            }
+        }
+
         // Report gateway RSSI
         if (m_conf.reporting.rssiOnTimeSync && respMsg.rssi != RSSI_UNKNOWN) {
             auto reportErr = this->publish(
                 this->buildReportRssiTopic(m_gw.addr),
-                std::to_string(respMsg.rssi));
+                this->buildReportRssiPayload(respMsg.rssi));
 
             if (reportErr != ErrCode::SUCCESS) {
                 KVIK_LOGW("Reporting RSSI failed");
@@ -490,7 +1014,7 @@ namespace kvik
     fail:
         bool trigDscv;
         {
-            const std::scoped_lock lock(m_mutex);
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
             m_timeSyncNoRespCnt++;
             trigDscv = m_conf.gwDscv.trigTimeSyncNoRespCnt == 0 ||
                        m_timeSyncNoRespCnt >=
@@ -527,15 +1051,16 @@ namespace kvik
 
         {
             // Reset failed messages counter
-            const std::scoped_lock lock(m_mutex);
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
             m_msgsFailCnt = 0;
         }
+        this->recordDelivered();
         return ErrCode::SUCCESS;
 
     fail:
         bool trigDscv;
         {
-            const std::scoped_lock lock(m_mutex);
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
             m_msgsFailCnt++;
             trigDscv = m_conf.gwDscv.trigMsgsFailCnt == 0 ||
                        m_msgsFailCnt >= m_conf.gwDscv.trigMsgsFailCnt;
@@ -552,26 +1077,32 @@ namespace kvik
     }
 
     ErrCode Client::sendLocalUnchecked(LocalMsg &msg, LocalMsg &respMsg,
-                                       bool noResp)
+                                       bool noResp, bool waitSlot)
     {
+        if (waitSlot) {
+            this->waitUplinkSlot(msg);
+        }
+
         // Prepare
         std::future<void> respFuture;
         std::vector<LocalMsg> *responsesPtr;
         {
-            const std::scoped_lock lock(m_mutex);
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
             this->prepareMsg(msg, false);
             if (msg.addr.empty()) {
                 return ErrCode::NO_GATEWAY;
             }
-            m_pendingMsgs.insert({msg.id, PendingMsg{msg, false}});
-            respFuture = m_pendingMsgs.at(msg.id).respPromise.get_future();
-            responsesPtr = &m_pendingMsgs.at(msg.id).resps;
+            if (!noResp) {
+                m_pendingMsgs.insert({msg.id, PendingMsg{msg, false}});
+                respFuture = m_pendingMsgs.at(msg.id).respPromise.get_future();
+                responsesPtr = &m_pendingMsgs.at(msg.id).resps;
+            }
         }
 
         KVIK_LOGD("Message (id=%u): %s", msg.id, msg.toString().c_str());
 
         // Send
-        KVIK_RETURN_ERROR(m_ll->send(msg));
+        KVIK_RETURN_ERROR(this->transmit(msg));
 
         if (noResp) {
             KVIK_LOGD("Not waiting for response");
@@ -579,9 +1110,15 @@ namespace kvik
         }
 
         // Wait for response
-        if (respFuture.wait_for(m_conf.nodeConf.localDelivery.respTimeout) ==
-            std::future_status::timeout) {
-            const std::scoped_lock lock(m_mutex);
+        auto waitStart = std::chrono::steady_clock::now();
+        auto status =
+            respFuture.wait_for(m_conf.nodeConf.localDelivery.respTimeout);
+        this->recordEnergy(EnergyOp::RESP_WAIT,
+                           std::chrono::duration_cast<std::chrono::microseconds>(
+                               std::chrono::steady_clock::now() - waitStart));
+
+        if (status == std::future_status::timeout) {
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
             m_pendingMsgs.erase(msg.id);
             KVIK_LOGW("Response timeout (id=%u) for: %s", msg.id,
                       msg.toString().c_str());
@@ -590,7 +1127,7 @@ namespace kvik
 
         // Get response, remove response promise and return
         {
-            const std::scoped_lock lock(m_mutex);
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
             respMsg = (*responsesPtr)[0];
             m_pendingMsgs.erase(msg.id);
             KVIK_LOGD("Response (id=%u): %s", msg.id,
@@ -599,14 +1136,30 @@ namespace kvik
         }
     }
 
+    ErrCode Client::publishUnacked(const std::string &topic,
+                                   const std::string &payload, bool waitSlot)
+    {
+        LocalMsg msg;
+        msg.type = LocalMsgType::PUB_SUB_UNSUB;
+        msg.pubs.push_back({.topic = topic, .payload = payload});
+
+        LocalMsg respMsg;
+        KVIK_RETURN_ERROR(
+            this->sendLocalUnchecked(msg, respMsg, true, waitSlot));
+
+        this->recordTraffic({}, topic, payload.size());
+        return ErrCode::SUCCESS;
+    }
+
     ErrCode Client::sendLocalUncheckedBroadcast(LocalMsg &msg,
-                                                LocalMsgVector &resps)
+                                                LocalMsgVector &resps,
+                                                EnergyOp waitOp)
     {
         // Prepare
         std::future<void> respFuture;
         std::vector<LocalMsg> *responsesPtr;
         {
-            const std::scoped_lock lock(m_mutex);
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
             this->prepareMsg(msg, true);
             m_pendingMsgs.insert({msg.id, PendingMsg{msg, true}});
             respFuture = m_pendingMsgs.at(msg.id).respPromise.get_future();
@@ -616,13 +1169,17 @@ namespace kvik
         KVIK_LOGD("Broadcast message (id=%u): %s", msg.id, msg.toString().c_str());
 
         // Send
-        KVIK_RETURN_ERROR(m_ll->send(msg));
+        KVIK_RETURN_ERROR(this->transmit(msg));
 
+        auto waitStart = std::chrono::steady_clock::now();
         std::this_thread::sleep_for(m_conf.nodeConf.localDelivery.respTimeout);
+        this->recordEnergy(waitOp,
+                           std::chrono::duration_cast<std::chrono::microseconds>(
+                               std::chrono::steady_clock::now() - waitStart));
 
         // Get responses, remove response promise and return
         {
-            const std::scoped_lock lock(m_mutex);
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
             resps = std::move(*responsesPtr);
             m_pendingMsgs.erase(msg.id);
             for (const auto &respMsg : resps) {
@@ -633,6 +1190,22 @@ namespace kvik
         }
     }
 
+    ErrCode Client::transmit(const LocalMsg &msg)
+    {
+        auto start = std::chrono::steady_clock::now();
+        ErrCode err = m_ll->send(msg);
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start);
+
+        // Prefer protocol's estimate over duration of (possibly
+        // asynchronous) send call
+        auto airtime = m_ll->estimateAirtime(msg);
+        this->recordEnergy(EnergyOp::TX,
+                           airtime.count() > 0 ? airtime : elapsed);
+
+        return err;
+    }
+
     ErrCode Client::recvLocal(LocalMsg msg)
     {
         // Check node type
@@ -648,6 +1221,12 @@ namespace kvik
         case LocalMsgType::FAIL:
         case LocalMsgType::PROBE_RES:
             KVIK_RETURN_ERROR(this->recvLocalResp(msg));
+            if (msg.type == LocalMsgType::OK && !msg.subsData.empty()) {
+                // Piggybacked data, acknowledged by next request
+                KVIK_LOGD("Received piggybacked data: %s",
+                          msg.toString().c_str());
+                KVIK_RETURN_ERROR(this->recvPiggybackedData(msg));
+            }
             break;
         case LocalMsgType::SUB_DATA:
             KVIK_RETURN_ERROR(this->recvLocalSubData(msg));
@@ -662,7 +1241,7 @@ namespace kvik
 
     ErrCode Client::recvLocalResp(const LocalMsg &msg)
     {
-        const std::scoped_lock lock(m_mutex);
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
 
         // Validate message ID
         if (!this->validateMsgId(msg.addr, msg.id)) {
@@ -696,6 +1275,14 @@ namespace kvik
             return ErrCode::MSG_UNKNOWN_SENDER;
         }
 
+        if (msg.type == LocalMsgType::OK && !msg.subsData.empty() &&
+            (pendingType != LocalMsgType::PUB_SUB_UNSUB ||
+             msg.addr != m_gw.addr)) {
+            KVIK_LOGD("Discarding piggybacked data not from gateway: %s",
+                      msg.toString().c_str());
+            return ErrCode::MSG_UNKNOWN_SENDER;
+        }
+
         if ((msg.type == LocalMsgType::OK &&
              pendingType == LocalMsgType::PUB_SUB_UNSUB) ||
             (msg.type == LocalMsgType::FAIL &&
@@ -716,6 +1303,11 @@ namespace kvik
                     return ErrCode::NOT_FOUND;
                 }
 
+                if (!msg.subsData.empty()) {
+                    m_gw.piggybackAckId = msg.id;
+                    m_gw.piggybackAckValid = true;
+                }
+
                 // Notify waiting sender
                 pendingMsg.resps.push_back(msg);
                 pendingMsg.respPromise.set_value();
@@ -729,6 +1321,33 @@ namespace kvik
         }
     }
 
+    ErrCode Client::recvPiggybackedData(const LocalMsg &msg)
+    {
+        // Decode delta-encoded payloads
+        std::vector<SubData> decodedSubsData;
+        const std::vector<SubData> *subsData = &msg.subsData;
+        if (msg.deltaPayloads) {
+            if (this->deltaDecodeSubs(msg, decodedSubsData) !=
+                ErrCode::SUCCESS) {
+                KVIK_LOGW("Delta-encoded data can't be decoded: %s",
+                          msg.toString().c_str());
+
+                // Withhold acknowledgement, gateway sends data separately
+                // after holding period (and falls back to full payloads
+                // on FAIL)
+                const std::scoped_lock lock(KVIK_SITE(m_mutex));
+                if (m_gw.piggybackAckValid && m_gw.piggybackAckId == msg.id) {
+                    m_gw.piggybackAckValid = false;
+                }
+                return ErrCode::MSG_PROCESSING_FAILED;
+            }
+            subsData = &decodedSubsData;
+        }
+
+        this->dispatchSubData(msg.addr, *subsData);
+        return ErrCode::SUCCESS;
+    }
+
     ErrCode Client::recvLocalSubData(const LocalMsg &msg)
     {
         KVIK_LOGD("Received subscriptions data: %s",
@@ -739,7 +1358,7 @@ namespace kvik
         // Validate message ID and timestamp
         bool msgIdValid, msgTsValid, senderValid;
         {
-            const std::scoped_lock lock(m_mutex);
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
             msgIdValid = this->validateMsgId(msg.addr, msg.id);
             msgTsValid = this->validateMsgTimestamp(msg.ts, m_gw.tsDiff);
             senderValid = msg.addr == m_gw.addr;
@@ -759,26 +1378,264 @@ namespace kvik
             return ErrCode::MSG_UNKNOWN_SENDER;
         }
 
-        // Notify sender about successful delivery
-        LocalMsg respMsg;
-        respMsg.type = LocalMsgType::OK;
-        this->sendLocalUnchecked(respMsg, respMsg, true);
+        if (!msg.groupRecipients.empty()) {
+            // Delta base of other recipients or of duplicate data must not
+            // be touched
+            {
+                const std::scoped_lock lock(KVIK_SITE(m_mutex));
+                err = this->checkGroupSeq(msg);
+            }
+            if (err == ErrCode::NOT_FOUND) {
+                KVIK_LOGD("Not a recipient of group data");
+                return ErrCode::SUCCESS;
+            }
+            if (err != ErrCode::SUCCESS) {
+                return err;
+            }
+        }
 
+        // Decode delta-encoded payloads
+        std::vector<SubData> decodedSubsData;
+        const std::vector<SubData> *subsData = &msg.subsData;
+        if (msg.deltaPayloads) {
+            err = this->deltaDecodeSubs(msg, decodedSubsData);
+            if (err != ErrCode::SUCCESS) {
+                KVIK_LOGW("Delta-encoded data can't be decoded: %s",
+                          msg.toString().c_str());
+                if (msg.groupRecipients.empty()) {
+                    // Gateway falls back to full payloads
+                    LocalMsg respMsg;
+                    respMsg.type = LocalMsgType::FAIL;
+                    respMsg.failReason = LocalMsgFailReason::PROCESSING_FAILED;
+                    this->sendLocalUnchecked(respMsg, respMsg, true, false);
+                }
+                return ErrCode::MSG_PROCESSING_FAILED;
+            }
+            subsData = &decodedSubsData;
+        }
+
+        if (!msg.groupRecipients.empty()) {
+            // Group-addressed data are acknowledged later
+            KVIK_RETURN_ERROR(this->processGroupSeq(msg));
+        } else {
+            // Notify sender about successful delivery
+            LocalMsg respMsg;
+            respMsg.type = LocalMsgType::OK;
+            this->sendLocalUnchecked(respMsg, respMsg, true, false);
+        }
+
+        this->dispatchSubData(msg.addr, *subsData);
+        return ErrCode::SUCCESS;
+    }
+
+    void Client::dispatchSubData(const LocalAddr &addr,
+                                 const std::vector<SubData> &subsData)
+    {
         // Iterate all subscriptions
-        for (const auto &subData : msg.subsData) {
-            std::unordered_map<std::string, const SubCb &> entries;
+        for (const auto &subData : subsData) {
+            this->recordTraffic(addr, subData.topic, subData.payload.size());
+
+            // Callbacks are copied, so they can be unsubscribed meanwhile
+            std::unordered_map<std::string, SubCb> entries;
             {
-                const std::scoped_lock lock(m_mutex);
-                entries = m_subDB.find(subData.topic);
+                const std::scoped_lock lock(KVIK_SITE(m_mutex));
+                for (const auto &[topic, cb] : m_subDB.find(subData.topic)) {
+                    entries.emplace(topic, cb);
+                }
             }
 
             for (const auto &[topic, cb] : entries) {
+                if (!cb) {
+                    // Subscribed without callback
+                    KVIK_LOGD("No callback for topic '%s'", topic.c_str());
+                    continue;
+                }
+
                 KVIK_LOGD("Calling user callback for topic '%s'",
                           topic.c_str());
                 cb(subData);
             }
         }
+    }
+
+    ErrCode Client::checkGroupSeq(const LocalMsg &msg) const
+    {
+        if (!groupRecipientsHas(msg.groupRecipients, m_gw.groupIdx)) {
+            return ErrCode::NOT_FOUND;
+        }
+        if (!m_gw.groupSeqValid) {
+            // Data can't be acknowledged without knowing what preceded them
+            KVIK_LOGD("No sync point of group data");
+            return ErrCode::NOT_FOUND;
+        }
+
+        int16_t diff = msg.groupSeq - m_gw.groupSeq;
+        if (diff <= 0 &&
+            (-diff >= 32 || (m_gw.groupSeqWindow & (1u << -diff)) != 0)) {
+            KVIK_LOGD("Discarding already received group data (seq %u)",
+                      msg.groupSeq);
+            return ErrCode::MSG_DUP_ID;
+        }
+        return ErrCode::SUCCESS;
+    }
+
+    ErrCode Client::processGroupSeq(const LocalMsg &msg)
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        KVIK_RETURN_ERROR(this->checkGroupSeq(msg));
+
+        int16_t diff = msg.groupSeq - m_gw.groupSeq;
+        if (diff > 0) {
+            // Newer data, shift window
+            m_gw.groupSeqWindow =
+                diff < 32 ? (m_gw.groupSeqWindow << diff) | 1 : 1;
+            m_gw.groupSeq = msg.groupSeq;
+        } else {
+            // Retransmission of missing data
+            m_gw.groupSeqWindow |= 1u << -diff;
+        }
+
+        // Schedule (negative) acknowledgement with random delay, so that
+        // recipients don't respond all at once
+        uint16_t gapSeq;
+        if (!m_groupAckScheduled && (m_conf.groupData.positiveAcks ||
+                                     this->findGroupSeqGap(gapSeq))) {
+            uint32_t rnd;
+            getRandomBytes(&rnd, sizeof(rnd));
+            auto jitter = std::chrono::milliseconds(
+                rnd % (m_conf.groupData.ackJitter.count() + 1));
+
+            m_groupAckScheduled = true;
+            m_groupAckTimer.setNextExec(std::chrono::steady_clock::now() +
+                                        jitter);
+        }
+
+        return ErrCode::SUCCESS;
+    }
+
+    bool Client::findGroupSeqGap(uint16_t &seq) const
+    {
+        // Find highest received offset
+        uint32_t window = m_gw.groupSeqWindow;
+        int highest = -1;
+        for (int i = 0; i < 32; i++) {
+            if (window & (1u << i)) {
+                highest = i;
+            }
+        }
+
+        // Find oldest missing offset below it
+        for (int i = highest - 1; i > 0; i--) {
+            if ((window & (1u << i)) == 0) {
+                seq = m_gw.groupSeq - i;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void Client::sendGroupAck()
+    {
+        LocalMsg msg;
+        {
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            if (!m_groupAckScheduled) {
+                return;
+            }
+            m_groupAckScheduled = false;
+
+            uint16_t gapSeq;
+            if (this->findGroupSeqGap(gapSeq)) {
+                msg.type = LocalMsgType::FAIL;
+                msg.failReason = LocalMsgFailReason::GROUP_SEQ_GAP;
+                msg.groupSeq = gapSeq;
+            } else if (m_conf.groupData.positiveAcks) {
+                msg.type = LocalMsgType::OK;
+                msg.groupSeq = m_gw.groupSeq;
+            } else {
+                return;
+            }
+        }
+
+        KVIK_LOGD("Acknowledging group data: %s", msg.toString().c_str());
+        LocalMsg respMsg;
+        if (this->sendLocalUnchecked(msg, respMsg, true, false) !=
+            ErrCode::SUCCESS) {
+            KVIK_LOGW("Sending group data acknowledgement failed");
+        }
+    }
+
+    void Client::sendStreamAcks()
+    {
+        decltype(m_streamAcks) acks;
+        {
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            acks.swap(m_streamAcks);
+        }
+
+        for (const auto &[key, ack] : acks) {
+            // Acknowledgements must not hold up timer thread
+            if (this->publishUnacked(key.first, ack, false) !=
+                ErrCode::SUCCESS) {
+                // Sender retransmits unacknowledged chunks
+                KVIK_LOGD("Sending stream acknowledgement failed");
+            }
+        }
+    }
+
+    bool Client::deltaEncodePubs(LocalMsg &msg)
+    {
+        if (!m_conf.delta.enable || msg.pubs.empty()) {
+            return false;
+        }
+
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        m_deltaTx.bindPeer(m_gw.addr);
+
+        bool deltaUsed = false;
+        for (auto &pub : msg.pubs) {
+            pub.payload = m_deltaTx.encode(pub.topic, pub.payload);
+            deltaUsed |= DeltaCodec::isDelta(pub.payload);
+        }
+        msg.deltaPayloads = true;
+        return deltaUsed;
+    }
+
+    void Client::deltaFinishPubs(const LocalMsg &msg, bool delivered)
+    {
+        if (!msg.deltaPayloads) {
+            return;
+        }
+
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        for (const auto &pub : msg.pubs) {
+            if (delivered) {
+                m_deltaTx.confirm(pub.topic);
+            } else {
+                m_deltaTx.invalidate(pub.topic);
+            }
+        }
+    }
 
+    ErrCode Client::deltaDecodeSubs(const LocalMsg &msg,
+                                    std::vector<SubData> &subsData)
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        m_deltaRx.bindPeer(msg.addr);
+
+        subsData = msg.subsData;
+        for (auto &subData : subsData) {
+            std::string payload;
+            ErrCode res = m_deltaRx.decode(subData.topic, subData.payload,
+                                           payload);
+            if (res != ErrCode::SUCCESS) {
+                // Sender falls back to full payload
+                m_deltaRx.invalidate(subData.topic);
+                return res;
+            }
+            subData.payload = std::move(payload);
+        }
         return ErrCode::SUCCESS;
     }
 
@@ -793,49 +1650,170 @@ namespace kvik
         msg.ts =
             static_cast<uint16_t>(gwTs / m_conf.nodeConf.msgIdCache.timeUnit);
         msg.nodeType = NodeType::CLIENT;
+
+        // Implicit acknowledgement of data piggybacked on previous OK
+        if (msg.type == LocalMsgType::PUB_SUB_UNSUB && !broadcast) {
+            msg.piggybackAck = m_gw.piggybackAckValid;
+            msg.piggybackAckId = m_gw.piggybackAckId;
+
+            // Acknowledged once (gateway attaches unacknowledged data again)
+            m_gw.piggybackAckValid = false;
+        }
     }
 
     void Client::subDBTick()
     {
         KVIK_LOGD("Renewal running");
 
-        LocalMsg msg, respMsg;
-        msg.type = LocalMsgType::PUB_SUB_UNSUB;
-
-        // Populate data
-        {
-            const std::scoped_lock lock(m_mutex);
-            m_subDB.forEach([&msg](const std::string &topic, const SubCb &cb) {
-                msg.subs.push_back(topic);
-            });
-        }
-
-        if (msg.subs.size() == 0) {
-            // Nothing to do
-            KVIK_LOGD("Nothing to renew");
+        if (this->renewSubs() != ErrCode::SUCCESS) {
+            KVIK_LOGW("Renewal failed");
             return;
         }
 
-        // Send the message
-        auto err = this->sendLocal(msg, respMsg);
-        if (err != ErrCode::SUCCESS) {
-            KVIK_LOGW("Error while sending the message");
-        }
-        if (respMsg.type != LocalMsgType::OK) {
-            KVIK_LOGW("Received non-OK response");
-        }
-
         KVIK_LOGD("Renewal done");
     }
 
     const ClientRetainedData Client::retain()
     {
-        const std::scoped_lock lock(m_mutex);
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
 
         return {
             .gw = m_gw.retain(),
             .msgsFailCnt = m_msgsFailCnt,
             .timeSyncNoRespCnt = m_timeSyncNoRespCnt,
+            .subs = this->retainSubs(),
         };
     }
+
+    RetainedSubs Client::retainSubs()
+    {
+        RetainedSubs retained;
+        if (!m_conf.subDB.retainSubs ||
+            m_subsLeaseExpiry == std::chrono::system_clock::time_point{}) {
+            return retained;
+        }
+
+        for (const auto &topic : this->getSubTopics()) {
+            if (retained.cnt >= retained.subs.size() ||
+                topic.size() > KVIK_RETAINED_TOPIC_MAX_LEN) {
+                KVIK_LOGW("Can't retain subscription to '%s'", topic.c_str());
+                continue;
+            }
+
+            auto &sub = retained.subs[retained.cnt++];
+            std::copy(topic.begin(), topic.end(), sub.topic.begin());
+            sub.topicLen = topic.size();
+        }
+
+        retained.leaseExpiry =
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                m_subsLeaseExpiry.time_since_epoch())
+                .count();
+        return retained;
+    }
+
+    void Client::restoreSubs(const RetainedSubs &subs)
+    {
+        if (!m_conf.subDB.retainSubs || subs.cnt == 0) {
+            return;
+        }
+
+        std::chrono::system_clock::time_point leaseExpiry{
+            std::chrono::milliseconds(subs.leaseExpiry)};
+        auto now = std::chrono::system_clock::now();
+        if (leaseExpiry <= now) {
+            KVIK_LOGD("Lease of retained subscriptions expired");
+            return;
+        }
+
+        {
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            for (size_t i = 0; i < subs.cnt && i < subs.subs.size(); i++) {
+                const auto &sub = subs.subs[i];
+                std::string topic{sub.topic.begin(),
+                                  sub.topic.begin() +
+                                      std::min<size_t>(sub.topicLen,
+                                                       sub.topic.size())};
+
+                // Callbacks can't be retained, topic is inserted into
+                // subscription DB once claimed by `subscribe()`
+                m_restoredSubs.insert(topic);
+            }
+            m_subsLeaseExpiry = leaseExpiry;
+        }
+
+        // Renew a margin before lease expires, so it doesn't lapse while
+        // renewal is in progress
+        auto untilExpiry =
+            std::chrono::duration_cast<std::chrono::milliseconds>(leaseExpiry -
+                                                                  now);
+        auto untilRenewal = std::max(
+            untilExpiry - m_conf.subDB.subLifetime / SUB_RENEWAL_MARGIN_DIV,
+            std::chrono::milliseconds(0));
+        m_subDBTimer.setNextExec(std::chrono::steady_clock::now() +
+                                 untilRenewal);
+
+        KVIK_LOGD("Restored %u subscriptions", subs.cnt);
+    }
+
+    void Client::waitUplinkSlot(const LocalMsg &msg)
+    {
+        if (!m_conf.slotted.enable || msg.type == LocalMsgType::OK ||
+            msg.type == LocalMsgType::FAIL) {
+            return;
+        }
+
+        bool contention =
+            msg.type != LocalMsgType::PUB_SUB_UNSUB || this->isUrgent(msg);
+        auto airtime = m_ll->estimateAirtime(msg);
+
+        UniqueLock lock{KVIK_SITE(m_mutex)};
+        const auto &slot = m_gw.uplinkSlot;
+        if (!slot.assigned()) {
+            return;
+        }
+
+        // Message may start later in the slot if it still fits in
+        auto slack = std::chrono::milliseconds(0);
+        if (airtime.count() > 0) {
+            slack = slot.slotLen -
+                    std::chrono::ceil<std::chrono::milliseconds>(airtime);
+            slack = std::max(slack, std::chrono::milliseconds(0));
+        }
+
+        auto gwTime = std::chrono::duration_cast<std::chrono::milliseconds>(
+                          std::chrono::steady_clock::now().time_since_epoch()) +
+                      m_gw.tsDiff;
+        auto wait = slot.nextStart(gwTime - slack, contention) - gwTime;
+        if (wait.count() <= 0) {
+            return;
+        }
+
+        KVIK_LOGD("Deferring message by %" PRId64 " ms to %s slot",
+                  static_cast<int64_t>(wait.count()),
+                  contention ? "contention" : "own");
+        m_dscvLoopCv.wait_for(lock, wait, [this]() { return !m_dscvLoopRun; });
+    }
+
+    bool Client::isUrgent(const LocalMsg &msg) const
+    {
+        if (m_urgentFilters.empty()) {
+            return false;
+        }
+
+        const auto &sep = m_conf.nodeConf.topicSep;
+        for (const auto &pub : msg.pubs) {
+            if (!Topic::isValid(pub.topic, sep)) {
+                continue;
+            }
+
+            Topic topic{pub.topic, sep};
+            for (const auto &filter : m_urgentFilters) {
+                if (filter.matches(topic)) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
 } // namespace kvik
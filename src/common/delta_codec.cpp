@@ -0,0 +1,266 @@
+/**
+ * @file delta_codec.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Stateful per-topic delta encoding of payloads
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "kvik/byte_codec.hpp"
+#include "kvik/delta_codec.hpp"
+#include "kvik/errors.hpp"
+
+namespace kvik
+{
+    namespace
+    {
+        constexpr uint8_t FULL_TAG = 0x00;
+        constexpr uint8_t DELTA_TAG = 0x01;
+        constexpr size_t FULL_HDR_LEN = 2;
+        constexpr size_t DELTA_HDR_LEN = 3;
+
+        /**
+         * @brief Returns byte of payload (zero beyond its end)
+         * @param str Payload
+         * @param i Index
+         * @return Byte
+         */
+        uint8_t byteAt(const std::string &str, size_t i)
+        {
+            return i < str.size() ? static_cast<uint8_t>(str[i]) : 0;
+        }
+
+        /**
+         * @brief Appends XOR of `payload` and `base` as zero-run ops
+         * @param out Output buffer
+         * @param base Base payload
+         * @param payload New payload
+         */
+        void putXorOps(std::string &out, const std::string &base,
+                       const std::string &payload)
+        {
+            size_t i = 0;
+            while (i < payload.size()) {
+                size_t zeroStart = i;
+                while (i < payload.size() &&
+                       byteAt(base, i) == static_cast<uint8_t>(payload[i])) {
+                    i++;
+                }
+                if (i == payload.size()) {
+                    // Trailing zeros are implicit
+                    break;
+                }
+
+                size_t litStart = i;
+                while (i < payload.size() &&
+                       byteAt(base, i) != static_cast<uint8_t>(payload[i])) {
+                    i++;
+                }
+
+                putVarint(out, litStart - zeroStart);
+                putVarint(out, i - litStart);
+                for (size_t j = litStart; j < i; j++) {
+                    out += static_cast<char>(byteAt(base, j) ^
+                                             static_cast<uint8_t>(payload[j]));
+                }
+            }
+        }
+    } // namespace
+
+    DeltaCodec::DeltaCodec(size_t maxTopics, size_t maxPayloadLen)
+        : m_maxTopics{maxTopics}, m_maxPayloadLen{maxPayloadLen}
+    {
+    }
+
+    void DeltaCodec::bindPeer(const LocalAddr &peer)
+    {
+        if (peer != m_peer) {
+            this->clear();
+            m_peer = peer;
+        }
+    }
+
+    std::string DeltaCodec::encode(const std::string &topic,
+                                   const std::string &payload)
+    {
+        std::string full;
+        full.reserve(FULL_HDR_LEN + payload.size());
+        full += static_cast<char>(FULL_TAG);
+
+        Entry *entry = this->touch(topic, payload.size() <= m_maxPayloadLen);
+        if (entry == nullptr) {
+            // Not tracked, sequence number is irrelevant
+            full += '\0';
+            full += payload;
+            return full;
+        }
+
+        uint8_t seq = entry->nextSeq++;
+        full += static_cast<char>(seq);
+        full += payload;
+
+        if (payload.size() > m_maxPayloadLen) {
+            // Too long to be tracked, receiver drops its base too
+            this->invalidate(topic);
+            return full;
+        }
+
+        entry->pending = payload;
+        entry->pendingSeq = seq;
+        entry->hasPending = true;
+
+        if (!entry->hasBase) {
+            return full;
+        }
+
+        std::string delta;
+        delta += static_cast<char>(DELTA_TAG);
+        delta += static_cast<char>(entry->baseSeq);
+        delta += static_cast<char>(seq);
+        putVarint(delta, payload.size());
+        putXorOps(delta, entry->base, payload);
+
+        return delta.size() < full.size() ? delta : full;
+    }
+
+    void DeltaCodec::confirm(const std::string &topic)
+    {
+        Entry *entry = this->touch(topic, false);
+        if (entry == nullptr || !entry->hasPending) {
+            return;
+        }
+
+        entry->base = std::move(entry->pending);
+        entry->baseSeq = entry->pendingSeq;
+        entry->hasBase = true;
+        entry->pending.clear();
+        entry->hasPending = false;
+    }
+
+    void DeltaCodec::invalidate(const std::string &topic)
+    {
+        auto it = m_index.find(topic);
+        if (it == m_index.end()) {
+            return;
+        }
+
+        // Keep sequence numbers running, so stale frames can't match
+        it->second->base.clear();
+        it->second->hasBase = false;
+        it->second->pending.clear();
+        it->second->hasPending = false;
+    }
+
+    ErrCode DeltaCodec::decode(const std::string &topic,
+                               const std::string &frame, std::string &payload)
+    {
+        if (frame.size() < FULL_HDR_LEN) {
+            return ErrCode::INVALID_ARG;
+        }
+
+        uint8_t tag = frame[0];
+        if (tag == FULL_TAG) {
+            payload = frame.substr(FULL_HDR_LEN);
+            Entry *entry =
+                this->touch(topic, payload.size() <= m_maxPayloadLen);
+            if (entry == nullptr) {
+                return ErrCode::SUCCESS;
+            }
+
+            if (payload.size() > m_maxPayloadLen) {
+                this->invalidate(topic);
+                return ErrCode::SUCCESS;
+            }
+
+            entry->base = payload;
+            entry->baseSeq = frame[1];
+            entry->hasBase = true;
+            return ErrCode::SUCCESS;
+        }
+
+        if (tag != DELTA_TAG || frame.size() < DELTA_HDR_LEN) {
+            return ErrCode::INVALID_ARG;
+        }
+
+        uint8_t baseSeq = frame[1];
+        uint8_t seq = frame[2];
+        size_t pos = DELTA_HDR_LEN;
+        uint64_t len;
+        if (!getVarint(frame, pos, len) || len > m_maxPayloadLen) {
+            return ErrCode::INVALID_ARG;
+        }
+
+        Entry *entry = this->touch(topic, false);
+        if (entry == nullptr || !entry->hasBase || entry->baseSeq != baseSeq) {
+            return ErrCode::NOT_FOUND;
+        }
+
+        std::string decoded(len, '\0');
+        for (size_t i = 0; i < len; i++) {
+            decoded[i] = static_cast<char>(byteAt(entry->base, i));
+        }
+
+        size_t i = 0;
+        while (pos < frame.size()) {
+            uint64_t zeroRun, litLen;
+            if (!getVarint(frame, pos, zeroRun) ||
+                !getVarint(frame, pos, litLen) || zeroRun > len - i ||
+                litLen > len - i - zeroRun || litLen > frame.size() - pos) {
+                return ErrCode::INVALID_ARG;
+            }
+
+            i += zeroRun;
+            for (size_t j = 0; j < litLen; j++, i++) {
+                decoded[i] ^= frame[pos++];
+            }
+        }
+
+        entry->base = decoded;
+        entry->baseSeq = seq;
+        payload = std::move(decoded);
+        return ErrCode::SUCCESS;
+    }
+
+    bool DeltaCodec::isDelta(const std::string &frame)
+    {
+        return frame.size() >= DELTA_HDR_LEN &&
+               static_cast<uint8_t>(frame[0]) == DELTA_TAG;
+    }
+
+    void DeltaCodec::clear()
+    {
+        m_entries.clear();
+        m_index.clear();
+    }
+
+    size_t DeltaCodec::size() const
+    {
+        return m_entries.size();
+    }
+
+    DeltaCodec::Entry *DeltaCodec::touch(const std::string &topic,
+                                         bool insert)
+    {
+        auto it = m_index.find(topic);
+        if (it != m_index.end()) {
+            m_entries.splice(m_entries.begin(), m_entries, it->second);
+            return &m_entries.front();
+        }
+
+        if (!insert || m_maxTopics == 0) {
+            return nullptr;
+        }
+
+        if (m_entries.size() >= m_maxTopics) {
+            // Evict least recently used topic
+            m_index.erase(m_entries.back().topic);
+            m_entries.pop_back();
+        }
+
+        m_entries.push_front(Entry{});
+        m_entries.front().topic = topic;
+        m_index[topic] = m_entries.begin();
+        return &m_entries.front();
+    }
+} // namespace kvik
@@ -0,0 +1,243 @@
+/**
+ * @file downlink_scheduler.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Fair downlink scheduler for Kvik
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <mutex>
+#include <thread>
+
+#include "kvik/downlink_scheduler.hpp"
+#include "kvik/errors.hpp"
+#include "kvik/logger.hpp"
+
+// Log tag
+static const char *KVIK_LOG_TAG = "Kvik/DownlinkScheduler";
+
+namespace kvik
+{
+    DownlinkScheduler::DownlinkScheduler(DownlinkSchedulerConfig conf,
+                                         ILocalLayer *ll)
+        : m_conf{conf}, m_ll{ll}
+    {
+        if (m_ll == nullptr) {
+            KVIK_THROW_EXC("Invalid local layer parameter");
+        }
+
+        if (m_conf.classWeights.empty() ||
+            m_conf.classWeights.size() > UINT8_MAX) {
+            KVIK_THROW_EXC("Invalid number of traffic classes");
+        }
+
+        for (const auto w : m_conf.classWeights) {
+            if (w == 0) {
+                KVIK_THROW_EXC("Traffic class weight can't be 0");
+            }
+        }
+
+        if (m_conf.quantum == 0 || m_conf.maxClientQueueLen == 0) {
+            KVIK_THROW_EXC("Quantum and queue length can't be 0");
+        }
+
+        // Pass received messages through
+        m_ll->setRecvCb([this](LocalMsg msg) -> ErrCode {
+            auto cb = m_recvCb;
+            return cb != nullptr ? cb(msg) : ErrCode::SUCCESS;
+        });
+
+        m_thread = std::thread(&DownlinkScheduler::senderThread, this);
+
+        KVIK_LOGD("Initialized");
+    }
+
+    DownlinkScheduler::~DownlinkScheduler()
+    {
+        {
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            m_run = false;
+        }
+        m_cv.notify_one();
+        m_thread.join();
+
+        m_ll->setRecvCb(nullptr);
+
+        KVIK_LOGD("Deinitialized");
+    }
+
+    ErrCode DownlinkScheduler::send(const LocalMsg &msg)
+    {
+        switch (msg.type) {
+        case LocalMsgType::OK:
+        case LocalMsgType::FAIL:
+        case LocalMsgType::PROBE_RES:
+            return this->send(msg, 0);
+        default:
+            return this->send(msg, m_conf.classWeights.size() > 1 ? 1 : 0);
+        }
+    }
+
+    ErrCode DownlinkScheduler::send(const LocalMsg &msg, uint8_t cls)
+    {
+        if (cls >= m_conf.classWeights.size()) {
+            return ErrCode::INVALID_ARG;
+        }
+
+        {
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+
+            auto &client = m_clients[msg.addr];
+            if (client.flows.empty()) {
+                client.flows.resize(m_conf.classWeights.size());
+            }
+
+            if (client.queuedCnt >= m_conf.maxClientQueueLen) {
+                KVIK_LOGD("Queue of %s is full, dropping: %s",
+                          msg.addr.toString().c_str(),
+                          msg.toString().c_str());
+                return ErrCode::QUEUE_FULL;
+            }
+
+            auto &flow = client.flows[cls];
+            flow.queue.push_back(msg);
+            client.queuedCnt++;
+            m_queuedCnt++;
+
+            if (!flow.active) {
+                flow.active = true;
+                m_active.push_back({msg.addr, cls});
+            }
+        }
+
+        m_cv.notify_one();
+        return ErrCode::SUCCESS;
+    }
+
+    const ILocalLayer::Channels &DownlinkScheduler::getChannels()
+    {
+        return m_ll->getChannels();
+    }
+
+    ErrCode DownlinkScheduler::setChannel(uint16_t ch)
+    {
+        return m_ll->setChannel(ch);
+    }
+
+    std::chrono::microseconds DownlinkScheduler::estimateAirtime(
+        const LocalMsg &msg)
+    {
+        return m_ll->estimateAirtime(msg);
+    }
+
+    size_t DownlinkScheduler::queuedCnt()
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        return m_queuedCnt;
+    }
+
+    void DownlinkScheduler::flush()
+    {
+        UniqueLock lock{KVIK_SITE(m_mutex)};
+        m_idleCv.wait(lock, [this]() {
+            return !m_run || (m_queuedCnt == 0 && !m_sending);
+        });
+    }
+
+    void DownlinkScheduler::senderThread()
+    {
+        while (true) {
+            LocalMsg msg;
+            {
+                UniqueLock lock{KVIK_SITE(m_mutex)};
+                m_sending = false;
+                if (m_queuedCnt == 0) {
+                    m_idleCv.notify_all();
+                }
+
+                m_cv.wait(lock, [this]() {
+                    return !m_run || m_queuedCnt > 0;
+                });
+                if (!m_run) {
+                    break;
+                }
+
+                if (!this->pickNext(msg)) {
+                    continue;
+                }
+                m_sending = true;
+            }
+
+            if (m_ll->send(msg) != ErrCode::SUCCESS) {
+                KVIK_LOGW("Send failed: %s", msg.toString().c_str());
+            }
+        }
+
+        m_idleCv.notify_all();
+    }
+
+    bool DownlinkScheduler::pickNext(LocalMsg &msg)
+    {
+        while (!m_active.empty()) {
+            const auto &[addr, cls] = m_active.front();
+            auto &client = m_clients.at(addr);
+            auto &flow = client.flows[cls];
+
+            // Every flow gets its quantum when it reaches the front
+            if (!flow.quantumGiven) {
+                flow.deficit += m_conf.quantum * m_conf.classWeights[cls];
+                flow.quantumGiven = true;
+            }
+
+            size_t cost = msgCost(flow.queue.front());
+            if (cost > flow.deficit) {
+                // Out of credit, move to the end of round
+                flow.quantumGiven = false;
+                m_active.push_back(m_active.front());
+                m_active.pop_front();
+                continue;
+            }
+
+            flow.deficit -= cost;
+            msg = std::move(flow.queue.front());
+            flow.queue.pop_front();
+            client.queuedCnt--;
+            m_queuedCnt--;
+
+            if (flow.queue.empty()) {
+                // Idle flows don't keep their credit
+                flow.deficit = 0;
+                flow.quantumGiven = false;
+                flow.active = false;
+                if (client.queuedCnt == 0) {
+                    m_clients.erase(addr);
+                }
+                m_active.pop_front();
+            }
+
+            return true;
+        }
+
+        return false;
+    }
+
+    size_t DownlinkScheduler::msgCost(const LocalMsg &msg)
+    {
+        // Rough estimate of encoded size
+        size_t cost = 16 + msg.addr.addr.size();
+        for (const auto &pub : msg.pubs) {
+            cost += pub.topic.size() + pub.payload.size() + 2;
+        }
+        for (const auto &topic : msg.subs) {
+            cost += topic.size() + 1;
+        }
+        for (const auto &topic : msg.unsubs) {
+            cost += topic.size() + 1;
+        }
+        for (const auto &data : msg.subsData) {
+            cost += data.topic.size() + data.payload.size() + 2;
+        }
+        return cost;
+    }
+} // namespace kvik
@@ -0,0 +1,97 @@
+/**
+ * @file energy_meter.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Radio-on time and energy accounting
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "kvik/energy_meter.hpp"
+
+namespace kvik
+{
+    const char *energyOpToStr(EnergyOp op)
+    {
+        switch (op) {
+        case EnergyOp::TX:
+            return "TX";
+        case EnergyOp::RESP_WAIT:
+            return "RESP_WAIT";
+        case EnergyOp::BROADCAST_WAIT:
+            return "BROADCAST_WAIT";
+        case EnergyOp::CHANNEL_SCAN:
+            return "CHANNEL_SCAN";
+        default:
+            return "UNKNOWN";
+        }
+    }
+
+    std::chrono::microseconds EnergyMeter::Snapshot::totalTime() const
+    {
+        std::chrono::microseconds total{0};
+        for (const auto &stats : ops) {
+            total += stats.time;
+        }
+        return total;
+    }
+
+    double EnergyMeter::Snapshot::totalEnergy() const
+    {
+        double total = 0.0;
+        for (const auto &stats : ops) {
+            total += stats.energy;
+        }
+        return total;
+    }
+
+    double EnergyMeter::Snapshot::energyPerDelivered() const
+    {
+        if (delivered == 0) {
+            return 0.0;
+        }
+        return this->totalEnergy() / delivered;
+    }
+
+    EnergyMeter::EnergyMeter(std::shared_ptr<const IPowerModel> powerModel)
+        : m_powerModel{powerModel}
+    {
+        if (!m_powerModel) {
+            m_powerModel = std::make_shared<ConstPowerModel>();
+        }
+    }
+
+    void EnergyMeter::record(EnergyOp op, std::chrono::microseconds time)
+    {
+        if (op >= EnergyOp::COUNT || time.count() < 0) {
+            return;
+        }
+
+        auto state = op == EnergyOp::TX ? RadioState::TX : RadioState::RX;
+        double energy = m_powerModel->power(state) * time.count() / 1e6;
+
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        auto &stats = m_snap.ops[static_cast<size_t>(op)];
+        stats.cnt++;
+        stats.time += time;
+        stats.energy += energy;
+    }
+
+    void EnergyMeter::recordDelivered()
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        m_snap.delivered++;
+    }
+
+    EnergyMeter::Snapshot EnergyMeter::snapshot() const
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        return m_snap;
+    }
+
+    void EnergyMeter::clear()
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        m_snap = {};
+    }
+} // namespace kvik
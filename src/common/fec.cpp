@@ -0,0 +1,262 @@
+/**
+ * @file fec.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Forward error correction (Reed-Solomon erasure code)
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+#include "kvik/errors.hpp"
+#include "kvik/fec.hpp"
+
+namespace kvik
+{
+    namespace
+    {
+        /**
+         * @brief Arithmetic in GF(2^8) (polynomial 0x11D)
+         */
+        class GF256
+        {
+            std::array<uint8_t, 512> m_exp;
+            std::array<uint8_t, 256> m_log;
+
+        public:
+            GF256()
+            {
+                unsigned x = 1;
+                for (unsigned i = 0; i < 255; i++) {
+                    m_exp[i] = x;
+                    m_log[x] = i;
+                    x <<= 1;
+                    if (x & 0x100) {
+                        x ^= 0x11D;
+                    }
+                }
+                // Duplicate, so sum of logarithms needs no modulo
+                for (unsigned i = 255; i < m_exp.size(); i++) {
+                    m_exp[i] = m_exp[i - 255];
+                }
+                m_log[0] = 0;
+            }
+
+            uint8_t mul(uint8_t a, uint8_t b) const
+            {
+                if (a == 0 || b == 0) {
+                    return 0;
+                }
+                return m_exp[m_log[a] + m_log[b]];
+            }
+
+            uint8_t inv(uint8_t a) const { return m_exp[255 - m_log[a]]; }
+
+            /**
+             * @brief Computes `dst += coef * src` (byte-wise)
+             * @param dst Destination
+             * @param src Source
+             * @param coef Coefficient
+             */
+            void mulAdd(std::string &dst, const std::string &src,
+                        uint8_t coef) const
+            {
+                if (coef == 0) {
+                    return;
+                }
+                unsigned logCoef = m_log[coef];
+                for (size_t i = 0; i < src.size(); i++) {
+                    uint8_t s = src[i];
+                    if (s != 0) {
+                        dst[i] ^= static_cast<char>(m_exp[logCoef + m_log[s]]);
+                    }
+                }
+            }
+        };
+
+        const GF256 &gf()
+        {
+            static const GF256 field;
+            return field;
+        }
+
+        /**
+         * @brief Returns encoding coefficient (Cauchy matrix element)
+         * @param dataCnt Number of data shards
+         * @param parityIdx Parity index (row)
+         * @param dataIdx Data index (column)
+         * @return Coefficient
+         */
+        uint8_t coef(size_t dataCnt, size_t parityIdx, size_t dataIdx)
+        {
+            // x = dataCnt + parityIdx and y = dataIdx never collide
+            return gf().inv(static_cast<uint8_t>((dataCnt + parityIdx) ^
+                                                 dataIdx));
+        }
+
+        /**
+         * @brief Inverts square matrix in-place (Gauss-Jordan)
+         *
+         * Cauchy submatrices are always invertible.
+         *
+         * @param m Matrix (row-major)
+         * @param n Dimension
+         */
+        void invert(std::vector<uint8_t> &m, size_t n)
+        {
+            std::vector<uint8_t> inv(n * n, 0);
+            for (size_t i = 0; i < n; i++) {
+                inv[i * n + i] = 1;
+            }
+
+            for (size_t col = 0; col < n; col++) {
+                size_t pivot = col;
+                while (m[pivot * n + col] == 0) {
+                    pivot++;
+                }
+                if (pivot != col) {
+                    for (size_t k = 0; k < n; k++) {
+                        std::swap(m[pivot * n + k], m[col * n + k]);
+                        std::swap(inv[pivot * n + k], inv[col * n + k]);
+                    }
+                }
+
+                uint8_t scale = gf().inv(m[col * n + col]);
+                for (size_t k = 0; k < n; k++) {
+                    m[col * n + k] = gf().mul(m[col * n + k], scale);
+                    inv[col * n + k] = gf().mul(inv[col * n + k], scale);
+                }
+
+                for (size_t row = 0; row < n; row++) {
+                    uint8_t factor = m[row * n + col];
+                    if (row == col || factor == 0) {
+                        continue;
+                    }
+                    for (size_t k = 0; k < n; k++) {
+                        m[row * n + k] ^= gf().mul(factor, m[col * n + k]);
+                        inv[row * n + k] ^= gf().mul(factor, inv[col * n + k]);
+                    }
+                }
+            }
+
+            m = std::move(inv);
+        }
+    } // namespace
+
+    ErrCode fecEncode(const std::vector<std::string> &data, size_t parityCnt,
+                      std::vector<std::string> &parity)
+    {
+        parity.clear();
+        if (data.empty() || data.size() + parityCnt > FEC_MAX_SHARDS) {
+            return ErrCode::INVALID_ARG;
+        }
+
+        size_t len = data[0].size();
+        for (const auto &shard : data) {
+            if (shard.size() != len) {
+                return ErrCode::INVALID_SIZE;
+            }
+        }
+
+        parity.resize(parityCnt, std::string(len, '\0'));
+        for (size_t j = 0; j < parityCnt; j++) {
+            for (size_t i = 0; i < data.size(); i++) {
+                gf().mulAdd(parity[j], data[i], coef(data.size(), j, i));
+            }
+        }
+        return ErrCode::SUCCESS;
+    }
+
+    ErrCode fecDecode(std::vector<std::string> &data,
+                      const std::vector<bool> &present,
+                      const std::map<size_t, std::string> &parity)
+    {
+        size_t k = data.size();
+        if (k == 0 || present.size() != k) {
+            return ErrCode::INVALID_ARG;
+        }
+
+        std::vector<size_t> missing;
+        size_t len = SIZE_MAX;
+        for (size_t i = 0; i < k; i++) {
+            if (!present[i]) {
+                missing.push_back(i);
+            } else if (len == SIZE_MAX) {
+                len = data[i].size();
+            } else if (data[i].size() != len) {
+                return ErrCode::INVALID_SIZE;
+            }
+        }
+        if (missing.empty()) {
+            return ErrCode::SUCCESS;
+        }
+        if (parity.size() < missing.size()) {
+            return ErrCode::NOT_FOUND;
+        }
+
+        // Use first `e` parity shards: s_j = p_j - sum(present) = C[j][M] * d_M
+        size_t e = missing.size();
+        std::vector<std::string> syndromes;
+        std::vector<size_t> rows;
+        for (const auto &[j, shard] : parity) {
+            if (rows.size() == e) {
+                break;
+            }
+            if (k + j > FEC_MAX_SHARDS) {
+                return ErrCode::INVALID_ARG;
+            }
+            if (len == SIZE_MAX) {
+                len = shard.size();
+            }
+            if (shard.size() != len) {
+                return ErrCode::INVALID_SIZE;
+            }
+
+            std::string syndrome = shard;
+            for (size_t i = 0; i < k; i++) {
+                if (present[i]) {
+                    gf().mulAdd(syndrome, data[i], coef(k, j, i));
+                }
+            }
+            syndromes.push_back(std::move(syndrome));
+            rows.push_back(j);
+        }
+
+        std::vector<uint8_t> m(e * e);
+        for (size_t r = 0; r < e; r++) {
+            for (size_t c = 0; c < e; c++) {
+                m[r * e + c] = coef(k, rows[r], missing[c]);
+            }
+        }
+        invert(m, e);
+
+        for (size_t c = 0; c < e; c++) {
+            std::string shard(len, '\0');
+            for (size_t r = 0; r < e; r++) {
+                gf().mulAdd(shard, syndromes[r], m[c * e + r]);
+            }
+            data[missing[c]] = std::move(shard);
+        }
+        return ErrCode::SUCCESS;
+    }
+
+    size_t fecParityCnt(size_t dataCnt, double lossRate, size_t maxParityCnt)
+    {
+        if (lossRate <= 0 || dataCnt == 0 || dataCnt >= FEC_MAX_SHARDS) {
+            return 0;
+        }
+        lossRate = std::min(lossRate, 0.9);
+
+        double k = static_cast<double>(dataCnt);
+        double expected = lossRate * k;
+        double deviation = std::sqrt(lossRate * (1 - lossRate) * k);
+        double cnt = std::ceil((expected + 2 * deviation) / (1 - lossRate));
+
+        size_t limit = std::min(maxParityCnt, FEC_MAX_SHARDS - dataCnt);
+        return std::min(static_cast<size_t>(cnt), limit);
+    }
+} // namespace kvik
@@ -0,0 +1,716 @@
+/**
+ * @file gateway_replicator.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Hot-standby replication of gateway state
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <algorithm>
+#include <cinttypes>
+#include <limits>
+
+#include "kvik/byte_codec.hpp"
+#include "kvik/errors.hpp"
+#include "kvik/gateway_replicator.hpp"
+#include "kvik/logger.hpp"
+
+// Log tag
+static const char *KVIK_LOG_TAG = "Kvik/GatewayReplicator";
+
+namespace kvik
+{
+    namespace
+    {
+        /**
+         * @brief Types of replication records
+         */
+        enum RecordType : uint8_t
+        {
+            SYNC_REQ = 0x01,     //!< Standby requests snapshot
+            SYNC_START = 0x02,   //!< Snapshot follows (state is reset)
+            SYNC_END = 0x03,     //!< Snapshot complete
+            SESSION = 0x04,      //!< Session created or updated
+            SESSION_DEL = 0x05,  //!< Session removed
+            SUB = 0x06,          //!< Lease created or renewed
+            UNSUB = 0x07,        //!< Lease removed
+            CONSUMER_DEL = 0x08, //!< All leases of consumer removed
+            RENEW_ALL = 0x09,    //!< All leases of consumer renewed
+        };
+
+        constexpr size_t FRAME_HDR_LEN = 4;
+        constexpr size_t RECORD_HDR_LEN = 3;
+        constexpr size_t MAX_RECORD_LEN = 0xFFFF;
+        constexpr size_t SESSION_LEN = 32; //!< Without address
+        constexpr size_t SUB_HDR_LEN = 12;
+        constexpr size_t MIN_FRAME_LEN = 64;
+
+        //! Maximum number of frames waiting for `tick()`
+        constexpr size_t MAX_INBOX_LEN = 1024;
+
+        /**
+         * @brief Makes record
+         * @param type Type
+         * @param body Body (at most `MAX_RECORD_LEN` bytes)
+         * @return Record
+         */
+        std::string makeRecord(RecordType type, const std::string &body)
+        {
+            std::string record;
+            record.reserve(RECORD_HDR_LEN + body.size());
+            record += static_cast<char>(type);
+            putLE(record, body.size(), 2);
+            record += body;
+            return record;
+        }
+
+        /**
+         * @brief Converts expiration to time remaining
+         * @param expiry Expiration (default value means none)
+         * @param now Current time
+         * @return Milliseconds remaining (0 if none, at least 1 otherwise)
+         */
+        uint32_t toRemaining(std::chrono::steady_clock::time_point expiry,
+                             std::chrono::steady_clock::time_point now)
+        {
+            if (expiry == std::chrono::steady_clock::time_point{}) {
+                return 0;
+            }
+
+            auto remaining =
+                std::chrono::ceil<std::chrono::milliseconds>(expiry - now)
+                    .count();
+            return std::clamp<int64_t>(remaining, 1,
+                                       std::numeric_limits<uint32_t>::max());
+        }
+
+        /**
+         * @brief Converts time remaining to expiration
+         * @param remaining Milliseconds remaining (0 if none)
+         * @param now Current time
+         * @return Expiration
+         */
+        std::chrono::steady_clock::time_point
+        fromRemaining(uint32_t remaining,
+                      std::chrono::steady_clock::time_point now)
+        {
+            if (remaining == 0) {
+                return {};
+            }
+            return now + std::chrono::milliseconds(remaining);
+        }
+
+        /**
+         * @brief Encodes session record body
+         * @param addr Address of client
+         * @param session Session
+         * @param now Current time
+         * @return Record body
+         */
+        std::string encodeSession(const LocalAddr &addr,
+                                  const PeerSession &session,
+                                  std::chrono::steady_clock::time_point now)
+        {
+            std::string body;
+            body.reserve(1 + addr.addr.size() + SESSION_LEN);
+            body += static_cast<char>(addr.addr.size());
+            body.append(addr.addr.begin(), addr.addr.end());
+            putLE(body, session.lastMsgId, 2);
+            putLE(body, session.msgIdWindow, 8);
+            putLE(body, static_cast<uint64_t>(session.tsDiff.count()), 8);
+            putLE(body, toRemaining(session.leaseExpiry, now), 4);
+            putLE(body, session.rxMsgs, 4);
+            putLE(body, session.txMsgs, 4);
+            putLE(body, session.failCnt, 2);
+            return body;
+        }
+
+        /**
+         * @brief Decodes session record body
+         * @param body Record body
+         * @param now Current time
+         * @param addr Address of client (modified in-place)
+         * @param session Session (modified in-place)
+         * @return true Decoded
+         * @return false Malformed body
+         */
+        bool decodeSession(const std::string &body,
+                           std::chrono::steady_clock::time_point now,
+                           LocalAddr &addr, PeerSession &session)
+        {
+            if (body.empty()) {
+                return false;
+            }
+
+            size_t addrLen = static_cast<uint8_t>(body[0]);
+            if (body.size() != 1 + addrLen + SESSION_LEN) {
+                return false;
+            }
+
+            addr.addr.assign(body.begin() + 1, body.begin() + 1 + addrLen);
+            size_t pos = 1 + addrLen;
+            session.lastMsgId = getLE(body, pos, 2);
+            session.msgIdWindow = getLE(body, pos, 8);
+            session.tsDiff = std::chrono::milliseconds(
+                static_cast<int64_t>(getLE(body, pos, 8)));
+            session.leaseExpiry = fromRemaining(getLE(body, pos, 4), now);
+            session.rxMsgs = getLE(body, pos, 4);
+            session.txMsgs = getLE(body, pos, 4);
+            session.failCnt = getLE(body, pos, 2);
+            return true;
+        }
+
+        /**
+         * @brief Encodes consumer ID
+         * @param consumer Consumer
+         * @return Record body
+         */
+        std::string encodeConsumer(SubLeaseTable::ConsumerId consumer)
+        {
+            std::string body;
+            putLE(body, consumer, 8);
+            return body;
+        }
+    } // namespace
+
+    void LoopbackReplicationChannel::connect(LoopbackReplicationChannel &a,
+                                             LoopbackReplicationChannel &b)
+    {
+        const std::scoped_lock lock(KVIK_SITE(a.m_mutex), KVIK_SITE(b.m_mutex));
+        a.m_peer = &b;
+        b.m_peer = &a;
+    }
+
+    void LoopbackReplicationChannel::setUp(bool up)
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        m_up = up;
+    }
+
+    ErrCode LoopbackReplicationChannel::send(const std::string &frame)
+    {
+        LoopbackReplicationChannel *peer;
+        {
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            if (m_peer == nullptr) {
+                return ErrCode::NOT_FOUND;
+            }
+            if (!m_up) {
+                return ErrCode::SUCCESS;
+            }
+            peer = m_peer;
+        }
+
+        if (peer->m_recvCb != nullptr) {
+            peer->m_recvCb(frame);
+        }
+        return ErrCode::SUCCESS;
+    }
+
+    GatewayReplicator::GatewayReplicator(Role role, IReplicationChannel *chan,
+                                         SubLeaseTable::UnsubCb unsubCb,
+                                         const Config &conf)
+        : m_conf{conf}, m_chan{chan}, m_role{role},
+          m_subs{conf.subLifetime,
+                 [this](const std::vector<std::string> &batch) {
+                     // Standby isn't subscribed upstream
+                     if (m_role == Role::ACTIVE) {
+                         m_unsubCb(batch);
+                     }
+                 },
+                 conf.unsubBatchSize, conf.leaseResolution},
+          m_unsubCb{unsubCb}
+    {
+        if (m_chan == nullptr) {
+            KVIK_THROW_EXC("Invalid replication channel");
+        }
+
+        if (!m_unsubCb) {
+            KVIK_THROW_EXC("Invalid unsubscription callback");
+        }
+
+        if (m_conf.heartbeat.count() <= 0 ||
+            m_conf.failoverTimeout <= m_conf.heartbeat) {
+            KVIK_THROW_EXC("Invalid heartbeat interval or failover timeout");
+        }
+
+        if (m_conf.maxFrameLen < MIN_FRAME_LEN) {
+            KVIK_THROW_EXC("Maximum frame length is too small");
+        }
+
+        m_chan->setRecvCb(
+            [this](const std::string &frame) { this->recv(frame); });
+    }
+
+    GatewayReplicator::~GatewayReplicator()
+    {
+        m_chan->setRecvCb(nullptr);
+    }
+
+    GatewayReplicator::Role GatewayReplicator::role() const
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        return m_role;
+    }
+
+    ErrCode GatewayReplicator::updateSession(const LocalAddr &addr,
+                                             const PeerSession &session)
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        if (m_role != Role::ACTIVE) {
+            return ErrCode::NOT_SUPPORTED;
+        }
+
+        PeerSession *value;
+        KVIK_RETURN_ERROR(m_sessions.getOrInsert(addr, value));
+        *value = session;
+        m_dirty.insert(addr);
+        return ErrCode::SUCCESS;
+    }
+
+    ErrCode GatewayReplicator::removeSession(const LocalAddr &addr)
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        if (m_role != Role::ACTIVE) {
+            return ErrCode::NOT_SUPPORTED;
+        }
+
+        if (!m_sessions.erase(addr)) {
+            return ErrCode::NOT_FOUND;
+        }
+
+        m_dirty.erase(addr);
+        m_records.push_back(makeRecord(
+            SESSION_DEL, std::string(addr.addr.begin(), addr.addr.end())));
+        return ErrCode::SUCCESS;
+    }
+
+    ErrCode GatewayReplicator::getSession(const LocalAddr &addr,
+                                          PeerSession &session) const
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        const PeerSession *value = m_sessions.find(addr);
+        if (value == nullptr) {
+            return ErrCode::NOT_FOUND;
+        }
+
+        session = *value;
+        return ErrCode::SUCCESS;
+    }
+
+    ErrCode GatewayReplicator::subscribe(
+        ConsumerId consumer, const std::string &filter,
+        std::chrono::steady_clock::time_point now, bool &newUpstream)
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        if (m_role != Role::ACTIVE) {
+            return ErrCode::NOT_SUPPORTED;
+        }
+
+        KVIK_RETURN_ERROR(m_subs.subscribe(consumer, filter, now, newUpstream));
+        this->queueSub(consumer, filter, now + m_conf.subLifetime, now);
+        return ErrCode::SUCCESS;
+    }
+
+    ErrCode GatewayReplicator::renewAll(
+        ConsumerId consumer, std::chrono::steady_clock::time_point now)
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        if (m_role != Role::ACTIVE) {
+            return ErrCode::NOT_SUPPORTED;
+        }
+
+        if (m_subs.renewAll(consumer, now) == 0) {
+            return ErrCode::NOT_FOUND;
+        }
+
+        m_records.push_back(makeRecord(RENEW_ALL, encodeConsumer(consumer)));
+        return ErrCode::SUCCESS;
+    }
+
+    ErrCode GatewayReplicator::unsubscribe(ConsumerId consumer,
+                                           const std::string &filter)
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        if (m_role != Role::ACTIVE) {
+            return ErrCode::NOT_SUPPORTED;
+        }
+
+        KVIK_RETURN_ERROR(m_subs.unsubscribe(consumer, filter));
+        m_records.push_back(
+            makeRecord(UNSUB, encodeConsumer(consumer) + filter));
+        return ErrCode::SUCCESS;
+    }
+
+    ErrCode GatewayReplicator::removeConsumer(ConsumerId consumer)
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        if (m_role != Role::ACTIVE) {
+            return ErrCode::NOT_SUPPORTED;
+        }
+
+        m_subs.removeConsumer(consumer);
+        m_records.push_back(makeRecord(CONSUMER_DEL, encodeConsumer(consumer)));
+        return ErrCode::SUCCESS;
+    }
+
+    void GatewayReplicator::match(const std::string &topic,
+                                  std::vector<ConsumerId> &consumers)
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        m_subs.match(topic, consumers);
+    }
+
+    ErrCode GatewayReplicator::flush(std::chrono::steady_clock::time_point now)
+    {
+        // Frames must be sent in order of their sequence numbers
+        const std::scoped_lock sendLock(KVIK_SITE(m_sendMutex));
+        std::vector<std::string> frames;
+        {
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            if (m_role != Role::ACTIVE) {
+                return ErrCode::SUCCESS;
+            }
+            this->buildFrames(now, false, frames);
+        }
+        return this->sendFrames(frames);
+    }
+
+    ErrCode GatewayReplicator::tick(std::chrono::steady_clock::time_point now)
+    {
+        const std::scoped_lock sendLock(KVIK_SITE(m_sendMutex));
+        std::vector<std::string> frames;
+        {
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            if (m_role == Role::ACTIVE) {
+                m_subs.tick(now);
+                if (m_snapshotRequested) {
+                    m_snapshotRequested = false;
+                    this->queueSnapshot(now);
+                }
+                this->buildFrames(now, now - m_lastTx >= m_conf.heartbeat,
+                                  frames);
+            } else {
+                this->applyInbox(now);
+
+                // Renewals may arrive late, leases expire after grace period
+                m_subs.tick(now - m_conf.failoverTimeout);
+
+                bool requestDue =
+                    m_lastSyncReq == std::chrono::steady_clock::time_point{} ||
+                    now - m_lastSyncReq >= (m_syncing ? m_conf.failoverTimeout
+                                                      : m_conf.heartbeat);
+                if (!m_synced && requestDue) {
+                    std::string frame;
+                    putLE(frame, 0, FRAME_HDR_LEN);
+                    frame += makeRecord(SYNC_REQ, "");
+                    frames.push_back(std::move(frame));
+                    m_lastSyncReq = now;
+                }
+            }
+        }
+        return this->sendFrames(frames);
+    }
+
+    bool GatewayReplicator::synced() const
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        return m_synced;
+    }
+
+    bool GatewayReplicator::activeLost(
+        std::chrono::steady_clock::time_point now) const
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        return m_role == Role::STANDBY && m_inbox.empty() &&
+               m_lastRx != std::chrono::steady_clock::time_point{} &&
+               now - m_lastRx > m_conf.failoverTimeout;
+    }
+
+    ErrCode GatewayReplicator::promote(std::vector<std::string> &upstream,
+                                       std::chrono::steady_clock::time_point now)
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        if (m_role == Role::ACTIVE) {
+            return ErrCode::NOT_SUPPORTED;
+        }
+
+        this->applyInbox(now);
+
+        // Still standby, so expired leases aren't unsubscribed upstream
+        m_subs.tick(now);
+        m_subs.upstreamFilters(upstream);
+
+        m_role = Role::ACTIVE;
+        m_records.clear();
+        m_dirty.clear();
+        m_snapshotRequested = false;
+        m_lastTx = {};
+
+        KVIK_LOGI("Promoted to active gateway (%zu sessions, %zu leases%s)",
+                  m_sessions.size(), m_subs.size(),
+                  m_synced ? "" : ", incomplete state");
+        return ErrCode::SUCCESS;
+    }
+
+    size_t GatewayReplicator::sessionCnt() const
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        return m_sessions.size();
+    }
+
+    size_t GatewayReplicator::subCnt() const
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        return m_subs.size();
+    }
+
+    void GatewayReplicator::recv(const std::string &frame)
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        if (m_role == Role::ACTIVE) {
+            // Only snapshot requests are expected from standby
+            if (frame.size() >= FRAME_HDR_LEN + RECORD_HDR_LEN &&
+                static_cast<uint8_t>(frame[FRAME_HDR_LEN]) == SYNC_REQ) {
+                m_snapshotRequested = true;
+            }
+            return;
+        }
+
+        if (m_inbox.size() >= MAX_INBOX_LEN) {
+            KVIK_LOGW("Too many replication frames pending, resynchronizing");
+            m_inbox.clear();
+            this->desync();
+        }
+        m_inbox.push_back(frame);
+    }
+
+    void GatewayReplicator::applyInbox(
+        std::chrono::steady_clock::time_point now)
+    {
+        if (m_inbox.empty()) {
+            return;
+        }
+        m_lastRx = now;
+
+        for (const auto &frame : m_inbox) {
+            if (frame.size() < FRAME_HDR_LEN) {
+                continue;
+            }
+
+            size_t pos = 0;
+            uint32_t seq = getLE(frame, pos, FRAME_HDR_LEN);
+            if (frame.size() > FRAME_HDR_LEN &&
+                static_cast<uint8_t>(frame[FRAME_HDR_LEN]) == SYNC_START) {
+                m_syncing = true;
+                m_synced = false;
+            } else if (!m_syncing && !m_synced) {
+                // Waiting for snapshot
+                continue;
+            } else if (seq != m_rxSeq) {
+                KVIK_LOGW("Missed replication frame (expected %" PRIu32
+                          ", got %" PRIu32 ")",
+                          m_rxSeq, seq);
+                this->desync();
+                continue;
+            }
+            m_rxSeq = seq + 1;
+
+            while (pos < frame.size()) {
+                if (frame.size() - pos < RECORD_HDR_LEN) {
+                    break;
+                }
+
+                uint8_t type = frame[pos++];
+                size_t len = getLE(frame, pos, 2);
+                if (len > frame.size() - pos ||
+                    !this->applyRecord(type, frame.substr(pos, len), now)) {
+                    break;
+                }
+                pos += len;
+            }
+
+            if (pos != frame.size()) {
+                KVIK_LOGE("Malformed replication frame %" PRIu32, seq);
+                this->desync();
+            }
+        }
+
+        m_inbox.clear();
+    }
+
+    void GatewayReplicator::desync()
+    {
+        // Stale state is kept until snapshot arrives, it's still better
+        // than nothing in case of failover
+        m_syncing = false;
+        m_synced = false;
+        m_lastSyncReq = {};
+    }
+
+    bool GatewayReplicator::applyRecord(
+        uint8_t type, const std::string &body,
+        std::chrono::steady_clock::time_point now)
+    {
+        size_t pos = 0;
+        bool newUpstream;
+        switch (type) {
+        case SYNC_START: {
+            m_sessions.clear();
+            std::vector<ConsumerId> consumers;
+            m_subs.forEach([&consumers](ConsumerId consumer,
+                                        const std::string &,
+                                        std::chrono::steady_clock::time_point) {
+                consumers.push_back(consumer);
+            });
+            for (auto consumer : consumers) {
+                m_subs.removeConsumer(consumer);
+            }
+            return true;
+        }
+
+        case SYNC_END:
+            m_syncing = false;
+            m_synced = true;
+            KVIK_LOGI("Replica synchronized (%zu sessions, %zu leases)",
+                      m_sessions.size(), m_subs.size());
+            return true;
+
+        case SESSION: {
+            LocalAddr addr;
+            PeerSession session;
+            PeerSession *value;
+            if (!decodeSession(body, now, addr, session) ||
+                m_sessions.getOrInsert(addr, value) != ErrCode::SUCCESS) {
+                return false;
+            }
+            *value = session;
+            return true;
+        }
+
+        case SESSION_DEL:
+            m_sessions.erase(LocalAddr{{body.begin(), body.end()}});
+            return true;
+
+        case SUB: {
+            if (body.size() < SUB_HDR_LEN) {
+                return false;
+            }
+            ConsumerId consumer = getLE(body, pos, 8);
+            uint32_t remaining = getLE(body, pos, 4);
+            return m_subs.subscribeUntil(consumer, body.substr(pos),
+                                         fromRemaining(remaining, now),
+                                         newUpstream) == ErrCode::SUCCESS;
+        }
+
+        case UNSUB:
+            if (body.size() < 8) {
+                return false;
+            }
+            m_subs.unsubscribe(getLE(body, pos, 8), body.substr(8));
+            return true;
+
+        case CONSUMER_DEL:
+            if (body.size() != 8) {
+                return false;
+            }
+            m_subs.removeConsumer(getLE(body, pos, 8));
+            return true;
+
+        case RENEW_ALL:
+            if (body.size() != 8) {
+                return false;
+            }
+            m_subs.renewAll(getLE(body, pos, 8), now);
+            return true;
+
+        default:
+            // Unknown records are skipped (newer active gateway)
+            return true;
+        }
+    }
+
+    void GatewayReplicator::queueSub(
+        ConsumerId consumer, const std::string &filter,
+        std::chrono::steady_clock::time_point expiry,
+        std::chrono::steady_clock::time_point now)
+    {
+        if (SUB_HDR_LEN + filter.size() > MAX_RECORD_LEN) {
+            KVIK_LOGW("Filter too long to be replicated");
+            return;
+        }
+
+        std::string body = encodeConsumer(consumer);
+        putLE(body, toRemaining(expiry, now), 4);
+        body += filter;
+        m_records.push_back(makeRecord(SUB, body));
+    }
+
+    void GatewayReplicator::queueSnapshot(
+        std::chrono::steady_clock::time_point now)
+    {
+        // Snapshot supersedes all queued deltas
+        m_records.clear();
+        m_dirty.clear();
+
+        m_records.push_back(makeRecord(SYNC_START, ""));
+        m_sessions.forEach([this, now](const LocalAddr &addr,
+                                       PeerSession &session) {
+            m_records.push_back(
+                makeRecord(SESSION, encodeSession(addr, session, now)));
+        });
+        m_subs.forEach([this, now](ConsumerId consumer,
+                                   const std::string &filter,
+                                   std::chrono::steady_clock::time_point expiry) {
+            this->queueSub(consumer, filter, expiry, now);
+        });
+        m_records.push_back(makeRecord(SYNC_END, ""));
+
+        KVIK_LOGI("Sending snapshot to standby (%zu sessions, %zu leases)",
+                  m_sessions.size(), m_subs.size());
+    }
+
+    void GatewayReplicator::buildFrames(
+        std::chrono::steady_clock::time_point now, bool heartbeat,
+        std::vector<std::string> &frames)
+    {
+        frames.clear();
+        for (const auto &addr : m_dirty) {
+            const PeerSession *session = m_sessions.find(addr);
+            if (session != nullptr) {
+                m_records.push_back(
+                    makeRecord(SESSION, encodeSession(addr, *session, now)));
+            }
+        }
+        m_dirty.clear();
+
+        if (m_records.empty() && !heartbeat) {
+            return;
+        }
+
+        std::string frame;
+        putLE(frame, m_txSeq++, FRAME_HDR_LEN);
+        for (const auto &record : m_records) {
+            if (frame.size() > FRAME_HDR_LEN &&
+                frame.size() + record.size() > m_conf.maxFrameLen) {
+                frames.push_back(std::move(frame));
+                frame.clear();
+                putLE(frame, m_txSeq++, FRAME_HDR_LEN);
+            }
+            frame += record;
+        }
+        frames.push_back(std::move(frame));
+
+        m_records.clear();
+        m_lastTx = now;
+    }
+
+    ErrCode GatewayReplicator::sendFrames(const std::vector<std::string> &frames)
+    {
+        for (const auto &frame : frames) {
+            KVIK_RETURN_ERROR(m_chan->send(frame));
+        }
+        return ErrCode::SUCCESS;
+    }
+} // namespace kvik
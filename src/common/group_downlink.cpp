@@ -0,0 +1,207 @@
+/**
+ * @file group_downlink.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Group-addressed downlink of subscription data
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "kvik/group_downlink.hpp"
+#include "kvik/hash.hpp"
+#include "kvik/logger.hpp"
+
+// Log tag
+static const char *KVIK_LOG_TAG = "Kvik/GroupDownlink";
+
+namespace kvik
+{
+    GroupDownlink::GroupDownlink(size_t minRecipients, size_t historyLen)
+        : m_minRecipients{minRecipients}, m_historyLen{historyLen}
+    {
+        if (m_minRecipients < 2) {
+            KVIK_THROW_EXC("Group data need at least 2 recipients");
+        }
+    }
+
+    void GroupDownlink::enqueue(const LocalAddr &addr, uint16_t groupIdx,
+                                const SubData &data)
+    {
+        LocalMsg unicast;
+        unicast.type = LocalMsgType::SUB_DATA;
+        unicast.addr = addr;
+        unicast.subsData = {data};
+
+        if (groupIdx == GROUP_IDX_NONE) {
+            m_unicasts.push_back(std::move(unicast));
+            return;
+        }
+
+        uint64_t hash = fnv1a64(data.topic);
+        hash = fnv1a64(data.payload.data(), data.payload.size(), hash);
+
+        auto it = m_pendingIdxs.find(hash);
+        if (it != m_pendingIdxs.end()) {
+            auto &pending = m_pending[it->second];
+            if (pending.data == data &&
+                !groupRecipientsHas(pending.recipients, groupIdx)) {
+                groupRecipientsSet(pending.recipients, groupIdx);
+                pending.addrs.push_back(addr);
+                return;
+            }
+
+            // Hash collision or duplicate data for the same client
+            m_unicasts.push_back(std::move(unicast));
+            return;
+        }
+
+        Pending pending = {
+            .data = data,
+            .hash = hash,
+            .recipients = {},
+            .addrs = {addr},
+        };
+        groupRecipientsSet(pending.recipients, groupIdx);
+        m_pendingIdxs[hash] = m_pending.size();
+        m_pending.push_back(std::move(pending));
+    }
+
+    std::vector<LocalMsg> GroupDownlink::build()
+    {
+        std::vector<LocalMsg> msgs;
+
+        for (auto &pending : m_pending) {
+            if (pending.addrs.size() < m_minRecipients) {
+                // Not worth grouping
+                for (const auto &addr : pending.addrs) {
+                    msgs.emplace_back();
+                    msgs.back().type = LocalMsgType::SUB_DATA;
+                    msgs.back().addr = addr;
+                    msgs.back().subsData = {pending.data};
+                }
+                continue;
+            }
+
+            uint16_t seq = m_nextSeq++;
+            KVIK_LOGD("Grouping data for %zu clients (seq %u): %s",
+                      pending.addrs.size(), seq,
+                      pending.data.toString().c_str());
+
+            LocalMsg msg;
+            msg.type = LocalMsgType::SUB_DATA;
+            msg.subsData = {pending.data};
+            msg.groupRecipients = pending.recipients;
+            msg.groupSeq = seq;
+            msgs.push_back(std::move(msg));
+
+            // Remember for retransmissions
+            m_history.push_back({
+                .seq = seq,
+                .data = std::move(pending.data),
+                .recipients = std::move(pending.recipients),
+                .acked = {},
+            });
+            if (m_history.size() > m_historyLen) {
+                m_history.pop_front();
+            }
+        }
+
+        msgs.insert(msgs.end(), std::make_move_iterator(m_unicasts.begin()),
+                    std::make_move_iterator(m_unicasts.end()));
+
+        m_pending.clear();
+        m_pendingIdxs.clear();
+        m_unicasts.clear();
+
+        return msgs;
+    }
+
+    ErrCode GroupDownlink::attach(LocalMsg &resp)
+    {
+        if (resp.type != LocalMsgType::PROBE_RES ||
+            resp.groupIdx == GROUP_IDX_NONE) {
+            return ErrCode::INVALID_ARG;
+        }
+
+        resp.groupSeq = static_cast<uint16_t>(m_nextSeq - 1);
+        m_syncPoints[resp.groupIdx] = resp.groupSeq;
+        return ErrCode::SUCCESS;
+    }
+
+    void GroupDownlink::processAck(uint16_t groupIdx, const LocalMsg &msg)
+    {
+        for (auto &entry : m_history) {
+            if (!seqBefore(msg.groupSeq, entry.seq) &&
+                !this->beforeSync(groupIdx, entry.seq) &&
+                groupRecipientsHas(entry.recipients, groupIdx)) {
+                groupRecipientsSet(entry.acked, groupIdx);
+            }
+        }
+    }
+
+    ErrCode GroupDownlink::processNack(const LocalAddr &addr,
+                                       uint16_t groupIdx, const LocalMsg &msg,
+                                       std::vector<LocalMsg> &msgs)
+    {
+        if (msg.type != LocalMsgType::FAIL ||
+            msg.failReason != LocalMsgFailReason::GROUP_SEQ_GAP) {
+            return ErrCode::INVALID_ARG;
+        }
+
+        // Retransmit everything unacknowledged since first missing data
+        bool firstFound = false;
+        for (const auto &entry : m_history) {
+            if (seqBefore(entry.seq, msg.groupSeq)) {
+                continue;
+            }
+
+            firstFound |= entry.seq == msg.groupSeq;
+            if (!this->beforeSync(groupIdx, entry.seq) &&
+                groupRecipientsHas(entry.recipients, groupIdx) &&
+                !groupRecipientsHas(entry.acked, groupIdx)) {
+                // Keep sequence number, so client can discard duplicates
+                LocalMsg retransmit;
+                retransmit.type = LocalMsgType::SUB_DATA;
+                retransmit.addr = addr;
+                retransmit.subsData = {entry.data};
+                groupRecipientsSet(retransmit.groupRecipients, groupIdx);
+                retransmit.groupSeq = entry.seq;
+                msgs.push_back(std::move(retransmit));
+            }
+        }
+
+        if (!firstFound && seqBefore(msg.groupSeq, m_nextSeq)) {
+            KVIK_LOGW("Group data seq %u no longer in history",
+                      msg.groupSeq);
+            return ErrCode::NOT_FOUND;
+        }
+
+        return ErrCode::SUCCESS;
+    }
+
+    ErrCode GroupDownlink::unacked(uint16_t seq,
+                                   std::vector<uint16_t> &groupIdxs) const
+    {
+        for (const auto &entry : m_history) {
+            if (entry.seq != seq) {
+                continue;
+            }
+
+            for (size_t i = 0; i < entry.recipients.size() * 8; i++) {
+                if (groupRecipientsHas(entry.recipients, i) &&
+                    !groupRecipientsHas(entry.acked, i)) {
+                    groupIdxs.push_back(i);
+                }
+            }
+            return ErrCode::SUCCESS;
+        }
+
+        return ErrCode::NOT_FOUND;
+    }
+
+    bool GroupDownlink::beforeSync(uint16_t groupIdx, uint16_t seq) const
+    {
+        auto it = m_syncPoints.find(groupIdx);
+        return it != m_syncPoints.end() && !seqBefore(it->second, seq);
+    }
+} // namespace kvik
@@ -7,6 +7,8 @@
  *
  */
 
+#include <algorithm>
+#include <cinttypes>
 #include <mutex>
 
 #include "kvik/local_broker.hpp"
@@ -17,7 +19,7 @@ static const char *KVIK_LOG_TAG = "Kvik/LocalBroker";
 
 namespace kvik
 {
-    LocalBroker::LocalBroker()
+    LocalBroker::LocalBroker(SharedSubIndex::Policy policy) : m_subs{policy}
     {
         KVIK_LOGD("Initialized");
     }
@@ -32,41 +34,107 @@ namespace kvik
         KVIK_LOGD("Publishing %zu bytes to topic '%s'",
                   data.payload.length(), data.topic.c_str());
 
-        // Check if node is subscribed to this topic
-        bool subscribed;
+        // Find subscribed consumers
+        std::vector<ConsumerId> consumers, selected;
+        std::vector<RecvCb> cbs;
         {
-            const std::scoped_lock lock(m_mutex);
-            subscribed = !m_subs.find(data.topic).empty();
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            m_subs.match(data.topic, consumers, &selected);
+            for (auto consumer : consumers) {
+                if (consumer == NODE_CONSUMER) {
+                    cbs.push_back(m_recvCb);
+                } else {
+                    auto it = m_consumers.find(consumer);
+                    cbs.push_back(it != m_consumers.end() ? it->second
+                                                          : nullptr);
+                }
+            }
         }
 
-        if (subscribed && m_recvCb != nullptr)
-        {
-            KVIK_LOGD("Subscription exists for published data, calling "
-                      "callback on topic '%s'",
-                      data.topic.c_str());
+        if (consumers.empty()) {
+            return ErrCode::SUCCESS;
+        }
 
-            // Send data back as received
-            KVIK_RETURN_ERROR(m_recvCb(data.toSubData()));
+        KVIK_LOGD("%zu subscriptions exist for published data, calling "
+                  "callbacks on topic '%s'",
+                  consumers.size(), data.topic.c_str());
+
+        // Send data back as received
+        ErrCode ret = ErrCode::SUCCESS;
+        SubData subData = data.toSubData();
+        for (size_t i = 0; i < consumers.size(); i++) {
+            if (cbs[i] != nullptr) {
+                ErrCode res = cbs[i](subData);
+                if (res != ErrCode::SUCCESS) {
+                    ret = res;
+                }
+            }
+
+            // Consumer selected from group is done with the message
+            if (std::find(selected.begin(), selected.end(), consumers[i]) !=
+                selected.end()) {
+                const std::scoped_lock lock(KVIK_SITE(m_mutex));
+                m_subs.release(consumers[i]);
+            }
         }
 
-        return ErrCode::SUCCESS;
+        return ret;
     }
 
     ErrCode LocalBroker::subscribe(const std::string &topic)
     {
-        const std::scoped_lock lock(m_mutex);
+        return this->subscribe(NODE_CONSUMER, topic);
+    }
 
-        KVIK_LOGD("Subscribe to topic '%s'", topic.c_str());
+    ErrCode LocalBroker::unsubscribe(const std::string &topic)
+    {
+        return this->unsubscribe(NODE_CONSUMER, topic);
+    }
+
+    LocalBroker::ConsumerId LocalBroker::addConsumer(RecvCb cb)
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+
+        ConsumerId consumer = m_nextConsumer++;
+        m_consumers[consumer] = cb;
+
+        KVIK_LOGD("Added consumer %" PRIu64, consumer);
+        return consumer;
+    }
+
+    ErrCode LocalBroker::removeConsumer(ConsumerId consumer)
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+
+        if (m_consumers.erase(consumer) == 0) {
+            return ErrCode::NOT_FOUND;
+        }
+        m_subs.removeConsumer(consumer);
 
-        m_subs.insert(topic, true);
+        KVIK_LOGD("Removed consumer %" PRIu64, consumer);
         return ErrCode::SUCCESS;
     }
 
-    ErrCode LocalBroker::unsubscribe(const std::string &topic)
+    ErrCode LocalBroker::subscribe(ConsumerId consumer,
+                                   const std::string &topic)
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+
+        if (consumer != NODE_CONSUMER && m_consumers.count(consumer) == 0) {
+            return ErrCode::NOT_FOUND;
+        }
+
+        KVIK_LOGD("Subscribe to topic '%s'", topic.c_str());
+
+        return m_subs.subscribe(consumer, topic);
+    }
+
+    ErrCode LocalBroker::unsubscribe(ConsumerId consumer,
+                                     const std::string &topic)
     {
-        const std::scoped_lock lock(m_mutex);
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
 
-        if (!m_subs.remove(topic))
+        if (m_subs.unsubscribe(consumer, topic) != ErrCode::SUCCESS)
         {
             KVIK_LOGD("Unsubscribe from topic '%s': subscription doesn't exist",
                       topic.c_str());
@@ -48,6 +48,8 @@ namespace kvik
             return "PROCESSING_FAILED";
         case LocalMsgFailReason::UNKNOWN_SENDER:
             return "UNKNOWN_SENDER";
+        case LocalMsgFailReason::GROUP_SEQ_GAP:
+            return "GROUP_SEQ_GAP";
         default:
             return "???";
         }
@@ -61,7 +63,15 @@ namespace kvik
                pubs == other.pubs &&
                subs == other.subs &&
                unsubs == other.unsubs &&
-               subsData == other.subsData;
+               subsData == other.subsData &&
+               subsDigest == other.subsDigest &&
+               groupIdx == other.groupIdx &&
+               groupRecipients == other.groupRecipients &&
+               groupSeq == other.groupSeq &&
+               deltaPayloads == other.deltaPayloads &&
+               piggybackAck == other.piggybackAck &&
+               piggybackAckId == other.piggybackAckId &&
+               uplinkSlot == other.uplinkSlot;
     }
 
     bool LocalMsg::operator!=(const LocalMsg &other) const
@@ -76,13 +86,42 @@ namespace kvik
                            (!relayedAddr.empty() ? " " + relayedAddr.toString() : "");
 
         switch (type) {
+        case LocalMsgType::OK:
+            if (!subsData.empty()) {
+                base += " | ";
+                for (const auto &d : subsData) {
+                    base += d.toString() + ", ";
+                }
+
+                // Remove last ", "
+                base.erase(base.size() - 2);
+            }
+            if (uplinkSlot.assigned()) {
+                base += (subsData.empty() ? " | slot " : ", slot ") +
+                        uplinkSlot.toString();
+            }
+            return base;
         case LocalMsgType::FAIL:
             return base + " | failed due to " +
-                   localMsgFailReasonToStr(failReason);
+                   localMsgFailReasonToStr(failReason) +
+                   (failReason == LocalMsgFailReason::GROUP_SEQ_GAP
+                        ? " (seq " + std::to_string(groupSeq) + ")"
+                        : "");
         case LocalMsgType::PROBE_RES:
-            return base + " | pref " + std::to_string(pref);
+            return base + " | pref " + std::to_string(pref) +
+                   (subsDigestMatch ? ", digest match" : "") +
+                   (groupIdx != GROUP_IDX_NONE
+                        ? ", group idx " + std::to_string(groupIdx) +
+                              " (seq " + std::to_string(groupSeq) + ")"
+                        : "") +
+                   (uplinkSlot.assigned()
+                        ? ", slot " + uplinkSlot.toString()
+                        : "");
         case LocalMsgType::PUB_SUB_UNSUB:
             base += " | ";
+            if (deltaPayloads) {
+                base += "DELTA, ";
+            }
             for (const auto &p : pubs) {
                 base += "PUB " + p.toString() + ", ";
             }
@@ -92,6 +131,12 @@ namespace kvik
             for (const auto &u : unsubs) {
                 base += "UNSUB " + u + ", ";
             }
+            if (!subsDigest.empty()) {
+                base += "DIGEST " + subsDigest.toString() + ", ";
+            }
+            if (piggybackAck) {
+                base += "ACK " + std::to_string(piggybackAckId) + ", ";
+            }
 
             // Remove last ", "
             base.erase(base.size() - 2);
@@ -99,6 +144,12 @@ namespace kvik
             return base;
         case LocalMsgType::SUB_DATA:
             base += " | ";
+            if (!groupRecipients.empty()) {
+                base += "GROUP seq " + std::to_string(groupSeq) + ", ";
+            }
+            if (deltaPayloads) {
+                base += "DELTA, ";
+            }
             for (const auto &d : subsData) {
                 base += d.toString() + ", ";
             }
@@ -0,0 +1,419 @@
+/**
+ * @file multi_link_layer.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Client local layer using multiple links to gateway
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <algorithm>
+#include <mutex>
+
+#include "kvik/errors.hpp"
+#include "kvik/logger.hpp"
+#include "kvik/multi_link_layer.hpp"
+
+// Log tag
+static const char *KVIK_LOG_TAG = "Kvik/MultiLinkLayer";
+
+namespace kvik
+{
+    namespace
+    {
+        /**
+         * @brief Checks whether gateway is expected to respond to message
+         * @param msg Message
+         * @return true Message is request
+         * @return false Message isn't request
+         */
+        bool isRequest(const LocalMsg &msg)
+        {
+            return msg.type == LocalMsgType::PROBE_REQ ||
+                   msg.type == LocalMsgType::PUB_SUB_UNSUB;
+        }
+
+        /**
+         * @brief Updates smoothed round trip time with new sample
+         * @param state Link state (modified in-place)
+         * @param sample Measured round trip time
+         * @param first Whether this is first sample
+         */
+        void updateRtt(MultiLinkLayer::LinkState &state,
+                       std::chrono::microseconds sample, bool first)
+        {
+            state.rtt = first ? sample : (state.rtt * 7 + sample) / 8;
+        }
+    } // namespace
+
+    MultiLinkLayer::MultiLinkLayer(const std::vector<LinkConfig> &links,
+                                   MultiLinkLayerConfig conf)
+        : m_conf{conf}
+    {
+        if (links.empty()) {
+            KVIK_THROW_EXC("No links");
+        }
+
+        if (m_conf.failThres == 0) {
+            KVIK_THROW_EXC("Failure threshold can't be 0");
+        }
+
+        for (const auto &link : links) {
+            if (link.ll == nullptr) {
+                KVIK_THROW_EXC("Invalid local layer parameter");
+            }
+        }
+
+        for (const auto &link : links) {
+            m_links.push_back({.conf = link});
+        }
+
+        for (size_t i = 0; i < m_links.size(); i++) {
+            m_links[i].conf.ll->setRecvCb(std::bind(
+                &MultiLinkLayer::recvFrom, this, i, std::placeholders::_1));
+        }
+
+        KVIK_LOGD("Initialized with %zu links", m_links.size());
+    }
+
+    MultiLinkLayer::~MultiLinkLayer()
+    {
+        for (auto &link : m_links) {
+            link.conf.ll->setRecvCb(nullptr);
+        }
+
+        KVIK_LOGD("Deinitialized");
+    }
+
+    ErrCode MultiLinkLayer::send(const LocalMsg &msg)
+    {
+        if (msg.addr.empty()) {
+            // Broadcast over all links
+            {
+                const std::scoped_lock lock(KVIK_SITE(m_mutex));
+                this->expirePending();
+                if (msg.type == LocalMsgType::PROBE_REQ) {
+                    // Gateway discovery, look for new endpoints
+                    m_dscvId = msg.id;
+                    m_dscvIdValid = true;
+                    m_dscvSent = Clock::now();
+                    for (auto &link : m_links) {
+                        link.gwFresh = false;
+                    }
+                }
+            }
+
+            ErrCode ret = ErrCode::NOT_FOUND;
+            for (size_t i = 0; i < m_links.size(); i++) {
+                ErrCode err = m_links[i].conf.ll->send(msg);
+                if (err == ErrCode::SUCCESS) {
+                    ret = ErrCode::SUCCESS;
+                    continue;
+                }
+
+                KVIK_LOGW("Broadcast over link %zu failed", i);
+                const std::scoped_lock lock(KVIK_SITE(m_mutex));
+                this->linkFailed(i, true);
+                if (ret != ErrCode::SUCCESS) {
+                    ret = err;
+                }
+            }
+            return ret;
+        }
+
+        auto airtimes = this->estimateAirtimes(msg);
+
+        bool toGw;
+        std::vector<size_t> order;
+        {
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            this->expirePending();
+
+            toGw = msg.addr == m_sessionAddr;
+            for (const auto &link : m_links) {
+                if (link.state.gw == msg.addr) {
+                    toGw = true;
+                    m_sessionAddr = msg.addr;
+                }
+            }
+
+            if (toGw) {
+                order = this->rankLinks(airtimes);
+
+                // Responses go back over link the gateway was heard on
+                auto lastRx =
+                    std::find(order.begin(), order.end(), m_lastRxLink);
+                if ((msg.type == LocalMsgType::OK ||
+                     msg.type == LocalMsgType::FAIL) &&
+                    lastRx != order.end()) {
+                    std::rotate(order.begin(), lastRx, lastRx + 1);
+                }
+            } else {
+                // Unknown destination, try links in fallback order
+                for (size_t i = 0; i < m_links.size(); i++) {
+                    order.push_back(i);
+                }
+            }
+        }
+
+        if (order.empty()) {
+            KVIK_LOGD("No link available for %s",
+                      msg.addr.toString().c_str());
+            return ErrCode::NOT_FOUND;
+        }
+
+        ErrCode err = ErrCode::NOT_FOUND;
+        for (auto idx : order) {
+            auto &link = m_links[idx];
+
+            LocalMsg linkMsg = msg;
+            if (toGw) {
+                const std::scoped_lock lock(KVIK_SITE(m_mutex));
+                linkMsg.addr = link.state.gw;
+            }
+
+            err = link.conf.ll->send(linkMsg);
+
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            if (err != ErrCode::SUCCESS) {
+                KVIK_LOGW("Send over link %zu failed, trying next link", idx);
+                this->linkFailed(idx, true);
+                continue;
+            }
+
+            if (!link.state.up) {
+                // Trial of link which is down, next one after interval
+                link.retryAt = Clock::now() + m_conf.retryInterval;
+            }
+
+            if (isRequest(msg)) {
+                m_pending[msg.id] = {.link = idx, .sent = Clock::now()};
+            }
+            m_lastTxId = msg.id;
+            m_lastTxLink = idx;
+            return ErrCode::SUCCESS;
+        }
+
+        return err;
+    }
+
+    const ILocalLayer::Channels &MultiLinkLayer::getChannels()
+    {
+        return m_channels;
+    }
+
+    ErrCode MultiLinkLayer::setChannel(uint16_t)
+    {
+        return ErrCode::NOT_SUPPORTED;
+    }
+
+    std::chrono::microseconds MultiLinkLayer::estimateAirtime(
+        const LocalMsg &msg)
+    {
+        if (msg.addr.empty()) {
+            std::chrono::microseconds airtime{0};
+            for (auto &link : m_links) {
+                airtime += link.conf.ll->estimateAirtime(msg);
+            }
+            return airtime;
+        }
+
+        {
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            if (msg.id == m_lastTxId) {
+                return m_links[m_lastTxLink].conf.ll->estimateAirtime(msg);
+            }
+        }
+
+        size_t idx;
+        if (this->selectLink(msg, idx) != ErrCode::SUCCESS) {
+            return std::chrono::microseconds(0);
+        }
+
+        return m_links[idx].conf.ll->estimateAirtime(msg);
+    }
+
+    void MultiLinkLayer::setPolicy(LinkPolicy policy)
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        m_conf.policy = policy;
+    }
+
+    size_t MultiLinkLayer::linkCnt() const
+    {
+        return m_links.size();
+    }
+
+    ErrCode MultiLinkLayer::getLinkState(size_t idx, LinkState &state)
+    {
+        if (idx >= m_links.size()) {
+            return ErrCode::INVALID_ARG;
+        }
+
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        state = m_links[idx].state;
+        return ErrCode::SUCCESS;
+    }
+
+    ErrCode MultiLinkLayer::selectLink(const LocalMsg &msg, size_t &idx)
+    {
+        auto airtimes = this->estimateAirtimes(msg);
+
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        auto order = this->rankLinks(airtimes);
+        if (order.empty()) {
+            return ErrCode::NOT_FOUND;
+        }
+
+        idx = order.front();
+        return ErrCode::SUCCESS;
+    }
+
+    ErrCode MultiLinkLayer::recvFrom(size_t idx, LocalMsg msg)
+    {
+        {
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            this->expirePending();
+
+            auto &link = m_links[idx];
+            auto now = Clock::now();
+            bool dscvResp = false;
+
+            if (msg.type == LocalMsgType::PROBE_RES && m_dscvIdValid &&
+                msg.reqId == m_dscvId) {
+                // Response to gateway discovery
+                dscvResp = true;
+                updateRtt(link.state,
+                          std::chrono::duration_cast<std::chrono::microseconds>(
+                              now - m_dscvSent),
+                          !link.gwFresh);
+                if (!link.gwFresh || msg.pref > link.gwPref) {
+                    link.state.gw = msg.addr;
+                    link.gwPref = msg.pref;
+                    link.gwFresh = true;
+                }
+            } else if (msg.type == LocalMsgType::OK ||
+                       msg.type == LocalMsgType::FAIL ||
+                       msg.type == LocalMsgType::PROBE_RES) {
+                auto it = m_pending.find(msg.reqId);
+                if (it != m_pending.end() && it->second.link == idx) {
+                    bool first = false;
+                    if (msg.type == LocalMsgType::PROBE_RES &&
+                        link.state.gw.empty()) {
+                        // Gateway reached without discovery (e.g. retained)
+                        link.state.gw = msg.addr;
+                        link.gwPref = msg.pref;
+                        first = true;
+                    }
+
+                    updateRtt(link.state,
+                              std::chrono::duration_cast<
+                                  std::chrono::microseconds>(
+                                  now - it->second.sent),
+                              first);
+                    m_pending.erase(it);
+                }
+            }
+
+            if (!link.state.gw.empty() && msg.addr == link.state.gw) {
+                if (!link.state.up) {
+                    KVIK_LOGI("Link %zu is up", idx);
+                }
+                link.state.up = true;
+                link.state.failCnt = 0;
+                m_lastRxLink = idx;
+
+                // Present endpoint as gateway client talks to
+                if (!dscvResp && !m_sessionAddr.empty()) {
+                    msg.addr = m_sessionAddr;
+                }
+            }
+        }
+
+        auto cb = m_recvCb;
+        if (cb == nullptr) {
+            return ErrCode::SUCCESS;
+        }
+        return cb(msg);
+    }
+
+    std::vector<size_t> MultiLinkLayer::rankLinks(
+        const std::vector<std::chrono::microseconds> &airtimes)
+    {
+        auto now = Clock::now();
+
+        std::vector<size_t> order;
+        for (size_t i = 0; i < m_links.size(); i++) {
+            const auto &link = m_links[i];
+            if (!link.state.gw.empty() &&
+                (link.state.up || now >= link.retryAt)) {
+                order.push_back(i);
+            }
+        }
+
+        switch (m_conf.policy) {
+        case LinkPolicy::FALLBACK:
+            break;
+        case LinkPolicy::LOWEST_LATENCY:
+            std::stable_sort(order.begin(), order.end(),
+                             [this](size_t a, size_t b) {
+                                 return m_links[a].state.rtt <
+                                        m_links[b].state.rtt;
+                             });
+            break;
+        case LinkPolicy::LOWEST_ENERGY:
+            std::stable_sort(order.begin(), order.end(),
+                             [this, &airtimes](size_t a, size_t b) {
+                                 return m_links[a].conf.txPower *
+                                            airtimes[a].count() <
+                                        m_links[b].conf.txPower *
+                                            airtimes[b].count();
+                             });
+            break;
+        }
+
+        return order;
+    }
+
+    std::vector<std::chrono::microseconds> MultiLinkLayer::estimateAirtimes(
+        const LocalMsg &msg)
+    {
+        std::vector<std::chrono::microseconds> airtimes;
+        for (auto &link : m_links) {
+            // Unknown airtime is compared by transmission power only
+            airtimes.push_back(std::max(link.conf.ll->estimateAirtime(msg),
+                                        std::chrono::microseconds(1)));
+        }
+        return airtimes;
+    }
+
+    void MultiLinkLayer::linkFailed(size_t idx, bool down)
+    {
+        auto &link = m_links[idx];
+        link.state.failCnt++;
+
+        if (down || link.state.failCnt >= m_conf.failThres) {
+            if (link.state.up) {
+                KVIK_LOGW("Link %zu is down", idx);
+            }
+            link.state.up = false;
+            link.retryAt = Clock::now() + m_conf.retryInterval;
+        }
+    }
+
+    void MultiLinkLayer::expirePending()
+    {
+        auto now = Clock::now();
+        for (auto it = m_pending.begin(); it != m_pending.end();) {
+            if (now - it->second.sent < m_conf.respTimeout) {
+                it++;
+                continue;
+            }
+
+            KVIK_LOGD("Request (id=%u) over link %zu not answered", it->first,
+                      it->second.link);
+            this->linkFailed(it->second.link, false);
+            it = m_pending.erase(it);
+        }
+    }
+} // namespace kvik
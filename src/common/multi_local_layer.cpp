@@ -0,0 +1,285 @@
+/**
+ * @file multi_local_layer.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Local layer aggregating multiple local layers
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <mutex>
+#include <thread>
+
+#include "kvik/errors.hpp"
+#include "kvik/logger.hpp"
+#include "kvik/multi_local_layer.hpp"
+
+// Log tag
+static const char *KVIK_LOG_TAG = "Kvik/MultiLocalLayer";
+
+namespace kvik
+{
+    MultiLocalLayer::MultiLocalLayer(const std::vector<ILocalLayer *> &layers,
+                                     size_t maxQueueLen, size_t maxRoutes)
+        : m_maxQueueLen{maxQueueLen}, m_maxRoutes{maxRoutes}
+    {
+        if (layers.empty()) {
+            KVIK_THROW_EXC("No local layers");
+        }
+
+        if (m_maxQueueLen == 0) {
+            KVIK_THROW_EXC("Queue length can't be 0");
+        }
+
+        if (m_maxRoutes == 0) {
+            KVIK_THROW_EXC("Routing table size can't be 0");
+        }
+
+        for (auto ll : layers) {
+            if (ll == nullptr) {
+                KVIK_THROW_EXC("Invalid local layer parameter");
+            }
+        }
+
+        // All members must exist before any of them can deliver a frame
+        for (auto ll : layers) {
+            auto member = std::make_unique<Member>();
+            member->ll = ll;
+            m_members.push_back(std::move(member));
+        }
+
+        for (size_t i = 0; i < m_members.size(); i++) {
+            auto &member = *m_members[i];
+            member.sendThread = std::thread(&MultiLocalLayer::sendThread,
+                                            this, std::ref(member));
+            member.recvThread = std::thread(&MultiLocalLayer::recvThread,
+                                            this, std::ref(member));
+            member.ll->setRecvCb(std::bind(&MultiLocalLayer::recvFrom, this,
+                                           i, std::placeholders::_1));
+        }
+
+        KVIK_LOGD("Initialized with %zu layers", m_members.size());
+    }
+
+    MultiLocalLayer::~MultiLocalLayer()
+    {
+        for (auto &member : m_members) {
+            member->ll->setRecvCb(nullptr);
+            {
+                const std::scoped_lock lock(KVIK_SITE(member->mutex));
+                member->run = false;
+            }
+            member->sendCv.notify_all();
+            member->recvCv.notify_all();
+            member->idleCv.notify_all();
+        }
+
+        for (auto &member : m_members) {
+            member->sendThread.join();
+            member->recvThread.join();
+        }
+
+        KVIK_LOGD("Deinitialized");
+    }
+
+    ErrCode MultiLocalLayer::send(const LocalMsg &msg)
+    {
+        if (msg.addr.empty()) {
+            // Broadcast over all layers
+            ErrCode ret = ErrCode::SUCCESS;
+            for (size_t i = 0; i < m_members.size(); i++) {
+                ErrCode err = this->enqueueSend(i, msg);
+                if (err != ErrCode::SUCCESS) {
+                    ret = err;
+                }
+            }
+            return ret;
+        }
+
+        size_t idx;
+        if (this->getRoute(msg.addr, idx) != ErrCode::SUCCESS) {
+            KVIK_LOGD("No route to %s", msg.addr.toString().c_str());
+            return ErrCode::NOT_FOUND;
+        }
+
+        return this->enqueueSend(idx, msg);
+    }
+
+    const ILocalLayer::Channels &MultiLocalLayer::getChannels()
+    {
+        return m_channels;
+    }
+
+    ErrCode MultiLocalLayer::setChannel(uint16_t)
+    {
+        return ErrCode::NOT_SUPPORTED;
+    }
+
+    std::chrono::microseconds MultiLocalLayer::estimateAirtime(
+        const LocalMsg &msg)
+    {
+        if (msg.addr.empty()) {
+            std::chrono::microseconds airtime{0};
+            for (auto &member : m_members) {
+                airtime += member->ll->estimateAirtime(msg);
+            }
+            return airtime;
+        }
+
+        size_t idx;
+        if (this->getRoute(msg.addr, idx) != ErrCode::SUCCESS) {
+            return std::chrono::microseconds(0);
+        }
+
+        return m_members[idx]->ll->estimateAirtime(msg);
+    }
+
+    size_t MultiLocalLayer::layerCnt() const
+    {
+        return m_members.size();
+    }
+
+    ErrCode MultiLocalLayer::getRoute(const LocalAddr &addr, size_t &layerIdx)
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+
+        auto it = m_routeIdx.find(addr);
+        if (it == m_routeIdx.end()) {
+            return ErrCode::NOT_FOUND;
+        }
+
+        layerIdx = it->second->layerIdx;
+        return ErrCode::SUCCESS;
+    }
+
+    void MultiLocalLayer::flush()
+    {
+        for (auto &member : m_members) {
+            UniqueLock lock{KVIK_SITE(member->mutex)};
+            member->idleCv.wait(lock, [&member]() {
+                return !member->run ||
+                       (member->sendQueue.empty() &&
+                        member->recvQueue.empty() && member->inFlight == 0);
+            });
+        }
+    }
+
+    void MultiLocalLayer::updateRoute(const LocalAddr &addr, size_t layerIdx)
+    {
+        auto it = m_routeIdx.find(addr);
+        if (it != m_routeIdx.end()) {
+            it->second->layerIdx = layerIdx;
+            m_routes.splice(m_routes.begin(), m_routes, it->second);
+            return;
+        }
+
+        if (m_routes.size() >= m_maxRoutes) {
+            KVIK_LOGD("Routing table full, evicting %s",
+                      m_routes.back().addr.toString().c_str());
+            m_routeIdx.erase(m_routes.back().addr);
+            m_routes.pop_back();
+        }
+
+        m_routes.push_front({addr, layerIdx});
+        m_routeIdx[addr] = m_routes.begin();
+    }
+
+    ErrCode MultiLocalLayer::recvFrom(size_t idx, LocalMsg msg)
+    {
+        // Remember where the sender was seen last
+        if (!msg.addr.empty()) {
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            this->updateRoute(msg.addr, idx);
+        }
+
+        auto &member = *m_members[idx];
+        {
+            const std::scoped_lock lock(KVIK_SITE(member.mutex));
+            if (member.recvQueue.size() >= m_maxQueueLen) {
+                KVIK_LOGW("Receive queue of layer %zu is full, dropping: %s",
+                          idx, msg.toString().c_str());
+                return ErrCode::QUEUE_FULL;
+            }
+            member.recvQueue.push_back(std::move(msg));
+        }
+        member.recvCv.notify_one();
+
+        return ErrCode::SUCCESS;
+    }
+
+    ErrCode MultiLocalLayer::enqueueSend(size_t idx, const LocalMsg &msg)
+    {
+        auto &member = *m_members[idx];
+        {
+            const std::scoped_lock lock(KVIK_SITE(member.mutex));
+            if (member.sendQueue.size() >= m_maxQueueLen) {
+                KVIK_LOGW("Send queue of layer %zu is full, dropping: %s",
+                          idx, msg.toString().c_str());
+                return ErrCode::QUEUE_FULL;
+            }
+            member.sendQueue.push_back(msg);
+        }
+        member.sendCv.notify_one();
+
+        return ErrCode::SUCCESS;
+    }
+
+    void MultiLocalLayer::sendThread(Member &member)
+    {
+        while (true) {
+            LocalMsg msg;
+            {
+                UniqueLock lock{KVIK_SITE(member.mutex)};
+                member.sendCv.wait(lock, [&member]() {
+                    return !member.run || !member.sendQueue.empty();
+                });
+                if (!member.run) {
+                    return;
+                }
+                msg = std::move(member.sendQueue.front());
+                member.sendQueue.pop_front();
+                member.inFlight++;
+            }
+
+            if (member.ll->send(msg) != ErrCode::SUCCESS) {
+                KVIK_LOGW("Send failed: %s", msg.toString().c_str());
+            }
+
+            {
+                const std::scoped_lock lock(KVIK_SITE(member.mutex));
+                member.inFlight--;
+            }
+            member.idleCv.notify_all();
+        }
+    }
+
+    void MultiLocalLayer::recvThread(Member &member)
+    {
+        while (true) {
+            LocalMsg msg;
+            {
+                UniqueLock lock{KVIK_SITE(member.mutex)};
+                member.recvCv.wait(lock, [&member]() {
+                    return !member.run || !member.recvQueue.empty();
+                });
+                if (!member.run) {
+                    return;
+                }
+                msg = std::move(member.recvQueue.front());
+                member.recvQueue.pop_front();
+                member.inFlight++;
+            }
+
+            auto cb = m_recvCb;
+            if (cb != nullptr) {
+                cb(msg);
+            }
+
+            {
+                const std::scoped_lock lock(KVIK_SITE(member.mutex));
+                member.inFlight--;
+            }
+            member.idleCv.notify_all();
+        }
+    }
+} // namespace kvik
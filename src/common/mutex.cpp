@@ -0,0 +1,274 @@
+/**
+ * @file mutex.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Mutexes with optional contention profiling
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <utility>
+
+#include "kvik/mutex.hpp"
+
+namespace kvik
+{
+    namespace
+    {
+        thread_local const char *tl_site = nullptr;
+
+        /**
+         * @brief Registry of all instrumented mutexes
+         */
+        struct Registry
+        {
+            std::mutex mutex;
+            std::vector<InstrumentedMutex *> live;
+            std::map<std::string, MutexStats> retired; //!< Merged by name
+        };
+
+        Registry &registry()
+        {
+            // Never destroyed, so mutexes with static storage duration
+            // can unregister at exit
+            static Registry *reg = new Registry();
+            return *reg;
+        }
+
+        bool sameSite(const char *a, const char *b)
+        {
+            return a == b || (a != nullptr && b != nullptr &&
+                              std::strcmp(a, b) == 0);
+        }
+
+        std::string histToString(const MutexStats::Histogram &hist)
+        {
+            std::string str;
+            for (size_t i = 0; i < hist.size(); i++) {
+                if (hist[i] == 0) {
+                    continue;
+                }
+
+                if (i == 0) {
+                    str += " <1us:";
+                } else if (i == hist.size() - 1) {
+                    str += " >=" + std::to_string(1ull << (i - 1)) + "us:";
+                } else {
+                    str += " <" + std::to_string(1ull << i) + "us:";
+                }
+                str += std::to_string(hist[i]);
+            }
+            return str;
+        }
+    } // namespace
+
+    void MutexStats::merge(const MutexStats &other)
+    {
+        acquisitions += other.acquisitions;
+        contended += other.contended;
+        totalWait += other.totalWait;
+        totalHold += other.totalHold;
+        for (size_t i = 0; i < MUTEX_HIST_BUCKETS; i++) {
+            waitHist[i] += other.waitHist[i];
+            holdHist[i] += other.holdHist[i];
+        }
+        for (const auto &hold : other.longestHolds) {
+            this->recordHold(hold.site, hold.time);
+        }
+    }
+
+    void MutexStats::recordHold(const char *site, std::chrono::microseconds time)
+    {
+        auto shortest = longestHolds.end();
+        for (auto it = longestHolds.begin(); it != longestHolds.end(); it++) {
+            if (sameSite(it->site, site)) {
+                it->time = std::max(it->time, time);
+                return;
+            }
+            if (shortest == longestHolds.end() || it->time < shortest->time) {
+                shortest = it;
+            }
+        }
+
+        if (longestHolds.size() < MUTEX_TOP_HOLDS) {
+            longestHolds.push_back({site, time});
+        } else if (time > shortest->time) {
+            *shortest = {site, time};
+        }
+    }
+
+    size_t MutexStats::bucket(std::chrono::microseconds time)
+    {
+        size_t idx = 0;
+        for (auto us = time.count(); us > 0 && idx < MUTEX_HIST_BUCKETS - 1;
+             us >>= 1) {
+            idx++;
+        }
+        return idx;
+    }
+
+    std::string MutexStats::toString() const
+    {
+        std::string str = name + ": " + std::to_string(acquisitions) +
+                          " acquisitions (" + std::to_string(contended) +
+                          " contended), wait " +
+                          std::to_string(totalWait.count()) + " us, hold " +
+                          std::to_string(totalHold.count()) + " us\n";
+        str += "  wait:" + histToString(waitHist) + "\n";
+        str += "  hold:" + histToString(holdHist) + "\n";
+
+        auto holds = longestHolds;
+        std::sort(holds.begin(), holds.end(), [](auto &a, auto &b) {
+            return a.time > b.time;
+        });
+        for (const auto &hold : holds) {
+            str += "  " + std::to_string(hold.time.count()) + " us at " +
+                   (hold.site != nullptr ? hold.site : "(unknown)") + "\n";
+        }
+        return str;
+    }
+
+    void markLockSite(const char *site) noexcept
+    {
+        tl_site = site;
+    }
+
+    InstrumentedMutex::InstrumentedMutex(const char *name)
+    {
+        m_stats.name = name;
+
+        auto &reg = registry();
+        const std::scoped_lock lock(reg.mutex);
+        reg.live.push_back(this);
+    }
+
+    InstrumentedMutex::~InstrumentedMutex()
+    {
+        auto stats = this->stats();
+
+        auto &reg = registry();
+        const std::scoped_lock lock(reg.mutex);
+        reg.live.erase(std::remove(reg.live.begin(), reg.live.end(), this),
+                       reg.live.end());
+        if (stats.acquisitions > 0) {
+            reg.retired[stats.name].merge(stats);
+        }
+    }
+
+    void InstrumentedMutex::lock()
+    {
+        auto start = Clock::now();
+        bool contended = !m_mutex.try_lock();
+        if (contended) {
+            m_mutex.lock();
+        }
+        this->acquired(start, contended);
+    }
+
+    bool InstrumentedMutex::try_lock()
+    {
+        auto start = Clock::now();
+        if (!m_mutex.try_lock()) {
+            return false;
+        }
+        this->acquired(start, false);
+        return true;
+    }
+
+    void InstrumentedMutex::unlock()
+    {
+        auto hold = std::chrono::duration_cast<std::chrono::microseconds>(
+            Clock::now() - m_acquired);
+        {
+            const std::scoped_lock lock(m_statsMutex);
+            m_stats.totalHold += hold;
+            m_stats.holdHist[MutexStats::bucket(hold)]++;
+            m_stats.recordHold(m_site, hold);
+        }
+        m_mutex.unlock();
+    }
+
+    MutexStats InstrumentedMutex::stats()
+    {
+        const std::scoped_lock lock(m_statsMutex);
+        return m_stats;
+    }
+
+    void InstrumentedMutex::resetStats()
+    {
+        const std::scoped_lock lock(m_statsMutex);
+        std::string name = std::move(m_stats.name);
+        m_stats = MutexStats{};
+        m_stats.name = std::move(name);
+    }
+
+    void InstrumentedMutex::acquired(Clock::time_point start, bool contended)
+    {
+        m_acquired = Clock::now();
+        m_site = tl_site;
+        tl_site = nullptr;
+
+        auto wait = std::chrono::duration_cast<std::chrono::microseconds>(
+            m_acquired - start);
+        const std::scoped_lock lock(m_statsMutex);
+        m_stats.acquisitions++;
+        if (contended) {
+            m_stats.contended++;
+            m_stats.totalWait += wait;
+        }
+        m_stats.waitHist[MutexStats::bucket(contended ? wait
+                                                      : decltype(wait){0})]++;
+    }
+
+    std::vector<MutexStats> mutexStatsSnapshot()
+    {
+        std::map<std::string, MutexStats> merged;
+        {
+            auto &reg = registry();
+            const std::scoped_lock lock(reg.mutex);
+            for (const auto &[name, stats] : reg.retired) {
+                merged[name].merge(stats);
+            }
+            for (auto *mutex : reg.live) {
+                auto stats = mutex->stats();
+                merged[stats.name].merge(stats);
+            }
+        }
+
+        std::vector<MutexStats> snap;
+        for (auto &[name, stats] : merged) {
+            if (stats.acquisitions == 0) {
+                continue;
+            }
+            stats.name = name;
+            snap.push_back(std::move(stats));
+        }
+
+        std::sort(snap.begin(), snap.end(), [](auto &a, auto &b) {
+            return a.totalHold > b.totalHold;
+        });
+        return snap;
+    }
+
+    std::string mutexStatsDump()
+    {
+        std::string str;
+        for (const auto &stats : mutexStatsSnapshot()) {
+            str += stats.toString();
+        }
+        return str;
+    }
+
+    void mutexStatsReset()
+    {
+        auto &reg = registry();
+        const std::scoped_lock lock(reg.mutex);
+        reg.retired.clear();
+        for (auto *mutex : reg.live) {
+            mutex->resetStats();
+        }
+    }
+} // namespace kvik
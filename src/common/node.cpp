@@ -8,10 +8,13 @@
  */
 
 #include "kvik/node.hpp"
+#include "kvik/energy_meter.hpp"
 #include "kvik/errors.hpp"
 #include "kvik/logger.hpp"
 #include "kvik/node_config.hpp"
 #include "kvik/random.hpp"
+#include "kvik/traffic_stats.hpp"
+#include "kvik/typed_payload.hpp"
 #include "kvik/version.hpp"
 
 // Log tag
@@ -30,6 +33,20 @@ namespace kvik
             KVIK_THROW_EXC("NodeConfig.msgIdCache.maxAge can't be 0!");
         }
 
+        if (m_nodeConf.stats.enabled) {
+            if (m_nodeConf.stats.rateHalfLife.count() <= 0) {
+                KVIK_THROW_EXC("NodeConfig.stats.rateHalfLife must be positive!");
+            }
+            m_trafficStats = std::make_unique<TrafficStats>(
+                m_nodeConf.stats.sketchWidth, m_nodeConf.stats.sketchDepth,
+                m_nodeConf.stats.topK, m_nodeConf.stats.rateHalfLife);
+        }
+
+        if (m_nodeConf.energy.enabled) {
+            m_energyMeter =
+                std::make_unique<EnergyMeter>(m_nodeConf.energy.powerModel);
+        }
+
         if (!VERSION_UNKNOWN) {
             KVIK_LOGI("Kvik version: %s", VERSION);
         }
@@ -44,6 +61,48 @@ namespace kvik
         return m_msgId++;
     }
 
+    ErrCode INode::getTrafficStats(TrafficStats::Snapshot &snap) const
+    {
+        if (!m_trafficStats) {
+            return ErrCode::NOT_SUPPORTED;
+        }
+
+        snap = m_trafficStats->snapshot();
+        return ErrCode::SUCCESS;
+    }
+
+    ErrCode INode::getEnergyStats(EnergyMeter::Snapshot &snap) const
+    {
+        if (!m_energyMeter) {
+            return ErrCode::NOT_SUPPORTED;
+        }
+
+        snap = m_energyMeter->snapshot();
+        return ErrCode::SUCCESS;
+    }
+
+    void INode::recordTraffic(const LocalAddr &src, const std::string &topic,
+                              size_t bytes)
+    {
+        if (m_trafficStats) {
+            m_trafficStats->record(src, topic, bytes);
+        }
+    }
+
+    void INode::recordEnergy(EnergyOp op, std::chrono::microseconds time)
+    {
+        if (m_energyMeter) {
+            m_energyMeter->record(op, time);
+        }
+    }
+
+    void INode::recordDelivered()
+    {
+        if (m_energyMeter) {
+            m_energyMeter->recordDelivered();
+        }
+    }
+
     bool INode::validateMsgId(const LocalAddr &addr, uint16_t id)
     {
         return m_msgIdCache.insert(addr, id);
@@ -76,4 +135,12 @@ namespace kvik
                m_nodeConf.topicSep.levelSeparator +
                peer.toString();
     }
+
+    std::string INode::buildReportRssiPayload(int16_t rssi) const
+    {
+        if (m_nodeConf.reporting.typedPayloads) {
+            return typedPayloadFromInt(rssi);
+        }
+        return std::to_string(rssi);
+    }
 } // namespace kvik
@@ -0,0 +1,166 @@
+/**
+ * @file piggyback_downlink.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Subscription data piggybacked on responses
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "kvik/logger.hpp"
+#include "kvik/piggyback_downlink.hpp"
+
+// Log tag
+static const char *KVIK_LOG_TAG = "Kvik/PiggybackDownlink";
+
+namespace kvik
+{
+    namespace
+    {
+        size_t dataLen(const SubData &data)
+        {
+            return data.topic.size() + data.payload.size();
+        }
+    } // namespace
+
+    PiggybackDownlink::PiggybackDownlink(const PiggybackDownlinkConfig &conf)
+        : m_conf{conf}
+    {
+        if (m_conf.maxLen == 0 || m_conf.maxClientQueueLen == 0) {
+            KVIK_THROW_EXC("Maximum length and queue length can't be 0");
+        }
+    }
+
+    ErrCode PiggybackDownlink::enqueue(const LocalAddr &addr,
+                                       const SubData &data,
+                                       Clock::time_point now)
+    {
+        if (dataLen(data) > m_conf.maxLen) {
+            return ErrCode::INVALID_SIZE;
+        }
+
+        auto &queue = m_clients[addr];
+        if (queue.pending.size() + queue.inFlight.size() >=
+            m_conf.maxClientQueueLen) {
+            return ErrCode::QUEUE_FULL;
+        }
+
+        queue.pending.push_back({data, now});
+        return ErrCode::SUCCESS;
+    }
+
+    void PiggybackDownlink::processRequest(const LocalMsg &req)
+    {
+        auto it = m_clients.find(req.addr);
+        if (it == m_clients.end() || it->second.inFlight.empty()) {
+            return;
+        }
+
+        auto &queue = it->second;
+        if (req.piggybackAck && req.piggybackAckId == queue.inFlightId) {
+            KVIK_LOGD("%zu piggybacked data acknowledged by %s",
+                      queue.inFlight.size(), req.addr.toString().c_str());
+            queue.inFlight.clear();
+        } else {
+            // Client hasn't received the response
+            KVIK_LOGD("Piggybacked data not acknowledged by %s",
+                      req.addr.toString().c_str());
+            requeue(queue);
+        }
+
+        if (queue.pending.empty() && queue.inFlight.empty()) {
+            m_clients.erase(it);
+        }
+    }
+
+    size_t PiggybackDownlink::attach(LocalMsg &resp, Clock::time_point now)
+    {
+        if (resp.type != LocalMsgType::OK) {
+            return 0;
+        }
+
+        auto it = m_clients.find(resp.addr);
+        if (it == m_clients.end() || !it->second.inFlight.empty()) {
+            return 0;
+        }
+
+        auto &queue = it->second;
+        size_t len = 0;
+        for (const auto &held : resp.subsData) {
+            len += dataLen(held);
+        }
+
+        while (!queue.pending.empty() &&
+               len + dataLen(queue.pending.front().data) <= m_conf.maxLen) {
+            len += dataLen(queue.pending.front().data);
+            resp.subsData.push_back(queue.pending.front().data);
+            queue.inFlight.push_back(std::move(queue.pending.front()));
+            queue.pending.pop_front();
+        }
+
+        queue.inFlightId = resp.id;
+        queue.inFlightSince = now;
+        return queue.inFlight.size();
+    }
+
+    std::vector<LocalMsg> PiggybackDownlink::takeExpired(Clock::time_point now)
+    {
+        std::vector<LocalMsg> msgs;
+
+        for (auto it = m_clients.begin(); it != m_clients.end();) {
+            auto &queue = it->second;
+            if (!queue.inFlight.empty() &&
+                now - queue.inFlightSince >= m_conf.maxHold) {
+                // Client went silent, acknowledgement won't come
+                requeue(queue);
+            }
+
+            if (queue.pending.empty() ||
+                now - queue.pending.front().since < m_conf.maxHold) {
+                it++;
+                continue;
+            }
+
+            // Split into messages of at most `maxLen`
+            size_t len = 0;
+            for (auto &held : queue.pending) {
+                if (msgs.empty() || msgs.back().addr != it->first ||
+                    len + dataLen(held.data) > m_conf.maxLen) {
+                    msgs.emplace_back();
+                    msgs.back().type = LocalMsgType::SUB_DATA;
+                    msgs.back().addr = it->first;
+                    len = 0;
+                }
+                len += dataLen(held.data);
+                msgs.back().subsData.push_back(std::move(held.data));
+            }
+            queue.pending.clear();
+
+            if (queue.inFlight.empty()) {
+                it = m_clients.erase(it);
+            } else {
+                it++;
+            }
+        }
+
+        return msgs;
+    }
+
+    size_t PiggybackDownlink::heldCnt(const LocalAddr &addr) const
+    {
+        auto it = m_clients.find(addr);
+        if (it == m_clients.end()) {
+            return 0;
+        }
+        return it->second.pending.size() + it->second.inFlight.size();
+    }
+
+    void PiggybackDownlink::requeue(ClientQueue &queue)
+    {
+        for (auto it = queue.inFlight.rbegin(); it != queue.inFlight.rend();
+             it++) {
+            queue.pending.push_front(std::move(*it));
+        }
+        queue.inFlight.clear();
+    }
+} // namespace kvik
@@ -0,0 +1,413 @@
+/**
+ * @file remote_layer_pool.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Remote layer distributing traffic over pool of remote layers
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <algorithm>
+#include <tuple>
+
+#include "kvik/errors.hpp"
+#include "kvik/hash.hpp"
+#include "kvik/logger.hpp"
+#include "kvik/remote_layer_pool.hpp"
+
+// Log tag
+static const char *KVIK_LOG_TAG = "Kvik/RemoteLayerPool";
+
+namespace kvik
+{
+    namespace
+    {
+        /**
+         * @brief Finalizes 64-bit hash (splitmix64)
+         * @param x Value
+         * @return Mixed value
+         */
+        uint64_t mix64(uint64_t x)
+        {
+            x ^= x >> 30;
+            x *= 0xbf58476d1ce4e5b9ULL;
+            x ^= x >> 27;
+            x *= 0x94d049bb133111ebULL;
+            x ^= x >> 31;
+            return x;
+        }
+
+        //! Maximum number of cached rankings
+        constexpr size_t RANK_CACHE_MAX = 1024;
+    } // namespace
+
+    RemoteLayerPool::RemoteLayerPool(const std::vector<IRemoteLayer *> &layers,
+                                     size_t failThres,
+                                     std::chrono::milliseconds retryInterval)
+        : m_failThres{failThres}, m_retryInterval{retryInterval}
+    {
+        if (layers.empty()) {
+            KVIK_THROW_EXC("No remote layers");
+        }
+
+        if (m_failThres == 0) {
+            KVIK_THROW_EXC("Failure threshold can't be 0");
+        }
+
+        for (auto rl : layers) {
+            if (rl == nullptr) {
+                KVIK_THROW_EXC("Invalid remote layer parameter");
+            }
+        }
+
+        for (size_t i = 0; i < layers.size(); i++) {
+            Member member;
+            member.rl = layers[i];
+            member.seed = mix64(i + 1);
+            m_members.push_back(member);
+        }
+
+        for (size_t i = 0; i < m_members.size(); i++) {
+            m_members[i].rl->setRecvCb(std::bind(
+                &RemoteLayerPool::recvFrom, this, std::placeholders::_1));
+            m_members[i].rl->setReconnectCb(
+                std::bind(&RemoteLayerPool::reconnectFrom, this, i));
+        }
+
+        KVIK_LOGD("Initialized with %zu layers", m_members.size());
+    }
+
+    RemoteLayerPool::~RemoteLayerPool()
+    {
+        for (auto &member : m_members) {
+            member.rl->setRecvCb(nullptr);
+            member.rl->setReconnectCb(nullptr);
+        }
+
+        KVIK_LOGD("Deinitialized");
+    }
+
+    ErrCode RemoteLayerPool::publish(const PubData &data)
+    {
+        size_t idx;
+        return this->runRanked(
+            data.topic,
+            [&data](IRemoteLayer *rl) { return rl->publish(data); }, idx);
+    }
+
+    ErrCode RemoteLayerPool::subscribe(const std::string &topic)
+    {
+        size_t idx;
+        bool subscribed;
+        {
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            auto it = m_subs.find(topic);
+            subscribed = it != m_subs.end() && m_members[it->second].healthy;
+            if (subscribed) {
+                idx = it->second;
+            }
+        }
+
+        if (subscribed) {
+            // Keep subscription on its layer
+            ErrCode res = m_members[idx].rl->subscribe(topic);
+            this->handleResult(idx, res);
+            return res;
+        }
+
+        KVIK_RETURN_ERROR(this->runRanked(
+            topic, [&topic](IRemoteLayer *rl) { return rl->subscribe(topic); },
+            idx));
+
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        m_subs[topic] = idx;
+        return ErrCode::SUCCESS;
+    }
+
+    ErrCode RemoteLayerPool::unsubscribe(const std::string &topic)
+    {
+        size_t idx;
+        {
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            auto it = m_subs.find(topic);
+            if (it == m_subs.end()) {
+                return ErrCode::NOT_FOUND;
+            }
+            idx = it->second;
+            m_subs.erase(it);
+        }
+
+        ErrCode res = m_members[idx].rl->unsubscribe(topic);
+        this->handleResult(idx, res);
+        return res;
+    }
+
+    size_t RemoteLayerPool::layerCnt() const
+    {
+        return m_members.size();
+    }
+
+    bool RemoteLayerPool::isHealthy(size_t idx)
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        return idx < m_members.size() && m_members[idx].healthy;
+    }
+
+    size_t RemoteLayerPool::getPubRoute(const std::string &topic)
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        return this->rank(topic).front();
+    }
+
+    ErrCode RemoteLayerPool::getSubRoute(const std::string &topic, size_t &idx)
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+
+        auto it = m_subs.find(topic);
+        if (it == m_subs.end()) {
+            return ErrCode::NOT_FOUND;
+        }
+
+        idx = it->second;
+        return ErrCode::SUCCESS;
+    }
+
+    std::vector<size_t> RemoteLayerPool::rank(const std::string &topic)
+    {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= m_rankExpiry) {
+            // Some unhealthy layer is due for retry
+            this->invalidateRanks();
+        }
+
+        auto cached = m_rankCache.find(topic);
+        if (cached != m_rankCache.end()) {
+            return cached->second;
+        }
+
+        uint64_t topicHash = fnv1a64(topic);
+
+        // (usable, score, index)
+        std::vector<std::tuple<bool, uint64_t, size_t>> scores;
+        scores.reserve(m_members.size());
+        for (size_t i = 0; i < m_members.size(); i++) {
+            const auto &member = m_members[i];
+            auto retryAt = member.downSince + m_retryInterval;
+            bool usable = member.healthy || now >= retryAt;
+            if (!usable) {
+                m_rankExpiry = std::min(m_rankExpiry, retryAt);
+            }
+            scores.emplace_back(usable, mix64(topicHash ^ member.seed), i);
+        }
+        std::sort(scores.begin(), scores.end(), std::greater<>());
+
+        std::vector<size_t> ranked;
+        ranked.reserve(scores.size());
+        for (const auto &score : scores) {
+            ranked.push_back(std::get<2>(score));
+        }
+
+        if (m_rankCache.size() >= RANK_CACHE_MAX) {
+            m_rankCache.clear();
+        }
+        m_rankCache.emplace(topic, ranked);
+        return ranked;
+    }
+
+    void RemoteLayerPool::invalidateRanks()
+    {
+        m_rankCache.clear();
+        m_rankExpiry = std::chrono::steady_clock::time_point::max();
+    }
+
+    RemoteLayerPool::HealthChange RemoteLayerPool::recordResult(size_t idx,
+                                                                ErrCode err)
+    {
+        auto &member = m_members[idx];
+
+        if (err == ErrCode::SUCCESS) {
+            member.failCnt = 0;
+            if (!member.healthy) {
+                KVIK_LOGI("Layer %zu is healthy again", idx);
+                member.healthy = true;
+                this->invalidateRanks();
+                return HealthChange::UP;
+            }
+            return HealthChange::NONE;
+        }
+
+        member.failCnt++;
+        if (!member.healthy) {
+            // Failed retry, postpone the next one
+            member.downSince = std::chrono::steady_clock::now();
+            this->invalidateRanks();
+            return HealthChange::NONE;
+        }
+
+        if (member.failCnt >= m_failThres) {
+            KVIK_LOGW("Layer %zu failed %zu times, marking unhealthy", idx,
+                      member.failCnt);
+            member.healthy = false;
+            member.downSince = std::chrono::steady_clock::now();
+            this->invalidateRanks();
+            return HealthChange::DOWN;
+        }
+        return HealthChange::NONE;
+    }
+
+    void RemoteLayerPool::handleResult(size_t idx, ErrCode err)
+    {
+        HealthChange change;
+        {
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            change = this->recordResult(idx, err);
+        }
+
+        if (change == HealthChange::DOWN) {
+            this->migrateSubs(idx);
+        } else if (change == HealthChange::UP) {
+            this->removeStaleSubs(idx);
+        }
+    }
+
+    void RemoteLayerPool::migrateSubs(size_t idx)
+    {
+        std::vector<std::string> topics;
+        {
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            for (const auto &[topic, subIdx] : m_subs) {
+                if (subIdx == idx) {
+                    topics.push_back(topic);
+                }
+            }
+        }
+
+        for (const auto &topic : topics) {
+            size_t newIdx;
+            ErrCode res = this->runRanked(
+                topic,
+                [&topic](IRemoteLayer *rl) { return rl->subscribe(topic); },
+                newIdx);
+            if (res != ErrCode::SUCCESS) {
+                KVIK_LOGW("Can't move subscription '%s' from layer %zu",
+                          topic.c_str(), idx);
+                continue;
+            }
+
+            {
+                const std::scoped_lock lock(KVIK_SITE(m_mutex));
+                auto it = m_subs.find(topic);
+                if (it == m_subs.end() || it->second != idx || newIdx == idx) {
+                    continue;
+                }
+                it->second = newIdx;
+                KVIK_LOGD("Subscription '%s' moved from layer %zu to %zu",
+                          topic.c_str(), idx, newIdx);
+            }
+
+            // Failed layer may still deliver data of the subscription
+            if (m_members[idx].rl->unsubscribe(topic) != ErrCode::SUCCESS) {
+                const std::scoped_lock lock(KVIK_SITE(m_mutex));
+                m_members[idx].staleSubs.push_back(topic);
+            }
+        }
+    }
+
+    void RemoteLayerPool::removeStaleSubs(size_t idx)
+    {
+        std::vector<std::string> topics;
+        {
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            topics.swap(m_members[idx].staleSubs);
+        }
+
+        for (const auto &topic : topics) {
+            {
+                // Subscription may have moved back meanwhile
+                const std::scoped_lock lock(KVIK_SITE(m_mutex));
+                auto it = m_subs.find(topic);
+                if (it != m_subs.end() && it->second == idx) {
+                    continue;
+                }
+            }
+
+            if (m_members[idx].rl->unsubscribe(topic) != ErrCode::SUCCESS) {
+                KVIK_LOGW("Can't remove moved subscription '%s' from layer "
+                          "%zu",
+                          topic.c_str(), idx);
+            }
+        }
+    }
+
+    ErrCode RemoteLayerPool::runRanked(
+        const std::string &topic,
+        const std::function<ErrCode(IRemoteLayer *)> &op, size_t &usedIdx)
+    {
+        std::vector<size_t> ranked;
+        {
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            ranked = this->rank(topic);
+        }
+
+        // Underlying layers are called without lock, they may call receive
+        // callback synchronously
+        ErrCode res = ErrCode::GENERIC_FAILURE;
+        for (auto idx : ranked) {
+            res = op(m_members[idx].rl);
+            this->handleResult(idx, res);
+
+            if (res == ErrCode::SUCCESS) {
+                usedIdx = idx;
+                return res;
+            }
+        }
+
+        return res;
+    }
+
+    ErrCode RemoteLayerPool::recvFrom(const SubData &data)
+    {
+        auto cb = m_recvCb;
+        if (cb == nullptr) {
+            return ErrCode::SUCCESS;
+        }
+        return cb(data);
+    }
+
+    ErrCode RemoteLayerPool::reconnectFrom(size_t idx)
+    {
+        std::vector<std::string> topics;
+        {
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            KVIK_LOGI("Layer %zu reconnected", idx);
+            m_members[idx].healthy = true;
+            m_members[idx].failCnt = 0;
+            this->invalidateRanks();
+
+            // Nothing left to unsubscribe after connection loss
+            m_members[idx].staleSubs.clear();
+            for (const auto &[topic, subIdx] : m_subs) {
+                if (subIdx == idx) {
+                    topics.push_back(topic);
+                }
+            }
+        }
+
+        // Subscriptions were lost with the connection
+        ErrCode ret = ErrCode::SUCCESS;
+        for (const auto &topic : topics) {
+            ErrCode res = m_members[idx].rl->subscribe(topic);
+            if (res != ErrCode::SUCCESS) {
+                KVIK_LOGW("Can't restore subscription '%s' on layer %zu",
+                          topic.c_str(), idx);
+                ret = res;
+            }
+        }
+
+        auto cb = m_reconnectCb;
+        if (cb != nullptr) {
+            KVIK_RETURN_ERROR(cb());
+        }
+        return ret;
+    }
+} // namespace kvik
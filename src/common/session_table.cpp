@@ -0,0 +1,45 @@
+/**
+ * @file session_table.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Open-addressing table of peer sessions
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "kvik/session_table.hpp"
+
+namespace kvik
+{
+    bool PeerSession::checkMsgId(uint16_t id)
+    {
+        if (msgIdWindow == 0) {
+            // First message
+            lastMsgId = id;
+            msgIdWindow = 1;
+            return true;
+        }
+
+        // Serial number arithmetic (wrap-around safe)
+        int16_t diff = static_cast<int16_t>(id - lastMsgId);
+        if (diff > 0) {
+            msgIdWindow = diff < 64 ? msgIdWindow << diff : 0;
+            msgIdWindow |= 1;
+            lastMsgId = id;
+            return true;
+        }
+
+        uint16_t age = -diff;
+        if (age >= 64) {
+            return false;
+        }
+
+        uint64_t bit = 1ULL << age;
+        if ((msgIdWindow & bit) != 0) {
+            return false;
+        }
+
+        msgIdWindow |= bit;
+        return true;
+    }
+} // namespace kvik
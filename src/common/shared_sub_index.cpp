@@ -0,0 +1,208 @@
+/**
+ * @file shared_sub_index.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Subscription index with shared (load-balanced) subscriptions
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <algorithm>
+
+#include "kvik/errors.hpp"
+#include "kvik/shared_sub_index.hpp"
+
+namespace kvik
+{
+    SharedSubIndex::SharedSubIndex(Policy policy,
+                                   const NodeConfig::TopicSeparators &sep)
+        : m_policy{policy}, m_sep{sep},
+          m_trie{sep.levelSeparator, sep.singleLevelWildcard,
+                 sep.multiLevelWildcard}
+    {
+    }
+
+    ErrCode SharedSubIndex::parseShared(const std::string &filter,
+                                        std::string &group,
+                                        std::string &realFilter) const
+    {
+        std::string prefix = SHARED_SUB_PREFIX + m_sep.levelSeparator;
+        if (filter.compare(0, prefix.size(), prefix) != 0) {
+            return ErrCode::NOT_FOUND;
+        }
+
+        size_t groupEnd = filter.find(m_sep.levelSeparator, prefix.size());
+        if (groupEnd == std::string::npos) {
+            return ErrCode::INVALID_ARG;
+        }
+
+        group = filter.substr(prefix.size(), groupEnd - prefix.size());
+        realFilter = filter.substr(groupEnd + m_sep.levelSeparator.size());
+        if (group.empty() || realFilter.empty() ||
+            group.find(m_sep.singleLevelWildcard) != std::string::npos ||
+            group.find(m_sep.multiLevelWildcard) != std::string::npos) {
+            return ErrCode::INVALID_ARG;
+        }
+        return ErrCode::SUCCESS;
+    }
+
+    ErrCode SharedSubIndex::subscribe(ConsumerId consumer,
+                                      const std::string &filter)
+    {
+        std::string group, realFilter;
+        ErrCode res = this->parseShared(filter, group, realFilter);
+        if (res == ErrCode::INVALID_ARG) {
+            return res;
+        }
+        bool shared = res == ErrCode::SUCCESS;
+
+        auto &entry = m_trie[shared ? realFilter : filter];
+        auto &consumers =
+            shared ? entry.groups[group].members : entry.consumers;
+        if (std::find(consumers.begin(), consumers.end(), consumer) !=
+            consumers.end()) {
+            return ErrCode::SUCCESS;
+        }
+
+        consumers.push_back(consumer);
+        m_consumerSubs[consumer].push_back(filter);
+        return ErrCode::SUCCESS;
+    }
+
+    ErrCode SharedSubIndex::unsubscribe(ConsumerId consumer,
+                                        const std::string &filter)
+    {
+        std::string group, realFilter;
+        ErrCode res = this->parseShared(filter, group, realFilter);
+        if (res == ErrCode::INVALID_ARG) {
+            return res;
+        }
+        bool shared = res == ErrCode::SUCCESS;
+
+        auto subsIt = m_consumerSubs.find(consumer);
+        if (subsIt == m_consumerSubs.end()) {
+            return ErrCode::NOT_FOUND;
+        }
+        auto &subs = subsIt->second;
+        auto filterIt = std::find(subs.begin(), subs.end(), filter);
+        if (filterIt == subs.end()) {
+            return ErrCode::NOT_FOUND;
+        }
+        subs.erase(filterIt);
+        if (subs.empty()) {
+            m_consumerSubs.erase(subsIt);
+        }
+
+        // Filter is known to exist, so this doesn't insert
+        const std::string &key = shared ? realFilter : filter;
+        auto &entry = m_trie[key];
+        if (shared) {
+            auto &members = entry.groups[group].members;
+            members.erase(std::remove(members.begin(), members.end(), consumer),
+                          members.end());
+            if (members.empty()) {
+                entry.groups.erase(group);
+            }
+        } else {
+            entry.consumers.erase(std::remove(entry.consumers.begin(),
+                                              entry.consumers.end(), consumer),
+                                  entry.consumers.end());
+        }
+
+        if (entry.empty()) {
+            m_trie.remove(key);
+        }
+        return ErrCode::SUCCESS;
+    }
+
+    void SharedSubIndex::removeConsumer(ConsumerId consumer)
+    {
+        auto subsIt = m_consumerSubs.find(consumer);
+        if (subsIt != m_consumerSubs.end()) {
+            auto subs = subsIt->second;
+            for (const auto &filter : subs) {
+                this->unsubscribe(consumer, filter);
+            }
+        }
+        m_load.erase(consumer);
+    }
+
+    void SharedSubIndex::match(const std::string &topic,
+                               std::vector<ConsumerId> &consumers,
+                               std::vector<ConsumerId> *selected)
+    {
+        consumers.clear();
+        if (selected != nullptr) {
+            selected->clear();
+        }
+
+        auto add = [&consumers](ConsumerId consumer) {
+            if (std::find(consumers.begin(), consumers.end(), consumer) ==
+                consumers.end()) {
+                consumers.push_back(consumer);
+                return true;
+            }
+            return false;
+        };
+
+        m_trie.visitMatches(
+            topic,
+            [this, &add, selected](const Entry &entry) {
+                for (auto consumer : entry.consumers) {
+                    add(consumer);
+                }
+                for (const auto &[name, group] : entry.groups) {
+                    ConsumerId consumer = this->select(group);
+                    if (add(consumer) && selected != nullptr) {
+                        selected->push_back(consumer);
+                        m_load[consumer]++;
+                    }
+                }
+                return false;
+            },
+            m_levelBuf);
+    }
+
+    void SharedSubIndex::release(ConsumerId consumer)
+    {
+        auto it = m_load.find(consumer);
+        if (it == m_load.end()) {
+            return;
+        }
+        if (--it->second == 0) {
+            m_load.erase(it);
+        }
+    }
+
+    size_t SharedSubIndex::load(ConsumerId consumer) const
+    {
+        auto it = m_load.find(consumer);
+        return it != m_load.end() ? it->second : 0;
+    }
+
+    bool SharedSubIndex::empty() const
+    {
+        return m_trie.empty();
+    }
+
+    SharedSubIndex::ConsumerId SharedSubIndex::select(const Group &group) const
+    {
+        if (m_policy == Policy::LEAST_LOADED) {
+            // Ties are broken round-robin, so idle members take turns too
+            size_t best = group.next % group.members.size();
+            for (size_t i = 1; i < group.members.size(); i++) {
+                size_t idx = (group.next + i) % group.members.size();
+                if (this->load(group.members[idx]) <
+                    this->load(group.members[best])) {
+                    best = idx;
+                }
+            }
+            group.next = best + 1;
+            return group.members[best];
+        }
+
+        ConsumerId consumer = group.members[group.next % group.members.size()];
+        group.next = (group.next + 1) % group.members.size();
+        return consumer;
+    }
+} // namespace kvik
@@ -0,0 +1,116 @@
+/**
+ * @file slot_scheduler.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Gateway-side assignment of uplink slots
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <algorithm>
+
+#include "kvik/logger.hpp"
+#include "kvik/slot_scheduler.hpp"
+
+// Log tag
+static const char *KVIK_LOG_TAG = "Kvik/SlotScheduler";
+
+namespace kvik
+{
+    SlotScheduler::SlotScheduler(const SlotSchedulerConfig &conf)
+        : m_conf{conf}
+    {
+        if (m_conf.frameLen < 2) {
+            KVIK_THROW_EXC("Frame must have at least 2 slots");
+        }
+        if (m_conf.slotLen.count() <= 0) {
+            KVIK_THROW_EXC("Slot length must be positive");
+        }
+
+        m_load.resize(m_conf.frameLen);
+    }
+
+    UplinkSlot SlotScheduler::assign(const LocalAddr &addr,
+                                     Clock::time_point now)
+    {
+        auto it = m_assignments.find(addr);
+        if (it != m_assignments.end()) {
+            it->second.expiry = now + m_conf.lease;
+            return this->makeSlot(it->second.idx);
+        }
+
+        // Least loaded slot (lowest one on tie), contention slot excluded
+        auto minIt = std::min_element(m_load.begin() + 1, m_load.end());
+        auto idx = static_cast<uint16_t>(minIt - m_load.begin());
+        (*minIt)++;
+        m_assignments[addr] = {idx, now + m_conf.lease};
+
+        if (*minIt > 1) {
+            KVIK_LOGD("All slots taken, %s shares slot %u with %u others",
+                      addr.toString().c_str(), idx, *minIt - 1);
+        }
+
+        return this->makeSlot(idx);
+    }
+
+    ErrCode SlotScheduler::attach(LocalMsg &resp, Clock::time_point now)
+    {
+        if ((resp.type != LocalMsgType::PROBE_RES &&
+             resp.type != LocalMsgType::OK) ||
+            resp.addr.empty()) {
+            return ErrCode::INVALID_ARG;
+        }
+
+        resp.uplinkSlot = this->assign(resp.addr, now);
+        return ErrCode::SUCCESS;
+    }
+
+    void SlotScheduler::release(const LocalAddr &addr)
+    {
+        auto it = m_assignments.find(addr);
+        if (it == m_assignments.end()) {
+            return;
+        }
+
+        m_load[it->second.idx]--;
+        m_assignments.erase(it);
+    }
+
+    size_t SlotScheduler::expire(Clock::time_point now)
+    {
+        size_t cnt = 0;
+        for (auto it = m_assignments.begin(); it != m_assignments.end();) {
+            if (it->second.expiry <= now) {
+                m_load[it->second.idx]--;
+                it = m_assignments.erase(it);
+                cnt++;
+            } else {
+                it++;
+            }
+        }
+
+        if (cnt > 0) {
+            KVIK_LOGD("Released %zu expired assignments", cnt);
+        }
+        return cnt;
+    }
+
+    size_t SlotScheduler::assignedCnt() const
+    {
+        return m_assignments.size();
+    }
+
+    uint16_t SlotScheduler::slotLoad(uint16_t idx) const
+    {
+        return idx < m_load.size() ? m_load[idx] : 0;
+    }
+
+    UplinkSlot SlotScheduler::makeSlot(uint16_t idx) const
+    {
+        return {
+            .idx = idx,
+            .frameLen = m_conf.frameLen,
+            .slotLen = m_conf.slotLen,
+        };
+    }
+} // namespace kvik
@@ -0,0 +1,625 @@
+/**
+ * @file stream.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Chunked streaming transfer of large payloads
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <algorithm>
+
+#include "kvik/byte_codec.hpp"
+#include "kvik/errors.hpp"
+#include "kvik/fec.hpp"
+#include "kvik/stream.hpp"
+
+namespace kvik
+{
+    namespace
+    {
+        constexpr uint8_t CHUNK_TAG = 0xC5;
+        constexpr uint8_t PARITY_TAG = 0xF5;
+        constexpr uint8_t ACK_TAG = 0xA5;
+        constexpr size_t CHUNK_HDR_LEN = 1 + 4 + 4 + 4 + 2;
+        constexpr size_t PARITY_HDR_LEN = CHUNK_HDR_LEN + 1 + 1;
+        constexpr size_t ACK_LEN = 1 + 4 + 4 + 8 + 1 + 1;
+
+        //! Weight of new sample of loss rate
+        constexpr double LOSS_RATE_ALPHA = 1.0 / 16;
+
+        //! Maximum number of gap chunks counted as lost at once
+        constexpr size_t LOSS_RATE_MAX_GAP = 64;
+
+        //! Number of remembered completed transfers (for duplicate chunks)
+        constexpr size_t COMPLETED_HISTORY = 16;
+
+        /**
+         * @brief Returns number of chunks of data
+         * @param totalLen Length of data
+         * @param chunkSize Chunk size
+         * @return Number of chunks (empty data are single empty chunk)
+         */
+        uint32_t chunkCount(uint32_t totalLen, uint16_t chunkSize)
+        {
+            if (chunkSize == 0) {
+                return 0;
+            }
+            if (totalLen == 0) {
+                return 1;
+            }
+            return (totalLen - 1) / chunkSize + 1;
+        }
+    } // namespace
+
+    uint32_t StreamChunk::chunkCnt() const
+    {
+        return chunkCount(totalLen, chunkSize);
+    }
+
+    std::string StreamChunk::encode() const
+    {
+        std::string out;
+        out.reserve(PARITY_HDR_LEN + data.size());
+        out += static_cast<char>(fecK != 0 ? PARITY_TAG : CHUNK_TAG);
+        putLE(out, transferId, 4);
+        putLE(out, totalLen, 4);
+        putLE(out, idx, 4);
+        putLE(out, chunkSize, 2);
+        if (fecK != 0) {
+            out += static_cast<char>(fecK);
+            out += static_cast<char>(fecIdx);
+        }
+        out += data;
+        return out;
+    }
+
+    ErrCode StreamChunk::decode(const std::string &payload, StreamChunk &chunk)
+    {
+        uint8_t tag = payload.empty() ? 0 : payload[0];
+        size_t hdrLen = tag == PARITY_TAG ? PARITY_HDR_LEN : CHUNK_HDR_LEN;
+        if (payload.size() < hdrLen ||
+            (tag != CHUNK_TAG && tag != PARITY_TAG)) {
+            return ErrCode::INVALID_ARG;
+        }
+
+        size_t pos = 1;
+        chunk.transferId = getLE(payload, pos, 4);
+        chunk.totalLen = getLE(payload, pos, 4);
+        chunk.idx = getLE(payload, pos, 4);
+        chunk.chunkSize = getLE(payload, pos, 2);
+        chunk.fecK = 0;
+        chunk.fecIdx = 0;
+        if (tag == PARITY_TAG) {
+            chunk.fecK = payload[pos++];
+            chunk.fecIdx = payload[pos++];
+            if (chunk.fecK == 0 || chunk.idx == STREAM_PROBE_IDX) {
+                return ErrCode::INVALID_ARG;
+            }
+        }
+        chunk.data = payload.substr(pos);
+
+        if (chunk.fecK != 0 && chunk.data.size() != chunk.chunkSize) {
+            return ErrCode::INVALID_SIZE;
+        }
+
+        if (chunk.idx == STREAM_PROBE_IDX) {
+            return chunk.data.empty() ? ErrCode::SUCCESS : ErrCode::INVALID_SIZE;
+        }
+        if (chunk.chunkSize == 0 || chunk.data.size() > chunk.chunkSize) {
+            return ErrCode::INVALID_SIZE;
+        }
+        return ErrCode::SUCCESS;
+    }
+
+    std::string StreamAck::encode() const
+    {
+        std::string out;
+        out.reserve(ACK_LEN);
+        out += static_cast<char>(ACK_TAG);
+        putLE(out, transferId, 4);
+        putLE(out, cumAck, 4);
+        putLE(out, sack, 8);
+        out += static_cast<char>(complete ? 1 : 0);
+        out += static_cast<char>(lossRate);
+        return out;
+    }
+
+    ErrCode StreamAck::decode(const std::string &payload, StreamAck &ack)
+    {
+        if (payload.size() != ACK_LEN ||
+            static_cast<uint8_t>(payload[0]) != ACK_TAG) {
+            return ErrCode::INVALID_ARG;
+        }
+
+        size_t pos = 1;
+        ack.transferId = getLE(payload, pos, 4);
+        ack.cumAck = getLE(payload, pos, 4);
+        ack.sack = getLE(payload, pos, 8);
+        ack.complete = payload[pos++] != 0;
+        ack.lossRate = payload[pos];
+        return ErrCode::SUCCESS;
+    }
+
+    StreamSender::StreamSender(uint32_t transferId, std::string data,
+                               uint16_t chunkSize, size_t window,
+                               std::chrono::milliseconds rto, SendFn send,
+                               size_t fecGroup, size_t fecMaxParity)
+        : m_transferId{transferId}, m_data{std::move(data)},
+          m_chunkSize{chunkSize}, m_window{window}, m_rto{rto},
+          m_send{send}, m_fecGroup{fecGroup}, m_fecMaxParity{fecMaxParity}
+    {
+        if (chunkSize == 0 || window == 0 || !send) {
+            KVIK_THROW_EXC("Invalid stream parameters");
+        }
+        if (fecGroup > UINT8_MAX || fecGroup + fecMaxParity > FEC_MAX_SHARDS) {
+            KVIK_THROW_EXC("Invalid FEC parameters");
+        }
+        if (m_data.size() > UINT32_MAX) {
+            KVIK_THROW_EXC("Stream data too long");
+        }
+
+        size_t cnt = chunkCount(m_data.size(), m_chunkSize);
+        m_states.resize(cnt, ChunkState::PENDING);
+        m_sentAt.resize(cnt);
+        m_sentSeq.resize(cnt, 0);
+        if (m_fecGroup > 0) {
+            m_paritySeq.resize((cnt - 1) / m_fecGroup + 1, 0);
+        }
+    }
+
+    ErrCode StreamSender::start(bool resume)
+    {
+        if (!resume) {
+            return this->pump();
+        }
+
+        // Ask receiver which chunks it already has
+        StreamChunk probe;
+        probe.transferId = m_transferId;
+        probe.totalLen = m_data.size();
+        probe.idx = STREAM_PROBE_IDX;
+        probe.chunkSize = m_chunkSize;
+
+        m_probing = true;
+        m_probeSentAt = std::chrono::steady_clock::now();
+        return m_send(probe.encode());
+    }
+
+    ErrCode StreamSender::processAck(const StreamAck &ack)
+    {
+        if (ack.transferId != m_transferId) {
+            return ErrCode::INVALID_ARG;
+        }
+        m_probing = false;
+        m_lossRate = ack.lossRate / 255.0;
+
+        if (ack.complete) {
+            for (size_t i = 0; i < m_states.size(); i++) {
+                this->markAcked(i);
+            }
+            return ErrCode::SUCCESS;
+        }
+
+        size_t cumAck = std::min<size_t>(ack.cumAck, m_states.size());
+        for (size_t i = 0; i < cumAck; i++) {
+            this->markAcked(i);
+        }
+
+        size_t highest = cumAck;
+        for (size_t bit = 0; bit < 64; bit++) {
+            size_t idx = cumAck + 1 + bit;
+            if (idx >= m_states.size()) {
+                break;
+            }
+            if ((ack.sack >> bit) & 1) {
+                this->markAcked(idx);
+                highest = idx;
+            }
+        }
+
+        // Chunks sent before a selectively acknowledged one are lost
+        if (highest > cumAck) {
+            for (size_t i = cumAck; i < highest; i++) {
+                if (m_states[i] != ChunkState::IN_FLIGHT ||
+                    m_sentSeq[i] >= m_sentSeq[highest]) {
+                    continue;
+                }
+
+                // Chunk may still be recovered from parity in flight
+                if (m_fecGroup > 0 &&
+                    m_sentSeq[highest] < m_paritySeq[i / m_fecGroup]) {
+                    continue;
+                }
+
+                m_states[i] = ChunkState::PENDING;
+                m_inFlight--;
+            }
+        }
+
+        return this->pump();
+    }
+
+    ErrCode StreamSender::tick(std::chrono::steady_clock::time_point now)
+    {
+        if (m_complete) {
+            return ErrCode::SUCCESS;
+        }
+
+        if (m_probing) {
+            if (now - m_probeSentAt >= m_rto) {
+                return this->start(true);
+            }
+            return ErrCode::SUCCESS;
+        }
+
+        for (size_t i = m_base; i < m_states.size(); i++) {
+            if (m_states[i] == ChunkState::IN_FLIGHT &&
+                now - m_sentAt[i] >= m_rto) {
+                m_states[i] = ChunkState::PENDING;
+                m_inFlight--;
+            }
+        }
+
+        return this->pump();
+    }
+
+    ErrCode StreamSender::pump()
+    {
+        for (size_t i = m_base; i < m_states.size() && m_inFlight < m_window;
+             i++) {
+            if (m_states[i] == ChunkState::PENDING) {
+                KVIK_RETURN_ERROR(this->sendChunk(i));
+            }
+        }
+        return ErrCode::SUCCESS;
+    }
+
+    ErrCode StreamSender::sendChunk(size_t idx)
+    {
+        StreamChunk chunk;
+        chunk.transferId = m_transferId;
+        chunk.totalLen = m_data.size();
+        chunk.idx = idx;
+        chunk.chunkSize = m_chunkSize;
+        chunk.data = m_data.substr(idx * m_chunkSize, m_chunkSize);
+
+        ErrCode sendErr = m_send(chunk.encode());
+        if (sendErr != ErrCode::SUCCESS) {
+            return sendErr;
+        }
+
+        bool firstSend = m_sentSeq[idx] == 0;
+        if (!firstSend) {
+            m_retransmits++;
+        }
+        m_states[idx] = ChunkState::IN_FLIGHT;
+        m_sentAt[idx] = std::chrono::steady_clock::now();
+        m_sentSeq[idx] = ++m_sendSeq;
+        m_inFlight++;
+
+        // Parity follows the last chunk of FEC group
+        if (firstSend && m_fecGroup > 0 &&
+            ((idx + 1) % m_fecGroup == 0 || idx + 1 == m_states.size())) {
+            return this->sendParity(idx / m_fecGroup);
+        }
+        return ErrCode::SUCCESS;
+    }
+
+    ErrCode StreamSender::sendParity(size_t group)
+    {
+        size_t start = group * m_fecGroup;
+        size_t k = std::min(m_fecGroup, m_states.size() - start);
+        size_t parityCnt = fecParityCnt(k, m_lossRate, m_fecMaxParity);
+        if (parityCnt == 0 || m_paritySeq[group] != 0) {
+            return ErrCode::SUCCESS;
+        }
+
+        std::vector<std::string> shards;
+        for (size_t i = start; i < start + k; i++) {
+            shards.push_back(this->paddedChunk(i));
+        }
+        std::vector<std::string> parity;
+        KVIK_RETURN_ERROR(fecEncode(shards, parityCnt, parity));
+
+        StreamChunk chunk;
+        chunk.transferId = m_transferId;
+        chunk.totalLen = m_data.size();
+        chunk.idx = start;
+        chunk.chunkSize = m_chunkSize;
+        chunk.fecK = k;
+        for (size_t j = 0; j < parity.size(); j++) {
+            chunk.fecIdx = j;
+            chunk.data = std::move(parity[j]);
+            KVIK_RETURN_ERROR(m_send(chunk.encode()));
+            m_paritySeq[group] = ++m_sendSeq;
+            m_paritySent++;
+        }
+        return ErrCode::SUCCESS;
+    }
+
+    std::string StreamSender::paddedChunk(size_t idx) const
+    {
+        std::string data = m_data.substr(idx * m_chunkSize, m_chunkSize);
+        data.resize(m_chunkSize, '\0');
+        return data;
+    }
+
+    void StreamSender::markAcked(size_t idx)
+    {
+        if (m_states[idx] == ChunkState::ACKED) {
+            return;
+        }
+        if (m_states[idx] == ChunkState::IN_FLIGHT) {
+            m_inFlight--;
+        }
+        m_states[idx] = ChunkState::ACKED;
+        m_ackedCnt++;
+        while (m_base < m_states.size() &&
+               m_states[m_base] == ChunkState::ACKED) {
+            m_base++;
+        }
+        m_complete = m_ackedCnt == m_states.size();
+    }
+
+    StreamReceiver::StreamReceiver(CompleteCb completeCb, size_t maxTransfers,
+                                   size_t maxLen,
+                                   std::chrono::milliseconds idleTimeout)
+        : m_maxTransfers{maxTransfers}, m_maxLen{maxLen},
+          m_idleTimeout{idleTimeout}, m_completeCb{completeCb}
+    {
+    }
+
+    ErrCode StreamReceiver::processChunk(const StreamChunk &chunk,
+                                         StreamAck &ack,
+                                         std::chrono::steady_clock::time_point now)
+    {
+        if (this->isCompleted(chunk.transferId)) {
+            // Acknowledgement of last chunk was lost
+            ack = StreamAck{};
+            ack.transferId = chunk.transferId;
+            ack.complete = true;
+            ack.lossRate = m_lossRate * 255;
+            return ErrCode::SUCCESS;
+        }
+
+        auto it = m_transfers.find(chunk.transferId);
+        if (chunk.idx == STREAM_PROBE_IDX) {
+            // Nothing received yet is a valid state too
+            if (it != m_transfers.end()) {
+                it->second.lastActivity = now;
+                ack = this->buildAck(chunk.transferId, it->second);
+            } else {
+                ack = StreamAck{chunk.transferId, 0, 0, false};
+                ack.lossRate = m_lossRate * 255;
+            }
+            return ErrCode::SUCCESS;
+        }
+
+        if (it == m_transfers.end()) {
+            if (chunk.totalLen > m_maxLen) {
+                return ErrCode::INVALID_SIZE;
+            }
+            if (chunk.chunkSize == 0) {
+                return ErrCode::INVALID_ARG;
+            }
+            if (m_transfers.size() >= m_maxTransfers) {
+                // Make room by dropping transfers abandoned by senders
+                this->expireIdle(now);
+            }
+            if (m_transfers.size() >= m_maxTransfers) {
+                return ErrCode::QUEUE_FULL;
+            }
+
+            Transfer transfer;
+            transfer.data.resize(chunk.totalLen);
+            transfer.chunkSize = chunk.chunkSize;
+            transfer.received.resize(chunk.chunkCnt(), false);
+            it = m_transfers.emplace(chunk.transferId, std::move(transfer))
+                     .first;
+        }
+
+        auto &transfer = it->second;
+        if (chunk.chunkSize != transfer.chunkSize ||
+            chunk.totalLen != transfer.data.size() ||
+            chunk.idx >= transfer.received.size()) {
+            return ErrCode::INVALID_ARG;
+        }
+        transfer.lastActivity = now;
+
+        uint32_t groupStart;
+        if (chunk.fecK != 0) {
+            // Parity chunk
+            if (chunk.idx + chunk.fecK > transfer.received.size()) {
+                return ErrCode::INVALID_ARG;
+            }
+            auto &group = transfer.fecGroups[chunk.idx];
+            if (group.k != 0 && group.k != chunk.fecK) {
+                return ErrCode::INVALID_ARG;
+            }
+            group.k = chunk.fecK;
+            group.parity[chunk.fecIdx] = chunk.data;
+            groupStart = chunk.idx;
+        } else {
+            size_t offset = static_cast<size_t>(chunk.idx) * transfer.chunkSize;
+            size_t expectedLen =
+                std::min<size_t>(transfer.chunkSize, chunk.totalLen - offset);
+            if (chunk.data.size() != expectedLen) {
+                return ErrCode::INVALID_SIZE;
+            }
+
+            this->updateLossRate(transfer, chunk.idx);
+            storeChunk(transfer, chunk.idx, chunk.data);
+
+            // Find FEC group containing the chunk
+            groupStart = STREAM_PROBE_IDX;
+            auto groupIt = transfer.fecGroups.upper_bound(chunk.idx);
+            if (groupIt != transfer.fecGroups.begin()) {
+                groupIt--;
+                if (groupIt->first + groupIt->second.k > chunk.idx) {
+                    groupStart = groupIt->first;
+                }
+            }
+        }
+
+        if (groupStart != STREAM_PROBE_IDX) {
+            recoverGroup(transfer, groupStart);
+        }
+
+        ack = this->buildAck(chunk.transferId, transfer);
+        if (!ack.complete) {
+            return ErrCode::SUCCESS;
+        }
+
+        // Whole transfer received
+        std::string data = std::move(transfer.data);
+        m_transfers.erase(it);
+        m_completed.push_back(chunk.transferId);
+        if (m_completed.size() > COMPLETED_HISTORY) {
+            m_completed.pop_front();
+        }
+
+        if (m_completeCb) {
+            m_completeCb(chunk.transferId, data);
+        }
+        return ErrCode::SUCCESS;
+    }
+
+    ErrCode StreamReceiver::getAck(uint32_t transferId, StreamAck &ack) const
+    {
+        if (this->isCompleted(transferId)) {
+            ack = StreamAck{};
+            ack.transferId = transferId;
+            ack.complete = true;
+            return ErrCode::SUCCESS;
+        }
+
+        auto it = m_transfers.find(transferId);
+        if (it == m_transfers.end()) {
+            return ErrCode::NOT_FOUND;
+        }
+        ack = buildAck(transferId, it->second);
+        return ErrCode::SUCCESS;
+    }
+
+    bool StreamReceiver::abort(uint32_t transferId)
+    {
+        return m_transfers.erase(transferId) > 0;
+    }
+
+    size_t StreamReceiver::expireIdle(std::chrono::steady_clock::time_point now)
+    {
+        size_t cnt = 0;
+        for (auto it = m_transfers.begin(); it != m_transfers.end();) {
+            if (now - it->second.lastActivity >= m_idleTimeout) {
+                it = m_transfers.erase(it);
+                cnt++;
+            } else {
+                it++;
+            }
+        }
+        return cnt;
+    }
+
+    StreamAck StreamReceiver::buildAck(uint32_t transferId,
+                                       const Transfer &transfer) const
+    {
+        StreamAck ack;
+        ack.transferId = transferId;
+        ack.cumAck = transfer.cumAck;
+        ack.complete = transfer.receivedCnt == transfer.received.size();
+        ack.lossRate = m_lossRate * 255;
+        for (size_t bit = 0; bit < 64; bit++) {
+            size_t idx = static_cast<size_t>(transfer.cumAck) + 1 + bit;
+            if (idx >= transfer.received.size()) {
+                break;
+            }
+            if (transfer.received[idx]) {
+                ack.sack |= uint64_t(1) << bit;
+            }
+        }
+        return ack;
+    }
+
+    void StreamReceiver::storeChunk(Transfer &transfer, size_t idx,
+                                    const std::string &data)
+    {
+        if (transfer.received[idx]) {
+            return;
+        }
+
+        size_t offset = idx * transfer.chunkSize;
+        std::copy(data.begin(), data.end(), transfer.data.begin() + offset);
+        transfer.received[idx] = true;
+        transfer.receivedCnt++;
+        while (transfer.cumAck < transfer.received.size() &&
+               transfer.received[transfer.cumAck]) {
+            transfer.cumAck++;
+        }
+    }
+
+    void StreamReceiver::updateLossRate(Transfer &transfer, size_t idx)
+    {
+        if (idx < transfer.nextIdx) {
+            // Retransmission or reordering
+            return;
+        }
+
+        // Skipped chunks of first transmission were lost
+        size_t gap = std::min(idx - transfer.nextIdx, LOSS_RATE_MAX_GAP);
+        for (size_t i = 0; i < gap; i++) {
+            m_lossRate += LOSS_RATE_ALPHA * (1 - m_lossRate);
+        }
+        m_lossRate -= LOSS_RATE_ALPHA * m_lossRate;
+        transfer.nextIdx = idx + 1;
+    }
+
+    void StreamReceiver::recoverGroup(Transfer &transfer, uint32_t start)
+    {
+        // Group bounds were validated when parity was received
+        auto groupIt = transfer.fecGroups.find(start);
+        auto &group = groupIt->second;
+        if (std::all_of(transfer.received.begin() + start,
+                        transfer.received.begin() + start + group.k,
+                        [](bool r) { return r; })) {
+            // Nothing to recover
+            transfer.fecGroups.erase(groupIt);
+            return;
+        }
+
+        std::vector<std::string> shards(group.k);
+        std::vector<bool> present(group.k);
+        for (size_t i = 0; i < group.k; i++) {
+            present[i] = transfer.received[start + i];
+            if (present[i]) {
+                size_t offset = (start + i) * transfer.chunkSize;
+                size_t len = std::min<size_t>(transfer.chunkSize,
+                                              transfer.data.size() - offset);
+                shards[i] = transfer.data.substr(offset, len);
+                shards[i].resize(transfer.chunkSize, '\0');
+            }
+        }
+
+        if (fecDecode(shards, present, group.parity) != ErrCode::SUCCESS) {
+            // Not enough chunks yet
+            return;
+        }
+
+        for (size_t i = 0; i < group.k; i++) {
+            if (!present[i]) {
+                size_t offset = (start + i) * transfer.chunkSize;
+                size_t len = std::min<size_t>(transfer.chunkSize,
+                                              transfer.data.size() - offset);
+                shards[i].resize(len);
+                storeChunk(transfer, start + i, shards[i]);
+            }
+        }
+        transfer.fecGroups.erase(groupIt);
+    }
+
+    bool StreamReceiver::isCompleted(uint32_t transferId) const
+    {
+        return std::find(m_completed.begin(), m_completed.end(), transferId) !=
+               m_completed.end();
+    }
+} // namespace kvik
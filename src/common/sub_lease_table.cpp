@@ -0,0 +1,248 @@
+/**
+ * @file sub_lease_table.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Gateway-side subscriptions with expiring leases
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <algorithm>
+
+#include "kvik/errors.hpp"
+#include "kvik/logger.hpp"
+#include "kvik/sub_lease_table.hpp"
+
+// Log tag
+static const char *KVIK_LOG_TAG = "Kvik/SubLeaseTable";
+
+namespace kvik
+{
+    SubLeaseTable::SubLeaseTable(std::chrono::milliseconds lifetime,
+                                 UnsubCb unsubCb, size_t batchSize,
+                                 std::chrono::milliseconds resolution,
+                                 SharedSubIndex::Policy policy,
+                                 const NodeConfig::TopicSeparators &sep)
+        : m_lifetime{lifetime}, m_resolution{resolution},
+          m_epoch{std::chrono::steady_clock::now()}, m_unsubCb{unsubCb},
+          m_batchSize{batchSize}, m_index{policy, sep}
+    {
+        if (!m_unsubCb) {
+            KVIK_THROW_EXC("Invalid unsubscription callback");
+        }
+
+        if (m_batchSize == 0) {
+            KVIK_THROW_EXC("Batch size can't be 0");
+        }
+
+        if (m_resolution.count() <= 0 || m_lifetime < m_resolution) {
+            KVIK_THROW_EXC("Invalid lease lifetime or resolution");
+        }
+    }
+
+    ErrCode SubLeaseTable::subscribe(ConsumerId consumer,
+                                     const std::string &filter,
+                                     std::chrono::steady_clock::time_point now,
+                                     bool &newUpstream)
+    {
+        return this->subscribeUntil(consumer, filter, now + m_lifetime,
+                                    newUpstream);
+    }
+
+    ErrCode SubLeaseTable::subscribeUntil(
+        ConsumerId consumer, const std::string &filter,
+        std::chrono::steady_clock::time_point expiry, bool &newUpstream)
+    {
+        newUpstream = false;
+        Lease lease{consumer, filter};
+        uint64_t tick;
+        if (m_wheel.getExpiry(lease, tick) == ErrCode::SUCCESS) {
+            m_wheel.schedule(lease, this->toTick(expiry));
+            return ErrCode::SUCCESS;
+        }
+
+        std::string upstream;
+        KVIK_RETURN_ERROR(this->upstreamFilter(filter, upstream));
+        KVIK_RETURN_ERROR(m_index.subscribe(consumer, filter));
+
+        if (m_upstream[upstream]++ == 0) {
+            // Pending unsubscription is cancelled instead of resubscribing
+            newUpstream = m_pendingUnsubs.erase(upstream) == 0;
+        }
+        m_consumerSubs[consumer].push_back(filter);
+        m_wheel.schedule(lease, this->toTick(expiry));
+        return ErrCode::SUCCESS;
+    }
+
+    size_t SubLeaseTable::renewAll(ConsumerId consumer,
+                                   std::chrono::steady_clock::time_point now)
+    {
+        auto it = m_consumerSubs.find(consumer);
+        if (it == m_consumerSubs.end()) {
+            return 0;
+        }
+
+        uint64_t expiry = this->toTick(now + m_lifetime);
+        for (const auto &filter : it->second) {
+            m_wheel.schedule({consumer, filter}, expiry);
+        }
+        return it->second.size();
+    }
+
+    ErrCode SubLeaseTable::unsubscribe(ConsumerId consumer,
+                                       const std::string &filter)
+    {
+        Lease lease{consumer, filter};
+        KVIK_RETURN_ERROR(m_wheel.cancel(lease));
+        this->removeSub(lease);
+        return ErrCode::SUCCESS;
+    }
+
+    void SubLeaseTable::removeConsumer(ConsumerId consumer)
+    {
+        auto it = m_consumerSubs.find(consumer);
+        if (it == m_consumerSubs.end()) {
+            return;
+        }
+
+        auto filters = it->second;
+        for (const auto &filter : filters) {
+            this->unsubscribe(consumer, filter);
+        }
+        m_index.removeConsumer(consumer);
+    }
+
+    void SubLeaseTable::match(const std::string &topic,
+                              std::vector<ConsumerId> &consumers,
+                              std::vector<ConsumerId> *selected)
+    {
+        m_index.match(topic, consumers, selected);
+    }
+
+    void SubLeaseTable::release(ConsumerId consumer)
+    {
+        m_index.release(consumer);
+    }
+
+    size_t SubLeaseTable::tick(std::chrono::steady_clock::time_point now)
+    {
+        // Lease expiring at tick `t` is valid until `t` is over
+        uint64_t nowTick = this->toTick(now);
+        m_expired.clear();
+        m_wheel.advance(nowTick > 0 ? nowTick - 1 : 0, m_expired);
+
+        for (const auto &lease : m_expired) {
+            this->removeSub(lease);
+        }
+        if (!m_expired.empty()) {
+            KVIK_LOGD("%zu subscription leases expired", m_expired.size());
+        }
+
+        this->flushUnsubs();
+        return m_expired.size();
+    }
+
+    void SubLeaseTable::forEach(
+        std::function<void(ConsumerId consumer, const std::string &filter,
+                           std::chrono::steady_clock::time_point expiry)>
+            f) const
+    {
+        for (const auto &[consumer, filters] : m_consumerSubs) {
+            for (const auto &filter : filters) {
+                uint64_t tick = 0;
+                m_wheel.getExpiry({consumer, filter}, tick);
+                f(consumer, filter, m_epoch + tick * m_resolution);
+            }
+        }
+    }
+
+    void SubLeaseTable::upstreamFilters(std::vector<std::string> &filters) const
+    {
+        filters.clear();
+        filters.reserve(m_upstream.size());
+        for (const auto &[filter, cnt] : m_upstream) {
+            filters.push_back(filter);
+        }
+    }
+
+    size_t SubLeaseTable::size() const
+    {
+        return m_wheel.size();
+    }
+
+    size_t SubLeaseTable::upstreamCnt() const
+    {
+        return m_upstream.size();
+    }
+
+    uint64_t SubLeaseTable::toTick(
+        std::chrono::steady_clock::time_point time) const
+    {
+        if (time <= m_epoch) {
+            return 0;
+        }
+
+        auto elapsed = time - m_epoch;
+        uint64_t tick = elapsed / m_resolution;
+        if (elapsed % m_resolution != decltype(elapsed)::zero()) {
+            tick++;
+        }
+        return tick;
+    }
+
+    ErrCode SubLeaseTable::upstreamFilter(const std::string &filter,
+                                          std::string &upstream) const
+    {
+        std::string group;
+        ErrCode res = m_index.parseShared(filter, group, upstream);
+        if (res == ErrCode::NOT_FOUND) {
+            upstream = filter;
+            return ErrCode::SUCCESS;
+        }
+        return res;
+    }
+
+    void SubLeaseTable::removeSub(const Lease &lease)
+    {
+        m_index.unsubscribe(lease.consumer, lease.filter);
+
+        auto subsIt = m_consumerSubs.find(lease.consumer);
+        if (subsIt != m_consumerSubs.end()) {
+            auto &subs = subsIt->second;
+            subs.erase(std::remove(subs.begin(), subs.end(), lease.filter),
+                       subs.end());
+            if (subs.empty()) {
+                m_consumerSubs.erase(subsIt);
+            }
+        }
+
+        // Lease exists only for valid filters
+        std::string upstream;
+        this->upstreamFilter(lease.filter, upstream);
+        auto it = m_upstream.find(upstream);
+        if (it != m_upstream.end() && --it->second == 0) {
+            m_upstream.erase(it);
+            m_pendingUnsubs.insert(upstream);
+        }
+    }
+
+    void SubLeaseTable::flushUnsubs()
+    {
+        if (m_pendingUnsubs.empty()) {
+            return;
+        }
+
+        std::vector<std::string> batch;
+        batch.reserve(std::min(m_batchSize, m_pendingUnsubs.size()));
+        for (auto it = m_pendingUnsubs.begin(); it != m_pendingUnsubs.end();) {
+            batch.push_back(std::move(m_pendingUnsubs.extract(it++).value()));
+            if (batch.size() == m_batchSize) {
+                m_unsubCb(batch);
+                batch.clear();
+            }
+        }
+        if (!batch.empty()) {
+            m_unsubCb(batch);
+        }
+    }
+} // namespace kvik
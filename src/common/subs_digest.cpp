@@ -0,0 +1,38 @@
+/**
+ * @file subs_digest.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Subscription set digest
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <cinttypes>
+#include <cstdio>
+
+#include "kvik/hash.hpp"
+#include "kvik/subs_digest.hpp"
+
+namespace kvik
+{
+    std::string SubsDigest::toString() const
+    {
+        char buf[24];
+        snprintf(buf, sizeof(buf), "%08" PRIx32 "/%" PRIu32, hash, cnt);
+        return buf;
+    }
+
+    SubsDigest calcSubsDigest(const std::vector<std::string> &topics)
+    {
+        // Commutative combination of per-topic hashes
+        uint64_t sum = 0;
+        for (const auto &topic : topics) {
+            sum += fnv1a64(topic);
+        }
+
+        return {
+            .hash = static_cast<uint32_t>(sum ^ (sum >> 32)),
+            .cnt = static_cast<uint32_t>(topics.size()),
+        };
+    }
+} // namespace kvik
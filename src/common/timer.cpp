@@ -25,7 +25,7 @@ namespace kvik
     Timer::~Timer()
     {
         {
-            std::scoped_lock lock{m_mutex};
+            std::scoped_lock lock{KVIK_SITE(m_mutex)};
             m_run = false;
         }
 
@@ -38,8 +38,13 @@ namespace kvik
 
     void Timer::setNextExec(const std::chrono::steady_clock::time_point &tp)
     {
-        const std::scoped_lock lock{m_mutex};
-        m_nextExec = tp;
+        {
+            const std::scoped_lock lock{KVIK_SITE(m_mutex)};
+            m_nextExec = tp;
+        }
+
+        // Wake up handler thread, so that earlier execution isn't missed
+        m_cv.notify_one();
     }
 
     void Timer::handlerThread()
@@ -48,18 +53,19 @@ namespace kvik
         {
             {
                 // Wait for `m_interval` or destructor notification again
-                std::unique_lock lock{m_mutex};
+                UniqueLock lock{KVIK_SITE(m_mutex)};
                 if (m_cv.wait_until(lock, m_nextExec, [this]()
                                     { return !m_run; }))
                 {
                     // Destructor has been called
                     break;
                 }
-            }
 
-            // Schedule next execution
-            // May be overriden by callback itself
-            m_nextExec += m_interval;
+                // Schedule next execution (under lock, so that concurrent
+                // `setNextExec` isn't overwritten)
+                // May be overriden by callback itself
+                m_nextExec += m_interval;
+            }
 
             // Call callback
             m_cb();
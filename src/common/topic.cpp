@@ -0,0 +1,145 @@
+/**
+ * @file topic.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Precompiled topic and topic filter handles
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "kvik/errors.hpp"
+#include "kvik/hash.hpp"
+#include "kvik/topic.hpp"
+
+namespace kvik
+{
+    /**
+     * @brief Splits topic to levels
+     * @param str Topic string
+     * @param sep Level separator (non-empty)
+     * @return Levels
+     */
+    static std::vector<std::string> splitTopic(const std::string &str,
+                                               const std::string &sep)
+    {
+        size_t curPos = 0, nextPos;
+        std::vector<std::string> levels;
+
+        while ((nextPos = str.find(sep, curPos)) != std::string::npos) {
+            levels.push_back(str.substr(curPos, nextPos - curPos));
+            curPos = nextPos + sep.length();
+        }
+
+        // Add the rest
+        levels.push_back(str.substr(curPos));
+
+        return levels;
+    }
+
+    /**
+     * @brief Checks whether separators are usable
+     * @param sep Topic separators
+     * @return true Separators are valid
+     * @return false Some separator is empty
+     */
+    static bool separatorsValid(const TopicSeparators &sep)
+    {
+        return !sep.levelSeparator.empty() &&
+               !sep.singleLevelWildcard.empty() &&
+               !sep.multiLevelWildcard.empty();
+    }
+
+    TopicHandle::TopicHandle(const std::string &str,
+                             const TopicSeparators &sep)
+        : m_str{str}, m_hash{fnv1a64(str)}, m_sep{sep}
+    {
+        if (!separatorsValid(sep)) {
+            KVIK_THROW_EXC("Separator or wildcard strings can't be empty");
+        }
+
+        m_levels = splitTopic(str, sep.levelSeparator);
+    }
+
+    Topic::Topic(const std::string &str, const TopicSeparators &sep)
+        : TopicHandle{str, sep}
+    {
+        if (!Topic::isValid(str, sep)) {
+            KVIK_THROW_EXC("Invalid topic");
+        }
+    }
+
+    bool Topic::isValid(const std::string &str, const TopicSeparators &sep)
+    {
+        return separatorsValid(sep) && !str.empty() &&
+               str.find(sep.singleLevelWildcard) == std::string::npos &&
+               str.find(sep.multiLevelWildcard) == std::string::npos;
+    }
+
+    Filter::Filter(const std::string &str, const TopicSeparators &sep)
+        : TopicHandle{str, sep}
+    {
+        if (!Filter::isValid(str, sep)) {
+            KVIK_THROW_EXC("Invalid topic filter");
+        }
+
+        for (const auto &level : m_levels) {
+            m_singleWild |= level == sep.singleLevelWildcard;
+            m_multiWild |= level == sep.multiLevelWildcard;
+        }
+    }
+
+    bool Filter::isValid(const std::string &str, const TopicSeparators &sep)
+    {
+        if (!separatorsValid(sep) || str.empty()) {
+            return false;
+        }
+
+        auto levels = splitTopic(str, sep.levelSeparator);
+        for (size_t i = 0; i < levels.size(); i++) {
+            const auto &level = levels[i];
+
+            if (level == sep.singleLevelWildcard) {
+                continue;
+            }
+
+            if (level == sep.multiLevelWildcard) {
+                if (i != levels.size() - 1) {
+                    return false;
+                }
+                continue;
+            }
+
+            // Wildcard tokens must take whole level
+            if (level.find(sep.singleLevelWildcard) != std::string::npos ||
+                level.find(sep.multiLevelWildcard) != std::string::npos) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool Filter::matches(const Topic &topic) const
+    {
+        const auto &levels = topic.levels();
+
+        for (size_t i = 0; i < m_levels.size(); i++) {
+            const auto &level = m_levels[i];
+
+            // Multi-level wildcard requires at least one more level
+            if (level == m_sep.multiLevelWildcard) {
+                return i < levels.size();
+            }
+
+            if (i >= levels.size()) {
+                return false;
+            }
+
+            if (level != m_sep.singleLevelWildcard && level != levels[i]) {
+                return false;
+            }
+        }
+
+        return m_levels.size() == levels.size();
+    }
+} // namespace kvik
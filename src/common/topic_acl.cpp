@@ -0,0 +1,309 @@
+/**
+ * @file topic_acl.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Topic access control lists
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+#include "kvik/errors.hpp"
+#include "kvik/logger.hpp"
+#include "kvik/topic_acl.hpp"
+
+// Log tag
+static const char *KVIK_LOG_TAG = "Kvik/TopicAcl";
+
+namespace kvik
+{
+    TopicAcl::TopicAcl(bool defaultAllow, size_t cacheSize,
+                       const NodeConfig::TopicSeparators &sep)
+        : m_defaultAllow{defaultAllow}, m_sep{sep}, m_cache(cacheSize)
+    {
+        if ((cacheSize & (cacheSize - 1)) != 0) {
+            KVIK_THROW_EXC("Cache size must be power of 2");
+        }
+
+        // Tries are created on demand, validate separators now
+        this->newRules();
+
+        // Most topic levels are short, avoid reallocations on first lookups
+        m_levelBuf.reserve(TOPIC_ACL_CACHE_KEY_LEN);
+    }
+
+    ErrCode TopicAcl::allow(const LocalAddr &client, const std::string &filter,
+                            AclAccess access)
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        return this->addRule(this->getClient(client).rules, filter, access, false);
+    }
+
+    ErrCode TopicAcl::deny(const LocalAddr &client, const std::string &filter,
+                           AclAccess access)
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        return this->addRule(this->getClient(client).rules, filter, access, true);
+    }
+
+    ErrCode TopicAcl::allowGroup(const std::string &group,
+                                 const std::string &filter, AclAccess access)
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        return this->addRule(m_groups[this->getGroupIdx(group)], filter,
+                             access, false);
+    }
+
+    ErrCode TopicAcl::denyGroup(const std::string &group,
+                                const std::string &filter, AclAccess access)
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        return this->addRule(m_groups[this->getGroupIdx(group)], filter,
+                             access, true);
+    }
+
+    ErrCode TopicAcl::removeRule(const LocalAddr &client,
+                                 const std::string &filter)
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+
+        auto it = m_clients.find(client);
+        if (it == m_clients.end() || !it->second.rules.remove(filter)) {
+            return ErrCode::NOT_FOUND;
+        }
+
+        m_ruleCnt--;
+        this->invalidateCache();
+        return ErrCode::SUCCESS;
+    }
+
+    ErrCode TopicAcl::removeGroupRule(const std::string &group,
+                                      const std::string &filter)
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+
+        auto it = m_groupIdxs.find(group);
+        if (it == m_groupIdxs.end() || !m_groups[it->second].remove(filter)) {
+            return ErrCode::NOT_FOUND;
+        }
+
+        m_ruleCnt--;
+        this->invalidateCache();
+        return ErrCode::SUCCESS;
+    }
+
+    void TopicAcl::addToGroup(const LocalAddr &client, const std::string &group)
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+
+        size_t idx = this->getGroupIdx(group);
+        auto &groups = this->getClient(client).groups;
+        if (std::find(groups.begin(), groups.end(), idx) == groups.end()) {
+            groups.push_back(idx);
+            this->invalidateCache();
+        }
+    }
+
+    ErrCode TopicAcl::removeFromGroup(const LocalAddr &client,
+                                      const std::string &group)
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+
+        auto clientIt = m_clients.find(client);
+        auto groupIt = m_groupIdxs.find(group);
+        if (clientIt == m_clients.end() || groupIt == m_groupIdxs.end()) {
+            return ErrCode::NOT_FOUND;
+        }
+
+        auto &groups = clientIt->second.groups;
+        auto it = std::find(groups.begin(), groups.end(), groupIt->second);
+        if (it == groups.end()) {
+            return ErrCode::NOT_FOUND;
+        }
+
+        groups.erase(it);
+        this->invalidateCache();
+        return ErrCode::SUCCESS;
+    }
+
+    void TopicAcl::removeClient(const LocalAddr &client)
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+
+        auto it = m_clients.find(client);
+        if (it == m_clients.end()) {
+            return;
+        }
+
+        it->second.rules.forEach([this](const std::string &, const Rule &) {
+            m_ruleCnt--;
+        });
+        m_clients.erase(it);
+        this->invalidateCache();
+    }
+
+    void TopicAcl::clear()
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+
+        m_clients.clear();
+        m_groupIdxs.clear();
+        m_groups.clear();
+        m_ruleCnt = 0;
+        this->invalidateCache();
+    }
+
+    size_t TopicAcl::ruleCnt() const
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        return m_ruleCnt;
+    }
+
+    bool TopicAcl::authorize(const LocalAddr &client, std::string_view topic,
+                             AclAccess access)
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+
+        uint8_t accessBits = static_cast<uint8_t>(access);
+        size_t addrLen = client.addr.size();
+        bool cacheable = !m_cache.empty() &&
+                         addrLen + topic.size() <= TOPIC_ACL_CACHE_KEY_LEN;
+
+        if (!cacheable) {
+            return this->evaluate(client, topic, accessBits);
+        }
+
+        uint64_t hash = fnv1a64(client.addr.data(), addrLen);
+        hash = fnv1a64(&accessBits, sizeof(accessBits), hash);
+        hash = fnv1a64(topic.data(), topic.size(), hash);
+
+        auto &entry = m_cache[hash & (m_cache.size() - 1)];
+        if (entry.gen == m_gen && entry.hash == hash &&
+            entry.access == accessBits && entry.addrLen == addrLen &&
+            entry.topicLen == topic.size() &&
+            std::memcmp(entry.key, client.addr.data(), addrLen) == 0 &&
+            std::memcmp(entry.key + addrLen, topic.data(), topic.size()) == 0) {
+            m_cacheStats.hits++;
+            return entry.result;
+        }
+
+        m_cacheStats.misses++;
+        bool result = this->evaluate(client, topic, accessBits);
+
+        // Replace cache entry
+        entry.hash = hash;
+        entry.gen = m_gen;
+        entry.access = accessBits;
+        entry.result = result;
+        entry.addrLen = addrLen;
+        entry.topicLen = topic.size();
+        std::memcpy(entry.key, client.addr.data(), addrLen);
+        std::memcpy(entry.key + addrLen, topic.data(), topic.size());
+
+        return result;
+    }
+
+    TopicAcl::CacheStats TopicAcl::cacheStats() const
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        return m_cacheStats;
+    }
+
+    ErrCode TopicAcl::addRule(RuleTrie &rules, const std::string &filter,
+                              AclAccess access, bool deny)
+    {
+        if (filter.empty()) {
+            return ErrCode::INVALID_ARG;
+        }
+
+        if (rules.find(filter).count(filter) == 0) {
+            m_ruleCnt++;
+        }
+
+        Rule &rule = rules[filter];
+        if (deny) {
+            rule.deny |= static_cast<uint8_t>(access);
+        } else {
+            rule.allow |= static_cast<uint8_t>(access);
+        }
+
+        KVIK_LOGD("%s 0x%02x for filter '%s'", deny ? "Denied" : "Allowed",
+                  static_cast<uint8_t>(access), filter.c_str());
+
+        this->invalidateCache();
+        return ErrCode::SUCCESS;
+    }
+
+    size_t TopicAcl::getGroupIdx(const std::string &group)
+    {
+        auto it = m_groupIdxs.find(group);
+        if (it != m_groupIdxs.end()) {
+            return it->second;
+        }
+
+        m_groups.push_back(this->newRules());
+        m_groupIdxs[group] = m_groups.size() - 1;
+        return m_groups.size() - 1;
+    }
+
+    TopicAcl::ClientEntry &TopicAcl::getClient(const LocalAddr &client)
+    {
+        auto it = m_clients.find(client);
+        if (it == m_clients.end()) {
+            it = m_clients.emplace(client, ClientEntry{this->newRules(), {}})
+                     .first;
+        }
+        return it->second;
+    }
+
+    TopicAcl::RuleTrie TopicAcl::newRules() const
+    {
+        return RuleTrie{m_sep.levelSeparator, m_sep.singleLevelWildcard,
+                        m_sep.multiLevelWildcard};
+    }
+
+    bool TopicAcl::evaluate(const LocalAddr &client, std::string_view topic,
+                            uint8_t access)
+    {
+        uint8_t allowed = 0, denied = 0;
+
+        // Stops visiting as soon as any requested access is denied
+        auto visitor = [&allowed, &denied, access](const Rule &rule) {
+            allowed |= rule.allow;
+            denied |= rule.deny;
+            return (denied & access) != 0;
+        };
+
+        auto it = m_clients.find(client);
+        if (it != m_clients.end()) {
+            if (it->second.rules.visitMatches(topic, visitor, m_levelBuf)) {
+                return false;
+            }
+
+            for (size_t idx : it->second.groups) {
+                if (m_groups[idx].visitMatches(topic, visitor, m_levelBuf)) {
+                    return false;
+                }
+            }
+        }
+
+        uint8_t granted = m_defaultAllow ? access : allowed;
+        return (granted & access) == access;
+    }
+
+    void TopicAcl::invalidateCache()
+    {
+        m_gen++;
+
+        // Generation overflow, entries from previous cycle could match
+        if (m_gen == 0) {
+            for (auto &entry : m_cache) {
+                entry.gen = 0;
+            }
+            m_gen = 1;
+        }
+    }
+} // namespace kvik
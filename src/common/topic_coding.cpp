@@ -0,0 +1,88 @@
+/**
+ * @file topic_coding.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Front coding of topic lists
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <algorithm>
+#include <numeric>
+
+#include "kvik/byte_codec.hpp"
+#include "kvik/topic_coding.hpp"
+
+namespace kvik
+{
+    namespace
+    {
+        //! Minimum length of encoded entry (three single byte varints)
+        constexpr size_t MIN_ENTRY_LEN = 3;
+    } // namespace
+
+    void frontEncodeTopics(const std::vector<std::string> &topics,
+                           std::string &out)
+    {
+        std::vector<size_t> order(topics.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&topics](size_t a, size_t b) {
+            return topics[a] < topics[b];
+        });
+
+        putVarint(out, topics.size());
+        const std::string *prev = nullptr;
+        for (auto idx : order) {
+            const auto &topic = topics[idx];
+            size_t prefixLen = 0;
+            if (prev != nullptr) {
+                auto mism = std::mismatch(topic.begin(), topic.end(),
+                                          prev->begin(), prev->end());
+                prefixLen = mism.first - topic.begin();
+            }
+
+            putVarint(out, idx);
+            putVarint(out, prefixLen);
+            putVarint(out, topic.size() - prefixLen);
+            out.append(topic, prefixLen, std::string::npos);
+            prev = &topic;
+        }
+    }
+
+    ErrCode frontDecodeTopics(const std::string &in, size_t &pos,
+                              std::vector<std::string> &topics)
+    {
+        size_t p = pos;
+        uint64_t cnt;
+        if (!getVarint(in, p, cnt) || cnt > (in.size() - p) / MIN_ENTRY_LEN) {
+            return ErrCode::INVALID_ARG;
+        }
+
+        std::vector<std::string> decoded(cnt);
+        std::vector<bool> seen(cnt, false);
+        const std::string *prev = nullptr;
+        for (uint64_t i = 0; i < cnt; i++) {
+            uint64_t idx, prefixLen, suffixLen;
+            if (!getVarint(in, p, idx) || !getVarint(in, p, prefixLen) ||
+                !getVarint(in, p, suffixLen) || idx >= cnt || seen[idx] ||
+                prefixLen > (prev != nullptr ? prev->size() : 0) ||
+                suffixLen > in.size() - p) {
+                return ErrCode::INVALID_ARG;
+            }
+
+            auto &topic = decoded[idx];
+            if (prev != nullptr) {
+                topic.assign(*prev, 0, prefixLen);
+            }
+            topic.append(in, p, suffixLen);
+            p += suffixLen;
+
+            seen[idx] = true;
+            prev = &topic;
+        }
+
+        topics = std::move(decoded);
+        pos = p;
+        return ErrCode::SUCCESS;
+    }
+} // namespace kvik
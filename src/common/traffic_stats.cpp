@@ -0,0 +1,228 @@
+/**
+ * @file traffic_stats.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Streaming traffic statistics
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "kvik/hash.hpp"
+#include "kvik/traffic_stats.hpp"
+
+namespace kvik
+{
+    void DecayedRate::add(double weight,
+                          std::chrono::steady_clock::time_point now,
+                          std::chrono::milliseconds halfLife)
+    {
+        if (lastUpdate != std::chrono::steady_clock::time_point{} &&
+            now > lastUpdate) {
+            std::chrono::duration<double> dt = now - lastUpdate;
+            std::chrono::duration<double> hl = halfLife;
+            value *= std::exp2(-dt / hl);
+        }
+        value += weight;
+        lastUpdate = std::max(now, lastUpdate);
+    }
+
+    double DecayedRate::rate(std::chrono::steady_clock::time_point now,
+                             std::chrono::milliseconds halfLife) const
+    {
+        std::chrono::duration<double> hl = halfLife;
+        double decayed = value;
+        if (now > lastUpdate) {
+            std::chrono::duration<double> dt = now - lastUpdate;
+            decayed *= std::exp2(-dt / hl);
+        }
+
+        // Sum of unit events arriving at rate `r` converges to
+        // `r * halfLife / ln(2)`
+        return decayed * std::log(2.0) / hl.count();
+    }
+
+    HeavyHitters::HeavyHitters(size_t width, size_t depth, size_t k,
+                               std::chrono::milliseconds halfLife)
+        : m_width{std::max<size_t>(width, 1)},
+          m_depth{std::max<size_t>(depth, 1)}, m_halfLife{halfLife},
+          m_msgsSketch(m_width * m_depth), m_bytesSketch(m_width * m_depth),
+          m_top(k)
+    {
+    }
+
+    void HeavyHitters::record(const std::string &key, size_t bytes,
+                              std::chrono::steady_clock::time_point now)
+    {
+        uint64_t hash = fnv1a64(key);
+        uint32_t bytesInc = static_cast<uint32_t>(
+            std::min<size_t>(bytes, std::numeric_limits<uint32_t>::max()));
+        uint64_t msgsEst = this->sketchAdd(m_msgsSketch, hash, 1);
+        uint64_t bytesEst = this->sketchAdd(m_bytesSketch, hash, bytesInc);
+
+        if (m_top.empty()) {
+            return;
+        }
+
+        // Find tracked entry or the least frequent one
+        Entry *minEntry = &m_top[0];
+        for (auto &entry : m_top) {
+            if (entry.msgs > 0 && entry.key == key) {
+                entry.msgs = msgsEst;
+                entry.bytes = bytesEst;
+                entry.msgRate.add(1, now, m_halfLife);
+                entry.byteRate.add(bytes, now, m_halfLife);
+                return;
+            }
+            if (entry.msgs < minEntry->msgs) {
+                minEntry = &entry;
+            }
+        }
+
+        if (minEntry->msgs >= msgsEst) {
+            // Not heavy enough
+            return;
+        }
+
+        // Replace the least frequent entry
+        *minEntry = {};
+        minEntry->key = key;
+        minEntry->msgs = msgsEst;
+        minEntry->bytes = bytesEst;
+        minEntry->msgRate.add(1, now, m_halfLife);
+        minEntry->byteRate.add(bytes, now, m_halfLife);
+    }
+
+    uint64_t HeavyHitters::estimate(const std::string &key) const
+    {
+        return this->sketchGet(m_msgsSketch, fnv1a64(key));
+    }
+
+    std::vector<HeavyHitter> HeavyHitters::top(
+        std::chrono::steady_clock::time_point now) const
+    {
+        std::vector<HeavyHitter> res;
+        for (const auto &entry : m_top) {
+            if (entry.msgs == 0) {
+                continue;
+            }
+            res.push_back({
+                .key = entry.key,
+                .msgs = entry.msgs,
+                .bytes = entry.bytes,
+                .msgRate = entry.msgRate.rate(now, m_halfLife),
+                .byteRate = entry.byteRate.rate(now, m_halfLife),
+            });
+        }
+
+        std::sort(res.begin(), res.end(),
+                  [](const HeavyHitter &a, const HeavyHitter &b) {
+                      return a.msgs > b.msgs;
+                  });
+        return res;
+    }
+
+    void HeavyHitters::clear()
+    {
+        std::fill(m_msgsSketch.begin(), m_msgsSketch.end(), 0);
+        std::fill(m_bytesSketch.begin(), m_bytesSketch.end(), 0);
+        std::fill(m_top.begin(), m_top.end(), Entry{});
+    }
+
+    uint64_t HeavyHitters::sketchAdd(std::vector<uint32_t> &sketch,
+                                     uint64_t hash, uint32_t inc)
+    {
+        // Double hashing to derive independent row hashes
+        uint32_t h1 = hash, h2 = (hash >> 32) | 1;
+        uint64_t est = std::numeric_limits<uint64_t>::max();
+
+        for (size_t row = 0; row < m_depth; row++) {
+            auto &counter = sketch[row * m_width + (h1 + row * h2) % m_width];
+
+            // Saturating add
+            counter = counter > std::numeric_limits<uint32_t>::max() - inc
+                          ? std::numeric_limits<uint32_t>::max()
+                          : counter + inc;
+            est = std::min<uint64_t>(est, counter);
+        }
+
+        return est;
+    }
+
+    uint64_t HeavyHitters::sketchGet(const std::vector<uint32_t> &sketch,
+                                     uint64_t hash) const
+    {
+        uint32_t h1 = hash, h2 = (hash >> 32) | 1;
+        uint64_t est = std::numeric_limits<uint64_t>::max();
+
+        for (size_t row = 0; row < m_depth; row++) {
+            est = std::min<uint64_t>(
+                est, sketch[row * m_width + (h1 + row * h2) % m_width]);
+        }
+
+        return est;
+    }
+
+    TrafficStats::TrafficStats(size_t width, size_t depth, size_t k,
+                               std::chrono::milliseconds halfLife)
+        : m_halfLife{halfLife}, m_topics{width, depth, k, halfLife},
+          m_sources{width, depth, k, halfLife}
+    {
+    }
+
+    void TrafficStats::record(const LocalAddr &src, const std::string &topic,
+                              size_t bytes,
+                              std::chrono::steady_clock::time_point now)
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+
+        m_msgs++;
+        m_bytes += bytes;
+        m_msgRate.add(1, now, m_halfLife);
+        m_byteRate.add(bytes, now, m_halfLife);
+
+        m_topics.record(topic, bytes, now);
+        if (!src.empty()) {
+            // Raw address is used as key, converted to hexdump in snapshot
+            m_sources.record({src.addr.begin(), src.addr.end()}, bytes, now);
+        }
+    }
+
+    TrafficStats::Snapshot TrafficStats::snapshot(
+        std::chrono::steady_clock::time_point now) const
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+
+        Snapshot snap = {
+            .msgs = m_msgs,
+            .bytes = m_bytes,
+            .msgRate = m_msgRate.rate(now, m_halfLife),
+            .byteRate = m_byteRate.rate(now, m_halfLife),
+            .topTopics = m_topics.top(now),
+            .topSources = m_sources.top(now),
+        };
+
+        for (auto &hh : snap.topSources) {
+            LocalAddr addr;
+            addr.addr = {hh.key.begin(), hh.key.end()};
+            hh.key = addr.toString();
+        }
+
+        return snap;
+    }
+
+    void TrafficStats::clear()
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+
+        m_msgs = 0;
+        m_bytes = 0;
+        m_msgRate = {};
+        m_byteRate = {};
+        m_topics.clear();
+        m_sources.clear();
+    }
+} // namespace kvik
@@ -0,0 +1,400 @@
+/**
+ * @file typed_payload.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Compact encoding of typed payloads
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <cstring>
+
+#include "kvik/byte_codec.hpp"
+#include "kvik/errors.hpp"
+#include "kvik/typed_payload.hpp"
+
+namespace kvik
+{
+    namespace
+    {
+        /**
+         * @brief Appends zigzag varint to `out`
+         * @param out Output buffer
+         * @param val Value
+         */
+        void putZigzag(std::string &out, int64_t val)
+        {
+            // Zigzag: small negative numbers are small unsigned numbers too
+            putVarint(out, (static_cast<uint64_t>(val) << 1) ^
+                               static_cast<uint64_t>(val >> 63));
+        }
+
+        /**
+         * @brief Reads zigzag varint from `in` at `pos`
+         * @param in Input buffer
+         * @param pos Position (advanced in-place)
+         * @param val Value (modified in-place)
+         * @return true Successfully read
+         * @return false Truncated or too long varint
+         */
+        bool getZigzag(const std::string &in, size_t &pos, int64_t &val)
+        {
+            uint64_t zz;
+            if (!getVarint(in, pos, zz)) {
+                return false;
+            }
+            val = static_cast<int64_t>(zz >> 1) ^ -static_cast<int64_t>(zz & 1);
+            return true;
+        }
+
+        /**
+         * @brief Converts single precision float to half precision bits
+         *
+         * Rounds to nearest even, overflows to infinity, keeps NaN.
+         *
+         * @param val Value
+         * @return Half precision bits
+         */
+        uint16_t floatToHalf(float val)
+        {
+            uint32_t f;
+            memcpy(&f, &val, sizeof(f));
+
+            uint16_t sign = (f >> 16) & 0x8000;
+            int32_t exp = static_cast<int32_t>((f >> 23) & 0xFF) - 127 + 15;
+            uint32_t mant = f & 0x7FFFFF;
+
+            if (((f >> 23) & 0xFF) == 0xFF) {
+                // Infinity or NaN
+                return sign | 0x7C00 | (mant ? 0x200 : 0);
+            }
+
+            if (exp >= 0x1F) {
+                // Overflow
+                return sign | 0x7C00;
+            }
+
+            if (exp <= 0) {
+                if (exp < -10) {
+                    // Underflow to zero
+                    return sign;
+                }
+
+                // Subnormal
+                mant |= 0x800000;
+                uint32_t shift = 14 - exp;
+                uint32_t half = mant >> shift;
+                uint32_t rem = mant & ((1u << shift) - 1);
+                uint32_t mid = 1u << (shift - 1);
+                if (rem > mid || (rem == mid && (half & 1))) {
+                    half++;
+                }
+                return sign | half;
+            }
+
+            uint32_t half = (static_cast<uint32_t>(exp) << 10) | (mant >> 13);
+            uint32_t rem = mant & 0x1FFF;
+            if (rem > 0x1000 || (rem == 0x1000 && (half & 1))) {
+                // Can carry into exponent, which is correct (even to inf)
+                half++;
+            }
+            return sign | half;
+        }
+
+        /**
+         * @brief Converts half precision bits to single precision float
+         * @param h Half precision bits
+         * @return Value
+         */
+        float halfToFloat(uint16_t h)
+        {
+            uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+            uint32_t exp = (h >> 10) & 0x1F;
+            uint32_t mant = h & 0x3FF;
+            uint32_t f;
+
+            if (exp == 0x1F) {
+                // Infinity or NaN
+                f = sign | 0x7F800000 | (mant << 13);
+            } else if (exp != 0) {
+                // Normal
+                f = sign | ((exp - 15 + 127) << 23) | (mant << 13);
+            } else if (mant == 0) {
+                // Zero
+                f = sign;
+            } else {
+                // Subnormal, normalize it
+                exp = 127 - 15 + 1;
+                while ((mant & 0x400) == 0) {
+                    mant <<= 1;
+                    exp--;
+                }
+                f = sign | (exp << 23) | ((mant & 0x3FF) << 13);
+            }
+
+            float val;
+            memcpy(&val, &f, sizeof(val));
+            return val;
+        }
+
+        void putFloat(std::string &out, float val, bool half)
+        {
+            if (half) {
+                putLE(out, floatToHalf(val), 2);
+            } else {
+                uint32_t f;
+                memcpy(&f, &val, sizeof(f));
+                putLE(out, f, 4);
+            }
+        }
+
+        bool getFloat(const std::string &in, size_t &pos, float &val,
+                      bool half)
+        {
+            size_t len = half ? 2 : 4;
+            if (pos + len > in.size()) {
+                return false;
+            }
+
+            if (half) {
+                val = halfToFloat(static_cast<uint16_t>(getLE(in, pos, 2)));
+            } else {
+                auto f = static_cast<uint32_t>(getLE(in, pos, 4));
+                memcpy(&val, &f, sizeof(val));
+            }
+            return true;
+        }
+
+        std::string tagged(PayloadType pt)
+        {
+            return std::string(1, static_cast<char>(pt));
+        }
+    } // namespace
+
+    const char *payloadTypeToStr(PayloadType pt) noexcept
+    {
+        switch (pt) {
+        case PayloadType::RAW:
+            return "RAW";
+        case PayloadType::INT:
+            return "INT";
+        case PayloadType::FLOAT16:
+            return "FLOAT16";
+        case PayloadType::FLOAT32:
+            return "FLOAT32";
+        case PayloadType::BOOL:
+            return "BOOL";
+        case PayloadType::INT_ARRAY:
+            return "INT_ARRAY";
+        case PayloadType::FLOAT16_ARRAY:
+            return "FLOAT16_ARRAY";
+        case PayloadType::FLOAT32_ARRAY:
+            return "FLOAT32_ARRAY";
+        case PayloadType::BOOL_ARRAY:
+            return "BOOL_ARRAY";
+        default:
+            return "???";
+        }
+    }
+
+    PayloadType typedPayloadType(const std::string &payload) noexcept
+    {
+        if (payload.empty()) {
+            return PayloadType::RAW;
+        }
+
+        auto pt = static_cast<PayloadType>(payload[0]);
+        switch (pt) {
+        case PayloadType::INT:
+        case PayloadType::FLOAT16:
+        case PayloadType::FLOAT32:
+        case PayloadType::BOOL:
+        case PayloadType::INT_ARRAY:
+        case PayloadType::FLOAT16_ARRAY:
+        case PayloadType::FLOAT32_ARRAY:
+        case PayloadType::BOOL_ARRAY:
+            return pt;
+        default:
+            return PayloadType::RAW;
+        }
+    }
+
+    std::string typedPayloadFromInt(int64_t val)
+    {
+        std::string payload = tagged(PayloadType::INT);
+        putZigzag(payload, val);
+        return payload;
+    }
+
+    std::string typedPayloadFromFloat(float val, bool half)
+    {
+        std::string payload = tagged(half ? PayloadType::FLOAT16
+                                          : PayloadType::FLOAT32);
+        putFloat(payload, val, half);
+        return payload;
+    }
+
+    std::string typedPayloadFromBool(bool val)
+    {
+        std::string payload = tagged(PayloadType::BOOL);
+        payload += static_cast<char>(val ? 1 : 0);
+        return payload;
+    }
+
+    ErrCode typedPayloadFromIntArray(const std::vector<int64_t> &vals,
+                                     std::string &payload)
+    {
+        if (vals.size() > TYPED_PAYLOAD_MAX_ARRAY_LEN) {
+            return ErrCode::INVALID_SIZE;
+        }
+
+        payload = tagged(PayloadType::INT_ARRAY);
+        payload += static_cast<char>(vals.size());
+        for (const auto val : vals) {
+            putZigzag(payload, val);
+        }
+        return ErrCode::SUCCESS;
+    }
+
+    ErrCode typedPayloadFromFloatArray(const std::vector<float> &vals,
+                                       std::string &payload, bool half)
+    {
+        if (vals.size() > TYPED_PAYLOAD_MAX_ARRAY_LEN) {
+            return ErrCode::INVALID_SIZE;
+        }
+
+        payload = tagged(half ? PayloadType::FLOAT16_ARRAY
+                              : PayloadType::FLOAT32_ARRAY);
+        payload.reserve(2 + vals.size() * (half ? 2 : 4));
+        payload += static_cast<char>(vals.size());
+        for (const auto val : vals) {
+            putFloat(payload, val, half);
+        }
+        return ErrCode::SUCCESS;
+    }
+
+    ErrCode typedPayloadFromBoolArray(const std::vector<bool> &vals,
+                                      std::string &payload)
+    {
+        if (vals.size() > TYPED_PAYLOAD_MAX_ARRAY_LEN) {
+            return ErrCode::INVALID_SIZE;
+        }
+
+        payload = tagged(PayloadType::BOOL_ARRAY);
+        payload += static_cast<char>(vals.size());
+        payload.append((vals.size() + 7) / 8, '\0');
+        for (size_t i = 0; i < vals.size(); i++) {
+            if (vals[i]) {
+                payload[2 + i / 8] |= static_cast<char>(1 << (i % 8));
+            }
+        }
+        return ErrCode::SUCCESS;
+    }
+
+    ErrCode typedPayloadToInt(const std::string &payload, int64_t &val)
+    {
+        if (typedPayloadType(payload) != PayloadType::INT) {
+            return ErrCode::INVALID_ARG;
+        }
+
+        size_t pos = 1;
+        if (!getZigzag(payload, pos, val) || pos != payload.size()) {
+            return ErrCode::INVALID_ARG;
+        }
+        return ErrCode::SUCCESS;
+    }
+
+    ErrCode typedPayloadToFloat(const std::string &payload, float &val)
+    {
+        auto pt = typedPayloadType(payload);
+        if (pt != PayloadType::FLOAT16 && pt != PayloadType::FLOAT32) {
+            return ErrCode::INVALID_ARG;
+        }
+
+        size_t pos = 1;
+        if (!getFloat(payload, pos, val, pt == PayloadType::FLOAT16) ||
+            pos != payload.size()) {
+            return ErrCode::INVALID_ARG;
+        }
+        return ErrCode::SUCCESS;
+    }
+
+    ErrCode typedPayloadToBool(const std::string &payload, bool &val)
+    {
+        if (typedPayloadType(payload) != PayloadType::BOOL ||
+            payload.size() != 2) {
+            return ErrCode::INVALID_ARG;
+        }
+
+        val = payload[1] != 0;
+        return ErrCode::SUCCESS;
+    }
+
+    ErrCode typedPayloadToIntArray(const std::string &payload,
+                                   std::vector<int64_t> &vals)
+    {
+        if (typedPayloadType(payload) != PayloadType::INT_ARRAY ||
+            payload.size() < 2) {
+            return ErrCode::INVALID_ARG;
+        }
+
+        size_t cnt = static_cast<uint8_t>(payload[1]);
+        size_t pos = 2;
+        std::vector<int64_t> out(cnt);
+        for (auto &val : out) {
+            if (!getZigzag(payload, pos, val)) {
+                return ErrCode::INVALID_ARG;
+            }
+        }
+        if (pos != payload.size()) {
+            return ErrCode::INVALID_ARG;
+        }
+
+        vals = std::move(out);
+        return ErrCode::SUCCESS;
+    }
+
+    ErrCode typedPayloadToFloatArray(const std::string &payload,
+                                     std::vector<float> &vals)
+    {
+        auto pt = typedPayloadType(payload);
+        if ((pt != PayloadType::FLOAT16_ARRAY &&
+             pt != PayloadType::FLOAT32_ARRAY) ||
+            payload.size() < 2) {
+            return ErrCode::INVALID_ARG;
+        }
+
+        bool half = pt == PayloadType::FLOAT16_ARRAY;
+        size_t cnt = static_cast<uint8_t>(payload[1]);
+        if (payload.size() != 2 + cnt * (half ? 2 : 4)) {
+            return ErrCode::INVALID_ARG;
+        }
+
+        size_t pos = 2;
+        vals.resize(cnt);
+        for (auto &val : vals) {
+            getFloat(payload, pos, val, half);
+        }
+        return ErrCode::SUCCESS;
+    }
+
+    ErrCode typedPayloadToBoolArray(const std::string &payload,
+                                    std::vector<bool> &vals)
+    {
+        if (typedPayloadType(payload) != PayloadType::BOOL_ARRAY ||
+            payload.size() < 2) {
+            return ErrCode::INVALID_ARG;
+        }
+
+        size_t cnt = static_cast<uint8_t>(payload[1]);
+        if (payload.size() != 2 + (cnt + 7) / 8) {
+            return ErrCode::INVALID_ARG;
+        }
+
+        vals.resize(cnt);
+        for (size_t i = 0; i < cnt; i++) {
+            vals[i] = (payload[2 + i / 8] >> (i % 8)) & 1;
+        }
+        return ErrCode::SUCCESS;
+    }
+} // namespace kvik
@@ -0,0 +1,48 @@
+/**
+ * @file uplink_slot.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Time-slotted uplink access
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <cinttypes>
+#include <cstdio>
+
+#include "kvik/uplink_slot.hpp"
+
+namespace kvik
+{
+    std::chrono::milliseconds UplinkSlot::nextStart(
+        std::chrono::milliseconds gwTime, bool contention) const
+    {
+        if (!this->assigned()) {
+            return gwTime;
+        }
+
+        auto period = slotLen * frameLen;
+        auto sinceFrameStart = gwTime % period;
+        if (sinceFrameStart.count() < 0) {
+            sinceFrameStart += period;
+        }
+
+        auto start = gwTime - sinceFrameStart + slotLen * (contention ? 0 : idx);
+        if (start < gwTime) {
+            start += period;
+        }
+        return start;
+    }
+
+    std::string UplinkSlot::toString() const
+    {
+        if (!this->assigned()) {
+            return "none";
+        }
+
+        char buf[48];
+        snprintf(buf, sizeof(buf), "%u/%u (%" PRId64 " ms)", idx, frameLen,
+                 static_cast<int64_t>(slotLen.count()));
+        return buf;
+    }
+} // namespace kvik
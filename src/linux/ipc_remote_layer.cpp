@@ -0,0 +1,718 @@
+/**
+ * @file ipc_remote_layer.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Inter-process remote layer (Linux only)
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "kvik/errors.hpp"
+#include "kvik/ipc_remote_layer.hpp"
+#include "kvik/ipc_ring.hpp"
+#include "kvik/logger.hpp"
+#include "kvik/topic.hpp"
+
+// Log tag
+static const char *KVIK_LOG_TAG = "Kvik/IpcRemoteLayer";
+
+namespace kvik
+{
+    namespace
+    {
+        constexpr uint32_t PROTO_VERSION = 1;
+        constexpr uint8_t DATA_TYPE = 1; //!< Ring record with data
+        constexpr size_t MAX_CTRL_LEN = 64 * 1024;
+        constexpr int HANDSHAKE_TIMEOUT_S = 1;
+
+        /**
+         * @brief Control message types
+         *
+         * Control message: `type (1 B) | body`. HELLO and WELCOME carry
+         * descriptor of sender's ring.
+         */
+        enum class CtrlType : uint8_t
+        {
+            HELLO = 1,   //!< Companion: `version (4 B)`
+            WELCOME = 2, //!< Node: `version (4 B) | filters ('\0'-separated)`
+            SUB = 3,     //!< Filter
+            UNSUB = 4,   //!< Filter
+            NOTIFY = 5,  //!< Records are waiting in sender's ring
+        };
+
+        std::string versionStr()
+        {
+            std::string str(sizeof(PROTO_VERSION), '\0');
+            std::memcpy(str.data(), &PROTO_VERSION, sizeof(PROTO_VERSION));
+            return str;
+        }
+
+        bool checkVersion(const std::string &body)
+        {
+            uint32_t version;
+            if (body.size() < sizeof(version)) {
+                return false;
+            }
+            std::memcpy(&version, body.data(), sizeof(version));
+            return version == PROTO_VERSION;
+        }
+
+        bool makeAddr(const std::string &path, sockaddr_un &addr)
+        {
+            if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+                return false;
+            }
+
+            std::memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            std::memcpy(addr.sun_path, path.data(), path.size());
+            return true;
+        }
+
+        void wake(int fd)
+        {
+            uint64_t val = 1;
+            [[maybe_unused]] auto ret = write(fd, &val, sizeof(val));
+        }
+    } // namespace
+
+    /**
+     * @brief Connection between node and companion (used by both sides)
+     */
+    class IpcConn
+    {
+    public:
+        int sock;
+        IpcRing tx; //!< Ring to peer (this side produces)
+        IpcRing rx; //!< Ring from peer (this side consumes)
+        bool ready = false;
+        WildcardTrie<bool> peerSubs; //!< Guarded by owner's mutex
+
+    private:
+        Mutex m_txMutex{"IpcConn/tx"};
+
+    public:
+        IpcConn(int sock, const NodeConfig::TopicSeparators &sep)
+            : sock{sock},
+              peerSubs{sep.levelSeparator, sep.singleLevelWildcard,
+                       sep.multiLevelWildcard}
+        {
+        }
+
+        ~IpcConn()
+        {
+            close(sock);
+        }
+
+        /**
+         * @brief Sends control message
+         *
+         * Never blocks, so slow peer can't stall the sender.
+         *
+         * @param type Message type
+         * @param body Message body
+         * @param fd Descriptor to pass (-1 if none)
+         * @retval QUEUE_FULL Socket buffer is full (peer doesn't read)
+         * @retval GENERIC_FAILURE Peer disconnected
+         * @retval SUCCESS Sent
+         */
+        ErrCode sendCtrl(CtrlType type, std::string_view body, int fd = -1)
+        {
+            uint8_t t = static_cast<uint8_t>(type);
+            iovec iov[2] = {
+                {&t, sizeof(t)},
+                {const_cast<char *>(body.data()), body.size()},
+            };
+
+            msghdr msg = {};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = body.empty() ? 1 : 2;
+
+            alignas(cmsghdr) char cbuf[CMSG_SPACE(sizeof(int))] = {};
+            if (fd >= 0) {
+                msg.msg_control = cbuf;
+                msg.msg_controllen = sizeof(cbuf);
+                cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+                cmsg->cmsg_level = SOL_SOCKET;
+                cmsg->cmsg_type = SCM_RIGHTS;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+                std::memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+            }
+
+            if (sendmsg(sock, &msg, MSG_NOSIGNAL | MSG_DONTWAIT) < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    return ErrCode::QUEUE_FULL;
+                }
+                KVIK_LOGD("Control message not sent: %s", strerror(errno));
+                return ErrCode::GENERIC_FAILURE;
+            }
+            return ErrCode::SUCCESS;
+        }
+
+        /**
+         * @brief Receives control message
+         * @param type Message type (modified in-place)
+         * @param body Message body (modified in-place)
+         * @param fd Passed descriptor, -1 if none (modified in-place)
+         * @retval NOT_FOUND Peer disconnected
+         * @retval GENERIC_FAILURE Receive failed or invalid message
+         * @retval SUCCESS Received
+         */
+        ErrCode recvCtrl(CtrlType &type, std::string &body, int &fd)
+        {
+            fd = -1;
+            body.resize(MAX_CTRL_LEN + 1);
+            uint8_t t;
+            iovec iov[2] = {
+                {&t, sizeof(t)},
+                {body.data(), body.size()},
+            };
+
+            alignas(cmsghdr) char cbuf[CMSG_SPACE(sizeof(int))];
+            msghdr msg = {};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = 2;
+            msg.msg_control = cbuf;
+            msg.msg_controllen = sizeof(cbuf);
+
+            ssize_t len = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+            if (len == 0) {
+                return ErrCode::NOT_FOUND;
+            }
+            if (len < 0) {
+                KVIK_LOGD("Control message not received: %s", strerror(errno));
+                return ErrCode::GENERIC_FAILURE;
+            }
+
+            for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+                 cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+                if (cmsg->cmsg_level == SOL_SOCKET &&
+                    cmsg->cmsg_type == SCM_RIGHTS &&
+                    cmsg->cmsg_len == CMSG_LEN(sizeof(int))) {
+                    std::memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+                }
+            }
+
+            if ((msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) != 0) {
+                if (fd >= 0) {
+                    close(fd);
+                    fd = -1;
+                }
+                return ErrCode::GENERIC_FAILURE;
+            }
+
+            type = static_cast<CtrlType>(t);
+            body.resize(len - sizeof(t));
+            return ErrCode::SUCCESS;
+        }
+
+        /**
+         * @brief Writes data to peer's ring and notifies peer if needed
+         * @param topic Topic
+         * @param payloadLen Length of payload
+         * @param fill Function writing payload
+         * @return Error code of `IpcRing::push()`
+         */
+        ErrCode push(std::string_view topic, size_t payloadLen,
+                     const IpcRing::FillFn &fill)
+        {
+            const std::scoped_lock lock(KVIK_SITE(m_txMutex));
+            bool notify;
+            auto res = tx.push(DATA_TYPE, 0, topic, payloadLen, fill, notify);
+            if (res == ErrCode::SUCCESS && notify) {
+                // Notification is dropped if socket buffer is full, as
+                // messages queued there wake the peer anyway. Other failure
+                // means the peer is gone, which the owner finds out.
+                this->sendCtrl(CtrlType::NOTIFY, {});
+            }
+            return res;
+        }
+    };
+
+    IpcRemoteLayer::IpcRemoteLayer(const std::string &path, size_t ringCapacity,
+                                   const NodeConfig::TopicSeparators &sep)
+        : m_path{path}, m_ringCapacity{ringCapacity}, m_sep{sep},
+          m_subs{sep.levelSeparator, sep.singleLevelWildcard,
+                 sep.multiLevelWildcard}
+    {
+        sockaddr_un addr;
+        if (!makeAddr(path, addr)) {
+            KVIK_THROW_EXC("Invalid socket path");
+        }
+
+        m_listenFd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        m_wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        unlink(path.c_str());
+        if (m_listenFd < 0 || m_wakeFd < 0 ||
+            bind(m_listenFd, reinterpret_cast<sockaddr *>(&addr),
+                 sizeof(addr)) != 0 ||
+            listen(m_listenFd, 16) != 0) {
+            KVIK_LOGE("Socket creation failed: %s", strerror(errno));
+            close(m_listenFd);
+            close(m_wakeFd);
+            KVIK_THROW_EXC("Socket creation failed");
+        }
+
+        m_thread = std::thread(&IpcRemoteLayer::loop, this);
+        KVIK_LOGI("Listening on %s", path.c_str());
+    }
+
+    IpcRemoteLayer::~IpcRemoteLayer()
+    {
+        m_stop = true;
+        wake(m_wakeFd);
+        m_thread.join();
+
+        m_conns.clear();
+        close(m_listenFd);
+        close(m_wakeFd);
+        unlink(m_path.c_str());
+        KVIK_LOGD("Deinitialized");
+    }
+
+    ErrCode IpcRemoteLayer::publish(const PubData &data)
+    {
+        std::vector<std::shared_ptr<IpcConn>> targets;
+        {
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            for (auto &conn : m_conns) {
+                if (conn->ready && !conn->peerSubs.find(data.topic).empty()) {
+                    targets.push_back(conn);
+                }
+            }
+        }
+
+        auto ret = ErrCode::SUCCESS;
+        for (auto &conn : targets) {
+            auto res = conn->push(
+                data.topic, data.payload.size(), [&data](char *buf) {
+                    std::memcpy(buf, data.payload.data(), data.payload.size());
+                });
+            if (res != ErrCode::SUCCESS) {
+                KVIK_LOGW("Data to companion dropped (%d)", static_cast<int>(res));
+                ret = res;
+            }
+        }
+        return ret;
+    }
+
+    ErrCode IpcRemoteLayer::subscribe(const std::string &topic)
+    {
+        if (!Filter::isValid(topic, m_sep)) {
+            return ErrCode::INVALID_ARG;
+        }
+
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        m_subs.insert(topic, true);
+        this->broadcastCtrl(static_cast<uint8_t>(CtrlType::SUB), topic);
+        return ErrCode::SUCCESS;
+    }
+
+    ErrCode IpcRemoteLayer::unsubscribe(const std::string &topic)
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        if (!m_subs.remove(topic)) {
+            return ErrCode::NOT_FOUND;
+        }
+        this->broadcastCtrl(static_cast<uint8_t>(CtrlType::UNSUB), topic);
+        return ErrCode::SUCCESS;
+    }
+
+    size_t IpcRemoteLayer::companionCnt()
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        return std::count_if(m_conns.begin(), m_conns.end(),
+                             [](auto &conn) { return conn->ready; });
+    }
+
+    void IpcRemoteLayer::loop()
+    {
+        std::vector<std::shared_ptr<IpcConn>> conns;
+        std::vector<pollfd> fds;
+        int timeout = -1;
+
+        auto removeConn = [this](const std::shared_ptr<IpcConn> &conn) {
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            m_conns.erase(std::remove(m_conns.begin(), m_conns.end(), conn),
+                          m_conns.end());
+            KVIK_LOGI("Companion disconnected");
+        };
+
+        while (!m_stop) {
+            {
+                const std::scoped_lock lock(KVIK_SITE(m_mutex));
+                conns = m_conns;
+            }
+
+            fds.clear();
+            fds.push_back({m_listenFd, POLLIN, 0});
+            fds.push_back({m_wakeFd, POLLIN, 0});
+            for (auto &conn : conns) {
+                fds.push_back({conn->sock, POLLIN, 0});
+            }
+
+            if (poll(fds.data(), fds.size(), timeout) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                KVIK_LOGE("poll failed: %s", strerror(errno));
+                break;
+            }
+
+            if (fds[1].revents != 0) {
+                uint64_t val;
+                [[maybe_unused]] auto ret = read(m_wakeFd, &val, sizeof(val));
+            }
+
+            if (fds[0].revents != 0) {
+                int fd = accept4(m_listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+                if (fd >= 0) {
+                    const std::scoped_lock lock(KVIK_SITE(m_mutex));
+                    m_conns.push_back(std::make_shared<IpcConn>(fd, m_sep));
+                }
+            }
+
+            // Records are drained regardless of notification, so one
+            // notification covers everything written before it was sent
+            timeout = -1;
+            for (size_t i = 0; i < conns.size(); i++) {
+                auto &conn = conns[i];
+                if (fds[i + 2].revents != 0 && !this->processCtrl(conn)) {
+                    removeConn(conn);
+                    continue;
+                }
+
+                if (!this->drain(conn)) {
+                    KVIK_LOGW("Ring of companion corrupted");
+                    removeConn(conn);
+                    continue;
+                }
+
+                if (!conn->rx.prepareWait()) {
+                    timeout = 0;
+                }
+            }
+        }
+    }
+
+    bool IpcRemoteLayer::processCtrl(const std::shared_ptr<IpcConn> &conn)
+    {
+        CtrlType type;
+        std::string body;
+        int fd;
+        if (conn->recvCtrl(type, body, fd) != ErrCode::SUCCESS) {
+            return false;
+        }
+
+        if (type == CtrlType::HELLO) {
+            if (conn->ready || fd < 0 || !checkVersion(body)) {
+                if (fd >= 0) {
+                    close(fd);
+                }
+                KVIK_LOGW("Invalid handshake of companion");
+                return false;
+            }
+
+            if (conn->rx.attach(fd) != ErrCode::SUCCESS ||
+                conn->tx.create(m_ringCapacity) != ErrCode::SUCCESS) {
+                KVIK_LOGW("Ring of companion couldn't be set up");
+                return false;
+            }
+
+            // Under lock, so no subscription change slips in between
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            std::string welcome = versionStr();
+            m_subs.forEach([&welcome](const std::string &filter, bool) {
+                welcome += filter;
+                welcome += '\0';
+            });
+            if (conn->sendCtrl(CtrlType::WELCOME, welcome, conn->tx.fd()) !=
+                ErrCode::SUCCESS) {
+                return false;
+            }
+
+            conn->ready = true;
+            KVIK_LOGI("Companion connected");
+            return true;
+        }
+
+        if (fd >= 0) {
+            close(fd);
+            return false;
+        }
+
+        if (!conn->ready) {
+            return false;
+        }
+
+        switch (type) {
+        case CtrlType::SUB:
+        case CtrlType::UNSUB: {
+            if (!Filter::isValid(body, m_sep)) {
+                KVIK_LOGW("Invalid filter from companion");
+                return false;
+            }
+
+            const std::scoped_lock lock(KVIK_SITE(m_mutex));
+            if (type == CtrlType::SUB) {
+                conn->peerSubs.insert(body, true);
+            } else {
+                conn->peerSubs.remove(body);
+            }
+            return true;
+        }
+        case CtrlType::NOTIFY:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    bool IpcRemoteLayer::drain(const std::shared_ptr<IpcConn> &conn)
+    {
+        if (!conn->ready) {
+            return true;
+        }
+
+        int cnt = conn->rx.drain([this](const IpcRing::Record &rec) {
+            if (rec.type != DATA_TYPE) {
+                return;
+            }
+
+            SubData data{std::string(rec.topic), std::string(rec.payload)};
+            bool subscribed;
+            {
+                const std::scoped_lock lock(KVIK_SITE(m_mutex));
+                subscribed = !m_subs.find(data.topic).empty();
+            }
+
+            if (subscribed && m_recvCb) {
+                m_recvCb(data);
+            }
+        });
+        return cnt >= 0;
+    }
+
+    void IpcRemoteLayer::broadcastCtrl(uint8_t type, const std::string &body)
+    {
+        for (auto &conn : m_conns) {
+            if (conn->ready &&
+                conn->sendCtrl(static_cast<CtrlType>(type), body) ==
+                    ErrCode::QUEUE_FULL) {
+                // Companion would miss subscription change, disconnect it
+                // (loop removes it on hangup)
+                KVIK_LOGW("Companion doesn't read control messages, "
+                          "disconnecting");
+                conn->ready = false;
+                shutdown(conn->sock, SHUT_RDWR);
+            }
+        }
+    }
+
+    IpcCompanion::IpcCompanion(const std::string &path, RecvCb recvCb,
+                               size_t ringCapacity,
+                               const NodeConfig::TopicSeparators &sep)
+        : m_sep{sep}, m_recvCb{recvCb},
+          m_nodeSubs{sep.levelSeparator, sep.singleLevelWildcard,
+                     sep.multiLevelWildcard}
+    {
+        sockaddr_un addr;
+        if (!makeAddr(path, addr)) {
+            KVIK_THROW_EXC("Invalid socket path");
+        }
+
+        int sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (sock < 0) {
+            KVIK_THROW_EXC("Socket creation failed");
+        }
+        m_conn = std::make_shared<IpcConn>(sock, sep);
+
+        if (connect(sock, reinterpret_cast<sockaddr *>(&addr),
+                    sizeof(addr)) != 0) {
+            KVIK_LOGE("Connection to %s failed: %s", path.c_str(),
+                      strerror(errno));
+            KVIK_THROW_EXC("Connection to node failed");
+        }
+
+        if (m_conn->tx.create(ringCapacity) != ErrCode::SUCCESS) {
+            KVIK_THROW_EXC("Ring creation failed");
+        }
+
+        // Node answers immediately, timeout only guards against stale
+        // socket file
+        timeval tv = {HANDSHAKE_TIMEOUT_S, 0};
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+        CtrlType type;
+        std::string body;
+        int fd = -1;
+        if (m_conn->sendCtrl(CtrlType::HELLO, versionStr(), m_conn->tx.fd()) !=
+                ErrCode::SUCCESS ||
+            m_conn->recvCtrl(type, body, fd) != ErrCode::SUCCESS ||
+            type != CtrlType::WELCOME || fd < 0 || !checkVersion(body)) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            KVIK_THROW_EXC("Handshake with node failed");
+        }
+
+        if (m_conn->rx.attach(fd) != ErrCode::SUCCESS) {
+            KVIK_THROW_EXC("Ring of node couldn't be attached");
+        }
+
+        tv = {0, 0};
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+        // Node's filters follow version
+        size_t pos = sizeof(PROTO_VERSION);
+        while (pos < body.size()) {
+            size_t end = body.find('\0', pos);
+            if (end == std::string::npos) {
+                end = body.size();
+            }
+            m_nodeSubs.insert(body.substr(pos, end - pos), true);
+            pos = end + 1;
+        }
+
+        m_wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (m_wakeFd < 0) {
+            KVIK_THROW_EXC("Event creation failed");
+        }
+
+        m_conn->ready = true;
+        m_connected = true;
+        m_thread = std::thread(&IpcCompanion::loop, this);
+        KVIK_LOGI("Connected to %s", path.c_str());
+    }
+
+    IpcCompanion::~IpcCompanion()
+    {
+        m_stop = true;
+        wake(m_wakeFd);
+        m_thread.join();
+        close(m_wakeFd);
+        KVIK_LOGD("Deinitialized");
+    }
+
+    ErrCode IpcCompanion::publish(std::string_view topic,
+                                  std::string_view payload)
+    {
+        return this->publish(topic, payload.size(), [&payload](char *buf) {
+            std::memcpy(buf, payload.data(), payload.size());
+        });
+    }
+
+    ErrCode IpcCompanion::publish(std::string_view topic, size_t payloadLen,
+                                  const FillFn &fill)
+    {
+        if (!m_connected) {
+            return ErrCode::NO_GATEWAY;
+        }
+
+        if (!this->nodeSubscribed(std::string(topic))) {
+            return ErrCode::SUCCESS;
+        }
+        return m_conn->push(topic, payloadLen, fill);
+    }
+
+    ErrCode IpcCompanion::subscribe(const std::string &filter)
+    {
+        if (!Filter::isValid(filter, m_sep)) {
+            return ErrCode::INVALID_ARG;
+        }
+
+        if (!m_connected) {
+            return ErrCode::NO_GATEWAY;
+        }
+
+        auto res = m_conn->sendCtrl(CtrlType::SUB, filter);
+        if (res == ErrCode::GENERIC_FAILURE) {
+            return ErrCode::NO_GATEWAY;
+        }
+        return res;
+    }
+
+    ErrCode IpcCompanion::unsubscribe(const std::string &filter)
+    {
+        if (!m_connected) {
+            return ErrCode::NO_GATEWAY;
+        }
+
+        auto res = m_conn->sendCtrl(CtrlType::UNSUB, filter);
+        if (res == ErrCode::GENERIC_FAILURE) {
+            return ErrCode::NO_GATEWAY;
+        }
+        return res;
+    }
+
+    bool IpcCompanion::nodeSubscribed(const std::string &topic)
+    {
+        const std::scoped_lock lock(KVIK_SITE(m_mutex));
+        return !m_nodeSubs.find(topic).empty();
+    }
+
+    void IpcCompanion::loop()
+    {
+        // Not waiting yet, node doesn't notify until first `prepareWait()`
+        int timeout = 0;
+        while (!m_stop) {
+            pollfd fds[2] = {
+                {m_conn->sock, POLLIN, 0},
+                {m_wakeFd, POLLIN, 0},
+            };
+
+            if (poll(fds, 2, timeout) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                KVIK_LOGE("poll failed: %s", strerror(errno));
+                break;
+            }
+
+            if (fds[0].revents != 0) {
+                CtrlType type;
+                std::string body;
+                int fd;
+                if (m_conn->recvCtrl(type, body, fd) != ErrCode::SUCCESS) {
+                    KVIK_LOGW("Node disconnected");
+                    break;
+                }
+                if (fd >= 0) {
+                    close(fd);
+                }
+
+                if (type == CtrlType::SUB || type == CtrlType::UNSUB) {
+                    const std::scoped_lock lock(KVIK_SITE(m_mutex));
+                    if (type == CtrlType::SUB) {
+                        m_nodeSubs.insert(body, true);
+                    } else {
+                        m_nodeSubs.remove(body);
+                    }
+                }
+            }
+
+            int cnt = m_conn->rx.drain([this](const IpcRing::Record &rec) {
+                if (rec.type == DATA_TYPE && m_recvCb) {
+                    m_recvCb(rec.topic, rec.payload);
+                }
+            });
+            if (cnt < 0) {
+                KVIK_LOGW("Ring of node corrupted");
+                break;
+            }
+
+            timeout = m_conn->rx.prepareWait() ? -1 : 0;
+        }
+
+        m_connected = false;
+    }
+} // namespace kvik
@@ -0,0 +1,283 @@
+/**
+ * @file ipc_ring.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Single-producer single-consumer ring in shared memory
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <cstring>
+#include <new>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "kvik/errors.hpp"
+#include "kvik/ipc_ring.hpp"
+#include "kvik/logger.hpp"
+
+// Log tag
+static const char *KVIK_LOG_TAG = "Kvik/IpcRing";
+
+namespace kvik
+{
+    namespace
+    {
+        constexpr uint64_t MAGIC = 0x4B56494B52494E47; // "KVIKRING"
+        constexpr uint8_t PAD_TYPE = 0;
+        constexpr size_t HDR_SPACE = 4096; //!< Space reserved for header
+        constexpr size_t MIN_CAPACITY = 4096;
+        constexpr size_t REC_HDR_LEN = 12;
+        constexpr size_t REC_ALIGN = 8;
+
+        static_assert(sizeof(uint64_t) * 2 + 3 * 64 <= HDR_SPACE,
+                      "Header doesn't fit");
+
+        size_t align(size_t len)
+        {
+            return (len + REC_ALIGN - 1) & ~(REC_ALIGN - 1);
+        }
+
+        uint32_t readU32(const char *buf)
+        {
+            uint32_t val;
+            std::memcpy(&val, buf, sizeof(val));
+            return val;
+        }
+
+        void writeU32(char *buf, uint32_t val)
+        {
+            std::memcpy(buf, &val, sizeof(val));
+        }
+    } // namespace
+
+    IpcRing::~IpcRing()
+    {
+        this->close();
+    }
+
+    ErrCode IpcRing::create(size_t capacity)
+    {
+        if (m_fd >= 0) {
+            return ErrCode::INVALID_ARG;
+        }
+
+        size_t cap = MIN_CAPACITY;
+        while (cap < capacity) {
+            cap *= 2;
+        }
+
+        m_fd = memfd_create("kvik_ipc_ring", MFD_CLOEXEC);
+        if (m_fd < 0) {
+            KVIK_LOGE("memfd_create failed: %s", strerror(errno));
+            return ErrCode::GENERIC_FAILURE;
+        }
+
+        if (ftruncate(m_fd, HDR_SPACE + cap) != 0 ||
+            !this->map(HDR_SPACE + cap)) {
+            KVIK_LOGE("Shared memory allocation failed: %s", strerror(errno));
+            this->close();
+            return ErrCode::GENERIC_FAILURE;
+        }
+
+        // Memory is zeroed, header just has to be constructed
+        m_hdr = new (m_mem) Header();
+        m_hdr->magic = MAGIC;
+        m_hdr->capacity = cap;
+        m_data = static_cast<char *>(m_mem) + HDR_SPACE;
+        m_mask = cap - 1;
+        return ErrCode::SUCCESS;
+    }
+
+    ErrCode IpcRing::attach(int fd)
+    {
+        if (m_fd >= 0) {
+            ::close(fd);
+            return ErrCode::INVALID_ARG;
+        }
+        m_fd = fd;
+
+        struct stat st;
+        if (fstat(m_fd, &st) != 0 ||
+            static_cast<size_t>(st.st_size) < HDR_SPACE + MIN_CAPACITY) {
+            this->close();
+            return ErrCode::INVALID_ARG;
+        }
+
+        if (!this->map(st.st_size)) {
+            KVIK_LOGE("Shared memory mapping failed: %s", strerror(errno));
+            this->close();
+            return ErrCode::GENERIC_FAILURE;
+        }
+
+        auto *hdr = static_cast<Header *>(m_mem);
+        uint64_t cap = hdr->capacity;
+        if (hdr->magic != MAGIC || cap < MIN_CAPACITY ||
+            (cap & (cap - 1)) != 0 ||
+            HDR_SPACE + cap != static_cast<uint64_t>(st.st_size)) {
+            this->close();
+            return ErrCode::INVALID_ARG;
+        }
+
+        m_hdr = hdr;
+        m_data = static_cast<char *>(m_mem) + HDR_SPACE;
+        m_mask = cap - 1;
+        return ErrCode::SUCCESS;
+    }
+
+    ErrCode IpcRing::push(uint8_t type, uint8_t flags, std::string_view topic,
+                          size_t payloadLen, const FillFn &fill, bool &notify)
+    {
+        notify = false;
+        if (m_hdr == nullptr) {
+            return ErrCode::INVALID_ARG;
+        }
+
+        size_t need = align(REC_HDR_LEN + topic.size() + payloadLen);
+        if (topic.size() > UINT16_MAX || need > this->capacity() / 2) {
+            return ErrCode::INVALID_SIZE;
+        }
+
+        // Tail is written by other process, so it's checked by arithmetic
+        uint64_t head = m_hdr->head.load(std::memory_order_relaxed);
+        uint64_t tail = m_hdr->tail.load(std::memory_order_acquire);
+        uint64_t idx = head & m_mask;
+        uint64_t pad = this->capacity() - idx < need ? this->capacity() - idx
+                                                      : 0;
+        if (head + pad + need - tail > this->capacity()) {
+            return ErrCode::QUEUE_FULL;
+        }
+
+        if (pad != 0) {
+            writeU32(m_data + idx, pad);
+            m_data[idx + 4] = static_cast<char>(PAD_TYPE);
+            head += pad;
+            idx = 0;
+        }
+
+        char *rec = m_data + idx;
+        writeU32(rec, need);
+        rec[4] = static_cast<char>(type);
+        rec[5] = static_cast<char>(flags);
+        uint16_t topicLen = topic.size();
+        std::memcpy(rec + 6, &topicLen, sizeof(topicLen));
+        writeU32(rec + 8, payloadLen);
+        std::memcpy(rec + REC_HDR_LEN, topic.data(), topic.size());
+        if (payloadLen > 0) {
+            fill(rec + REC_HDR_LEN + topic.size());
+        }
+
+        // Pairs with `prepareWait()`: either consumer sees new head, or
+        // producer sees it waiting
+        m_hdr->head.store(head + need, std::memory_order_seq_cst);
+        notify = m_hdr->waiting.exchange(0, std::memory_order_seq_cst) != 0;
+        return ErrCode::SUCCESS;
+    }
+
+    ErrCode IpcRing::push(uint8_t type, uint8_t flags, std::string_view topic,
+                          std::string_view payload, bool &notify)
+    {
+        return this->push(
+            type, flags, topic, payload.size(),
+            [&payload](char *buf) {
+                std::memcpy(buf, payload.data(), payload.size());
+            },
+            notify);
+    }
+
+    int IpcRing::drain(const std::function<void(const Record &)> &f)
+    {
+        if (m_hdr == nullptr) {
+            return 0;
+        }
+
+        uint64_t tail = m_hdr->tail.load(std::memory_order_relaxed);
+        uint64_t head = m_hdr->head.load(std::memory_order_acquire);
+        int cnt = 0;
+        while (tail != head) {
+            // Head is written by other process, everything is validated
+            uint64_t idx = tail & m_mask;
+            const char *rec = m_data + idx;
+            uint64_t avail = head - tail;
+            if (avail < REC_ALIGN || avail > this->capacity()) {
+                return -1;
+            }
+
+            uint32_t len = readU32(rec);
+            if (len < REC_ALIGN || len % REC_ALIGN != 0 || len > avail ||
+                idx + len > this->capacity()) {
+                return -1;
+            }
+
+            if (static_cast<uint8_t>(rec[4]) != PAD_TYPE) {
+                uint16_t topicLen;
+                std::memcpy(&topicLen, rec + 6, sizeof(topicLen));
+                uint32_t payloadLen = readU32(rec + 8);
+                if (len < REC_HDR_LEN ||
+                    static_cast<uint64_t>(topicLen) + payloadLen >
+                        len - REC_HDR_LEN) {
+                    return -1;
+                }
+
+                Record record;
+                record.type = rec[4];
+                record.flags = rec[5];
+                record.topic = {rec + REC_HDR_LEN, topicLen};
+                record.payload = {rec + REC_HDR_LEN + topicLen, payloadLen};
+                f(record);
+                cnt++;
+            }
+
+            tail += len;
+            m_hdr->tail.store(tail, std::memory_order_release);
+        }
+        return cnt;
+    }
+
+    bool IpcRing::prepareWait()
+    {
+        if (m_hdr == nullptr) {
+            return true;
+        }
+
+        m_hdr->waiting.store(1, std::memory_order_seq_cst);
+        if (m_hdr->head.load(std::memory_order_seq_cst) !=
+            m_hdr->tail.load(std::memory_order_relaxed)) {
+            m_hdr->waiting.store(0, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    bool IpcRing::map(size_t len)
+    {
+        void *mem =
+            mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+        if (mem == MAP_FAILED) {
+            return false;
+        }
+
+        m_mem = mem;
+        m_mapLen = len;
+        return true;
+    }
+
+    void IpcRing::close()
+    {
+        if (m_mem != nullptr) {
+            munmap(m_mem, m_mapLen);
+        }
+        if (m_fd >= 0) {
+            ::close(m_fd);
+        }
+
+        m_fd = -1;
+        m_mem = nullptr;
+        m_mapLen = 0;
+        m_hdr = nullptr;
+        m_data = nullptr;
+        m_mask = 0;
+    }
+} // namespace kvik
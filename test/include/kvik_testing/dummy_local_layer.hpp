@@ -11,6 +11,7 @@
 
 #include <chrono>
 #include <mutex>
+#include <queue>
 #include <string>
 #include <thread>
 #include <vector>
@@ -49,6 +50,12 @@ namespace kvik
         //! Time unit of response messages
         std::chrono::milliseconds respTimeUnit = std::chrono::seconds(1);
 
+        //! Duration of `send` (simulates transmission time)
+        std::chrono::milliseconds sendDelay = std::chrono::milliseconds(0);
+
+        //! Airtime returned by `estimateAirtime`
+        std::chrono::microseconds airtime = std::chrono::microseconds(0);
+
         SentLog sentLog;         //!< All sent messages
         ChannelsLog channelsLog; //!< All set channels
 
@@ -57,6 +64,8 @@ namespace kvik
 
         ErrCode send(const LocalMsg &msg)
         {
+            std::this_thread::sleep_for(sendDelay);
+
             const std::scoped_lock lock{_mutex};
             sentLog.push_back(msg);
 
@@ -86,6 +95,11 @@ namespace kvik
             return setChannelRet;
         }
 
+        std::chrono::microseconds estimateAirtime(const LocalMsg &)
+        {
+            return airtime;
+        }
+
         /**
          * @brief Simulates message reception
          *
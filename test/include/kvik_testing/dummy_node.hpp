@@ -39,6 +39,8 @@ namespace kvik
         using INode::validateMsgId;
         using INode::validateMsgTimestamp;
         using INode::buildReportRssiTopic;
+        using INode::buildReportRssiPayload;
+        using INode::recordTraffic;
 
         ErrCode pubSubUnsubBulk(const std::vector<PubData> &newPubs,
                                 const std::vector<SubReq> &newSubs,
@@ -0,0 +1,86 @@
+/**
+ * @file dummy_remote_layer.hpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @brief Dummy remote layer for testing purposes
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "kvik/layers.hpp"
+
+namespace kvik
+{
+    /**
+     * @brief Dummy remote layer
+     *
+     * Just logs all actions to local variables.
+     */
+    class DummyRemoteLayer : public IRemoteLayer
+    {
+    protected:
+        std::mutex _mutex;
+
+    public:
+        using PubsLog = std::vector<PubData>;
+        using TopicsLog = std::vector<std::string>;
+
+        ErrCode ret = ErrCode::SUCCESS; //!< Return code of all operations
+
+        PubsLog pubsLog;     //!< All publications
+        TopicsLog subsLog;   //!< All subscriptions
+        TopicsLog unsubsLog; //!< All unsubscriptions
+
+        ErrCode publish(const PubData &data)
+        {
+            const std::scoped_lock lock{_mutex};
+            pubsLog.push_back(data);
+            return ret;
+        }
+
+        ErrCode subscribe(const std::string &topic)
+        {
+            const std::scoped_lock lock{_mutex};
+            subsLog.push_back(topic);
+            return ret;
+        }
+
+        ErrCode unsubscribe(const std::string &topic)
+        {
+            const std::scoped_lock lock{_mutex};
+            unsubsLog.push_back(topic);
+            return ret;
+        }
+
+        /**
+         * @brief Simulates data reception
+         * @param data Received data
+         * @return Error code returned by callback, SUCCESS if none set
+         */
+        ErrCode recv(const SubData &data)
+        {
+            if (m_recvCb != nullptr) {
+                return m_recvCb(data);
+            }
+            return ErrCode::SUCCESS;
+        }
+
+        /**
+         * @brief Simulates reconnection
+         * @return Error code returned by callback, SUCCESS if none set
+         */
+        ErrCode reconnect()
+        {
+            if (m_reconnectCb != nullptr) {
+                return m_reconnectCb();
+            }
+            return ErrCode::SUCCESS;
+        }
+    };
+} // namespace kvik
@@ -4,13 +4,19 @@
  * @copyright Copyright (c) 2024
  */
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <future>
+#include <memory>
 #include <thread>
 
 #include <catch2/catch_test_macros.hpp>
 
 #include "kvik/client.hpp"
 #include "kvik/client_config.hpp"
+#include "kvik/delta_codec.hpp"
+#include "kvik/stream.hpp"
 #include "kvik_testing/dummy_local_layer.hpp"
 
 using namespace kvik;
@@ -398,6 +404,87 @@ TEST_CASE("Initialization with multiple gateways on multiple channels",
     CHECK(ll.channelsLog == ChannelsLog{74, 39, 88, 39});
 }
 
+TEST_CASE("Asynchronous initialization", "[Client]")
+{
+    DEFAULT_LL(ll);
+    auto conf = CONF;
+    conf.startup.async = true;
+
+    std::atomic<size_t> readyCnt = 0;
+    conf.startup.readyCb = [&readyCnt]() { readyCnt++; };
+
+    SECTION("Fail fast before readiness")
+    {
+        ll.responses.push(MSG_PROBE_RES_GW2);
+        ll.responses.push(MSG_OK_GW2);
+
+        auto startTS = std::chrono::steady_clock::now();
+        Client cl(conf, &ll);
+        CHECK(std::chrono::steady_clock::now() - startTS <
+              CONF.nodeConf.localDelivery.respTimeout);
+
+        CHECK(!cl.isReady());
+        CHECK(cl.publish(TOPIC1, PAYLOAD1) == ErrCode::NO_GATEWAY);
+
+        auto ready = cl.getReadyFuture();
+        REQUIRE(ready.wait_for(1s) == std::future_status::ready);
+        CHECK(ready.get() == ErrCode::SUCCESS);
+        CHECK(cl.isReady());
+        CHECK(readyCnt == 1);
+
+        CHECK(cl.publish(TOPIC1, PAYLOAD1) == ErrCode::SUCCESS);
+        CHECK(ll.sentLog == SentLog{MSG_PROBE_REQ, MSG_PUB_1_GW2});
+    }
+
+    SECTION("Wait for readiness")
+    {
+        conf.startup.earlyOps = ClientConfig::Startup::EarlyOpPolicy::WAIT;
+        ll.responses.push(MSG_PROBE_RES_GW2);
+        ll.responses.push(MSG_OK_GW2);
+
+        Client cl(conf, &ll);
+        CHECK(cl.publish(TOPIC1, PAYLOAD1) == ErrCode::SUCCESS);
+        CHECK(cl.isReady());
+        CHECK(readyCnt == 1);
+        CHECK(ll.sentLog == SentLog{MSG_PROBE_REQ, MSG_PUB_1_GW2});
+    }
+
+    SECTION("Wait timeout")
+    {
+        conf.startup.earlyOps = ClientConfig::Startup::EarlyOpPolicy::WAIT;
+        conf.startup.earlyOpTimeout = 10ms;
+
+        Client cl(conf, &ll);
+        CHECK(cl.publish(TOPIC1, PAYLOAD1) == ErrCode::TIMEOUT);
+        CHECK(!cl.isReady());
+    }
+
+    SECTION("Destroyed before readiness")
+    {
+        std::shared_future<ErrCode> ready;
+        {
+            Client cl(conf, &ll);
+            ready = cl.getReadyFuture();
+            std::this_thread::sleep_for(30ms);
+        }
+
+        REQUIRE(ready.wait_for(0s) == std::future_status::ready);
+        CHECK(ready.get() == ErrCode::NO_GATEWAY);
+        CHECK(readyCnt == 0);
+    }
+
+    SECTION("Synchronous initialization is ready immediately")
+    {
+        conf.startup.async = false;
+        ll.responses.push(MSG_PROBE_RES_GW2);
+
+        Client cl(conf, &ll);
+        CHECK(cl.isReady());
+        CHECK(cl.getReadyFuture().wait_for(0s) == std::future_status::ready);
+        CHECK(readyCnt == 1);
+    }
+}
+
 TEST_CASE("Initialization without local layer", "[Client]")
 {
     REQUIRE_THROWS(Client(CONF, nullptr));
@@ -502,6 +589,54 @@ TEST_CASE("Publish, subscribe, unsubscribe", "[Client]")
                                 MSG_PUB_12_SUB_12_UNSUB_12_GW2});
 }
 
+TEST_CASE("Energy accounting", "[Client]")
+{
+    DEFAULT_LL(ll);
+    ll.responses.push(MSG_PROBE_RES_GW2);
+
+    SECTION("Disabled")
+    {
+        Client cl(CONF, &ll);
+        EnergyMeter::Snapshot snap;
+        CHECK(cl.getEnergyStats(snap) == ErrCode::NOT_SUPPORTED);
+    }
+
+    SECTION("Enabled")
+    {
+        auto conf = CONF;
+        conf.nodeConf.energy.enabled = true;
+        conf.nodeConf.energy.powerModel =
+            std::make_shared<ConstPowerModel>(1.0, 0.5);
+        ll.airtime = 2ms;
+        ll.responses.push(MSG_OK_GW2);
+
+        Client cl(conf, &ll);
+        CHECK(cl.publish(TOPIC1, PAYLOAD1) == ErrCode::SUCCESS);
+
+        EnergyMeter::Snapshot snap;
+        REQUIRE(cl.getEnergyStats(snap) == ErrCode::SUCCESS);
+
+        // Discovery broadcast and publication
+        CHECK(snap.op(EnergyOp::TX).cnt == 2);
+        CHECK(snap.op(EnergyOp::TX).time == 4ms);
+        CHECK(snap.op(EnergyOp::TX).energy == 0.004);
+
+        // Discovery listens for whole response timeout
+        CHECK(snap.op(EnergyOp::CHANNEL_SCAN).cnt == 1);
+        CHECK(snap.op(EnergyOp::CHANNEL_SCAN).time >=
+              CONF.nodeConf.localDelivery.respTimeout);
+        CHECK(snap.op(EnergyOp::BROADCAST_WAIT).cnt == 0);
+
+        // Response came before timeout
+        CHECK(snap.op(EnergyOp::RESP_WAIT).cnt == 1);
+        CHECK(snap.op(EnergyOp::RESP_WAIT).time <
+              CONF.nodeConf.localDelivery.respTimeout);
+
+        CHECK(snap.delivered == 1);
+        CHECK(snap.energyPerDelivered() == snap.totalEnergy());
+    }
+}
+
 TEST_CASE("Periodic subscriptions renewal with empty database", "[Client]")
 {
     auto modifConf = CONF;
@@ -664,6 +799,145 @@ TEST_CASE("Resubscribe all with populated database", "[Client]")
                                  MSG_SUB_21_GW2}));
 }
 
+TEST_CASE("Resubscribe all using subscriptions digest", "[Client]")
+{
+    auto modifConf = CONF;
+    modifConf.subDB.digestRenewal = true;
+
+    auto digest = calcSubsDigest({TOPIC1, TOPIC2});
+    LocalMsg msgDigest = {
+        .type = LocalMsgType::PUB_SUB_UNSUB,
+        .addr = PEER_GW2.addr,
+        .nodeType = NodeType::CLIENT,
+        .subsDigest = digest,
+    };
+    LocalMsg msgSub12Digest = MSG_SUB_12_GW2;
+    msgSub12Digest.subsDigest = digest;
+    LocalMsg msgSub21Digest = MSG_SUB_21_GW2;
+    msgSub21Digest.subsDigest = digest;
+    LocalMsg msgOkDigestMatch = MSG_OK_GW2;
+    msgOkDigestMatch.subsDigestMatch = true;
+
+    DEFAULT_LL(ll);
+    ll.responses.push(MSG_PROBE_RES_GW2);
+    ll.responses.push(MSG_OK_GW2);
+
+    SECTION("Digest match")
+    {
+        ll.responses.push(msgOkDigestMatch);
+        Client cl(modifConf, &ll);
+        cl.subscribeBulk({SUB_REQ1, SUB_REQ2});
+        CHECK(cl.resubscribeAll() == ErrCode::SUCCESS);
+        CHECK(ll.sentLog == SentLog{MSG_PROBE_REQ, MSG_SUB_12_GW2, msgDigest});
+    }
+
+    SECTION("Digest mismatch")
+    {
+        ll.responses.push(MSG_OK_GW2);
+        ll.responses.push(msgOkDigestMatch);
+        ll.responses.push(msgOkDigestMatch);
+        Client cl(modifConf, &ll);
+        cl.subscribeBulk({SUB_REQ1, SUB_REQ2});
+        CHECK(cl.resubscribeAll() == ErrCode::SUCCESS);
+        CHECK((ll.sentLog == SentLog{MSG_PROBE_REQ, MSG_SUB_12_GW2, msgDigest,
+                                     msgSub12Digest} ||
+               ll.sentLog == SentLog{MSG_PROBE_REQ, MSG_SUB_12_GW2, msgDigest,
+                                     msgSub21Digest}));
+
+        // Gateway supports digests, next renewal uses digest again
+        CHECK(cl.resubscribeAll() == ErrCode::SUCCESS);
+        CHECK(ll.sentLog.size() == 5);
+        CHECK(ll.sentLog.back() == msgDigest);
+    }
+
+    SECTION("Gateway without digest support")
+    {
+        ll.responses.push(MSG_OK_GW2);
+        ll.responses.push(MSG_OK_GW2);
+        ll.responses.push(MSG_OK_GW2);
+        Client cl(modifConf, &ll);
+        cl.subscribeBulk({SUB_REQ1, SUB_REQ2});
+        CHECK(cl.resubscribeAll() == ErrCode::SUCCESS);
+        CHECK(ll.sentLog.size() == 4);
+
+        // Digest isn't sent anymore
+        CHECK(cl.resubscribeAll() == ErrCode::SUCCESS);
+        CHECK(ll.sentLog.size() == 5);
+        CHECK((ll.sentLog.back() == MSG_SUB_12_GW2 ||
+               ll.sentLog.back() == MSG_SUB_21_GW2));
+    }
+
+    SECTION("Timeout")
+    {
+        Client cl(modifConf, &ll);
+        cl.subscribeBulk({SUB_REQ1, SUB_REQ2});
+        CHECK(cl.resubscribeAll() == ErrCode::TIMEOUT);
+        CHECK(ll.sentLog == SentLog{MSG_PROBE_REQ, MSG_SUB_12_GW2, msgDigest});
+    }
+}
+
+TEST_CASE("Time sync with subscriptions digest", "[Client]")
+{
+    auto modifConf = CONF;
+    modifConf.subDB.digestRenewal = true;
+
+    auto digest = calcSubsDigest({TOPIC1, TOPIC2});
+    LocalMsg msgProbeDigest = MSG_PROBE_REQ_GW2;
+    msgProbeDigest.subsDigest = digest;
+    LocalMsg msgProbeResDigestMatch = MSG_PROBE_RES_GW2;
+    msgProbeResDigestMatch.subsDigestMatch = true;
+    LocalMsg msgOkDigestMatch = MSG_OK_GW2;
+    msgOkDigestMatch.subsDigestMatch = true;
+    LocalMsg msgDigest = {
+        .type = LocalMsgType::PUB_SUB_UNSUB,
+        .addr = PEER_GW2.addr,
+        .nodeType = NodeType::CLIENT,
+        .subsDigest = digest,
+    };
+
+    DEFAULT_LL(ll);
+    ll.responses.push(MSG_PROBE_RES_GW2);
+    ll.responses.push(MSG_OK_GW2);
+
+    SECTION("Gateway holds subscriptions")
+    {
+        ll.responses.push(msgProbeResDigestMatch);
+        Client cl(modifConf, &ll);
+        cl.subscribeBulk({SUB_REQ1, SUB_REQ2});
+        CHECK(cl.syncTime() == ErrCode::SUCCESS);
+        CHECK(ll.sentLog == SentLog{MSG_PROBE_REQ, MSG_SUB_12_GW2,
+                                    msgProbeDigest});
+    }
+
+    SECTION("Gateway lost subscriptions")
+    {
+        ll.responses.push(MSG_PROBE_RES_GW2);
+        ll.responses.push(msgOkDigestMatch);
+        Client cl(modifConf, &ll);
+        cl.subscribeBulk({SUB_REQ1, SUB_REQ2});
+        CHECK(cl.syncTime() == ErrCode::SUCCESS);
+        CHECK(ll.sentLog == SentLog{MSG_PROBE_REQ, MSG_SUB_12_GW2,
+                                    msgProbeDigest, msgDigest});
+    }
+
+    SECTION("Gateway without digest support")
+    {
+        ll.responses.push(MSG_PROBE_RES_GW2);
+        ll.responses.push(MSG_OK_GW2);
+        ll.responses.push(MSG_OK_GW2);
+        ll.responses.push(MSG_PROBE_RES_GW2);
+        Client cl(modifConf, &ll);
+        cl.subscribeBulk({SUB_REQ1, SUB_REQ2});
+        CHECK(cl.syncTime() == ErrCode::SUCCESS);
+        CHECK(ll.sentLog.size() == 5);
+
+        // Digest isn't attached anymore, no resubscription
+        CHECK(cl.syncTime() == ErrCode::SUCCESS);
+        CHECK(ll.sentLog.size() == 6);
+        CHECK(ll.sentLog.back() == MSG_PROBE_REQ_GW2);
+    }
+}
+
 TEST_CASE("Receive subscription data", "[Client]")
 {
     DEFAULT_LL(ll);
@@ -719,6 +993,740 @@ TEST_CASE("Receive subscription data", "[Client]")
     CHECK(ll.respSuccLog == RespSuccLog{true, true});
 }
 
+TEST_CASE("Receive data of precompiled filter", "[Client]")
+{
+    DEFAULT_LL(ll);
+    ll.responses.push(MSG_PROBE_RES_GW2);
+    ll.responses.push(MSG_OK_GW2);
+
+    int cnt = 0;
+    Client cl(CONF, &ll);
+    const Filter filter{"aaa/+/#"};
+    REQUIRE(cl.subscribe(filter, [&cnt](const SubData &) { cnt++; }) ==
+            ErrCode::SUCCESS);
+    CHECK(ll.sentLog.back().subs == std::vector<std::string>{"aaa/+/#"});
+
+    LocalMsg msg = {
+        .type = LocalMsgType::SUB_DATA,
+        .addr = PEER_GW2.addr,
+        .subsData = {{"aaa/bbb/1", "payload"}},
+        .nodeType = NodeType::GATEWAY,
+    };
+    prepLocalMsg(msg, ll.respTsDiff, ll.respTimeUnit);
+    CHECK(ll.recv(msg) == ErrCode::SUCCESS);
+    CHECK(cnt == 1);
+
+    ll.responses.push(MSG_OK_GW2);
+    REQUIRE(cl.unsubscribe(filter) == ErrCode::SUCCESS);
+    prepLocalMsg(msg, ll.respTsDiff, ll.respTimeUnit);
+    CHECK(ll.recv(msg) == ErrCode::SUCCESS);
+    CHECK(cnt == 1);
+}
+
+TEST_CASE("Receive piggybacked subscription data", "[Client]")
+{
+    DEFAULT_LL(ll);
+    ll.responses.push(MSG_PROBE_RES_GW2);
+    ll.responses.push(MSG_OK_GW2);
+
+    std::atomic<int> cnt = 0;
+    Client cl(CONF, &ll);
+    REQUIRE(cl.subscribe("aaa/#", [&cnt](const SubData &data) {
+        cnt++;
+    }) == ErrCode::SUCCESS);
+    CHECK(!ll.sentLog.back().piggybackAck);
+
+    LocalMsg okData = MSG_OK_GW2;
+    okData.subsData = {{"aaa/1", "payload1"}, {"bbb", "payload2"}};
+    ll.responses.push(okData);
+    REQUIRE(cl.publish(TOPIC1, PAYLOAD1) == ErrCode::SUCCESS);
+
+    // Data are acknowledged by next request, not by separate OK
+    std::this_thread::sleep_for(10ms);
+    CHECK(cnt == 1);
+    CHECK(ll.sentLog.size() == 3);
+
+    ll.responses.push(okData);
+    REQUIRE(cl.publish(TOPIC1, PAYLOAD1) == ErrCode::SUCCESS);
+    auto firstAck = ll.sentLog.back();
+    CHECK(firstAck.piggybackAck);
+
+    ll.responses.push(MSG_OK_GW2);
+    REQUIRE(cl.publish(TOPIC1, PAYLOAD1) == ErrCode::SUCCESS);
+    CHECK(ll.sentLog.back().piggybackAck);
+    CHECK(ll.sentLog.back().piggybackAckId != firstAck.piggybackAckId);
+
+    std::this_thread::sleep_for(10ms);
+    CHECK(cnt == 2);
+    CHECK(ll.sentLog.size() == 5);
+    CHECK(ll.respSuccLog == RespSuccLog{true, true, true, true, true});
+
+    // Data are acknowledged only once
+    ll.responses.push(MSG_OK_GW2);
+    REQUIRE(cl.publish(TOPIC1, PAYLOAD1) == ErrCode::SUCCESS);
+    CHECK(!ll.sentLog.back().piggybackAck);
+}
+
+TEST_CASE("Receive group-addressed subscription data", "[Client]")
+{
+    DEFAULT_LL(ll);
+    auto probeRes = MSG_PROBE_RES_GW2;
+    probeRes.groupIdx = 3;
+    probeRes.groupSeq = 6; // Sync point
+    ll.responses.push(probeRes);
+    ll.responses.push(MSG_OK_GW2);
+
+    auto conf = CONF;
+    conf.groupData.ackJitter = 10ms;
+
+    int cnt = 0;
+    std::unique_ptr<Client> cl;
+
+    auto groupMsg = [&ll](uint16_t idx, uint16_t seq) {
+        LocalMsg msg = {
+            .type = LocalMsgType::SUB_DATA,
+            .addr = PEER_GW2.addr,
+            .subsData = {SUB_DATA1},
+            .nodeType = NodeType::GATEWAY,
+        };
+        msg.groupRecipients = std::vector<uint8_t>(2);
+        msg.groupRecipients[idx / 8] |= 1 << (idx % 8);
+        msg.groupSeq = seq;
+        prepLocalMsg(msg, ll.respTsDiff, ll.respTimeUnit);
+        return msg;
+    };
+    auto groupAck = [](LocalMsgType type, uint16_t seq) {
+        LocalMsg msg = {
+            .type = type,
+            .addr = PEER_GW2.addr,
+            .nodeType = NodeType::CLIENT,
+        };
+        if (type == LocalMsgType::FAIL) {
+            msg.failReason = LocalMsgFailReason::GROUP_SEQ_GAP;
+        }
+        msg.groupSeq = seq;
+        return msg;
+    };
+
+    SECTION("Positive acknowledgements")
+    {
+        cl = std::make_unique<Client>(conf, &ll);
+        cl->subscribe(TOPIC1, [&cnt](const SubData &) { cnt++; });
+
+        // Not a recipient
+        CHECK(ll.recv(groupMsg(4, 7)) == ErrCode::SUCCESS);
+        CHECK(cnt == 0);
+
+        // Two data acknowledged at once
+        CHECK(ll.recv(groupMsg(3, 7)) == ErrCode::SUCCESS);
+        CHECK(ll.recv(groupMsg(3, 8)) == ErrCode::SUCCESS);
+        CHECK(cnt == 2);
+        CHECK(ll.sentLog.size() == 2);
+
+        std::this_thread::sleep_for(30ms);
+        CHECK(ll.sentLog.size() == 3);
+        CHECK(ll.sentLog.back() == groupAck(LocalMsgType::OK, 8));
+
+        // Already received
+        CHECK(ll.recv(groupMsg(3, 7)) == ErrCode::MSG_DUP_ID);
+        CHECK(cnt == 2);
+    }
+
+    SECTION("Gap and retransmission")
+    {
+        cl = std::make_unique<Client>(conf, &ll);
+        cl->subscribe(TOPIC1, [&cnt](const SubData &) { cnt++; });
+
+        CHECK(ll.recv(groupMsg(3, 7)) == ErrCode::SUCCESS);
+        CHECK(ll.recv(groupMsg(3, 10)) == ErrCode::SUCCESS);
+        std::this_thread::sleep_for(30ms);
+        CHECK(ll.sentLog.back() == groupAck(LocalMsgType::FAIL, 8));
+
+        // Retransmissions of missing data
+        CHECK(ll.recv(groupMsg(3, 8)) == ErrCode::SUCCESS);
+        CHECK(ll.recv(groupMsg(3, 9)) == ErrCode::SUCCESS);
+        CHECK(cnt == 4);
+        std::this_thread::sleep_for(30ms);
+        CHECK(ll.sentLog.back() == groupAck(LocalMsgType::OK, 10));
+    }
+
+    SECTION("Window starts at sync point")
+    {
+        cl = std::make_unique<Client>(conf, &ll);
+        cl->subscribe(TOPIC1, [&cnt](const SubData &) { cnt++; });
+
+        // Data sent before the sync point aren't for this client
+        CHECK(ll.recv(groupMsg(3, 5)) == ErrCode::MSG_DUP_ID);
+        CHECK(cnt == 0);
+
+        // First received data don't hide missing ones
+        CHECK(ll.recv(groupMsg(3, 9)) == ErrCode::SUCCESS);
+        std::this_thread::sleep_for(30ms);
+        CHECK(ll.sentLog.back() == groupAck(LocalMsgType::FAIL, 7));
+    }
+
+    SECTION("Delta base untouched by data for others")
+    {
+        std::vector<std::string> payloads;
+        cl = std::make_unique<Client>(conf, &ll);
+        cl->subscribe(TOPIC1, [&payloads](const SubData &data) {
+            payloads.push_back(data.payload);
+        });
+
+        DeltaCodec gwCodec, otherCodec;
+        auto deltaMsg = [&groupMsg](uint16_t idx, uint16_t seq,
+                                    DeltaCodec &codec,
+                                    const std::string &payload) {
+            LocalMsg msg = groupMsg(idx, seq);
+            msg.subsData = {{TOPIC1, codec.encode(TOPIC1, payload)}};
+            msg.deltaPayloads = true;
+            return msg;
+        };
+
+        CHECK(ll.recv(deltaMsg(3, 7, gwCodec, "counter=1000")) ==
+              ErrCode::SUCCESS);
+        gwCodec.confirm(TOPIC1);
+
+        // Other recipient's data and duplicate aren't decoded
+        CHECK(ll.recv(deltaMsg(4, 8, otherCodec, "other=1")) ==
+              ErrCode::SUCCESS);
+        CHECK(ll.recv(deltaMsg(3, 7, otherCodec, "other=2")) ==
+              ErrCode::MSG_DUP_ID);
+
+        CHECK(ll.recv(deltaMsg(3, 9, gwCodec, "counter=1001")) ==
+              ErrCode::SUCCESS);
+        CHECK(payloads ==
+              std::vector<std::string>{"counter=1000", "counter=1001"});
+    }
+
+    SECTION("Negative acknowledgements only")
+    {
+        conf.groupData.positiveAcks = false;
+        cl = std::make_unique<Client>(conf, &ll);
+        cl->subscribe(TOPIC1, [&cnt](const SubData &) { cnt++; });
+        size_t sentCnt = ll.sentLog.size();
+
+        CHECK(ll.recv(groupMsg(3, 7)) == ErrCode::SUCCESS);
+        CHECK(ll.recv(groupMsg(3, 8)) == ErrCode::SUCCESS);
+        std::this_thread::sleep_for(30ms);
+        CHECK(ll.sentLog.size() == sentCnt);
+
+        CHECK(ll.recv(groupMsg(3, 11)) == ErrCode::SUCCESS);
+        std::this_thread::sleep_for(30ms);
+        CHECK(ll.sentLog.size() == sentCnt + 1);
+        CHECK(ll.sentLog.back() == groupAck(LocalMsgType::FAIL, 9));
+    }
+}
+
+/**
+ * @brief Local layer simulating gateway with stream endpoint behind it
+ *
+ * Confirms (un)subscriptions. Uplink chunks are reassembled by receiver
+ * behind the gateway, whose acknowledgements come back as SUB_DATA.
+ * Downlink acknowledgements published by client are collected.
+ */
+class StreamGatewayLayer : public DummyLocalLayer
+{
+    std::vector<StreamAck> _acks;
+
+public:
+    StreamReceiver receiver;
+    std::string received;
+
+    //! Decides whether n-th uplink chunk is lost
+    std::function<bool(size_t)> dropChunk = [](size_t) { return false; };
+    size_t chunkCnt = 0;
+
+    StreamGatewayLayer()
+        : receiver{[this](uint32_t, const std::string &data) {
+              received = data;
+          }}
+    {
+        respTsDiff = 0ms;
+        respTimeUnit = 10ms;
+    }
+
+    ErrCode send(const LocalMsg &msg)
+    {
+        if (msg.type == LocalMsgType::PUB_SUB_UNSUB &&
+            (!msg.subs.empty() || !msg.unsubs.empty())) {
+            const std::scoped_lock lock{_mutex};
+            responses.push(MSG_OK_GW2);
+        }
+
+        ErrCode ret = DummyLocalLayer::send(msg);
+
+        for (const auto &pub : msg.pubs) {
+            StreamChunk chunk;
+            StreamAck ack;
+            {
+                const std::scoped_lock lock{_mutex};
+                if (StreamAck::decode(pub.payload, ack) == ErrCode::SUCCESS) {
+                    _acks.push_back(ack);
+                    continue;
+                }
+                if (StreamChunk::decode(pub.payload, chunk) !=
+                        ErrCode::SUCCESS ||
+                    dropChunk(chunkCnt++) ||
+                    receiver.processChunk(chunk, ack) != ErrCode::SUCCESS) {
+                    continue;
+                }
+            }
+
+            LocalMsg ackMsg = {
+                .type = LocalMsgType::SUB_DATA,
+                .addr = PEER_GW2.addr,
+                .subsData = {{pub.topic + "/_ack", ack.encode()}},
+                .nodeType = NodeType::GATEWAY,
+            };
+            std::thread respThread(&StreamGatewayLayer::simulateResponse,
+                                   this, ackMsg);
+            respThread.detach();
+        }
+
+        return ret;
+    }
+
+    /**
+     * @brief Takes acknowledgements published by client
+     * @return Acknowledgements
+     */
+    std::vector<StreamAck> takeAcks()
+    {
+        const std::scoped_lock lock{_mutex};
+        return std::move(_acks);
+    }
+};
+
+/**
+ * @brief Generates deterministic stream data
+ * @param len Length
+ * @return Data
+ */
+static std::string streamData(size_t len)
+{
+    std::string data(len, '\0');
+    for (size_t i = 0; i < len; i++) {
+        data[i] = static_cast<char>((i * 13 + 5) & 0xFF);
+    }
+    return data;
+}
+
+TEST_CASE("Publish stream", "[Client]")
+{
+    StreamGatewayLayer ll;
+    ll.responses.push(MSG_PROBE_RES_GW2);
+
+    ClientConfig conf = CONF;
+    conf.stream.chunkSize = 100;
+    conf.stream.window = 4;
+    conf.stream.rto = 20ms;
+    conf.stream.timeout = 300ms;
+
+    Client cl(conf, &ll);
+    std::string data = streamData(2000);
+    uint32_t transferId = 0;
+
+    SECTION("Lossless")
+    {
+        CHECK(cl.publishStream("ota", data, transferId) == ErrCode::SUCCESS);
+        CHECK(transferId != 0);
+        CHECK(ll.received == data);
+        CHECK(ll.chunkCnt == 20);
+
+        // Pipelined, client doesn't wait for gateway's responses
+        CHECK(ll.sentLog.size() < 2 + 20 + 20 + 2);
+    }
+
+    SECTION("Lossy link")
+    {
+        ll.dropChunk = [](size_t i) { return i % 5 == 2; };
+        CHECK(cl.publishStream("ota", data, transferId) == ErrCode::SUCCESS);
+        CHECK(ll.received == data);
+        CHECK(ll.chunkCnt < 30);
+    }
+
+    SECTION("Resumed after timeout")
+    {
+        // Only first 10 chunks get through
+        ll.dropChunk = [](size_t i) { return i >= 10; };
+        CHECK(cl.publishStream("ota", data, transferId) == ErrCode::TIMEOUT);
+        CHECK(ll.received.empty());
+        std::this_thread::sleep_for(50ms);
+
+        uint32_t prevTransferId = transferId;
+        ll.dropChunk = [](size_t) { return false; };
+        ll.chunkCnt = 0;
+        CHECK(cl.publishStream("ota", data, transferId) == ErrCode::SUCCESS);
+        CHECK(transferId == prevTransferId);
+        CHECK(ll.received == data);
+
+        // Probe and missing chunks only
+        CHECK(ll.chunkCnt == 1 + 10);
+    }
+
+    // Wait for remaining acknowledgements
+    std::this_thread::sleep_for(50ms);
+}
+
+TEST_CASE("Publish stream with FEC", "[Client]")
+{
+    StreamGatewayLayer ll;
+    ll.responses.push(MSG_PROBE_RES_GW2);
+    ll.dropChunk = [](size_t i) { return i % 7 == 3; };
+
+    ClientConfig conf = CONF;
+    conf.stream.chunkSize = 100;
+    conf.stream.window = 4;
+    conf.stream.rto = 20ms;
+    conf.stream.timeout = 300ms;
+    conf.stream.fecGroup = 5;
+
+    Client cl(conf, &ll);
+    std::string data = streamData(2000);
+    uint32_t transferId = 0;
+
+    CHECK(cl.publishStream("ota", data, transferId) == ErrCode::SUCCESS);
+    CHECK(ll.received == data);
+    CHECK(ll.receiver.lossRate() > 0);
+    std::this_thread::sleep_for(50ms);
+
+    // Next transfer is protected from the start
+    transferId = 0;
+    ll.received.clear();
+    ll.chunkCnt = 0;
+    CHECK(cl.publishStream("ota", data, transferId) == ErrCode::SUCCESS);
+    CHECK(ll.received == data);
+    CHECK(ll.chunkCnt > 20);
+
+    // Wait for remaining acknowledgements
+    std::this_thread::sleep_for(50ms);
+}
+
+TEST_CASE("Subscribe stream", "[Client]")
+{
+    StreamGatewayLayer ll;
+    ll.responses.push(MSG_PROBE_RES_GW2);
+
+    Client cl(CONF, &ll);
+
+    std::string recvTopic, recvData;
+    int cnt = 0;
+    REQUIRE(cl.subscribeStream(
+                "ota/#", [&](const std::string &topic, const std::string &data) {
+                    recvTopic = topic;
+                    recvData = data;
+                    cnt++;
+                }) == ErrCode::SUCCESS);
+
+    // Gateway-side sender injecting chunks as SUB_DATA
+    size_t sentCnt = 0;
+    std::function<bool(size_t)> drop = [](size_t) { return false; };
+    std::string data = streamData(3000);
+    StreamSender sender(
+        42, data, 200, 4, 20ms, [&](const std::string &payload) {
+            if (drop(sentCnt++)) {
+                return ErrCode::SUCCESS;
+            }
+            LocalMsg msg = {
+                .type = LocalMsgType::SUB_DATA,
+                .addr = PEER_GW2.addr,
+                .subsData = {{"ota/fw", payload}},
+                .nodeType = NodeType::GATEWAY,
+            };
+            prepLocalMsg(msg, ll.respTsDiff, ll.respTimeUnit);
+            return ll.recv(msg);
+        });
+
+    SECTION("Lossless")
+    {
+    }
+
+    SECTION("Lossy link")
+    {
+        drop = [](size_t i) { return i % 4 == 1; };
+    }
+
+    REQUIRE(sender.start() == ErrCode::SUCCESS);
+    auto now = std::chrono::steady_clock::now();
+    for (int round = 0; round < 100 && !sender.done(); round++) {
+        auto acks = ll.takeAcks();
+        for (const auto &ack : acks) {
+            REQUIRE(sender.processAck(ack) == ErrCode::SUCCESS);
+        }
+        if (acks.empty()) {
+            now += 20ms;
+            REQUIRE(sender.tick(now) == ErrCode::SUCCESS);
+        }
+    }
+
+    CHECK(sender.done());
+    CHECK(cnt == 1);
+    CHECK(recvTopic == "ota/fw");
+    CHECK(recvData == data);
+}
+
+/**
+ * @brief Local layer simulating gateway decoding delta-encoded publications
+ */
+class DeltaGatewayLayer : public DummyLocalLayer
+{
+public:
+    DeltaCodec codec;
+    std::vector<std::string> received; //!< Decoded payloads
+    std::vector<size_t> frameSizes;    //!< Sizes of received frames
+    bool loseResps = false;            //!< Whether responses are lost
+
+    DeltaGatewayLayer()
+    {
+        respTsDiff = 0ms;
+        respTimeUnit = 10ms;
+    }
+
+    ErrCode send(const LocalMsg &msg)
+    {
+        if (msg.type == LocalMsgType::PUB_SUB_UNSUB) {
+            const std::scoped_lock lock{_mutex};
+            bool ok = true;
+            for (const auto &pub : msg.pubs) {
+                std::string payload = pub.payload;
+                if (msg.deltaPayloads) {
+                    codec.bindPeer(msg.addr);
+                    ok = ok && codec.decode(pub.topic, pub.payload, payload) ==
+                                   ErrCode::SUCCESS;
+                }
+                if (ok) {
+                    received.push_back(payload);
+                    frameSizes.push_back(pub.payload.size());
+                }
+            }
+            if (!loseResps) {
+                responses.push(ok ? MSG_OK_GW2 : MSG_FAIL_GW2);
+            }
+        }
+
+        return DummyLocalLayer::send(msg);
+    }
+};
+
+TEST_CASE("Delta-encoded publications", "[Client]")
+{
+    DeltaGatewayLayer ll;
+    ll.responses.push(MSG_PROBE_RES_GW2);
+
+    ClientConfig conf = CONF;
+    conf.delta.enable = true;
+    Client cl(conf, &ll);
+
+    std::string json = R"({"temp":21.5,"hum":40,"bat":3.71,"uptime":1000})";
+    auto publish = [&cl](const std::string &payload) {
+        return cl.pubSubUnsubBulk({{"sensor/1", payload}}, {}, {});
+    };
+
+    REQUIRE(publish(json) == ErrCode::SUCCESS);
+    CHECK(ll.frameSizes.back() == json.size() + 2);
+
+    SECTION("Chatty topic")
+    {
+        for (int i = 1; i <= 5; i++) {
+            json[json.size() - 2] = '0' + i;
+            REQUIRE(publish(json) == ErrCode::SUCCESS);
+            CHECK(ll.received.back() == json);
+            CHECK(ll.frameSizes.back() < 10);
+        }
+        CHECK(ll.sentLog.back().deltaPayloads);
+    }
+
+    SECTION("Gateway lost state")
+    {
+        ll.codec.clear();
+        json[json.size() - 2] = '7';
+        REQUIRE(publish(json) == ErrCode::SUCCESS);
+
+        // Delta frame rejected, full payload sent again
+        CHECK(ll.received.back() == json);
+        CHECK(ll.frameSizes.back() == json.size() + 2);
+        CHECK(ll.respSuccLog.size() == 4);
+    }
+
+    SECTION("Lost response")
+    {
+        ll.loseResps = true;
+        json[json.size() - 2] = '8';
+        CHECK(publish(json) == ErrCode::TIMEOUT);
+        ll.loseResps = false;
+
+        // Unconfirmed payload isn't used as base, next one is full
+        REQUIRE(publish(json) == ErrCode::SUCCESS);
+        CHECK(ll.frameSizes.back() == json.size() + 2);
+    }
+}
+
+TEST_CASE("Receive delta-encoded subscription data", "[Client]")
+{
+    DEFAULT_LL(ll);
+    ll.responses.push(MSG_PROBE_RES_GW2);
+    ll.responses.push(MSG_OK_GW2);
+
+    std::vector<std::string> payloads;
+    Client cl(CONF, &ll);
+    cl.subscribe("sensor/#", [&payloads](const SubData &data) {
+        payloads.push_back(data.payload);
+    });
+
+    DeltaCodec gwCodec;
+    auto recv = [&](const std::string &payload) {
+        LocalMsg msg = {
+            .type = LocalMsgType::SUB_DATA,
+            .addr = PEER_GW2.addr,
+            .subsData = {{"sensor/1", gwCodec.encode("sensor/1", payload)}},
+            .nodeType = NodeType::GATEWAY,
+        };
+        msg.deltaPayloads = true;
+        prepLocalMsg(msg, ll.respTsDiff, ll.respTimeUnit);
+        return ll.recv(msg);
+    };
+
+    CHECK(recv("counter=1000") == ErrCode::SUCCESS);
+    gwCodec.confirm("sensor/1");
+    CHECK(recv("counter=1001") == ErrCode::SUCCESS);
+    gwCodec.confirm("sensor/1");
+    CHECK(payloads == std::vector<std::string>{"counter=1000", "counter=1001"});
+
+    SECTION("Unknown base")
+    {
+        // Unconfirmed by gateway, so client's base is newer
+        CHECK(recv("counter=1002") == ErrCode::SUCCESS);
+        CHECK(recv("counter=1003") == ErrCode::MSG_PROCESSING_FAILED);
+        std::this_thread::sleep_for(10ms);
+        CHECK(ll.sentLog.back().type == LocalMsgType::FAIL);
+
+        // Gateway falls back to full payload
+        gwCodec.invalidate("sensor/1");
+        CHECK(recv("counter=1003") == ErrCode::SUCCESS);
+        CHECK(payloads.back() == "counter=1003");
+    }
+
+    SECTION("Piggybacked on OK")
+    {
+        LocalMsg okData = MSG_OK_GW2;
+        okData.subsData = {
+            {"sensor/1", gwCodec.encode("sensor/1", "counter=1002")}};
+        okData.deltaPayloads = true;
+        ll.responses.push(okData);
+        REQUIRE(cl.publish(TOPIC1, PAYLOAD1) == ErrCode::SUCCESS);
+        std::this_thread::sleep_for(10ms);
+        CHECK(payloads.back() == "counter=1002");
+
+        // Undecodable data aren't acknowledged
+        okData.subsData = {
+            {"sensor/1", gwCodec.encode("sensor/1", "counter=1003")}};
+        ll.responses.push(okData);
+        REQUIRE(cl.publish(TOPIC1, PAYLOAD1) == ErrCode::SUCCESS);
+        std::this_thread::sleep_for(10ms);
+        CHECK(payloads.back() == "counter=1002");
+
+        ll.responses.push(MSG_OK_GW2);
+        REQUIRE(cl.publish(TOPIC1, PAYLOAD1) == ErrCode::SUCCESS);
+        CHECK(!ll.sentLog.back().piggybackAck);
+    }
+}
+
+TEST_CASE("Slotted uplink", "[Client]")
+{
+    DEFAULT_LL(ll);
+
+    // Slot 3 of 5, frame is 200 ms long
+    const UplinkSlot slot = {.idx = 3, .frameLen = 5, .slotLen = 40ms};
+    LocalMsg probeRes = MSG_PROBE_RES_GW2;
+    probeRes.uplinkSlot = slot;
+    ll.responses.push(probeRes);
+
+    ClientConfig conf = CONF;
+    conf.slotted.enable = true;
+    conf.slotted.urgentTopics = {"alarm/#"};
+    Client cl(conf, &ll);
+
+    // Gateway time equals steady clock (zero `tsDiff`)
+    auto framePhase = []() {
+        auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch());
+        return now % 200ms;
+    };
+    auto sleepToPhase = [&framePhase](std::chrono::milliseconds phase) {
+        std::this_thread::sleep_for((phase - framePhase() + 200ms) % 200ms);
+    };
+
+    SECTION("Publication waits for own slot")
+    {
+        for (int i = 0; i < 3; i++) {
+            ll.responses.push(MSG_OK_GW2);
+            REQUIRE(cl.publish(TOPIC1, PAYLOAD1) == ErrCode::SUCCESS);
+            auto phase = framePhase();
+            CHECK(phase >= 120ms);
+            CHECK(phase < 160ms);
+        }
+    }
+
+    SECTION("Urgent publication uses contention slot")
+    {
+        sleepToPhase(50ms);
+        ll.responses.push(MSG_OK_GW2);
+        REQUIRE(cl.publish("alarm/fire", "1") == ErrCode::SUCCESS);
+        CHECK(framePhase() < 40ms);
+    }
+
+    SECTION("Messages fitting in the rest of slot aren't deferred")
+    {
+        ll.airtime = 5ms;
+        sleepToPhase(125ms);
+        auto start = std::chrono::steady_clock::now();
+        ll.responses.push(MSG_OK_GW2);
+        REQUIRE(cl.publish(TOPIC1, PAYLOAD1) == ErrCode::SUCCESS);
+        ll.responses.push(MSG_OK_GW2);
+        REQUIRE(cl.publish(TOPIC2, PAYLOAD2) == ErrCode::SUCCESS);
+        CHECK(std::chrono::steady_clock::now() - start < 30ms);
+    }
+
+    SECTION("Acknowledgements aren't deferred")
+    {
+        sleepToPhase(10ms);
+        LocalMsg data = MSG_SUB_DATA_12_GW2;
+        prepLocalMsg(data, ll.respTsDiff, ll.respTimeUnit);
+        auto start = std::chrono::steady_clock::now();
+        CHECK(ll.recv(data) == ErrCode::SUCCESS);
+        CHECK(std::chrono::steady_clock::now() - start < 20ms);
+        CHECK(ll.sentLog.back().type == LocalMsgType::OK);
+    }
+
+    SECTION("Time sync updates assignment")
+    {
+        // Time sync probe uses contention slot
+        sleepToPhase(50ms);
+        ll.responses.push(MSG_PROBE_RES_GW2);
+        REQUIRE(cl.syncTime() == ErrCode::SUCCESS);
+        CHECK(framePhase() < 40ms);
+
+        // Response without assignment keeps the current one
+        sleepToPhase(50ms);
+        ll.responses.push(MSG_OK_GW2);
+        REQUIRE(cl.publish(TOPIC1, PAYLOAD1) == ErrCode::SUCCESS);
+        CHECK(framePhase() >= 120ms);
+        CHECK(framePhase() < 160ms);
+
+        // New assignment
+        LocalMsg newProbeRes = MSG_PROBE_RES_GW2;
+        newProbeRes.uplinkSlot = {.idx = 1, .frameLen = 5, .slotLen = 40ms};
+        sleepToPhase(50ms);
+        ll.responses.push(newProbeRes);
+        REQUIRE(cl.syncTime() == ErrCode::SUCCESS);
+        ll.responses.push(MSG_OK_GW2);
+        REQUIRE(cl.publish(TOPIC1, PAYLOAD1) == ErrCode::SUCCESS);
+        CHECK(framePhase() >= 40ms);
+        CHECK(framePhase() < 80ms);
+    }
+}
+
 TEST_CASE("Gateway discovery on local layer without channels", "[Client]")
 {
     DEFAULT_LL(ll);
@@ -981,6 +1989,115 @@ TEST_CASE("Retain", "[Client]")
     }
 }
 
+TEST_CASE("Retained subscriptions", "[Client]")
+{
+    DEFAULT_LL(ll);
+    ll.responses.push(MSG_PROBE_RES_GW2);
+    ll.responses.push(MSG_OK_GW2);
+
+    auto conf = CONF;
+    conf.subDB.retainSubs = true;
+
+    ClientRetainedData retained;
+    {
+        Client cl(conf, &ll);
+        REQUIRE(cl.subscribeBulk({SUB_REQ1, SUB_REQ2}) == ErrCode::SUCCESS);
+        retained = cl.retain();
+    }
+
+    REQUIRE(retained.subs.cnt == 2);
+    CHECK(retained.subs.leaseExpiry >
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+              std::chrono::system_clock::now().time_since_epoch())
+              .count());
+
+    ll.sentLog.clear();
+    ll.respSuccLog.clear();
+
+    SECTION("Restored without round trip")
+    {
+        ll.responses.push(MSG_PROBE_RES_GW2);
+
+        int cnt = 0;
+        Client cl(conf, &ll, retained);
+        CHECK(cl.subscribe(TOPIC1, [&cnt](const SubData &) { cnt++; }) ==
+              ErrCode::SUCCESS);
+        CHECK(ll.sentLog == SentLog{MSG_PROBE_REQ_GW2});
+
+        // Unclaimed restored subscription isn't dispatched
+        auto msg = MSG_SUB_DATA_12_GW2;
+        prepLocalMsg(msg, ll.respTsDiff, ll.respTimeUnit);
+        CHECK(ll.recv(msg) == ErrCode::SUCCESS);
+        CHECK(cnt == 1);
+
+        // Restored topics are retained again
+        CHECK(cl.retain().subs.cnt == 2);
+    }
+
+    SECTION("Expired lease")
+    {
+        retained.subs.leaseExpiry = 1;
+        ll.responses.push(MSG_PROBE_RES_GW2);
+        ll.responses.push(MSG_OK_GW2);
+
+        Client cl(conf, &ll, retained);
+        CHECK(cl.subscribe(TOPIC1, nullptr) == ErrCode::SUCCESS);
+        CHECK(ll.sentLog.size() == 2);
+        CHECK(ll.sentLog.back().subs == std::vector<std::string>{TOPIC1});
+        CHECK(cl.retain().subs.cnt == 1);
+    }
+
+    SECTION("Gateway changed")
+    {
+        // Time sync with retained gateway fails (response from another
+        // node), restored subscriptions are renewed at newly discovered one
+        LocalMsg okGw3 = MSG_OK_GW2;
+        okGw3.addr = PEER_GW3.addr;
+        ll.responses.push(MSG_PROBE_RES_GW3);
+        ll.responses.push(MSG_PROBE_RES_GW3);
+        ll.responses.push(okGw3);
+
+        retained.gw = PEER_GW1.retain();
+        Client cl(conf, &ll, retained);
+        REQUIRE(ll.sentLog.size() == 3);
+        CHECK(ll.sentLog[0] == MSG_PROBE_REQ_GW1);
+        CHECK(ll.sentLog[1] == MSG_PROBE_REQ);
+        CHECK(ll.sentLog[2].addr == PEER_GW3.addr);
+        auto subs = ll.sentLog[2].subs;
+        std::sort(subs.begin(), subs.end());
+        CHECK(subs == std::vector<std::string>{TOPIC1, TOPIC2});
+    }
+
+    SECTION("Renewed before lease expires")
+    {
+        conf.subDB.subLifetime = 1s;
+        auto leaseExpiry = std::chrono::system_clock::now() + 300ms;
+        retained.subs.leaseExpiry =
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                leaseExpiry.time_since_epoch())
+                .count();
+        ll.responses.push(MSG_PROBE_RES_GW2);
+        ll.responses.push(MSG_OK_GW2);
+
+        Client cl(conf, &ll, retained);
+        std::this_thread::sleep_for(250ms);
+        REQUIRE(ll.sentLog.size() == 2);
+        CHECK(ll.sentLog.back().subs.size() == 2);
+        CHECK(std::chrono::system_clock::now() < leaseExpiry);
+    }
+
+    SECTION("Disabled")
+    {
+        ll.responses.push(MSG_PROBE_RES_GW2);
+        ll.responses.push(MSG_OK_GW2);
+
+        Client cl(CONF, &ll, retained);
+        CHECK(cl.subscribe(TOPIC1, nullptr) == ErrCode::SUCCESS);
+        CHECK(ll.sentLog.size() == 2);
+        CHECK(cl.retain().subs.cnt == 0);
+    }
+}
+
 TEST_CASE("Gateway rediscovery after many failures", "[Client]")
 {
     auto modifConf = CONF;
@@ -1415,6 +2532,68 @@ TEST_CASE("Reporting of RSSI after gateway discovery", "[Client]")
     }
 }
 
+TEST_CASE("Reporting of RSSI during construction", "[Client]")
+{
+    DEFAULT_LL(ll);
+    auto modifConf = CONF;
+
+    SECTION("Gateway discovery")
+    {
+        modifConf.reporting.rssiOnGwDscv = true;
+        ll.channels = {0, 1};
+        ll.responses.push(MSG_PROBE_RES_GW2_WITH_RSSI);
+        ll.responses.push(MSG_PROBE_RES_RELAY1_WITH_RSSI);
+        ll.responses.push(MSG_OK_GW2);
+
+        Client cl(modifConf, &ll);
+        std::this_thread::sleep_for(10ms);
+
+        REQUIRE(ll.sentLog.size() == 2 + 1);
+        auto pubs = ll.sentLog.back().pubs;
+        CHECK((pubs == std::vector<PubData>{PUB_DATA_GW2_RSSI,
+                                            PUB_DATA_RELAY1_RSSI} ||
+               pubs == std::vector<PubData>{PUB_DATA_RELAY1_RSSI,
+                                            PUB_DATA_GW2_RSSI}));
+        CHECK(ll.respSuccLog == RespSuccLog(2 + 1, true));
+    }
+
+    SECTION("Time sync with retained gateway")
+    {
+        modifConf.reporting.rssiOnTimeSync = true;
+        ll.responses.push(MSG_PROBE_RES_GW2_WITH_RSSI);
+        ll.responses.push(MSG_OK_GW2);
+
+        ClientRetainedData retained = {.gw = PEER_GW2.retain()};
+        Client cl(modifConf, &ll, retained);
+        std::this_thread::sleep_for(10ms);
+
+        REQUIRE(ll.sentLog.size() == 2);
+        CHECK(ll.sentLog.back().pubs ==
+              std::vector<PubData>{PUB_DATA_GW2_RSSI});
+        CHECK(ll.respSuccLog == RespSuccLog(2, true));
+    }
+
+    SECTION("Publication from ready callback")
+    {
+        ll.responses.push(MSG_PROBE_RES_GW2);
+        ll.responses.push(MSG_OK_GW2);
+
+        ErrCode readyPubRes = ErrCode::GENERIC_FAILURE;
+        Client *clPtr = nullptr;
+        modifConf.startup.readyCb = [&readyPubRes, &clPtr]() {
+            readyPubRes = clPtr->publish(TOPIC1, PAYLOAD1);
+        };
+
+        // Callback needs the instance, so it's constructed in-place
+        alignas(Client) unsigned char buf[sizeof(Client)];
+        clPtr = reinterpret_cast<Client *>(buf);
+        new (buf) Client(modifConf, &ll);
+        CHECK(readyPubRes == ErrCode::SUCCESS);
+        CHECK(ll.sentLog == SentLog{MSG_PROBE_REQ, MSG_PUB_1_GW2});
+        clPtr->~Client();
+    }
+}
+
 TEST_CASE("Reporting of RSSI after time sync", "[Client]")
 {
     auto modifConf = CONF;
@@ -0,0 +1,162 @@
+/**
+ * @file delta_codec.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @copyright Copyright (c) 2024
+ */
+
+#include <string>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "kvik/delta_codec.hpp"
+#include "kvik/errors.hpp"
+
+using namespace kvik;
+
+namespace
+{
+    /**
+     * @brief Encodes, decodes and confirms payload
+     * @param tx Sender's codec
+     * @param rx Receiver's codec
+     * @param topic Topic
+     * @param payload Payload
+     * @return Frame size
+     */
+    size_t transfer(DeltaCodec &tx, DeltaCodec &rx, const std::string &topic,
+                    const std::string &payload)
+    {
+        std::string frame = tx.encode(topic, payload);
+        std::string decoded;
+        REQUIRE(rx.decode(topic, frame, decoded) == ErrCode::SUCCESS);
+        REQUIRE(decoded == payload);
+        tx.confirm(topic);
+        return frame.size();
+    }
+} // namespace
+
+TEST_CASE("Delta encoding", "[DeltaCodec]")
+{
+    DeltaCodec tx, rx;
+    std::string json = R"({"temp":21.5,"hum":40,"uptime":123456})";
+
+    CHECK(transfer(tx, rx, "t", json) == json.size() + 2);
+
+    SECTION("Small change")
+    {
+        json[9] = '2';
+        CHECK(transfer(tx, rx, "t", json) <= 7);
+        json[9] = '3';
+        json[json.size() - 2] = '9';
+        CHECK(transfer(tx, rx, "t", json) <= 10);
+    }
+
+    SECTION("Identical payload")
+    {
+        CHECK(transfer(tx, rx, "t", json) == 4);
+    }
+
+    SECTION("Length changes")
+    {
+        CHECK(transfer(tx, rx, "t", json + "xyz") < 10);
+        CHECK(transfer(tx, rx, "t", json.substr(0, 10)) < 10);
+        CHECK(transfer(tx, rx, "t", "") == 2);
+        CHECK(transfer(tx, rx, "t", json) == json.size() + 2);
+    }
+
+    SECTION("Unrelated payload is sent in full")
+    {
+        std::string other(json.size(), 'x');
+        CHECK(transfer(tx, rx, "t", other) == other.size() + 2);
+    }
+
+    SECTION("Binary payload")
+    {
+        std::string bin(100, '\0');
+        for (size_t i = 0; i < bin.size(); i++) {
+            bin[i] = static_cast<char>(i * 7);
+        }
+        transfer(tx, rx, "b", bin);
+        bin[50] ^= 0x80;
+        bin[99] = 0;
+        CHECK(transfer(tx, rx, "b", bin) < 12);
+    }
+
+    SECTION("Topics are independent")
+    {
+        CHECK(transfer(tx, rx, "u", json) == json.size() + 2);
+        CHECK(transfer(tx, rx, "t", json) == 4);
+        CHECK(tx.size() == 2);
+        CHECK(rx.size() == 2);
+    }
+}
+
+TEST_CASE("Delta encoding fallback", "[DeltaCodec]")
+{
+    DeltaCodec tx(2, 50), rx(2, 50);
+    std::string payload = "counter=1000";
+    std::string decoded;
+    transfer(tx, rx, "a", payload);
+
+    SECTION("Lost frame")
+    {
+        // Frame is lost, so it isn't confirmed
+        tx.encode("a", "counter=1001");
+        tx.invalidate("a");
+        CHECK(transfer(tx, rx, "a", "counter=1002") == 14);
+    }
+
+    SECTION("Receiver lost base")
+    {
+        rx.clear();
+        std::string frame = tx.encode("a", "counter=1001");
+        CHECK(DeltaCodec::isDelta(frame));
+        CHECK(rx.decode("a", frame, decoded) == ErrCode::NOT_FOUND);
+        tx.invalidate("a");
+        CHECK(transfer(tx, rx, "a", "counter=1001") == 14);
+    }
+
+    SECTION("Unconfirmed frame decoded by receiver")
+    {
+        // Receiver moves on, sender keeps old base
+        std::string frame = tx.encode("a", "counter=1001");
+        REQUIRE(rx.decode("a", frame, decoded) == ErrCode::SUCCESS);
+        frame = tx.encode("a", "counter=1002");
+        CHECK(rx.decode("a", frame, decoded) == ErrCode::NOT_FOUND);
+    }
+
+    SECTION("Peer change")
+    {
+        tx.bindPeer(LocalAddr{{1, 2, 3}});
+        CHECK(tx.size() == 0);
+        CHECK(transfer(tx, rx, "a", payload) == 14);
+        tx.bindPeer(LocalAddr{{1, 2, 3}});
+        CHECK(transfer(tx, rx, "a", payload) == 4);
+    }
+
+    SECTION("Bounded memory")
+    {
+        transfer(tx, rx, "b", payload);
+        transfer(tx, rx, "c", payload);
+        CHECK(tx.size() == 2);
+        CHECK(rx.size() == 2);
+
+        // "a" was evicted
+        CHECK(transfer(tx, rx, "a", payload) == 14);
+
+        std::string longPayload(51, 'x');
+        CHECK(transfer(tx, rx, "a", longPayload) == 53);
+        CHECK(transfer(tx, rx, "a", longPayload) == 53);
+        CHECK(transfer(tx, rx, "a", payload) == 14);
+    }
+
+    SECTION("Malformed frames")
+    {
+        CHECK(rx.decode("a", "", decoded) == ErrCode::INVALID_ARG);
+        CHECK(rx.decode("a", "\x05\x00", decoded) == ErrCode::INVALID_ARG);
+        CHECK(rx.decode("a", std::string("\x01\x00\x01\x05\x00\x09x", 7),
+                        decoded) == ErrCode::INVALID_ARG);
+        CHECK(rx.decode("a", std::string("\x01\x00\x01\xFF", 4), decoded) ==
+              ErrCode::INVALID_ARG);
+    }
+}
@@ -0,0 +1,201 @@
+/**
+ * @file downlink_scheduler.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @copyright Copyright (c) 2024
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "kvik/downlink_scheduler.hpp"
+#include "kvik/errors.hpp"
+#include "kvik_testing/dummy_local_layer.hpp"
+
+using namespace kvik;
+using namespace std::chrono_literals;
+
+using SentLog = DummyLocalLayer::SentLog;
+
+static const LocalAddr ADDR1{{0x01}};
+static const LocalAddr ADDR2{{0x02}};
+static const LocalAddr ADDR3{{0x03}};
+
+static LocalMsg subDataMsg(const LocalAddr &addr, const std::string &payload)
+{
+    return {
+        .type = LocalMsgType::SUB_DATA,
+        .addr = addr,
+        .subsData = {{.topic = "t", .payload = payload}},
+        .nodeType = NodeType::GATEWAY,
+    };
+}
+
+TEST_CASE("Invalid parameters", "[DownlinkScheduler]")
+{
+    DummyLocalLayer ll;
+    DownlinkSchedulerConfig conf;
+
+    SECTION("No local layer")
+    {
+        REQUIRE_THROWS(DownlinkScheduler(conf, nullptr));
+    }
+
+    SECTION("No classes")
+    {
+        conf.classWeights = {};
+        REQUIRE_THROWS(DownlinkScheduler(conf, &ll));
+    }
+
+    SECTION("Zero weight")
+    {
+        conf.classWeights = {1, 0};
+        REQUIRE_THROWS(DownlinkScheduler(conf, &ll));
+    }
+
+    SECTION("Zero quantum")
+    {
+        conf.quantum = 0;
+        REQUIRE_THROWS(DownlinkScheduler(conf, &ll));
+    }
+}
+
+TEST_CASE("Pass-through", "[DownlinkScheduler]")
+{
+    DummyLocalLayer ll;
+    ll.channels = {1, 2};
+    DownlinkScheduler sched({}, &ll);
+
+    SECTION("Send")
+    {
+        auto msg = subDataMsg(ADDR1, "a");
+        REQUIRE(sched.send(msg) == ErrCode::SUCCESS);
+        sched.flush();
+        CHECK(ll.sentLog == SentLog{msg});
+        CHECK(sched.queuedCnt() == 0);
+    }
+
+    SECTION("Channels")
+    {
+        CHECK(sched.getChannels() == ILocalLayer::Channels{1, 2});
+        CHECK(sched.setChannel(2) == ErrCode::SUCCESS);
+        CHECK(ll.channelsLog == DummyLocalLayer::ChannelsLog{2});
+    }
+
+    SECTION("Airtime")
+    {
+        ll.airtime = std::chrono::microseconds(1500);
+        CHECK(sched.estimateAirtime(subDataMsg(ADDR1, "a")) == ll.airtime);
+    }
+
+    SECTION("Receive")
+    {
+        int cnt = 0;
+        sched.setRecvCb([&cnt](LocalMsg) {
+            cnt++;
+            return ErrCode::SUCCESS;
+        });
+        CHECK(ll.recv({}) == ErrCode::SUCCESS);
+        CHECK(cnt == 1);
+    }
+
+    SECTION("Invalid class")
+    {
+        CHECK(sched.send(subDataMsg(ADDR1, "a"), 2) == ErrCode::INVALID_ARG);
+    }
+}
+
+TEST_CASE("Per-client queue limit", "[DownlinkScheduler]")
+{
+    DummyLocalLayer ll;
+    ll.sendDelay = 20ms;
+    DownlinkSchedulerConfig conf;
+    conf.maxClientQueueLen = 3;
+    DownlinkScheduler sched(conf, &ll);
+
+    // First message is picked by sender thread immediately
+    REQUIRE(sched.send(subDataMsg(ADDR1, "0")) == ErrCode::SUCCESS);
+    std::this_thread::sleep_for(5ms);
+
+    for (int i = 1; i <= 3; i++) {
+        REQUIRE(sched.send(subDataMsg(ADDR1, std::to_string(i))) ==
+                ErrCode::SUCCESS);
+    }
+    CHECK(sched.send(subDataMsg(ADDR1, "4")) == ErrCode::QUEUE_FULL);
+
+    // Other clients aren't affected
+    CHECK(sched.send(subDataMsg(ADDR2, "0")) == ErrCode::SUCCESS);
+
+    sched.flush();
+    CHECK(ll.sentLog.size() == 5);
+}
+
+TEST_CASE("Fairness under skewed fan-out", "[DownlinkScheduler]")
+{
+    DummyLocalLayer ll;
+    ll.sendDelay = 2ms;
+    DownlinkSchedulerConfig conf;
+    conf.quantum = 64;
+    conf.maxClientQueueLen = 100;
+    DownlinkScheduler sched(conf, &ll);
+
+    // Chatty client gets burst, then two other clients get single message
+    std::string payload(32, 'x');
+    for (int i = 0; i < 50; i++) {
+        REQUIRE(sched.send(subDataMsg(ADDR1, payload)) == ErrCode::SUCCESS);
+    }
+    REQUIRE(sched.send(subDataMsg(ADDR2, payload)) == ErrCode::SUCCESS);
+    REQUIRE(sched.send(subDataMsg(ADDR3, payload)) == ErrCode::SUCCESS);
+    sched.flush();
+
+    REQUIRE(ll.sentLog.size() == 52);
+    auto posOf = [&ll](const LocalAddr &addr) {
+        return std::find_if(ll.sentLog.begin(), ll.sentLog.end(),
+                            [&addr](const LocalMsg &m) {
+                                return m.addr == addr;
+                            }) -
+               ll.sentLog.begin();
+    };
+
+    // Arrival order would deliver them at positions 50 and 51
+    CHECK(posOf(ADDR2) < 5);
+    CHECK(posOf(ADDR3) < 5);
+}
+
+TEST_CASE("Class weights", "[DownlinkScheduler]")
+{
+    DummyLocalLayer ll;
+    ll.sendDelay = 2ms;
+    DownlinkSchedulerConfig conf;
+    conf.quantum = 50;
+    conf.maxClientQueueLen = 100;
+    conf.classWeights = {3, 1};
+    DownlinkScheduler sched(conf, &ll);
+
+    // Block sender thread with first message
+    REQUIRE(sched.send(subDataMsg(ADDR3, "")) == ErrCode::SUCCESS);
+    std::this_thread::sleep_for(1ms);
+
+    // Both classes of single client, messages cost 50 bytes each
+    std::string payload1(50 - 16 - 1 - 1 - 2, 'x');
+    std::string payload0(50 - 16 - 1 - 1 - 2, 'y');
+    for (int i = 0; i < 20; i++) {
+        REQUIRE(sched.send(subDataMsg(ADDR1, payload1), 1) ==
+                ErrCode::SUCCESS);
+        REQUIRE(sched.send(subDataMsg(ADDR1, payload0), 0) ==
+                ErrCode::SUCCESS);
+    }
+    sched.flush();
+
+    // In first 8 messages after blocking one, class 0 gets 3x more turns
+    size_t cls0Cnt = 0;
+    for (size_t i = 1; i <= 8; i++) {
+        if (ll.sentLog[i].subsData[0].payload.back() == 'y') {
+            cls0Cnt++;
+        }
+    }
+    CHECK(cls0Cnt == 6);
+}
@@ -0,0 +1,101 @@
+/**
+ * @file energy_meter.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @copyright Copyright (c) 2024
+ */
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include <catch2/catch_approx.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "kvik/energy_meter.hpp"
+
+using namespace kvik;
+using namespace std::chrono_literals;
+
+TEST_CASE("Energy operation to string", "[EnergyMeter]")
+{
+    CHECK(std::string(energyOpToStr(EnergyOp::TX)) == "TX");
+    CHECK(std::string(energyOpToStr(EnergyOp::RESP_WAIT)) == "RESP_WAIT");
+    CHECK(std::string(energyOpToStr(EnergyOp::BROADCAST_WAIT)) ==
+          "BROADCAST_WAIT");
+    CHECK(std::string(energyOpToStr(EnergyOp::CHANNEL_SCAN)) ==
+          "CHANNEL_SCAN");
+    CHECK(std::string(energyOpToStr(EnergyOp::COUNT)) == "UNKNOWN");
+}
+
+TEST_CASE("Constant power model", "[EnergyMeter]")
+{
+    ConstPowerModel model(0.8, 0.2);
+    CHECK(model.power(RadioState::TX) == 0.8);
+    CHECK(model.power(RadioState::RX) == 0.2);
+}
+
+TEST_CASE("Energy accumulation", "[EnergyMeter]")
+{
+    EnergyMeter meter(std::make_shared<ConstPowerModel>(1.0, 0.25));
+
+    auto snap = meter.snapshot();
+    CHECK(snap.totalTime() == 0us);
+    CHECK(snap.totalEnergy() == 0.0);
+    CHECK(snap.energyPerDelivered() == 0.0);
+
+    meter.record(EnergyOp::TX, 1000us);
+    meter.record(EnergyOp::TX, 3000us);
+    meter.record(EnergyOp::RESP_WAIT, 20ms);
+    meter.record(EnergyOp::CHANNEL_SCAN, 100ms);
+    meter.recordDelivered();
+    meter.recordDelivered();
+
+    snap = meter.snapshot();
+
+    SECTION("Per operation")
+    {
+        CHECK(snap.op(EnergyOp::TX).cnt == 2);
+        CHECK(snap.op(EnergyOp::TX).time == 4ms);
+        CHECK(snap.op(EnergyOp::TX).energy == Catch::Approx(0.004));
+        CHECK(snap.op(EnergyOp::RESP_WAIT).energy == Catch::Approx(0.005));
+        CHECK(snap.op(EnergyOp::BROADCAST_WAIT).cnt == 0);
+        CHECK(snap.op(EnergyOp::CHANNEL_SCAN).energy == Catch::Approx(0.025));
+    }
+
+    SECTION("Totals")
+    {
+        CHECK(snap.totalTime() == 124ms);
+        CHECK(snap.totalEnergy() == Catch::Approx(0.034));
+        CHECK(snap.delivered == 2);
+        CHECK(snap.energyPerDelivered() == Catch::Approx(0.017));
+    }
+
+    SECTION("Invalid records are ignored")
+    {
+        meter.record(EnergyOp::COUNT, 1ms);
+        meter.record(EnergyOp::TX, -1ms);
+        CHECK(meter.snapshot().totalTime() == 124ms);
+    }
+
+    SECTION("Clear")
+    {
+        meter.clear();
+        snap = meter.snapshot();
+        CHECK(snap.totalTime() == 0us);
+        CHECK(snap.delivered == 0);
+    }
+}
+
+TEST_CASE("Default power model", "[EnergyMeter]")
+{
+    EnergyMeter meter;
+    meter.record(EnergyOp::TX, 1s);
+    meter.record(EnergyOp::BROADCAST_WAIT, 1s);
+
+    auto snap = meter.snapshot();
+    ConstPowerModel model;
+    CHECK(snap.op(EnergyOp::TX).energy ==
+          Catch::Approx(model.power(RadioState::TX)));
+    CHECK(snap.op(EnergyOp::BROADCAST_WAIT).energy ==
+          Catch::Approx(model.power(RadioState::RX)));
+}
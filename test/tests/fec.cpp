@@ -0,0 +1,118 @@
+/**
+ * @file fec.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @copyright Copyright (c) 2024
+ */
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "kvik/errors.hpp"
+#include "kvik/fec.hpp"
+
+using namespace kvik;
+
+namespace
+{
+    /**
+     * @brief Generates deterministic shards
+     * @param cnt Number of shards
+     * @param len Length of shard
+     * @return Shards
+     */
+    std::vector<std::string> testShards(size_t cnt, size_t len)
+    {
+        std::vector<std::string> shards(cnt, std::string(len, '\0'));
+        for (size_t i = 0; i < cnt; i++) {
+            for (size_t j = 0; j < len; j++) {
+                shards[i][j] = static_cast<char>((i * 131 + j * 17 + 3) & 0xFF);
+            }
+        }
+        return shards;
+    }
+} // namespace
+
+TEST_CASE("FEC reconstruction", "[FEC]")
+{
+    constexpr size_t K = 5;
+    constexpr size_t M = 3;
+    auto data = testShards(K, 40);
+    std::vector<std::string> parity;
+    REQUIRE(fecEncode(data, M, parity) == ErrCode::SUCCESS);
+    REQUIRE(parity.size() == M);
+
+    // Every combination of up to M lost shards out of K + M
+    for (unsigned mask = 0; mask < (1u << (K + M)); mask++) {
+        size_t lostCnt = 0;
+        for (size_t i = 0; i < K + M; i++) {
+            lostCnt += (mask >> i) & 1;
+        }
+        if (lostCnt > M) {
+            continue;
+        }
+
+        std::vector<std::string> shards = data;
+        std::vector<bool> present(K, true);
+        for (size_t i = 0; i < K; i++) {
+            if ((mask >> i) & 1) {
+                present[i] = false;
+                shards[i].clear();
+            }
+        }
+        std::map<size_t, std::string> received;
+        for (size_t j = 0; j < M; j++) {
+            if (!((mask >> (K + j)) & 1)) {
+                received[j] = parity[j];
+            }
+        }
+
+        REQUIRE(fecDecode(shards, present, received) == ErrCode::SUCCESS);
+        REQUIRE(shards == data);
+    }
+}
+
+TEST_CASE("FEC errors", "[FEC]")
+{
+    auto data = testShards(4, 10);
+    std::vector<std::string> parity;
+
+    SECTION("Not enough shards")
+    {
+        REQUIRE(fecEncode(data, 1, parity) == ErrCode::SUCCESS);
+        std::vector<bool> present{false, true, false, true};
+        CHECK(fecDecode(data, present, {{0, parity[0]}}) ==
+              ErrCode::NOT_FOUND);
+    }
+
+    SECTION("Invalid arguments")
+    {
+        CHECK(fecEncode({}, 1, parity) == ErrCode::INVALID_ARG);
+        CHECK(fecEncode(data, FEC_MAX_SHARDS, parity) == ErrCode::INVALID_ARG);
+        data[1] += "x";
+        CHECK(fecEncode(data, 1, parity) == ErrCode::INVALID_SIZE);
+        CHECK(fecDecode(data, {true}, {}) == ErrCode::INVALID_ARG);
+    }
+
+    SECTION("Parity count is independent")
+    {
+        // First parity shards are the same regardless of parity count
+        std::vector<std::string> more;
+        REQUIRE(fecEncode(data, 2, parity) == ErrCode::SUCCESS);
+        REQUIRE(fecEncode(data, 4, more) == ErrCode::SUCCESS);
+        CHECK(more[0] == parity[0]);
+        CHECK(more[1] == parity[1]);
+    }
+}
+
+TEST_CASE("FEC redundancy", "[FEC]")
+{
+    CHECK(fecParityCnt(8, 0, 4) == 0);
+    CHECK(fecParityCnt(8, 0.01, 4) == 1);
+    CHECK(fecParityCnt(8, 0.1, 4) >= 2);
+    CHECK(fecParityCnt(8, 0.5, 4) == 4);
+    CHECK(fecParityCnt(8, 0.5, 100) > fecParityCnt(8, 0.2, 100));
+    CHECK(fecParityCnt(250, 0.5, 100) == 5);
+}
@@ -0,0 +1,321 @@
+/**
+ * @file gateway_replicator.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @copyright Copyright (c) 2024
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "kvik/errors.hpp"
+#include "kvik/gateway_replicator.hpp"
+
+using namespace kvik;
+using namespace std::chrono_literals;
+
+using Consumers = std::vector<GatewayReplicator::ConsumerId>;
+using Filters = std::vector<std::string>;
+using Role = GatewayReplicator::Role;
+
+namespace
+{
+    /**
+     * @brief Loopback channel counting sent frames
+     */
+    class CountingChannel : public LoopbackReplicationChannel
+    {
+    public:
+        size_t sentCnt = 0;
+
+        ErrCode send(const std::string &frame) override
+        {
+            sentCnt++;
+            return LoopbackReplicationChannel::send(frame);
+        }
+    };
+
+    /**
+     * @brief Returns address of n-th client
+     * @param n Client number
+     * @return Address
+     */
+    LocalAddr clientAddr(size_t n)
+    {
+        return LocalAddr{{0xAA, static_cast<uint8_t>(n >> 8),
+                          static_cast<uint8_t>(n & 0xFF)}};
+    }
+
+    /**
+     * @brief Lets standby request snapshot and receive it
+     * @param active Active gateway
+     * @param standby Standby gateway
+     * @param now Current time
+     */
+    void sync(GatewayReplicator &active, GatewayReplicator &standby,
+              std::chrono::steady_clock::time_point now)
+    {
+        REQUIRE(standby.tick(now) == ErrCode::SUCCESS);
+        REQUIRE(active.tick(now) == ErrCode::SUCCESS);
+        REQUIRE(standby.tick(now) == ErrCode::SUCCESS);
+    }
+} // namespace
+
+TEST_CASE("Gateway state replication", "[GatewayReplicator]")
+{
+    CountingChannel chanA, chanB;
+    LoopbackReplicationChannel::connect(chanA, chanB);
+
+    Filters unsubsA, unsubsB;
+    GatewayReplicator::Config conf;
+    conf.subLifetime = 60s;
+    GatewayReplicator active(
+        Role::ACTIVE, &chanA,
+        [&](const Filters &b) {
+            unsubsA.insert(unsubsA.end(), b.begin(), b.end());
+        },
+        conf);
+    GatewayReplicator standby(
+        Role::STANDBY, &chanB,
+        [&](const Filters &b) {
+            unsubsB.insert(unsubsB.end(), b.begin(), b.end());
+        },
+        conf);
+
+    auto start = std::chrono::steady_clock::now();
+    bool newUpstream;
+    Consumers consumers;
+
+    // State existing before standby joins
+    for (size_t i = 0; i < 100; i++) {
+        PeerSession session;
+        session.lastMsgId = 1000 + i;
+        session.msgIdWindow = 0b1011;
+        session.tsDiff = std::chrono::milliseconds(-500 + int64_t(i));
+        session.leaseExpiry = start + 30s;
+        session.rxMsgs = i;
+        REQUIRE(active.updateSession(clientAddr(i), session) ==
+                ErrCode::SUCCESS);
+        REQUIRE(active.subscribe(i, "dev/" + std::to_string(i) + "/cmd",
+                                 start, newUpstream) == ErrCode::SUCCESS);
+    }
+    REQUIRE(active.subscribe(1, "$share/g/jobs", start, newUpstream) ==
+            ErrCode::SUCCESS);
+    REQUIRE(active.subscribe(2, "$share/g/jobs", start, newUpstream) ==
+            ErrCode::SUCCESS);
+
+    CHECK_FALSE(standby.synced());
+    CHECK(standby.updateSession(clientAddr(0), {}) == ErrCode::NOT_SUPPORTED);
+    CHECK(standby.subscribe(1, "a", start, newUpstream) ==
+          ErrCode::NOT_SUPPORTED);
+
+    sync(active, standby, start);
+    REQUIRE(standby.synced());
+    CHECK(standby.sessionCnt() == 100);
+    CHECK(standby.subCnt() == 102);
+
+    PeerSession session;
+    REQUIRE(standby.getSession(clientAddr(42), session) == ErrCode::SUCCESS);
+    CHECK(session.lastMsgId == 1042);
+    CHECK(session.msgIdWindow == 0b1011);
+    CHECK(session.tsDiff == -458ms);
+    CHECK(session.leaseExpiry == start + 30s);
+    CHECK(session.rxMsgs == 42);
+
+    standby.match("dev/42/cmd", consumers);
+    CHECK(consumers == Consumers{42});
+
+    SECTION("Deltas")
+    {
+        session.lastMsgId = 2000;
+        REQUIRE(active.updateSession(clientAddr(42), session) ==
+                ErrCode::SUCCESS);
+        REQUIRE(active.updateSession(clientAddr(500), session) ==
+                ErrCode::SUCCESS);
+        REQUIRE(active.removeSession(clientAddr(7)) == ErrCode::SUCCESS);
+        CHECK(active.removeSession(clientAddr(7)) == ErrCode::NOT_FOUND);
+        REQUIRE(active.unsubscribe(3, "dev/3/cmd") == ErrCode::SUCCESS);
+        REQUIRE(active.removeConsumer(4) == ErrCode::SUCCESS);
+        REQUIRE(active.subscribe(5, "extra/#", start, newUpstream) ==
+                ErrCode::SUCCESS);
+
+        // Coalesced into single frame
+        chanA.sentCnt = 0;
+        REQUIRE(active.flush(start + 1s) == ErrCode::SUCCESS);
+        CHECK(chanA.sentCnt == 1);
+        REQUIRE(standby.tick(start + 1s) == ErrCode::SUCCESS);
+
+        CHECK(standby.synced());
+        CHECK(standby.sessionCnt() == 100);
+        CHECK(standby.subCnt() == 101);
+        REQUIRE(standby.getSession(clientAddr(42), session) ==
+                ErrCode::SUCCESS);
+        CHECK(session.lastMsgId == 2000);
+        CHECK(standby.getSession(clientAddr(500), session) ==
+              ErrCode::SUCCESS);
+        CHECK(standby.getSession(clientAddr(7), session) ==
+              ErrCode::NOT_FOUND);
+
+        standby.match("dev/3/cmd", consumers);
+        CHECK(consumers.empty());
+        standby.match("dev/4/cmd", consumers);
+        CHECK(consumers.empty());
+        standby.match("extra/x", consumers);
+        CHECK(consumers == Consumers{5});
+    }
+
+    SECTION("Heartbeat")
+    {
+        chanA.sentCnt = 0;
+        REQUIRE(active.tick(start + 100ms) == ErrCode::SUCCESS);
+        CHECK(chanA.sentCnt == 0);
+        REQUIRE(active.tick(start + 1s) == ErrCode::SUCCESS);
+        CHECK(chanA.sentCnt == 1);
+
+        REQUIRE(standby.tick(start + 1s) == ErrCode::SUCCESS);
+        CHECK_FALSE(standby.activeLost(start + 3s));
+        CHECK(standby.activeLost(start + 5s));
+        CHECK_FALSE(active.activeLost(start + 5s));
+    }
+
+    SECTION("Failover")
+    {
+        // Leases are renewed shortly before they'd expire
+        REQUIRE(active.renewAll(42, start + 59s) == ErrCode::SUCCESS);
+        CHECK(active.renewAll(1000, start + 59s) == ErrCode::NOT_FOUND);
+        REQUIRE(active.tick(start + 59s) == ErrCode::SUCCESS);
+
+        // Active gateway fails, standby is ticking late
+        chanA.setUp(false);
+        REQUIRE(standby.tick(start + 61s) == ErrCode::SUCCESS);
+        CHECK_FALSE(standby.activeLost(start + 63s));
+        CHECK(standby.subCnt() == 102);
+        CHECK(standby.activeLost(start + 65s));
+
+        Filters upstream;
+        REQUIRE(standby.promote(upstream, start + 65s) == ErrCode::SUCCESS);
+        CHECK(standby.role() == Role::ACTIVE);
+        CHECK(standby.promote(upstream, start + 65s) ==
+              ErrCode::NOT_SUPPORTED);
+
+        // Only renewed lease survived, expired ones aren't unsubscribed
+        // upstream (standby never subscribed them)
+        CHECK(upstream == Filters{"dev/42/cmd"});
+        CHECK(unsubsB.empty());
+        CHECK(standby.subCnt() == 1);
+
+        // Clients keep their sessions, no rediscovery needed
+        CHECK(standby.sessionCnt() == 100);
+        REQUIRE(standby.getSession(clientAddr(42), session) ==
+                ErrCode::SUCCESS);
+        CHECK_FALSE(session.checkMsgId(1042));
+        CHECK(session.checkMsgId(1043));
+
+        // New active gateway serves clients and expires leases
+        REQUIRE(standby.subscribe(9, "new", start + 65s, newUpstream) ==
+                ErrCode::SUCCESS);
+        CHECK(newUpstream);
+        REQUIRE(standby.tick(start + 200s) == ErrCode::SUCCESS);
+        std::sort(unsubsB.begin(), unsubsB.end());
+        CHECK(unsubsB == Filters{"dev/42/cmd", "new"});
+    }
+
+    SECTION("Former active rejoins as standby")
+    {
+        Filters upstream;
+        chanA.setUp(false);
+        REQUIRE(standby.promote(upstream, start + 5s) == ErrCode::SUCCESS);
+        chanA.setUp(true);
+
+        Filters unsubsC;
+        GatewayReplicator rejoined(
+            Role::STANDBY, &chanA,
+            [&](const Filters &b) {
+                unsubsC.insert(unsubsC.end(), b.begin(), b.end());
+            },
+            conf);
+        sync(standby, rejoined, start + 6s);
+        CHECK(rejoined.synced());
+        CHECK(rejoined.sessionCnt() == 100);
+        CHECK(rejoined.subCnt() == 102);
+    }
+}
+
+TEST_CASE("Gateway state resynchronization", "[GatewayReplicator]")
+{
+    LoopbackReplicationChannel chanA, chanB;
+    LoopbackReplicationChannel::connect(chanA, chanB);
+
+    Filters unsubs;
+    auto unsubCb = [&](const Filters &b) {
+        unsubs.insert(unsubs.end(), b.begin(), b.end());
+    };
+    GatewayReplicator::Config conf;
+    conf.maxFrameLen = 64;
+    GatewayReplicator active(Role::ACTIVE, &chanA, unsubCb, conf);
+    GatewayReplicator standby(Role::STANDBY, &chanB, unsubCb, conf);
+
+    auto start = std::chrono::steady_clock::now();
+    bool newUpstream;
+    for (size_t i = 0; i < 50; i++) {
+        REQUIRE(active.subscribe(i, "t/" + std::to_string(i), start,
+                                 newUpstream) == ErrCode::SUCCESS);
+    }
+
+    // Snapshot is split to many small frames
+    sync(active, standby, start);
+    REQUIRE(standby.synced());
+    CHECK(standby.subCnt() == 50);
+
+    SECTION("Lost frame")
+    {
+        chanA.setUp(false);
+        REQUIRE(active.unsubscribe(0, "t/0") == ErrCode::SUCCESS);
+        REQUIRE(active.flush(start + 1s) == ErrCode::SUCCESS);
+        chanA.setUp(true);
+        REQUIRE(active.unsubscribe(1, "t/1") == ErrCode::SUCCESS);
+        REQUIRE(active.flush(start + 1s) == ErrCode::SUCCESS);
+
+        // Gap is detected, stale state is kept until snapshot arrives
+        REQUIRE(standby.tick(start + 1s) == ErrCode::SUCCESS);
+        CHECK_FALSE(standby.synced());
+        CHECK(standby.subCnt() == 50);
+
+        REQUIRE(active.tick(start + 1s) == ErrCode::SUCCESS);
+        REQUIRE(standby.tick(start + 1s) == ErrCode::SUCCESS);
+        CHECK(standby.synced());
+        CHECK(standby.subCnt() == 48);
+    }
+
+    SECTION("Restarted standby")
+    {
+        // Takes over the channel, its first request is lost
+        GatewayReplicator fresh(Role::STANDBY, &chanB, unsubCb, conf);
+        chanB.setUp(false);
+        REQUIRE(fresh.tick(start + 1s) == ErrCode::SUCCESS);
+        chanB.setUp(true);
+
+        // Heartbeat doesn't help, request is repeated
+        REQUIRE(active.tick(start + 1s) == ErrCode::SUCCESS);
+        REQUIRE(fresh.tick(start + 1500ms) == ErrCode::SUCCESS);
+        CHECK_FALSE(fresh.synced());
+        CHECK_FALSE(fresh.activeLost(start + 2s));
+
+        sync(active, fresh, start + 2s);
+        CHECK(fresh.synced());
+        CHECK(fresh.subCnt() == 50);
+    }
+
+    SECTION("Invalid configuration")
+    {
+        LoopbackReplicationChannel chan;
+        GatewayReplicator::Config invalid;
+        invalid.failoverTimeout = invalid.heartbeat;
+        CHECK_THROWS(GatewayReplicator(Role::ACTIVE, &chan, unsubCb, invalid));
+        CHECK_THROWS(GatewayReplicator(Role::ACTIVE, nullptr, unsubCb));
+        CHECK_THROWS(GatewayReplicator(Role::ACTIVE, &chan, nullptr));
+    }
+}
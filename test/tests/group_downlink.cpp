@@ -0,0 +1,210 @@
+/**
+ * @file group_downlink.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @copyright Copyright (c) 2024
+ */
+
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "kvik/group_downlink.hpp"
+#include "kvik/limits.hpp"
+#include "kvik/local_msg.hpp"
+
+using namespace kvik;
+
+using Msgs = std::vector<LocalMsg>;
+
+static const LocalAddr ADDR1{{0x01}};
+static const LocalAddr ADDR2{{0x02}};
+static const LocalAddr ADDR3{{0x03}};
+static const SubData DATA1 = {.topic = "fw/announce", .payload = "v2"};
+static const SubData DATA2 = {.topic = "cfg", .payload = "x"};
+
+static LocalMsg unicast(const LocalAddr &addr, const SubData &data)
+{
+    return {
+        .type = LocalMsgType::SUB_DATA,
+        .addr = addr,
+        .subsData = {data},
+    };
+}
+
+static LocalMsg group(const std::vector<uint16_t> &idxs, uint16_t seq,
+                      const SubData &data, const LocalAddr &addr = {})
+{
+    LocalMsg msg = unicast(addr, data);
+    for (auto idx : idxs) {
+        groupRecipientsSet(msg.groupRecipients, idx);
+    }
+    msg.groupSeq = seq;
+    return msg;
+}
+
+static LocalMsg nack(uint16_t seq)
+{
+    LocalMsg msg = {
+        .type = LocalMsgType::FAIL,
+        .failReason = LocalMsgFailReason::GROUP_SEQ_GAP,
+    };
+    msg.groupSeq = seq;
+    return msg;
+}
+
+TEST_CASE("Recipients bitmap", "[GroupDownlink]")
+{
+    std::vector<uint8_t> bitmap;
+    groupRecipientsSet(bitmap, 0);
+    groupRecipientsSet(bitmap, 9);
+
+    CHECK(bitmap == std::vector<uint8_t>{0x01, 0x02});
+    CHECK(groupRecipientsHas(bitmap, 0));
+    CHECK(groupRecipientsHas(bitmap, 9));
+    CHECK(!groupRecipientsHas(bitmap, 1));
+    CHECK(!groupRecipientsHas(bitmap, 100));
+    CHECK(!groupRecipientsHas(bitmap, GROUP_IDX_NONE));
+}
+
+TEST_CASE("Build group-addressed data", "[GroupDownlink]")
+{
+    REQUIRE_THROWS(GroupDownlink(1));
+
+    GroupDownlink gd;
+
+    SECTION("Identical data grouped")
+    {
+        gd.enqueue(ADDR1, 0, DATA1);
+        gd.enqueue(ADDR2, 1, DATA1);
+        gd.enqueue(ADDR3, 10, DATA1);
+        CHECK(gd.build() == Msgs{group({0, 1, 10}, 0, DATA1)});
+        CHECK(gd.build().empty());
+    }
+
+    SECTION("Single recipient stays unicast")
+    {
+        gd.enqueue(ADDR1, 0, DATA1);
+        gd.enqueue(ADDR2, 1, DATA2);
+        CHECK(gd.build() == Msgs{unicast(ADDR1, DATA1), unicast(ADDR2, DATA2)});
+    }
+
+    SECTION("Clients without group index stay unicast")
+    {
+        gd.enqueue(ADDR1, 0, DATA1);
+        gd.enqueue(ADDR2, 1, DATA1);
+        gd.enqueue(ADDR3, GROUP_IDX_NONE, DATA1);
+        CHECK(gd.build() ==
+              Msgs{group({0, 1}, 0, DATA1), unicast(ADDR3, DATA1)});
+    }
+
+    SECTION("Duplicate data for the same client")
+    {
+        gd.enqueue(ADDR1, 0, DATA1);
+        gd.enqueue(ADDR2, 1, DATA1);
+        gd.enqueue(ADDR1, 0, DATA1);
+        CHECK(gd.build() ==
+              Msgs{group({0, 1}, 0, DATA1), unicast(ADDR1, DATA1)});
+    }
+
+    SECTION("Sequence numbers")
+    {
+        gd.enqueue(ADDR1, 0, DATA1);
+        gd.enqueue(ADDR2, 1, DATA1);
+        gd.enqueue(ADDR1, 0, DATA2);
+        gd.enqueue(ADDR2, 1, DATA2);
+        CHECK(gd.build() ==
+              Msgs{group({0, 1}, 0, DATA1), group({0, 1}, 1, DATA2)});
+    }
+}
+
+TEST_CASE("Group data acknowledgements", "[GroupDownlink]")
+{
+    GroupDownlink gd(2, 2);
+
+    for (auto data : {DATA1, DATA2, DATA1}) {
+        gd.enqueue(ADDR1, 0, data);
+        gd.enqueue(ADDR2, 1, data);
+        gd.build();
+    }
+
+    std::vector<uint16_t> idxs;
+
+    SECTION("Cumulative ack")
+    {
+        LocalMsg ack = {.type = LocalMsgType::OK};
+        ack.groupSeq = 2;
+        gd.processAck(0, ack);
+
+        REQUIRE(gd.unacked(2, idxs) == ErrCode::SUCCESS);
+        CHECK(idxs == std::vector<uint16_t>{1});
+        CHECK(gd.unacked(0, idxs) == ErrCode::NOT_FOUND);
+    }
+
+    SECTION("Retransmission after NACK")
+    {
+        Msgs msgs;
+        REQUIRE(gd.processNack(ADDR2, 1, nack(1), msgs) == ErrCode::SUCCESS);
+        CHECK(msgs == Msgs{group({1}, 1, DATA2, ADDR2),
+                           group({1}, 2, DATA1, ADDR2)});
+    }
+
+    SECTION("Retransmission of acked data is skipped")
+    {
+        LocalMsg ack = {.type = LocalMsgType::OK};
+        ack.groupSeq = 1;
+        gd.processAck(1, ack);
+
+        Msgs msgs;
+        REQUIRE(gd.processNack(ADDR2, 1, nack(1), msgs) == ErrCode::SUCCESS);
+        CHECK(msgs == Msgs{group({1}, 2, DATA1, ADDR2)});
+    }
+
+    SECTION("Missing data no longer in history")
+    {
+        Msgs msgs;
+        CHECK(gd.processNack(ADDR1, 0, nack(0), msgs) == ErrCode::NOT_FOUND);
+        CHECK(msgs.size() == 2);
+    }
+
+    SECTION("Sync point")
+    {
+        LocalMsg probeRes = {.type = LocalMsgType::PROBE_RES};
+        CHECK(gd.attach(probeRes) == ErrCode::INVALID_ARG);
+        LocalMsg ok = {.type = LocalMsgType::OK};
+        ok.groupIdx = 1;
+        CHECK(gd.attach(ok) == ErrCode::INVALID_ARG);
+
+        // Group index reassigned to new client
+        probeRes.groupIdx = 1;
+        REQUIRE(gd.attach(probeRes) == ErrCode::SUCCESS);
+        CHECK(probeRes.groupSeq == 2);
+
+        // Data sent before aren't covered by its acknowledgements
+        LocalMsg ack = {.type = LocalMsgType::OK};
+        ack.groupSeq = 2;
+        gd.processAck(1, ack);
+        REQUIRE(gd.unacked(2, idxs) == ErrCode::SUCCESS);
+        CHECK(idxs == std::vector<uint16_t>{0, 1});
+
+        Msgs msgs;
+        REQUIRE(gd.processNack(ADDR2, 1, nack(1), msgs) == ErrCode::SUCCESS);
+        CHECK(msgs.empty());
+
+        // Newer data are
+        gd.enqueue(ADDR1, 0, DATA2);
+        gd.enqueue(ADDR2, 1, DATA2);
+        gd.build();
+        ack.groupSeq = 3;
+        gd.processAck(1, ack);
+        idxs.clear();
+        REQUIRE(gd.unacked(3, idxs) == ErrCode::SUCCESS);
+        CHECK(idxs == std::vector<uint16_t>{0});
+    }
+
+    SECTION("Invalid NACK")
+    {
+        Msgs msgs;
+        CHECK(gd.processNack(ADDR1, 0, {.type = LocalMsgType::FAIL}, msgs) ==
+              ErrCode::INVALID_ARG);
+    }
+}
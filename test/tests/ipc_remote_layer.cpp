@@ -0,0 +1,439 @@
+/**
+ * @file ipc_remote_layer.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @copyright Copyright (c) 2024
+ */
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "kvik/ipc_remote_layer.hpp"
+#include "kvik/ipc_ring.hpp"
+
+using namespace kvik;
+using namespace std::chrono_literals;
+
+namespace
+{
+    const std::string SOCK_PATH =
+        "/tmp/kvik_ipc_test_" + std::to_string(getpid()) + ".sock";
+
+    bool waitUntil(const std::function<bool()> &pred,
+                   std::chrono::milliseconds timeout = 2000ms)
+    {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (!pred()) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                return false;
+            }
+            std::this_thread::sleep_for(1ms);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Thread-safe collector of received data
+     */
+    struct Inbox
+    {
+        std::mutex mutex;
+        std::vector<PubData> data;
+
+        void add(std::string_view topic, std::string_view payload)
+        {
+            const std::scoped_lock lock(mutex);
+            data.push_back({std::string(topic), std::string(payload)});
+        }
+
+        size_t size()
+        {
+            const std::scoped_lock lock(mutex);
+            return data.size();
+        }
+
+        void clear()
+        {
+            const std::scoped_lock lock(mutex);
+            data.clear();
+        }
+    };
+} // namespace
+
+TEST_CASE("IPC ring", "[IpcRing]")
+{
+    IpcRing prod;
+    REQUIRE(prod.create(4096) == ErrCode::SUCCESS);
+    CHECK(prod.create(4096) == ErrCode::INVALID_ARG);
+    CHECK(prod.capacity() == 4096);
+
+    IpcRing cons;
+    REQUIRE(cons.attach(dup(prod.fd())) == ErrCode::SUCCESS);
+    CHECK(cons.capacity() == 4096);
+
+    std::vector<std::string> got;
+    auto collect = [&got](const IpcRing::Record &rec) {
+        got.push_back(std::string(rec.topic) + "=" + std::string(rec.payload));
+    };
+    bool notify;
+
+    SECTION("Capacity rounding")
+    {
+        IpcRing ring;
+        REQUIRE(ring.create(5000) == ErrCode::SUCCESS);
+        CHECK(ring.capacity() == 8192);
+    }
+
+    SECTION("Invalid attach")
+    {
+        int fd = memfd_create("kvik_test", 0);
+        REQUIRE(fd >= 0);
+        REQUIRE(ftruncate(fd, 8192) == 0);
+
+        IpcRing ring;
+        CHECK(ring.attach(fd) == ErrCode::INVALID_ARG);
+        CHECK(ring.fd() == -1);
+    }
+
+    SECTION("Records in order")
+    {
+        CHECK(prod.push(1, 7, "a/b", "xyz", notify) == ErrCode::SUCCESS);
+        CHECK(prod.push(1, 0, "c", "", notify) == ErrCode::SUCCESS);
+
+        uint8_t flags = 0;
+        CHECK(cons.drain([&](const IpcRing::Record &rec) {
+            flags |= rec.flags;
+            collect(rec);
+        }) == 2);
+        CHECK(got == std::vector<std::string>{"a/b=xyz", "c="});
+        CHECK(flags == 7);
+        CHECK(cons.drain(collect) == 0);
+    }
+
+    SECTION("Zero-copy write")
+    {
+        CHECK(prod.push(
+                  1, 0, "t", 4, [](char *buf) { std::memcpy(buf, "abcd", 4); },
+                  notify) == ErrCode::SUCCESS);
+        CHECK(cons.drain(collect) == 1);
+        CHECK(got == std::vector<std::string>{"t=abcd"});
+    }
+
+    SECTION("Wrap-around")
+    {
+        std::string payload(900, 'p');
+        for (int i = 0; i < 50; i++) {
+            payload[0] = 'a' + i % 26;
+            REQUIRE(prod.push(1, 0, "t", payload, notify) == ErrCode::SUCCESS);
+            REQUIRE(prod.push(1, 0, "u", payload, notify) == ErrCode::SUCCESS);
+            got.clear();
+            REQUIRE(cons.drain(collect) == 2);
+            CHECK(got[0] == "t=" + payload);
+            CHECK(got[1] == "u=" + payload);
+        }
+    }
+
+    SECTION("Full ring")
+    {
+        std::string payload(1000, 'p');
+        int cnt = 0;
+        while (prod.push(1, 0, "t", payload, notify) == ErrCode::SUCCESS) {
+            cnt++;
+        }
+        CHECK(cnt == 4);
+        CHECK(prod.push(1, 0, "t", payload, notify) == ErrCode::QUEUE_FULL);
+        CHECK(prod.push(1, 0, "t", std::string(3000, 'x'), notify) ==
+              ErrCode::INVALID_SIZE);
+
+        CHECK(cons.drain(collect) == cnt);
+        CHECK(prod.push(1, 0, "t", payload, notify) == ErrCode::SUCCESS);
+    }
+
+    SECTION("Batched notifications")
+    {
+        CHECK(prod.push(1, 0, "t", "1", notify) == ErrCode::SUCCESS);
+        CHECK(!notify);
+
+        // Consumer can't sleep with records pending
+        CHECK(!cons.prepareWait());
+        CHECK(cons.drain(collect) == 1);
+        CHECK(cons.prepareWait());
+
+        // Only the first record after consumer went to sleep notifies
+        CHECK(prod.push(1, 0, "t", "2", notify) == ErrCode::SUCCESS);
+        CHECK(notify);
+        for (int i = 0; i < 10; i++) {
+            CHECK(prod.push(1, 0, "t", "3", notify) == ErrCode::SUCCESS);
+            CHECK(!notify);
+        }
+        CHECK(cons.drain(collect) == 11);
+    }
+
+    SECTION("Corrupted ring")
+    {
+        CHECK(prod.push(1, 0, "t", "1", notify) == ErrCode::SUCCESS);
+
+        // Length of first record, which is right after 4 KiB header
+        uint32_t len = 3;
+        REQUIRE(pwrite(prod.fd(), &len, sizeof(len), 4096) == sizeof(len));
+        CHECK(cons.drain(collect) == -1);
+        CHECK(got.empty());
+    }
+}
+
+TEST_CASE("IPC remote layer", "[IpcRemoteLayer]")
+{
+    CHECK_THROWS(IpcRemoteLayer(""));
+    CHECK_THROWS(IpcRemoteLayer(std::string(200, 'a')));
+    CHECK_THROWS(IpcCompanion(SOCK_PATH, nullptr));
+
+    Inbox nodeInbox;
+    Inbox compInbox;
+    std::function<void()> nodeHook;
+    std::function<void()> compHook;
+
+    IpcRemoteLayer layer(SOCK_PATH, 4096);
+    layer.setRecvCb([&](const SubData &data) {
+        if (nodeHook) {
+            nodeHook();
+        }
+        nodeInbox.add(data.topic, data.payload);
+        return ErrCode::SUCCESS;
+    });
+    REQUIRE(layer.subscribe("sensors/#") == ErrCode::SUCCESS);
+    CHECK(layer.subscribe("a/#/b") == ErrCode::INVALID_ARG);
+
+    auto comp = std::make_unique<IpcCompanion>(
+        SOCK_PATH,
+        [&compInbox, &compHook](std::string_view topic,
+                                std::string_view payload) {
+            if (compHook) {
+                compHook();
+            }
+            compInbox.add(topic, payload);
+        },
+        4096);
+    CHECK(comp->connected());
+    CHECK(waitUntil([&] { return layer.companionCnt() == 1; }));
+
+    // Subscriptions made before connecting are known after handshake
+    CHECK(comp->nodeSubscribed("sensors/t"));
+    CHECK(!comp->nodeSubscribed("other"));
+
+    SECTION("Companion to node")
+    {
+        CHECK(comp->publish("other", "x") == ErrCode::SUCCESS);
+        CHECK(comp->publish("sensors/t", "21.5") == ErrCode::SUCCESS);
+        CHECK(comp->publish("sensors/h", 2, [](char *buf) {
+            buf[0] = '4';
+            buf[1] = '2';
+        }) == ErrCode::SUCCESS);
+
+        REQUIRE(waitUntil([&] { return nodeInbox.size() == 2; }));
+        CHECK(nodeInbox.data[0] == PubData{"sensors/t", "21.5"});
+        CHECK(nodeInbox.data[1] == PubData{"sensors/h", "42"});
+    }
+
+    SECTION("Node subscription changes")
+    {
+        REQUIRE(layer.subscribe("cmd") == ErrCode::SUCCESS);
+        CHECK(waitUntil([&] { return comp->nodeSubscribed("cmd"); }));
+
+        REQUIRE(layer.unsubscribe("sensors/#") == ErrCode::SUCCESS);
+        CHECK(layer.unsubscribe("sensors/#") == ErrCode::NOT_FOUND);
+        CHECK(waitUntil([&] { return !comp->nodeSubscribed("sensors/t"); }));
+
+        CHECK(comp->publish("sensors/t", "1") == ErrCode::SUCCESS);
+        CHECK(comp->publish("cmd", "2") == ErrCode::SUCCESS);
+        REQUIRE(waitUntil([&] { return nodeInbox.size() == 1; }));
+        CHECK(nodeInbox.data[0] == PubData{"cmd", "2"});
+    }
+
+    SECTION("Node to companion")
+    {
+        CHECK(comp->subscribe("a/#/b") == ErrCode::INVALID_ARG);
+        REQUIRE(comp->subscribe("cmd/+") == ErrCode::SUCCESS);
+        REQUIRE(waitUntil([&] {
+            CHECK(layer.publish({"cmd/sync", ""}) == ErrCode::SUCCESS);
+            return compInbox.size() > 0;
+        }));
+        std::this_thread::sleep_for(10ms);
+        compInbox.clear();
+
+        CHECK(layer.publish({"cmd/x", "on"}) == ErrCode::SUCCESS);
+        CHECK(layer.publish({"other", "off"}) == ErrCode::SUCCESS);
+        CHECK(layer.publish({"cmd/y", "off"}) == ErrCode::SUCCESS);
+        REQUIRE(waitUntil([&] { return compInbox.size() == 2; }));
+        CHECK(compInbox.data[0] == PubData{"cmd/x", "on"});
+        CHECK(compInbox.data[1] == PubData{"cmd/y", "off"});
+
+        REQUIRE(comp->unsubscribe("cmd/+") == ErrCode::SUCCESS);
+        std::this_thread::sleep_for(20ms);
+        compInbox.clear();
+        CHECK(layer.publish({"cmd/x", "on"}) == ErrCode::SUCCESS);
+        std::this_thread::sleep_for(20ms);
+        CHECK(compInbox.size() == 0);
+    }
+
+    SECTION("Burst")
+    {
+        // Much more than ring holds, so consumer must keep up with producer
+        constexpr int CNT = 2000;
+        for (int i = 0; i < CNT; i++) {
+            while (comp->publish("sensors/t", std::to_string(i)) ==
+                   ErrCode::QUEUE_FULL) {
+                std::this_thread::yield();
+            }
+        }
+
+        REQUIRE(waitUntil([&] { return nodeInbox.size() == CNT; }));
+        for (int i = 0; i < CNT; i++) {
+            CHECK(nodeInbox.data[i].payload == std::to_string(i));
+        }
+    }
+
+    SECTION("Backpressure")
+    {
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool blocked = true;
+        nodeHook = [&]() {
+            std::unique_lock lock(mutex);
+            cv.wait(lock, [&] { return !blocked; });
+        };
+
+        std::string payload(500, 'p');
+        int cnt = 0;
+        while (comp->publish("sensors/t", payload) == ErrCode::SUCCESS) {
+            cnt++;
+            REQUIRE(cnt < 100);
+        }
+        CHECK(comp->publish("sensors/t", payload) == ErrCode::QUEUE_FULL);
+
+        {
+            const std::scoped_lock lock(mutex);
+            blocked = false;
+        }
+        cv.notify_all();
+        CHECK(waitUntil([&] { return nodeInbox.size() == size_t(cnt); }));
+    }
+
+    SECTION("Slow companion")
+    {
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool blocked = true;
+        std::atomic<bool> entered = false;
+        compHook = [&]() {
+            entered = true;
+            std::unique_lock lock(mutex);
+            cv.wait(lock, [&] { return !blocked; });
+        };
+
+        // Companion stops reading its socket
+        REQUIRE(comp->subscribe("cmd") == ErrCode::SUCCESS);
+        REQUIRE(waitUntil([&] {
+            CHECK(layer.publish({"cmd", ""}) == ErrCode::SUCCESS);
+            return entered.load();
+        }));
+
+        // Node isn't blocked by full socket, companion is disconnected
+        std::string filter(1000, 'f');
+        for (int i = 0; i < 2000 && layer.companionCnt() > 0; i++) {
+            REQUIRE(layer.subscribe(filter + std::to_string(i)) ==
+                    ErrCode::SUCCESS);
+        }
+        CHECK(waitUntil([&] { return layer.companionCnt() == 0; }));
+
+        {
+            const std::scoped_lock lock(mutex);
+            blocked = false;
+        }
+        cv.notify_all();
+        CHECK(waitUntil([&] { return !comp->connected(); }));
+    }
+
+    SECTION("Disconnection")
+    {
+        SECTION("Companion leaves")
+        {
+            comp.reset();
+            CHECK(waitUntil([&] { return layer.companionCnt() == 0; }));
+            CHECK(layer.publish({"sensors/t", "1"}) == ErrCode::SUCCESS);
+        }
+
+        SECTION("Multiple companions")
+        {
+            Inbox inbox2;
+            IpcCompanion comp2(SOCK_PATH,
+                               [&inbox2](std::string_view topic,
+                                         std::string_view payload) {
+                                   inbox2.add(topic, payload);
+                               });
+            CHECK(waitUntil([&] { return layer.companionCnt() == 2; }));
+
+            CHECK(comp->publish("sensors/a", "1") == ErrCode::SUCCESS);
+            CHECK(comp2.publish("sensors/b", "2") == ErrCode::SUCCESS);
+            CHECK(waitUntil([&] { return nodeInbox.size() == 2; }));
+
+            comp.reset();
+            CHECK(waitUntil([&] { return layer.companionCnt() == 1; }));
+            CHECK(comp2.publish("sensors/c", "3") == ErrCode::SUCCESS);
+            CHECK(waitUntil([&] { return nodeInbox.size() == 3; }));
+        }
+    }
+}
+
+TEST_CASE("IPC remote layer node shutdown", "[IpcRemoteLayer]")
+{
+    auto layer = std::make_unique<IpcRemoteLayer>(SOCK_PATH);
+    REQUIRE(layer->subscribe("t") == ErrCode::SUCCESS);
+    IpcCompanion comp(SOCK_PATH, nullptr);
+
+    layer.reset();
+    CHECK(waitUntil([&] { return !comp.connected(); }));
+    CHECK(comp.publish("t", "x") == ErrCode::NO_GATEWAY);
+    CHECK(comp.subscribe("t") == ErrCode::NO_GATEWAY);
+}
+
+TEST_CASE("IPC remote layer round trip", "[IpcRemoteLayer][.benchmark]")
+{
+    IpcRemoteLayer layer(SOCK_PATH);
+    layer.setRecvCb([&layer](const SubData &data) {
+        return layer.publish({"pong", data.payload});
+    });
+    REQUIRE(layer.subscribe("ping") == ErrCode::SUCCESS);
+
+    std::atomic<uint64_t> pongs = 0;
+    IpcCompanion comp(SOCK_PATH, [&pongs](std::string_view, std::string_view) {
+        pongs.fetch_add(1, std::memory_order_release);
+    });
+    REQUIRE(comp.subscribe("pong") == ErrCode::SUCCESS);
+    REQUIRE(waitUntil([&] {
+        comp.publish("ping", "");
+        return pongs > 0;
+    }));
+    std::this_thread::sleep_for(10ms);
+
+    std::string payload(64, 'p');
+    BENCHMARK("Ping-pong (64 B)")
+    {
+        uint64_t expected = pongs.load(std::memory_order_acquire) + 1;
+        comp.publish("ping", payload);
+        while (pongs.load(std::memory_order_acquire) < expected) {
+        }
+        return expected;
+    };
+}
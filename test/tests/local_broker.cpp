@@ -172,3 +172,81 @@ TEST_CASE("Receive callback returns error", "[LocalBroker]")
         REQUIRE(lb.publish(DATA_PUBLISH) == ErrCode::GENERIC_FAILURE);
     }
 }
+
+TEST_CASE("Shared subscriptions of in-process consumers", "[LocalBroker]")
+{
+    std::vector<int> recvCnts(3, 0);
+    int nodeCnt = 0;
+
+    LocalBroker lb;
+    lb.setRecvCb([&nodeCnt](const SubData &data) -> ErrCode {
+        nodeCnt++;
+        return ErrCode::SUCCESS;
+    });
+
+    std::vector<LocalBroker::ConsumerId> consumers;
+    for (size_t i = 0; i < recvCnts.size(); i++) {
+        consumers.push_back(lb.addConsumer([&recvCnts, i](const SubData &) {
+            recvCnts[i]++;
+            return ErrCode::SUCCESS;
+        }));
+    }
+
+    SECTION("Work is divided among group members")
+    {
+        for (auto consumer : consumers) {
+            REQUIRE(lb.subscribe(consumer, "$share/workers/" +
+                                               TOPIC_MULTI_WILDCARD) ==
+                    ErrCode::SUCCESS);
+        }
+        REQUIRE(lb.subscribe(TOPIC_MULTI_WILDCARD) == ErrCode::SUCCESS);
+
+        for (int i = 0; i < 30; i++) {
+            REQUIRE(lb.publish(DATA_PUBLISH_FOR_WILDCARD) == ErrCode::SUCCESS);
+        }
+
+        // Ordinary subscriber gets everything
+        CHECK(nodeCnt == 30);
+        CHECK(recvCnts == std::vector<int>{10, 10, 10});
+    }
+
+    SECTION("Removed consumer")
+    {
+        for (auto consumer : consumers) {
+            REQUIRE(lb.subscribe(consumer, "$share/workers/" + TOPIC) ==
+                    ErrCode::SUCCESS);
+        }
+        REQUIRE(lb.removeConsumer(consumers[1]) == ErrCode::SUCCESS);
+        REQUIRE(lb.removeConsumer(consumers[1]) == ErrCode::NOT_FOUND);
+        CHECK(lb.subscribe(consumers[1], TOPIC) == ErrCode::NOT_FOUND);
+
+        for (int i = 0; i < 4; i++) {
+            REQUIRE(lb.publish(DATA_PUBLISH) == ErrCode::SUCCESS);
+        }
+        CHECK(recvCnts == std::vector<int>{2, 0, 2});
+        CHECK(nodeCnt == 0);
+    }
+
+    SECTION("Node in group")
+    {
+        REQUIRE(lb.subscribe("$share/g/" + TOPIC) == ErrCode::SUCCESS);
+        REQUIRE(lb.subscribe(consumers[0], "$share/g/" + TOPIC) ==
+                ErrCode::SUCCESS);
+        for (int i = 0; i < 4; i++) {
+            REQUIRE(lb.publish(DATA_PUBLISH) == ErrCode::SUCCESS);
+        }
+        CHECK(nodeCnt == 2);
+        CHECK(recvCnts[0] == 2);
+
+        REQUIRE(lb.unsubscribe("$share/g/" + TOPIC) == ErrCode::SUCCESS);
+        REQUIRE(lb.unsubscribe("$share/g/" + TOPIC) == ErrCode::NOT_FOUND);
+    }
+
+    SECTION("Invalid shared filter")
+    {
+        CHECK(lb.subscribe("$share/" + TOPIC) == ErrCode::SUCCESS);
+        CHECK(lb.subscribe("$share/g") == ErrCode::INVALID_ARG);
+        CHECK(lb.subscribe("$share//" + TOPIC) == ErrCode::INVALID_ARG);
+        CHECK(lb.subscribe("$share/+/" + TOPIC) == ErrCode::INVALID_ARG);
+    }
+}
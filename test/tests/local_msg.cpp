@@ -62,6 +62,12 @@ TEST_CASE("Comparison", "[LocalMsg]")
         REQUIRE(msg1 != msg2);
     }
 
+    SECTION("Different subscriptions digests")
+    {
+        msg2.subsDigest = calcSubsDigest({"1"});
+        REQUIRE(msg1 != msg2);
+    }
+
     SECTION("Different IDs")
     {
         // Just additional data, no difference in comparison
@@ -111,3 +117,27 @@ TEST_CASE("String representation", "[LocalMsgFailReason]")
     // Invalid value
     CHECK(strEq(static_cast<LocalMsgFailReason>(-1), "???"));
 }
+
+TEST_CASE("Subscriptions digest", "[SubsDigest]")
+{
+    auto digest = calcSubsDigest({"a/b", "c", "d/#"});
+
+    CHECK(digest.cnt == 3);
+    CHECK_FALSE(digest.empty());
+    CHECK(calcSubsDigest({}).empty());
+
+    // Independent of order
+    CHECK(digest == calcSubsDigest({"d/#", "a/b", "c"}));
+
+    // Sensitive to content
+    CHECK(digest != calcSubsDigest({"a/b", "c", "d/+"}));
+    CHECK(digest.toString().size() == 8 + 2);
+
+    // Count doesn't wrap around
+    std::vector<std::string> many;
+    for (size_t i = 0; i < 65536; i++) {
+        many.push_back(std::to_string(i));
+    }
+    CHECK(calcSubsDigest(many).cnt == 65536);
+    CHECK_FALSE(calcSubsDigest(many).empty());
+}
@@ -0,0 +1,413 @@
+/**
+ * @file multi_link_layer.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @copyright Copyright (c) 2024
+ */
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "kvik/client.hpp"
+#include "kvik/errors.hpp"
+#include "kvik/multi_link_layer.hpp"
+#include "kvik_testing/dummy_local_layer.hpp"
+
+using namespace kvik;
+using namespace std::chrono_literals;
+
+static const LocalAddr GW_FAST{{0x0a}};
+static const LocalAddr GW_SLOW{{0x0b, 0x01}};
+static const LocalAddr GW_OTHER{{0x0c}};
+static const LocalAddr PEER{{0x42}};
+
+static constexpr uint16_t DSCV_ID = 100;
+
+static LocalMsg probeRes(const LocalAddr &addr, uint16_t reqId, int16_t pref)
+{
+    return {
+        .type = LocalMsgType::PROBE_RES,
+        .addr = addr,
+        .reqId = reqId,
+        .nodeType = NodeType::GATEWAY,
+        .pref = pref,
+    };
+}
+
+static LocalMsg okRes(const LocalAddr &addr, uint16_t reqId)
+{
+    return {
+        .type = LocalMsgType::OK,
+        .addr = addr,
+        .reqId = reqId,
+        .nodeType = NodeType::GATEWAY,
+    };
+}
+
+static LocalMsg request(const LocalAddr &addr, uint16_t id)
+{
+    return {
+        .type = LocalMsgType::PUB_SUB_UNSUB,
+        .addr = addr,
+        .pubs = {{.topic = "a", .payload = "b"}},
+        .id = id,
+        .nodeType = NodeType::CLIENT,
+    };
+}
+
+/**
+ * @brief Two links (fast one first) with discovered endpoints
+ */
+struct TwoLinks
+{
+    DummyLocalLayer fast, slow;
+    MultiLinkLayer mll;
+    std::mutex mutex;
+    std::vector<LocalMsg> received;
+
+    TwoLinks(MultiLinkLayerConfig conf = {}, double fastPower = 0,
+             double slowPower = 0)
+        : mll{{{.ll = &fast, .txPower = fastPower},
+               {.ll = &slow, .txPower = slowPower}},
+              conf}
+    {
+        mll.setRecvCb([this](LocalMsg msg) {
+            const std::scoped_lock lock(mutex);
+            received.push_back(msg);
+            return ErrCode::SUCCESS;
+        });
+    }
+
+    void discover()
+    {
+        LocalMsg probe = {
+            .type = LocalMsgType::PROBE_REQ,
+            .id = DSCV_ID,
+            .nodeType = NodeType::CLIENT,
+        };
+        REQUIRE(mll.send(probe) == ErrCode::SUCCESS);
+        REQUIRE(fast.recv(probeRes(GW_FAST, DSCV_ID, 10)) ==
+                ErrCode::SUCCESS);
+        REQUIRE(slow.recv(probeRes(GW_SLOW, DSCV_ID, 5)) ==
+                ErrCode::SUCCESS);
+    }
+
+    LocalAddr lastAddr(DummyLocalLayer &ll)
+    {
+        REQUIRE_FALSE(ll.sentLog.empty());
+        return ll.sentLog.back().addr;
+    }
+};
+
+TEST_CASE("Invalid parameters", "[MultiLinkLayer]")
+{
+    DummyLocalLayer ll;
+    REQUIRE_THROWS(MultiLinkLayer({}));
+    REQUIRE_THROWS(MultiLinkLayer({{.ll = &ll}, {.ll = nullptr}}));
+    REQUIRE_THROWS(MultiLinkLayer({{.ll = &ll}}, {.failThres = 0}));
+}
+
+TEST_CASE("Gateway endpoints", "[MultiLinkLayer]")
+{
+    TwoLinks t;
+    CHECK(t.mll.linkCnt() == 2);
+    CHECK(t.mll.getChannels().empty());
+    CHECK(t.mll.setChannel(1) == ErrCode::NOT_SUPPORTED);
+
+    SECTION("Unknown destination goes over first accepting link")
+    {
+        t.fast.sendRet = ErrCode::INVALID_ARG;
+        CHECK(t.mll.send(request(PEER, 1)) == ErrCode::SUCCESS);
+        CHECK(t.fast.sentLog.size() == 1);
+        CHECK(t.lastAddr(t.slow) == PEER);
+    }
+
+    SECTION("Discovery finds endpoint on each link")
+    {
+        t.discover();
+        CHECK(t.fast.sentLog.size() == 1);
+        CHECK(t.slow.sentLog.size() == 1);
+
+        MultiLinkLayer::LinkState state;
+        REQUIRE(t.mll.getLinkState(0, state) == ErrCode::SUCCESS);
+        CHECK(state.gw == GW_FAST);
+        CHECK(state.up);
+        REQUIRE(t.mll.getLinkState(1, state) == ErrCode::SUCCESS);
+        CHECK(state.gw == GW_SLOW);
+        CHECK(t.mll.getLinkState(2, state) == ErrCode::INVALID_ARG);
+
+        // Discovery responses are passed unchanged
+        REQUIRE(t.received.size() == 2);
+        CHECK(t.received[0].addr == GW_FAST);
+        CHECK(t.received[1].addr == GW_SLOW);
+
+        // Gateway with higher preference wins, stale endpoint is replaced
+        // in next discovery
+        REQUIRE(t.slow.recv(probeRes(GW_OTHER, DSCV_ID, 20)) ==
+                ErrCode::SUCCESS);
+        REQUIRE(t.fast.recv(probeRes(GW_OTHER, DSCV_ID, 1)) ==
+                ErrCode::SUCCESS);
+        REQUIRE(t.mll.getLinkState(1, state) == ErrCode::SUCCESS);
+        CHECK(state.gw == GW_OTHER);
+        REQUIRE(t.mll.getLinkState(0, state) == ErrCode::SUCCESS);
+        CHECK(state.gw == GW_FAST);
+
+        t.discover();
+        REQUIRE(t.mll.getLinkState(1, state) == ErrCode::SUCCESS);
+        CHECK(state.gw == GW_SLOW);
+    }
+
+    SECTION("Messages from endpoints appear to come from gateway")
+    {
+        t.discover();
+        REQUIRE(t.mll.send(request(GW_FAST, 1)) == ErrCode::SUCCESS);
+        CHECK(t.lastAddr(t.fast) == GW_FAST);
+
+        LocalMsg data = {
+            .type = LocalMsgType::SUB_DATA,
+            .addr = GW_SLOW,
+            .subsData = {{.topic = "a", .payload = "b"}},
+            .nodeType = NodeType::GATEWAY,
+        };
+        REQUIRE(t.slow.recv(data) == ErrCode::SUCCESS);
+        REQUIRE(t.slow.recv(okRes(GW_OTHER, 0)) == ErrCode::SUCCESS);
+        REQUIRE(t.received.size() == 4);
+        CHECK(t.received[2].addr == GW_FAST);
+        CHECK(t.received[3].addr == GW_OTHER);
+
+        // Acknowledgement goes back over link data came from
+        LocalMsg ack = {
+            .type = LocalMsgType::OK,
+            .addr = GW_FAST,
+            .id = 2,
+            .nodeType = NodeType::CLIENT,
+        };
+        REQUIRE(t.mll.send(ack) == ErrCode::SUCCESS);
+        CHECK(t.fast.sentLog.size() == 2);
+        CHECK(t.lastAddr(t.slow) == GW_SLOW);
+    }
+}
+
+TEST_CASE("Link selection", "[MultiLinkLayer]")
+{
+    size_t idx;
+
+    SECTION("Fallback order")
+    {
+        TwoLinks t;
+        CHECK(t.mll.selectLink(request(GW_FAST, 1), idx) ==
+              ErrCode::NOT_FOUND);
+        t.discover();
+        REQUIRE(t.mll.selectLink(request(GW_FAST, 1), idx) ==
+                ErrCode::SUCCESS);
+        CHECK(idx == 0);
+
+        // Any endpoint address reaches gateway over preferred link
+        REQUIRE(t.mll.send(request(GW_SLOW, 1)) == ErrCode::SUCCESS);
+        CHECK(t.lastAddr(t.fast) == GW_FAST);
+        CHECK(t.slow.sentLog.size() == 1);
+    }
+
+    SECTION("Lowest latency")
+    {
+        TwoLinks t{{.policy = LinkPolicy::LOWEST_LATENCY}};
+        t.discover();
+
+        // Measured on discovery, both are roughly equal
+        MultiLinkLayer::LinkState state;
+        REQUIRE(t.mll.getLinkState(1, state) == ErrCode::SUCCESS);
+        CHECK(state.rtt < 10ms);
+
+        // Fast link turns out to be slower
+        t.fast.respDelay = 40ms;
+        t.fast.responses.push(okRes(GW_FAST, 0));
+        REQUIRE(t.mll.send(request(GW_FAST, 1)) == ErrCode::SUCCESS);
+        std::this_thread::sleep_for(50ms);
+
+        REQUIRE(t.mll.getLinkState(0, state) == ErrCode::SUCCESS);
+        CHECK(state.rtt >= 5ms);
+
+        REQUIRE(t.mll.selectLink(request(GW_FAST, 11), idx) ==
+                ErrCode::SUCCESS);
+        CHECK(idx == 1);
+    }
+
+    SECTION("Lowest energy")
+    {
+        TwoLinks t{{.policy = LinkPolicy::LOWEST_ENERGY}, 100, 10};
+        t.fast.airtime = 2000us; // 200 uJ
+        t.slow.airtime = 50000us; // 500 uJ
+        t.discover();
+
+        REQUIRE(t.mll.selectLink(request(GW_FAST, 1), idx) ==
+                ErrCode::SUCCESS);
+        CHECK(idx == 0);
+
+        t.slow.airtime = 10000us; // 100 uJ
+        REQUIRE(t.mll.selectLink(request(GW_FAST, 1), idx) ==
+                ErrCode::SUCCESS);
+        CHECK(idx == 1);
+
+        // Estimate follows link message was sent over
+        REQUIRE(t.mll.send(request(GW_FAST, 7)) == ErrCode::SUCCESS);
+        t.mll.setPolicy(LinkPolicy::FALLBACK);
+        CHECK(t.mll.estimateAirtime(request(GW_FAST, 7)) == 10000us);
+        CHECK(t.mll.estimateAirtime(request(GW_FAST, 8)) == 2000us);
+        CHECK(t.mll.estimateAirtime(request({}, 9)) == 12000us);
+    }
+}
+
+TEST_CASE("Failover", "[MultiLinkLayer]")
+{
+    TwoLinks t{{
+        .respTimeout = 10ms,
+        .failThres = 2,
+        .retryInterval = 50ms,
+    }};
+    t.discover();
+    MultiLinkLayer::LinkState state;
+
+    SECTION("Send failure")
+    {
+        t.fast.sendRet = ErrCode::GENERIC_FAILURE;
+        CHECK(t.mll.send(request(GW_FAST, 1)) == ErrCode::SUCCESS);
+        CHECK(t.lastAddr(t.fast) == GW_FAST);
+        CHECK(t.lastAddr(t.slow) == GW_SLOW);
+
+        REQUIRE(t.mll.getLinkState(0, state) == ErrCode::SUCCESS);
+        CHECK_FALSE(state.up);
+
+        // Down link isn't used until retry interval elapses
+        t.fast.sendRet = ErrCode::SUCCESS;
+        CHECK(t.mll.send(request(GW_FAST, 2)) == ErrCode::SUCCESS);
+        CHECK(t.fast.sentLog.size() == 2);
+        CHECK(t.slow.sentLog.size() == 3);
+
+        // All links fail
+        t.slow.sendRet = ErrCode::QUEUE_FULL;
+        CHECK(t.mll.send(request(GW_FAST, 3)) == ErrCode::QUEUE_FULL);
+        CHECK(t.mll.send(request(GW_FAST, 4)) == ErrCode::NOT_FOUND);
+    }
+
+    SECTION("Unanswered requests")
+    {
+        CHECK(t.mll.send(request(GW_FAST, 1)) == ErrCode::SUCCESS);
+        std::this_thread::sleep_for(15ms);
+        CHECK(t.mll.send(request(GW_FAST, 2)) == ErrCode::SUCCESS);
+        REQUIRE(t.mll.getLinkState(0, state) == ErrCode::SUCCESS);
+        CHECK(state.up);
+        CHECK(state.failCnt == 1);
+        CHECK(t.fast.sentLog.size() == 3);
+
+        std::this_thread::sleep_for(15ms);
+        CHECK(t.mll.send(request(GW_FAST, 3)) == ErrCode::SUCCESS);
+        REQUIRE(t.mll.getLinkState(0, state) == ErrCode::SUCCESS);
+        CHECK_FALSE(state.up);
+        CHECK(t.fast.sentLog.size() == 3);
+        CHECK(t.lastAddr(t.slow) == GW_SLOW);
+
+        // Preferred link is used again once it responds
+        std::this_thread::sleep_for(50ms);
+        t.fast.responses.push(okRes(GW_FAST, 0));
+        CHECK(t.mll.send(request(GW_FAST, 4)) == ErrCode::SUCCESS);
+        CHECK(t.fast.sentLog.size() == 4);
+        std::this_thread::sleep_for(5ms);
+        REQUIRE(t.mll.getLinkState(0, state) == ErrCode::SUCCESS);
+        CHECK(state.up);
+        CHECK(state.failCnt == 0);
+        CHECK(t.mll.send(request(GW_FAST, 5)) == ErrCode::SUCCESS);
+        CHECK(t.fast.sentLog.size() == 5);
+    }
+
+    SECTION("Trial of down link is limited")
+    {
+        t.fast.sendRet = ErrCode::GENERIC_FAILURE;
+        CHECK(t.mll.send(request(GW_FAST, 1)) == ErrCode::SUCCESS);
+        t.fast.sendRet = ErrCode::SUCCESS;
+        std::this_thread::sleep_for(55ms);
+
+        // Trial message goes over down link, the rest over working one
+        CHECK(t.mll.send(request(GW_FAST, 2)) == ErrCode::SUCCESS);
+        CHECK(t.mll.send(request(GW_FAST, 3)) == ErrCode::SUCCESS);
+        CHECK(t.fast.sentLog.size() == 3);
+        CHECK(t.slow.sentLog.size() == 3);
+    }
+}
+
+TEST_CASE("Client over multiple links", "[MultiLinkLayer]")
+{
+    static const ClientConfig conf = {
+        .nodeConf = {
+            .localDelivery = {
+                .respTimeout = 20ms,
+            },
+            .msgIdCache = {
+                .timeUnit = 10ms,
+                .maxAge = 2,
+            },
+        },
+        .gwDscv = {
+            .dscvMinDelay = 5ms,
+            .dscvMaxDelay = 1s,
+            .initialDscvFailThres = 3,
+            .trigMsgsFailCnt = 1,
+            .trigTimeSyncNoRespCnt = 1,
+        },
+        .reporting = {
+            .rssiOnTimeSync = false,
+            .rssiOnGwDscv = false,
+        },
+        .subDB = {
+            .subLifetime = 10s,
+        },
+        .timeSync = {
+            .syncSystemTime = false,
+            .reprobeGatewayInterval = 10s,
+        },
+    };
+
+    DummyLocalLayer fast, slow;
+    for (auto ll : {&fast, &slow}) {
+        ll->respTsDiff = 0ms;
+        ll->respTimeUnit = 10ms;
+    }
+    fast.responses.push(probeRes(GW_FAST, 0, 10));
+    slow.responses.push(probeRes(GW_SLOW, 0, 5));
+
+    MultiLinkLayer mll({{.ll = &fast}, {.ll = &slow}},
+                       {.retryInterval = 30ms});
+    Client cl(conf, &mll);
+    REQUIRE(fast.sentLog.size() == 1);
+    REQUIRE(slow.sentLog.size() == 1);
+
+    // Fast link is used while available
+    fast.responses.push(okRes(GW_FAST, 0));
+    CHECK(cl.publish("a", "b") == ErrCode::SUCCESS);
+    CHECK(fast.sentLog.back().addr == GW_FAST);
+
+    // Gateway is reached over slow link without rediscovery
+    fast.sendRet = ErrCode::GENERIC_FAILURE;
+    slow.responses.push(okRes(GW_SLOW, 0));
+    CHECK(cl.publish("a", "c") == ErrCode::SUCCESS);
+    CHECK(slow.sentLog.size() == 2);
+    CHECK(slow.sentLog.back().addr == GW_SLOW);
+    CHECK(slow.sentLog.back().pubs[0].payload == "c");
+
+    // Back on fast link once it's available
+    std::this_thread::sleep_for(35ms);
+    fast.sendRet = ErrCode::SUCCESS;
+    fast.responses.push(okRes(GW_FAST, 0));
+    CHECK(cl.publish("a", "d") == ErrCode::SUCCESS);
+    CHECK(fast.sentLog.back().pubs[0].payload == "d");
+
+    // No broadcast besides initial discovery
+    std::this_thread::sleep_for(10ms);
+    for (auto ll : {&fast, &slow}) {
+        for (size_t i = 1; i < ll->sentLog.size(); i++) {
+            CHECK_FALSE(ll->sentLog[i].addr.empty());
+        }
+    }
+}
@@ -0,0 +1,182 @@
+/**
+ * @file multi_local_layer.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @copyright Copyright (c) 2024
+ */
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "kvik/errors.hpp"
+#include "kvik/multi_local_layer.hpp"
+#include "kvik_testing/dummy_local_layer.hpp"
+
+using namespace kvik;
+using namespace std::chrono_literals;
+
+using SentLog = DummyLocalLayer::SentLog;
+
+static const LocalAddr ADDR1{{0x01}};
+static const LocalAddr ADDR2{{0x02}};
+
+static LocalMsg MSG_PROBE_REQ_FROM1 = {
+    .type = LocalMsgType::PROBE_REQ,
+    .addr = ADDR1,
+    .nodeType = NodeType::CLIENT,
+};
+static LocalMsg MSG_PROBE_REQ_FROM2 = {
+    .type = LocalMsgType::PROBE_REQ,
+    .addr = ADDR2,
+    .nodeType = NodeType::CLIENT,
+};
+static LocalMsg MSG_PROBE_RES_TO1 = {
+    .type = LocalMsgType::PROBE_RES,
+    .addr = ADDR1,
+    .nodeType = NodeType::GATEWAY,
+};
+static LocalMsg MSG_PROBE_RES_TO2 = {
+    .type = LocalMsgType::PROBE_RES,
+    .addr = ADDR2,
+    .nodeType = NodeType::GATEWAY,
+};
+static LocalMsg MSG_BROADCAST = {
+    .type = LocalMsgType::SUB_DATA,
+    .subsData = {{.topic = "a", .payload = "b"}},
+    .nodeType = NodeType::GATEWAY,
+};
+
+TEST_CASE("Invalid parameters", "[MultiLocalLayer]")
+{
+    DummyLocalLayer ll;
+    REQUIRE_THROWS(MultiLocalLayer({}));
+    REQUIRE_THROWS(MultiLocalLayer({&ll, nullptr}));
+    REQUIRE_THROWS(MultiLocalLayer({&ll}, 0));
+    REQUIRE_THROWS(MultiLocalLayer({&ll}, 1, 0));
+}
+
+TEST_CASE("Routing", "[MultiLocalLayer]")
+{
+    DummyLocalLayer ll1, ll2;
+    MultiLocalLayer mll({&ll1, &ll2});
+    std::atomic<int> recvCnt = 0;
+    mll.setRecvCb([&recvCnt](LocalMsg) {
+        recvCnt++;
+        return ErrCode::SUCCESS;
+    });
+
+    CHECK(mll.layerCnt() == 2);
+    CHECK(mll.getChannels().empty());
+    CHECK(mll.setChannel(1) == ErrCode::NOT_SUPPORTED);
+
+    SECTION("Unknown destination")
+    {
+        CHECK(mll.send(MSG_PROBE_RES_TO1) == ErrCode::NOT_FOUND);
+    }
+
+    SECTION("Reply goes to layer where client was seen")
+    {
+        REQUIRE(ll1.recv(MSG_PROBE_REQ_FROM1) == ErrCode::SUCCESS);
+        REQUIRE(ll2.recv(MSG_PROBE_REQ_FROM2) == ErrCode::SUCCESS);
+        mll.flush();
+        CHECK(recvCnt == 2);
+
+        size_t idx;
+        REQUIRE(mll.getRoute(ADDR2, idx) == ErrCode::SUCCESS);
+        CHECK(idx == 1);
+
+        REQUIRE(mll.send(MSG_PROBE_RES_TO1) == ErrCode::SUCCESS);
+        REQUIRE(mll.send(MSG_PROBE_RES_TO2) == ErrCode::SUCCESS);
+        mll.flush();
+        CHECK(ll1.sentLog == SentLog{MSG_PROBE_RES_TO1});
+        CHECK(ll2.sentLog == SentLog{MSG_PROBE_RES_TO2});
+    }
+
+    SECTION("Client moved to other layer")
+    {
+        REQUIRE(ll1.recv(MSG_PROBE_REQ_FROM1) == ErrCode::SUCCESS);
+        REQUIRE(ll2.recv(MSG_PROBE_REQ_FROM1) == ErrCode::SUCCESS);
+        mll.flush();
+
+        REQUIRE(mll.send(MSG_PROBE_RES_TO1) == ErrCode::SUCCESS);
+        mll.flush();
+        CHECK(ll1.sentLog.empty());
+        CHECK(ll2.sentLog == SentLog{MSG_PROBE_RES_TO1});
+    }
+
+    SECTION("Broadcast")
+    {
+        REQUIRE(mll.send(MSG_BROADCAST) == ErrCode::SUCCESS);
+        mll.flush();
+        CHECK(ll1.sentLog == SentLog{MSG_BROADCAST});
+        CHECK(ll2.sentLog == SentLog{MSG_BROADCAST});
+    }
+}
+
+TEST_CASE("Routing table is bounded", "[MultiLocalLayer]")
+{
+    static const LocalAddr ADDR3{{0x03}};
+
+    DummyLocalLayer ll1, ll2;
+    MultiLocalLayer mll({&ll1, &ll2}, 64, 2);
+    mll.setRecvCb([](LocalMsg) { return ErrCode::SUCCESS; });
+
+    auto probeReq = MSG_PROBE_REQ_FROM1;
+    REQUIRE(ll1.recv(probeReq) == ErrCode::SUCCESS);
+    probeReq.addr = ADDR2;
+    REQUIRE(ll2.recv(probeReq) == ErrCode::SUCCESS);
+
+    // Refreshes ADDR1, so ADDR2 is least recently seen
+    probeReq.addr = ADDR1;
+    REQUIRE(ll2.recv(probeReq) == ErrCode::SUCCESS);
+    probeReq.addr = ADDR3;
+    REQUIRE(ll1.recv(probeReq) == ErrCode::SUCCESS);
+    mll.flush();
+
+    size_t idx;
+    REQUIRE(mll.getRoute(ADDR1, idx) == ErrCode::SUCCESS);
+    CHECK(idx == 1);
+    REQUIRE(mll.getRoute(ADDR3, idx) == ErrCode::SUCCESS);
+    CHECK(idx == 0);
+    CHECK(mll.getRoute(ADDR2, idx) == ErrCode::NOT_FOUND);
+    CHECK(mll.send(MSG_PROBE_RES_TO2) == ErrCode::NOT_FOUND);
+}
+
+TEST_CASE("Slow layer doesn't block others", "[MultiLocalLayer]")
+{
+    DummyLocalLayer ll1, ll2;
+    ll1.sendDelay = 200ms;
+    MultiLocalLayer mll({&ll1, &ll2});
+
+    REQUIRE(ll1.recv(MSG_PROBE_REQ_FROM1) == ErrCode::SUCCESS);
+    REQUIRE(ll2.recv(MSG_PROBE_REQ_FROM2) == ErrCode::SUCCESS);
+    mll.flush();
+
+    REQUIRE(mll.send(MSG_PROBE_RES_TO1) == ErrCode::SUCCESS);
+    REQUIRE(mll.send(MSG_PROBE_RES_TO2) == ErrCode::SUCCESS);
+
+    std::this_thread::sleep_for(100ms);
+    CHECK(ll1.sentLog.empty());
+    CHECK(ll2.sentLog == SentLog{MSG_PROBE_RES_TO2});
+
+    mll.flush();
+    CHECK(ll1.sentLog == SentLog{MSG_PROBE_RES_TO1});
+}
+
+TEST_CASE("Queue full", "[MultiLocalLayer]")
+{
+    DummyLocalLayer ll;
+    ll.sendDelay = 100ms;
+    MultiLocalLayer mll({&ll}, 1);
+
+    // First message is taken by send thread, second waits in queue
+    REQUIRE(mll.send(MSG_BROADCAST) == ErrCode::SUCCESS);
+    std::this_thread::sleep_for(20ms);
+    REQUIRE(mll.send(MSG_BROADCAST) == ErrCode::SUCCESS);
+    CHECK(mll.send(MSG_BROADCAST) == ErrCode::QUEUE_FULL);
+
+    mll.flush();
+    CHECK(ll.sentLog.size() == 2);
+}
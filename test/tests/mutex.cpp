@@ -0,0 +1,211 @@
+/**
+ * @file mutex.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @copyright Copyright (c) 2024
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "kvik/mutex.hpp"
+
+using namespace kvik;
+using namespace std::chrono_literals;
+
+static MutexStats statsOf(const std::string &name)
+{
+    auto snap = mutexStatsSnapshot();
+    auto it = std::find_if(snap.begin(), snap.end(),
+                           [&name](auto &s) { return s.name == name; });
+    return it != snap.end() ? *it : MutexStats{.name = name};
+}
+
+static uint64_t histSum(const MutexStats::Histogram &hist)
+{
+    uint64_t sum = 0;
+    for (auto cnt : hist) {
+        sum += cnt;
+    }
+    return sum;
+}
+
+TEST_CASE("Instrumented mutex", "[Mutex]")
+{
+    SECTION("Histogram buckets")
+    {
+        CHECK(MutexStats::bucket(0us) == 0);
+        CHECK(MutexStats::bucket(1us) == 1);
+        CHECK(MutexStats::bucket(3us) == 2);
+        CHECK(MutexStats::bucket(4us) == 3);
+        CHECK(MutexStats::bucket(1000us) == 10);
+        CHECK(MutexStats::bucket(1h) == MUTEX_HIST_BUCKETS - 1);
+    }
+
+    SECTION("Uncontended acquisitions")
+    {
+        InstrumentedMutex mutex{"test/uncontended"};
+        for (int i = 0; i < 100; i++) {
+            const std::scoped_lock lock(mutex);
+        }
+        CHECK(mutex.try_lock());
+        mutex.unlock();
+
+        auto stats = mutex.stats();
+        CHECK(stats.name == "test/uncontended");
+        CHECK(stats.acquisitions == 101);
+        CHECK(stats.contended == 0);
+        CHECK(stats.totalWait == 0us);
+        CHECK(stats.waitHist[0] == 101);
+        CHECK(histSum(stats.holdHist) == 101);
+
+        mutex.resetStats();
+        CHECK(mutex.stats().acquisitions == 0);
+        CHECK(mutex.stats().name == "test/uncontended");
+    }
+
+    SECTION("Contention and hold times")
+    {
+        InstrumentedMutex mutex{"test/contended"};
+        std::thread holder;
+        {
+            markLockSite("holder");
+            std::unique_lock lock(mutex);
+            holder = std::thread{[&mutex]() {
+                markLockSite("waiter");
+                const std::scoped_lock lock(mutex);
+            }};
+            std::this_thread::sleep_for(20ms);
+        }
+        holder.join();
+
+        auto stats = mutex.stats();
+        CHECK(stats.acquisitions == 2);
+        CHECK(stats.contended == 1);
+        CHECK(stats.totalWait >= 10ms);
+        CHECK(stats.totalHold >= 20ms);
+        CHECK(histSum(stats.waitHist) == 2);
+
+        // Longest hold is attributed to its call site
+        REQUIRE(stats.longestHolds.size() == 2);
+        auto longest = std::max_element(
+            stats.longestHolds.begin(), stats.longestHolds.end(),
+            [](auto &a, auto &b) { return a.time < b.time; });
+        CHECK(std::string(longest->site) == "holder");
+        CHECK(longest->time >= 20ms);
+        CHECK(stats.toString().find("at holder") != std::string::npos);
+    }
+
+    SECTION("Site is consumed by acquisition")
+    {
+        InstrumentedMutex mutex{"test/site"};
+        markLockSite("marked");
+        {
+            const std::scoped_lock lock(mutex);
+        }
+        {
+            const std::scoped_lock lock(mutex);
+            std::this_thread::sleep_for(5ms);
+        }
+
+        auto stats = mutex.stats();
+        REQUIRE(stats.longestHolds.size() == 2);
+        auto longest = std::max_element(
+            stats.longestHolds.begin(), stats.longestHolds.end(),
+            [](auto &a, auto &b) { return a.time < b.time; });
+        CHECK(longest->site == nullptr);
+    }
+
+    SECTION("Longest holds are bounded")
+    {
+        static const char *sites[] = {"s0", "s1", "s2", "s3", "s4",
+                                      "s5", "s6", "s7", "s8", "s9"};
+        MutexStats stats;
+        for (size_t i = 0; i < 10; i++) {
+            stats.recordHold(sites[i], std::chrono::microseconds(i + 1));
+        }
+        stats.recordHold("s9", 5us);
+        stats.recordHold("s0", 1us);
+
+        REQUIRE(stats.longestHolds.size() == MUTEX_TOP_HOLDS);
+        for (const auto &hold : stats.longestHolds) {
+            CHECK(hold.time >= 3us);
+            if (std::string(hold.site) == "s9") {
+                CHECK(hold.time == 10us);
+            }
+        }
+    }
+
+    SECTION("Works with condition variables")
+    {
+        InstrumentedMutex mutex{"test/cv"};
+        std::condition_variable_any cv;
+        bool ready = false;
+
+        std::thread notifier{[&]() {
+            std::this_thread::sleep_for(5ms);
+            const std::scoped_lock lock(mutex);
+            ready = true;
+            cv.notify_all();
+        }};
+        {
+            std::unique_lock lock(mutex);
+            CHECK(cv.wait_for(lock, 1s, [&ready]() { return ready; }));
+        }
+        notifier.join();
+
+        CHECK(mutex.stats().acquisitions >= 3);
+    }
+
+    SECTION("Snapshot merges mutexes by name")
+    {
+        mutexStatsReset();
+        {
+            InstrumentedMutex a{"test/merged"};
+            const std::scoped_lock lock(a);
+        }
+        InstrumentedMutex b{"test/merged"};
+        for (int i = 0; i < 2; i++) {
+            const std::scoped_lock lock(b);
+        }
+
+        for (int i = 0; i < 3; i++) {
+            InstrumentedMutex c{"test/merged"};
+            const std::scoped_lock lock(c);
+        }
+
+        auto stats = statsOf("test/merged");
+        CHECK(stats.acquisitions == 6);
+        CHECK(mutexStatsDump().find("test/merged: 6 acquisitions") !=
+              std::string::npos);
+
+        mutexStatsReset();
+        CHECK(statsOf("test/merged").acquisitions == 0);
+        CHECK(mutexStatsDump().find("test/merged") == std::string::npos);
+    }
+
+    SECTION("Library mutex")
+    {
+        Mutex mutex{"test/alias"};
+        CondVar cv;
+        bool ready = true;
+        {
+            UniqueLock lock(KVIK_SITE(mutex));
+            CHECK(cv.wait_for(lock, 1ms, [&ready]() { return ready; }));
+        }
+        {
+            const std::scoped_lock lock(KVIK_SITE(mutex));
+        }
+
+#if KVIK_MUTEX_PROFILING
+        CHECK(statsOf("test/alias").acquisitions == 2);
+#else
+        CHECK(statsOf("test/alias").acquisitions == 0);
+#endif
+    }
+}
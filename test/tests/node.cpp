@@ -13,6 +13,7 @@
 #include "kvik/node.hpp"
 #include "kvik/node_config.hpp"
 #include "kvik/pub_sub_struct.hpp"
+#include "kvik/topic.hpp"
 #include "kvik_testing/dummy_node.hpp"
 
 using namespace kvik;
@@ -53,6 +54,38 @@ TEST_CASE("Publish", "[Node]")
         REQUIRE(node.publishBulk({PUB_DATA1, PUB_DATA2}) == ErrCode::SUCCESS);
         REQUIRE(node.pubsLog == PubsLog{PUB_DATA1, PUB_DATA2});
     }
+
+    SECTION("Precompiled topic")
+    {
+        Topic topic(TOPIC1);
+        REQUIRE(node.publish(topic, PAYLOAD1) == ErrCode::SUCCESS);
+        REQUIRE(node.pubsLog == PubsLog{PUB_DATA1});
+
+        Topic otherSepTopic(TOPIC1, {.levelSeparator = "."});
+        REQUIRE(node.publish(otherSepTopic, PAYLOAD1) ==
+                ErrCode::INVALID_ARG);
+        REQUIRE(node.pubsLog.size() == 1);
+    }
+
+    SECTION("Typed")
+    {
+        REQUIRE(node.publishInt(TOPIC1, -5) == ErrCode::SUCCESS);
+        REQUIRE(node.publishFloat(TOPIC1, 1.5f, true) == ErrCode::SUCCESS);
+        REQUIRE(node.publishBool(TOPIC1, true) == ErrCode::SUCCESS);
+        REQUIRE(node.publishIntArray(TOPIC2, {1, 2}) == ErrCode::SUCCESS);
+        REQUIRE(node.publishFloatArray(TOPIC2, {1.5f}) == ErrCode::SUCCESS);
+        REQUIRE(node.publishBoolArray(TOPIC2, {true}) == ErrCode::SUCCESS);
+        REQUIRE(node.publishIntArray(TOPIC2, std::vector<int64_t>(256)) ==
+                ErrCode::INVALID_SIZE);
+        REQUIRE(node.pubsLog == PubsLog{
+                                    {TOPIC1, typedPayloadFromInt(-5)},
+                                    {TOPIC1, typedPayloadFromFloat(1.5f, true)},
+                                    {TOPIC1, typedPayloadFromBool(true)},
+                                    {TOPIC2, std::string("\x11\x02\x02\x04", 4)},
+                                    {TOPIC2, std::string("\x13\x01\x00\x00\xc0\x3f", 6)},
+                                    {TOPIC2, std::string("\x14\x01\x01", 3)},
+                                });
+    }
 }
 
 TEST_CASE("Subscribe", "[Node]")
@@ -70,6 +103,15 @@ TEST_CASE("Subscribe", "[Node]")
         REQUIRE(node.subscribeBulk({SUB_REQ1, SUB_REQ2}) == ErrCode::SUCCESS);
         REQUIRE(node.subsLog == SubsLog{SUB_REQ1, SUB_REQ2});
     }
+
+    SECTION("Precompiled filter")
+    {
+        REQUIRE(node.subscribe(Filter(SUB_REQ1.topic), SUB_REQ1.cb) ==
+                ErrCode::SUCCESS);
+        REQUIRE(node.subsLog == SubsLog{SUB_REQ1});
+        REQUIRE(node.subscribe(Filter(TOPIC1, {.levelSeparator = "."}),
+                               SUB_REQ1.cb) == ErrCode::INVALID_ARG);
+    }
 }
 
 TEST_CASE("Unsubscribe", "[Node]")
@@ -88,6 +130,12 @@ TEST_CASE("Unsubscribe", "[Node]")
         REQUIRE(node.unsubsLog == UnsubsLog{TOPIC1, TOPIC2});
     }
 
+    SECTION("Precompiled filter")
+    {
+        REQUIRE(node.unsubscribe(Filter(TOPIC1)) == ErrCode::SUCCESS);
+        REQUIRE(node.unsubsLog == UnsubsLog{TOPIC1});
+    }
+
     SECTION("All")
     {
         REQUIRE(node.unsubscribeAll() == ErrCode::SUCCESS);
@@ -232,3 +280,67 @@ TEST_CASE("Build RSSI report topic", "[Node]")
     CHECK(node.buildReportRssiTopic(peer) ==
           "REPORT..RSSI.." + peer.toString());
 }
+
+TEST_CASE("Build RSSI report payload", "[Node]")
+{
+    auto conf = DEFAULT_CONFIG;
+
+    SECTION("Text")
+    {
+        DummyNode node(conf);
+        CHECK(node.buildReportRssiPayload(-74) == "-74");
+    }
+
+    SECTION("Typed")
+    {
+        conf.reporting.typedPayloads = true;
+        DummyNode node(conf);
+
+        int64_t val;
+        auto payload = node.buildReportRssiPayload(-74);
+        CHECK(payload.size() == 3);
+        REQUIRE(typedPayloadToInt(payload, val) == ErrCode::SUCCESS);
+        CHECK(val == -74);
+    }
+}
+
+TEST_CASE("Traffic statistics", "[Node]")
+{
+    auto conf = DEFAULT_CONFIG;
+    LocalAddr peer;
+    peer.addr = {1, 2, 3};
+    TrafficStats::Snapshot snap;
+
+    SECTION("Disabled")
+    {
+        DummyNode node(conf);
+        node.recordTraffic(peer, TOPIC1, 10);
+        CHECK(node.getTrafficStats(snap) == ErrCode::NOT_SUPPORTED);
+    }
+
+    SECTION("Enabled")
+    {
+        conf.stats.enabled = true;
+        DummyNode node(conf);
+        node.recordTraffic(peer, TOPIC1, 10);
+        node.recordTraffic({}, TOPIC2, 5);
+        node.recordTraffic(peer, TOPIC1, 10);
+
+        REQUIRE(node.getTrafficStats(snap) == ErrCode::SUCCESS);
+        CHECK(snap.msgs == 3);
+        CHECK(snap.bytes == 25);
+        REQUIRE(snap.topTopics.size() == 2);
+        CHECK(snap.topTopics[0].key == TOPIC1);
+        CHECK(snap.topTopics[0].msgs == 2);
+        REQUIRE(snap.topSources.size() == 1);
+        CHECK(snap.topSources[0].key == peer.toString());
+        CHECK(snap.topSources[0].bytes == 20);
+    }
+
+    SECTION("Invalid config")
+    {
+        conf.stats.enabled = true;
+        conf.stats.rateHalfLife = 0ms;
+        REQUIRE_THROWS(DummyNode(conf));
+    }
+}
@@ -0,0 +1,169 @@
+/**
+ * @file piggyback_downlink.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @copyright Copyright (c) 2024
+ */
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "kvik/local_msg.hpp"
+#include "kvik/piggyback_downlink.hpp"
+
+using namespace kvik;
+using namespace std::chrono_literals;
+
+using Data = std::vector<SubData>;
+
+static const LocalAddr ADDR1{{0x01}};
+static const LocalAddr ADDR2{{0x02}};
+static const SubData DATA1 = {.topic = "cfg/rate", .payload = "60"};
+static const SubData DATA2 = {.topic = "cmd", .payload = "reboot"};
+static const SubData DATA3 = {.topic = "fw",
+                              .payload = std::string(105, 'x')};
+
+static LocalMsg ok(const LocalAddr &addr, uint16_t id)
+{
+    LocalMsg msg = {
+        .type = LocalMsgType::OK,
+        .addr = addr,
+    };
+    msg.id = id;
+    return msg;
+}
+
+static LocalMsg req(const LocalAddr &addr, bool ack = false,
+                    uint16_t ackId = 0)
+{
+    LocalMsg msg = {
+        .type = LocalMsgType::PUB_SUB_UNSUB,
+        .addr = addr,
+    };
+    msg.piggybackAck = ack;
+    msg.piggybackAckId = ackId;
+    return msg;
+}
+
+TEST_CASE("Piggyback downlink construction", "[PiggybackDownlink]")
+{
+    CHECK_THROWS(PiggybackDownlink({.maxLen = 0}));
+    CHECK_THROWS(PiggybackDownlink({.maxClientQueueLen = 0}));
+    CHECK_NOTHROW(PiggybackDownlink());
+}
+
+TEST_CASE("Piggyback downlink", "[PiggybackDownlink]")
+{
+    auto t0 = PiggybackDownlink::Clock::now();
+    PiggybackDownlink pd({.maxLen = 120, .maxHold = 10s,
+                          .maxClientQueueLen = 4});
+
+    REQUIRE(pd.enqueue(ADDR1, DATA1, t0) == ErrCode::SUCCESS);
+    REQUIRE(pd.enqueue(ADDR1, DATA2, t0) == ErrCode::SUCCESS);
+
+    SECTION("Limits")
+    {
+        CHECK(pd.enqueue(ADDR1, {"t", std::string(120, 'x')}) ==
+              ErrCode::INVALID_SIZE);
+        CHECK(pd.enqueue(ADDR1, DATA1) == ErrCode::SUCCESS);
+        CHECK(pd.enqueue(ADDR1, DATA1) == ErrCode::SUCCESS);
+        CHECK(pd.enqueue(ADDR1, DATA1) == ErrCode::QUEUE_FULL);
+        CHECK(pd.enqueue(ADDR2, DATA1) == ErrCode::SUCCESS);
+        CHECK(pd.heldCnt(ADDR1) == 4);
+        CHECK(pd.heldCnt(ADDR2) == 1);
+    }
+
+    SECTION("Attach and acknowledge")
+    {
+        pd.processRequest(req(ADDR1));
+        auto resp = ok(ADDR1, 7);
+        CHECK(pd.attach(resp, t0) == 2);
+        CHECK(resp.subsData == Data{DATA1, DATA2});
+
+        // Other clients and other responses are unaffected
+        auto other = ok(ADDR2, 8);
+        CHECK(pd.attach(other, t0) == 0);
+        CHECK(other.subsData.empty());
+        auto fail = ok(ADDR1, 9);
+        fail.type = LocalMsgType::FAIL;
+        CHECK(pd.attach(fail, t0) == 0);
+
+        pd.processRequest(req(ADDR1, true, 7));
+        CHECK(pd.heldCnt(ADDR1) == 0);
+        CHECK(pd.takeExpired(t0 + 1h).empty());
+    }
+
+    SECTION("Size budget")
+    {
+        REQUIRE(pd.enqueue(ADDR1, DATA3, t0) == ErrCode::SUCCESS);
+        auto resp = ok(ADDR1, 1);
+        CHECK(pd.attach(resp, t0) == 2);
+        CHECK(resp.subsData == Data{DATA1, DATA2});
+
+        pd.processRequest(req(ADDR1, true, 1));
+        resp = ok(ADDR1, 2);
+        CHECK(pd.attach(resp, t0) == 1);
+        CHECK(resp.subsData == Data{DATA3});
+    }
+
+    SECTION("Lost response")
+    {
+        auto resp = ok(ADDR1, 1);
+        CHECK(pd.attach(resp, t0) == 2);
+        REQUIRE(pd.enqueue(ADDR1, DATA3, t0) == ErrCode::SUCCESS);
+
+        // Not attached again until previous data are resolved
+        auto resp2 = ok(ADDR1, 2);
+        CHECK(pd.attach(resp2, t0) == 0);
+
+        SECTION("Stale acknowledgement")
+        {
+            pd.processRequest(req(ADDR1, true, 0));
+        }
+
+        SECTION("No acknowledgement")
+        {
+            pd.processRequest(req(ADDR1));
+        }
+
+        // Unacknowledged data go first
+        resp = ok(ADDR1, 3);
+        CHECK(pd.attach(resp, t0) == 2);
+        CHECK(resp.subsData == Data{DATA1, DATA2});
+        CHECK(pd.heldCnt(ADDR1) == 3);
+    }
+
+    SECTION("Expiry")
+    {
+        REQUIRE(pd.enqueue(ADDR2, DATA2, t0 + 5s) == ErrCode::SUCCESS);
+        CHECK(pd.takeExpired(t0 + 9s).empty());
+
+        REQUIRE(pd.enqueue(ADDR1, DATA3, t0 + 9s) == ErrCode::SUCCESS);
+        auto msgs = pd.takeExpired(t0 + 10s);
+        REQUIRE(msgs.size() == 2);
+        CHECK(msgs[0].type == LocalMsgType::SUB_DATA);
+        CHECK(msgs[0].addr == ADDR1);
+        CHECK(msgs[0].subsData == Data{DATA1, DATA2});
+        CHECK(msgs[1].subsData == Data{DATA3});
+        CHECK(pd.heldCnt(ADDR1) == 0);
+        CHECK(pd.heldCnt(ADDR2) == 1);
+    }
+
+    SECTION("Silent client")
+    {
+        auto resp = ok(ADDR1, 1);
+        CHECK(pd.attach(resp, t0 + 5s) == 2);
+        CHECK(pd.takeExpired(t0 + 14s).empty());
+
+        auto msgs = pd.takeExpired(t0 + 15s);
+        REQUIRE(msgs.size() == 1);
+        CHECK(msgs[0].subsData == Data{DATA1, DATA2});
+        CHECK(pd.heldCnt(ADDR1) == 0);
+
+        // Late acknowledgement is ignored
+        pd.processRequest(req(ADDR1, true, 1));
+        CHECK(pd.heldCnt(ADDR1) == 0);
+    }
+}
@@ -0,0 +1,222 @@
+/**
+ * @file remote_layer_pool.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @copyright Copyright (c) 2024
+ */
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "kvik/remote_layer_pool.hpp"
+#include "kvik_testing/dummy_remote_layer.hpp"
+
+using namespace kvik;
+using namespace std::chrono_literals;
+
+TEST_CASE("Remote layer pool construction", "[RemoteLayerPool]")
+{
+    DummyRemoteLayer rl;
+
+    CHECK_THROWS(RemoteLayerPool({}));
+    CHECK_THROWS(RemoteLayerPool({&rl, nullptr}));
+    CHECK_THROWS(RemoteLayerPool({&rl}, 0));
+    CHECK(RemoteLayerPool({&rl, &rl}).layerCnt() == 2);
+}
+
+TEST_CASE("Remote layer pool sharding", "[RemoteLayerPool]")
+{
+    std::vector<DummyRemoteLayer> rls(4);
+    RemoteLayerPool pool({&rls[0], &rls[1], &rls[2], &rls[3]});
+
+    SECTION("Topic affinity")
+    {
+        for (int i = 0; i < 3; i++) {
+            CHECK(pool.publish({"a/b", std::to_string(i)}) == ErrCode::SUCCESS);
+        }
+
+        // All data of single topic in order over single layer
+        size_t idx = pool.getPubRoute("a/b");
+        CHECK(rls[idx].pubsLog ==
+              DummyRemoteLayer::PubsLog{{"a/b", "0"}, {"a/b", "1"}, {"a/b", "2"}});
+    }
+
+    SECTION("Spread over all layers")
+    {
+        for (int i = 0; i < 400; i++) {
+            CHECK(pool.publish({"topic/" + std::to_string(i), ""}) ==
+                  ErrCode::SUCCESS);
+        }
+        for (const auto &rl : rls) {
+            CHECK(rl.pubsLog.size() > 50);
+        }
+    }
+
+    SECTION("Subscriptions")
+    {
+        CHECK(pool.subscribe("x/#") == ErrCode::SUCCESS);
+        size_t idx;
+        REQUIRE(pool.getSubRoute("x/#", idx) == ErrCode::SUCCESS);
+        CHECK(rls[idx].subsLog == DummyRemoteLayer::TopicsLog{"x/#"});
+
+        size_t subCnt = 0;
+        for (const auto &rl : rls) {
+            subCnt += rl.subsLog.size();
+        }
+        CHECK(subCnt == 1);
+
+        CHECK(pool.unsubscribe("x/#") == ErrCode::SUCCESS);
+        CHECK(rls[idx].unsubsLog == DummyRemoteLayer::TopicsLog{"x/#"});
+        CHECK(pool.getSubRoute("x/#", idx) == ErrCode::NOT_FOUND);
+        CHECK(pool.unsubscribe("x/#") == ErrCode::NOT_FOUND);
+    }
+
+    SECTION("Merged reception")
+    {
+        std::vector<std::string> recvLog;
+        pool.setRecvCb([&recvLog](const SubData &data) {
+            recvLog.push_back(data.topic);
+            return ErrCode::SUCCESS;
+        });
+
+        CHECK(rls[2].recv({"t2", ""}) == ErrCode::SUCCESS);
+        CHECK(rls[0].recv({"t0", ""}) == ErrCode::SUCCESS);
+        CHECK(recvLog == std::vector<std::string>{"t2", "t0"});
+    }
+}
+
+TEST_CASE("Remote layer pool failover", "[RemoteLayerPool]")
+{
+    std::vector<DummyRemoteLayer> rls(3);
+    RemoteLayerPool pool({&rls[0], &rls[1], &rls[2]}, 2, 50ms);
+
+    std::string topic = "sensor/1";
+    size_t primary = pool.getPubRoute(topic);
+    CHECK(pool.subscribe("cmd/#") == ErrCode::SUCCESS);
+    size_t subIdx;
+    REQUIRE(pool.getSubRoute("cmd/#", subIdx) == ErrCode::SUCCESS);
+
+    rls[primary].ret = ErrCode::TIMEOUT;
+    rls[subIdx].ret = ErrCode::TIMEOUT;
+
+    // Failed publications are retried over other layers
+    CHECK(pool.publish({topic, "1"}) == ErrCode::SUCCESS);
+    CHECK(pool.isHealthy(primary));
+    CHECK(pool.publish({topic, "2"}) == ErrCode::SUCCESS);
+    CHECK_FALSE(pool.isHealthy(primary));
+    CHECK(rls[primary].pubsLog.size() == 2);
+
+    // Unhealthy layer isn't tried at all
+    size_t secondary = pool.getPubRoute(topic);
+    CHECK(secondary != primary);
+    CHECK(pool.publish({topic, "3"}) == ErrCode::SUCCESS);
+    CHECK(rls[primary].pubsLog.size() == 2);
+    CHECK(rls[secondary].pubsLog.back() == PubData{topic, "3"});
+
+    if (subIdx == primary) {
+        // Subscription moved to healthy layer
+        size_t newSubIdx;
+        REQUIRE(pool.getSubRoute("cmd/#", newSubIdx) == ErrCode::SUCCESS);
+        CHECK(newSubIdx != primary);
+        CHECK(rls[newSubIdx].subsLog.back() == "cmd/#");
+    }
+
+    SECTION("Retry after interval")
+    {
+        rls[primary].ret = ErrCode::SUCCESS;
+        std::this_thread::sleep_for(60ms);
+        CHECK(pool.getPubRoute(topic) == primary);
+        CHECK(pool.publish({topic, "4"}) == ErrCode::SUCCESS);
+        CHECK(pool.isHealthy(primary));
+        CHECK(rls[primary].pubsLog.back() == PubData{topic, "4"});
+    }
+
+    SECTION("Reconnection")
+    {
+        rls[primary].ret = ErrCode::SUCCESS;
+        CHECK(rls[primary].reconnect() == ErrCode::SUCCESS);
+        CHECK(pool.isHealthy(primary));
+        CHECK(pool.getPubRoute(topic) == primary);
+    }
+
+    SECTION("All layers failing")
+    {
+        for (auto &rl : rls) {
+            rl.ret = ErrCode::TIMEOUT;
+        }
+        CHECK(pool.publish({topic, "5"}) == ErrCode::TIMEOUT);
+    }
+}
+
+TEST_CASE("Remote layer pool removes moved subscriptions", "[RemoteLayerPool]")
+{
+    std::vector<DummyRemoteLayer> rls(2);
+    RemoteLayerPool pool({&rls[0], &rls[1]}, 1, 50ms);
+
+    CHECK(pool.subscribe("cmd/#") == ErrCode::SUCCESS);
+    size_t subIdx;
+    REQUIRE(pool.getSubRoute("cmd/#", subIdx) == ErrCode::SUCCESS);
+
+    std::string topic;
+    for (int i = 0; pool.getPubRoute(topic) != subIdx; i++) {
+        topic = "sensor/" + std::to_string(i);
+    }
+
+    // Failed layer can't be unsubscribed right away
+    rls[subIdx].ret = ErrCode::TIMEOUT;
+    CHECK(pool.publish({topic, "1"}) == ErrCode::SUCCESS);
+    CHECK_FALSE(pool.isHealthy(subIdx));
+    size_t newSubIdx;
+    REQUIRE(pool.getSubRoute("cmd/#", newSubIdx) == ErrCode::SUCCESS);
+    CHECK(newSubIdx != subIdx);
+    CHECK(rls[subIdx].unsubsLog == DummyRemoteLayer::TopicsLog{"cmd/#"});
+    CHECK(rls[newSubIdx].unsubsLog.empty());
+
+    SECTION("On recovery")
+    {
+        rls[subIdx].ret = ErrCode::SUCCESS;
+        std::this_thread::sleep_for(60ms);
+        CHECK(pool.publish({topic, "2"}) == ErrCode::SUCCESS);
+        CHECK(pool.isHealthy(subIdx));
+        CHECK(rls[subIdx].unsubsLog ==
+              DummyRemoteLayer::TopicsLog{"cmd/#", "cmd/#"});
+        CHECK(rls[newSubIdx].unsubsLog.empty());
+    }
+
+    SECTION("Not after reconnection")
+    {
+        rls[subIdx].ret = ErrCode::SUCCESS;
+        CHECK(rls[subIdx].reconnect() == ErrCode::SUCCESS);
+        CHECK(pool.publish({topic, "2"}) == ErrCode::SUCCESS);
+        CHECK(rls[subIdx].unsubsLog == DummyRemoteLayer::TopicsLog{"cmd/#"});
+        CHECK(rls[subIdx].subsLog == DummyRemoteLayer::TopicsLog{"cmd/#"});
+    }
+}
+
+TEST_CASE("Remote layer pool restores subscriptions on reconnection",
+          "[RemoteLayerPool]")
+{
+    DummyRemoteLayer rl1, rl2;
+    RemoteLayerPool pool({&rl1, &rl2});
+
+    for (int i = 0; i < 20; i++) {
+        CHECK(pool.subscribe("t/" + std::to_string(i)) == ErrCode::SUCCESS);
+    }
+    size_t held = rl1.subsLog.size();
+    CHECK(held > 0);
+    CHECK(held < 20);
+
+    size_t reconnectCnt = 0;
+    pool.setReconnectCb([&reconnectCnt]() {
+        reconnectCnt++;
+        return ErrCode::SUCCESS;
+    });
+
+    CHECK(rl1.reconnect() == ErrCode::SUCCESS);
+    CHECK(rl1.subsLog.size() == 2 * held);
+    CHECK(rl2.subsLog.size() == 20 - held);
+    CHECK(reconnectCnt == 1);
+}
@@ -0,0 +1,248 @@
+/**
+ * @file session_table.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @copyright Copyright (c) 2024
+ */
+
+#include <unordered_map>
+#include <vector>
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "kvik/errors.hpp"
+#include "kvik/local_addr.hpp"
+#include "kvik/session_table.hpp"
+
+using namespace kvik;
+
+/**
+ * @brief Makes 6-byte address from number
+ * @param i Number
+ * @return Address
+ */
+static LocalAddr makeAddr(uint32_t i)
+{
+    return LocalAddr{{0x02, 0x00, uint8_t(i >> 24), uint8_t(i >> 16),
+                      uint8_t(i >> 8), uint8_t(i)}};
+}
+
+TEST_CASE("Basic operations", "[SessionTable]")
+{
+    SessionTable<PeerSession> table;
+    CHECK(table.empty());
+    CHECK(table.capacity() == 64);
+    CHECK(table.find(makeAddr(1)) == nullptr);
+
+    PeerSession *session;
+    REQUIRE(table.getOrInsert(makeAddr(1), session) == ErrCode::SUCCESS);
+    REQUIRE(session != nullptr);
+    session->rxMsgs = 5;
+    CHECK(table.size() == 1);
+
+    SECTION("Find")
+    {
+        auto found = table.find(makeAddr(1));
+        REQUIRE(found != nullptr);
+        CHECK(found->rxMsgs == 5);
+        CHECK(table.find(makeAddr(2)) == nullptr);
+    }
+
+    SECTION("Get existing")
+    {
+        PeerSession *same;
+        REQUIRE(table.getOrInsert(makeAddr(1), same) == ErrCode::SUCCESS);
+        CHECK(same->rxMsgs == 5);
+        CHECK(table.size() == 1);
+    }
+
+    SECTION("Erase")
+    {
+        CHECK(table.erase(makeAddr(1)));
+        CHECK(!table.erase(makeAddr(1)));
+        CHECK(table.find(makeAddr(1)) == nullptr);
+        CHECK(table.empty());
+
+        // Reinsert gets default state
+        REQUIRE(table.getOrInsert(makeAddr(1), session) == ErrCode::SUCCESS);
+        CHECK(session->rxMsgs == 0);
+    }
+
+    SECTION("Address prefixes are distinct keys")
+    {
+        PeerSession *other;
+        REQUIRE(table.getOrInsert(LocalAddr{{0x02, 0x00}}, other) ==
+                ErrCode::SUCCESS);
+        REQUIRE(table.getOrInsert(LocalAddr{}, other) == ErrCode::SUCCESS);
+        CHECK(table.size() == 3);
+        CHECK(table.find(makeAddr(1))->rxMsgs == 5);
+    }
+
+    SECTION("Too long address")
+    {
+        LocalAddr longAddr{std::vector<uint8_t>(9, 0xaa)};
+        CHECK(table.getOrInsert(longAddr, session) == ErrCode::INVALID_SIZE);
+        CHECK(table.find(longAddr) == nullptr);
+        CHECK(!table.erase(longAddr));
+    }
+
+    SECTION("Clear")
+    {
+        table.clear();
+        CHECK(table.empty());
+        CHECK(table.find(makeAddr(1)) == nullptr);
+    }
+}
+
+TEST_CASE("Incremental rehash", "[SessionTable]")
+{
+    constexpr uint32_t CNT = 5000;
+
+    SessionTable<uint32_t> table(8);
+    bool rehashSeen = false;
+
+    for (uint32_t i = 0; i < CNT; i++) {
+        uint32_t *value;
+        REQUIRE(table.getOrInsert(makeAddr(i), value) == ErrCode::SUCCESS);
+        *value = i;
+        rehashSeen |= table.rehashing();
+    }
+
+    CHECK(rehashSeen);
+    CHECK(table.size() == CNT);
+    CHECK(table.capacity() >= CNT);
+
+    // All entries are reachable, regardless of migration state
+    for (uint32_t i = 0; i < CNT; i++) {
+        auto value = table.find(makeAddr(i));
+        REQUIRE(value != nullptr);
+        CHECK(*value == i);
+    }
+
+    SECTION("Erase during rehash")
+    {
+        for (uint32_t i = 0; i < CNT; i += 2) {
+            REQUIRE(table.erase(makeAddr(i)));
+        }
+        CHECK(table.size() == CNT / 2);
+
+        for (uint32_t i = 0; i < CNT; i++) {
+            auto value = table.find(makeAddr(i));
+            if (i % 2 == 0) {
+                CHECK(value == nullptr);
+            } else {
+                REQUIRE(value != nullptr);
+                CHECK(*value == i);
+            }
+        }
+    }
+
+    SECTION("For each")
+    {
+        size_t cnt = 0;
+        uint64_t sum = 0;
+        table.forEach([&](const LocalAddr &addr, uint32_t &value) {
+            CHECK(addr == makeAddr(value));
+            cnt++;
+            sum += value;
+        });
+        CHECK(cnt == CNT);
+        CHECK(sum == uint64_t(CNT) * (CNT - 1) / 2);
+    }
+}
+
+TEST_CASE("Churn doesn't grow table", "[SessionTable]")
+{
+    SessionTable<PeerSession> table(64);
+
+    // Tombstones are purged without growing
+    for (uint32_t i = 0; i < 10000; i++) {
+        PeerSession *session;
+        REQUIRE(table.getOrInsert(makeAddr(i), session) == ErrCode::SUCCESS);
+        REQUIRE(table.erase(makeAddr(i)));
+    }
+
+    CHECK(table.empty());
+    CHECK(table.capacity() == 64);
+}
+
+TEST_CASE("Message ID window", "[SessionTable]")
+{
+    PeerSession session;
+
+    CHECK(session.checkMsgId(100));
+    CHECK(!session.checkMsgId(100));
+
+    SECTION("Newer IDs")
+    {
+        CHECK(session.checkMsgId(101));
+        CHECK(session.checkMsgId(110));
+        CHECK(!session.checkMsgId(101));
+        CHECK(session.lastMsgId == 110);
+    }
+
+    SECTION("Reordered IDs")
+    {
+        CHECK(session.checkMsgId(105));
+        CHECK(session.checkMsgId(103));
+        CHECK(!session.checkMsgId(103));
+        CHECK(session.lastMsgId == 105);
+    }
+
+    SECTION("Too old IDs")
+    {
+        CHECK(session.checkMsgId(200));
+        CHECK(!session.checkMsgId(136));
+        CHECK(session.checkMsgId(137));
+    }
+
+    SECTION("Big jump clears window")
+    {
+        CHECK(session.checkMsgId(1000));
+        CHECK(session.checkMsgId(999));
+    }
+
+    SECTION("Wrap-around")
+    {
+        PeerSession wrapped;
+        CHECK(wrapped.checkMsgId(65534));
+        CHECK(wrapped.checkMsgId(1));
+        CHECK(!wrapped.checkMsgId(65534));
+        CHECK(wrapped.checkMsgId(65535));
+    }
+}
+
+TEST_CASE("Lookup with 100k sessions", "[SessionTable][.benchmark]")
+{
+    constexpr uint32_t CNT = 100000;
+
+    SessionTable<PeerSession> table;
+    std::unordered_map<LocalAddr, PeerSession> map;
+
+    std::vector<LocalAddr> addrs;
+    for (uint32_t i = 0; i < CNT; i++) {
+        addrs.push_back(makeAddr(i * 2654435761u));
+
+        PeerSession *session;
+        REQUIRE(table.getOrInsert(addrs.back(), session) == ErrCode::SUCCESS);
+        map[addrs.back()];
+    }
+
+    BENCHMARK("SessionTable")
+    {
+        uint32_t sum = 0;
+        for (size_t i = 0; i < addrs.size(); i += 7) {
+            sum += table.find(addrs[i])->rxMsgs++;
+        }
+        return sum;
+    };
+
+    BENCHMARK("std::unordered_map")
+    {
+        uint32_t sum = 0;
+        for (size_t i = 0; i < addrs.size(); i += 7) {
+            sum += map.find(addrs[i])->second.rxMsgs++;
+        }
+        return sum;
+    };
+}
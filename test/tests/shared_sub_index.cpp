@@ -0,0 +1,172 @@
+/**
+ * @file shared_sub_index.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @copyright Copyright (c) 2024
+ */
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "kvik/errors.hpp"
+#include "kvik/shared_sub_index.hpp"
+
+using namespace kvik;
+
+using Consumers = std::vector<SharedSubIndex::ConsumerId>;
+
+TEST_CASE("Shared filter parsing", "[SharedSubIndex]")
+{
+    SharedSubIndex index;
+    std::string group, filter;
+
+    CHECK(index.parseShared("a/b", group, filter) == ErrCode::NOT_FOUND);
+    CHECK(index.parseShared("$shared/g/a", group, filter) ==
+          ErrCode::NOT_FOUND);
+    CHECK(index.parseShared("$share/g/a/+/#", group, filter) ==
+          ErrCode::SUCCESS);
+    CHECK(group == "g");
+    CHECK(filter == "a/+/#");
+
+    CHECK(index.parseShared("$share/g", group, filter) == ErrCode::INVALID_ARG);
+    CHECK(index.parseShared("$share/g/", group, filter) ==
+          ErrCode::INVALID_ARG);
+    CHECK(index.parseShared("$share//a", group, filter) ==
+          ErrCode::INVALID_ARG);
+    CHECK(index.parseShared("$share/#/a", group, filter) ==
+          ErrCode::INVALID_ARG);
+
+    SECTION("Custom separators")
+    {
+        SharedSubIndex custom(SharedSubIndex::Policy::ROUND_ROBIN,
+                              {".", "*", ">"});
+        CHECK(custom.parseShared("$share.g.a.*", group, filter) ==
+              ErrCode::SUCCESS);
+        CHECK(group == "g");
+        CHECK(filter == "a.*");
+    }
+}
+
+TEST_CASE("Ordinary subscriptions", "[SharedSubIndex]")
+{
+    SharedSubIndex index;
+    Consumers consumers;
+
+    CHECK(index.empty());
+    CHECK(index.subscribe(1, "a/#") == ErrCode::SUCCESS);
+    CHECK(index.subscribe(1, "a/b") == ErrCode::SUCCESS);
+    CHECK(index.subscribe(2, "a/+") == ErrCode::SUCCESS);
+    CHECK(index.subscribe(2, "a/+") == ErrCode::SUCCESS);
+
+    index.match("a/b", consumers);
+    std::sort(consumers.begin(), consumers.end());
+    CHECK(consumers == Consumers{1, 2});
+
+    index.match("x", consumers);
+    CHECK(consumers.empty());
+
+    CHECK(index.unsubscribe(2, "a/+") == ErrCode::SUCCESS);
+    CHECK(index.unsubscribe(2, "a/+") == ErrCode::NOT_FOUND);
+    index.match("a/b", consumers);
+    CHECK(consumers == Consumers{1});
+
+    index.removeConsumer(1);
+    CHECK(index.empty());
+}
+
+TEST_CASE("Shared subscriptions", "[SharedSubIndex]")
+{
+    SECTION("Round robin")
+    {
+        SharedSubIndex index;
+        Consumers consumers;
+        for (SharedSubIndex::ConsumerId id = 1; id <= 3; id++) {
+            CHECK(index.subscribe(id, "$share/g/s/#") == ErrCode::SUCCESS);
+        }
+        CHECK(index.subscribe(10, "$share/h/s/+") == ErrCode::SUCCESS);
+        CHECK(index.subscribe(11, "$share/h/s/+") == ErrCode::SUCCESS);
+
+        Consumers gSeq, hSeq, selected;
+        for (int i = 0; i < 6; i++) {
+            index.match("s/1", consumers, &selected);
+            REQUIRE(consumers.size() == 2);
+            CHECK(selected == consumers);
+            for (auto id : consumers) {
+                (id < 10 ? gSeq : hSeq).push_back(id);
+                index.release(id);
+            }
+        }
+
+        // Each group receives every message exactly once
+        CHECK(gSeq == Consumers{1, 2, 3, 1, 2, 3});
+        CHECK(hSeq == Consumers{10, 11, 10, 11, 10, 11});
+    }
+
+    SECTION("Least loaded")
+    {
+        SharedSubIndex index(SharedSubIndex::Policy::LEAST_LOADED);
+        Consumers consumers, selected;
+        CHECK(index.subscribe(1, "$share/g/t") == ErrCode::SUCCESS);
+        CHECK(index.subscribe(2, "$share/g/t") == ErrCode::SUCCESS);
+
+        // Consumer 1 doesn't release its messages
+        index.match("t", consumers, &selected);
+        CHECK(consumers == Consumers{1});
+        index.match("t", consumers, &selected);
+        CHECK(consumers == Consumers{2});
+        index.release(2);
+        CHECK(index.load(1) == 1);
+        CHECK(index.load(2) == 0);
+
+        for (int i = 0; i < 3; i++) {
+            index.match("t", consumers, &selected);
+            CHECK(consumers == Consumers{2});
+            index.release(2);
+        }
+
+        index.release(1);
+        index.match("t", consumers, &selected);
+        CHECK(consumers.size() == 1);
+
+        // Load isn't tracked without selected consumers
+        index.release(consumers.front());
+        index.match("t", consumers);
+        CHECK(index.load(consumers.front()) == 0);
+    }
+
+    SECTION("Member subscribed also directly")
+    {
+        SharedSubIndex index;
+        Consumers consumers;
+        CHECK(index.subscribe(1, "t") == ErrCode::SUCCESS);
+        CHECK(index.subscribe(1, "$share/g/t") == ErrCode::SUCCESS);
+        CHECK(index.subscribe(2, "t") == ErrCode::SUCCESS);
+
+        // Ordinary subscribers aren't selected (and never released)
+        Consumers selected;
+        index.match("t", consumers, &selected);
+        std::sort(consumers.begin(), consumers.end());
+        CHECK(consumers == Consumers{1, 2});
+        CHECK(selected.empty());
+        CHECK(index.load(1) == 0);
+    }
+
+    SECTION("Unsubscription")
+    {
+        SharedSubIndex index;
+        Consumers consumers;
+        CHECK(index.subscribe(1, "$share/g/t") == ErrCode::SUCCESS);
+        CHECK(index.subscribe(2, "$share/g/t") == ErrCode::SUCCESS);
+        CHECK(index.unsubscribe(1, "t") == ErrCode::NOT_FOUND);
+        CHECK(index.unsubscribe(1, "$share/h/t") == ErrCode::NOT_FOUND);
+        CHECK(index.unsubscribe(1, "$share/g/t") == ErrCode::SUCCESS);
+        for (int i = 0; i < 3; i++) {
+            index.match("t", consumers);
+            CHECK(consumers == Consumers{2});
+        }
+        CHECK(index.unsubscribe(2, "$share/g/t") == ErrCode::SUCCESS);
+        CHECK(index.empty());
+    }
+}
@@ -0,0 +1,203 @@
+/**
+ * @file slot_scheduler.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @copyright Copyright (c) 2024
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "kvik/local_msg.hpp"
+#include "kvik/slot_scheduler.hpp"
+#include "kvik/uplink_slot.hpp"
+
+using namespace kvik;
+using namespace std::chrono_literals;
+
+static const LocalAddr ADDR1{{0x01}};
+static const LocalAddr ADDR2{{0x02}};
+static const LocalAddr ADDR3{{0x03}};
+
+static LocalAddr clientAddr(size_t n)
+{
+    return LocalAddr{{0xC0, static_cast<uint8_t>(n >> 8),
+                      static_cast<uint8_t>(n)}};
+}
+
+/**
+ * @brief Transmission on simulated shared medium
+ */
+struct Tx
+{
+    std::chrono::milliseconds start;
+    std::chrono::milliseconds end;
+};
+
+/**
+ * @brief Counts transmissions not overlapping any other
+ */
+static size_t countDelivered(std::vector<Tx> txs)
+{
+    std::sort(txs.begin(), txs.end(),
+              [](auto &a, auto &b) { return a.start < b.start; });
+
+    std::vector<bool> collided(txs.size());
+    for (size_t i = 0; i < txs.size(); i++) {
+        for (size_t j = i + 1; j < txs.size() && txs[j].start < txs[i].end;
+             j++) {
+            collided[i] = true;
+            collided[j] = true;
+        }
+    }
+    return std::count(collided.begin(), collided.end(), false);
+}
+
+TEST_CASE("Uplink slot", "[SlotScheduler]")
+{
+    const UplinkSlot slot = {.idx = 2, .frameLen = 4, .slotLen = 10ms};
+
+    SECTION("Validity")
+    {
+        CHECK(slot.assigned());
+        CHECK(!UplinkSlot{}.assigned());
+        CHECK(!UplinkSlot{.idx = 0, .frameLen = 4, .slotLen = 10ms}.assigned());
+        CHECK(!UplinkSlot{.idx = 4, .frameLen = 4, .slotLen = 10ms}.assigned());
+        CHECK(!UplinkSlot{.idx = 1, .frameLen = 4}.assigned());
+        CHECK(UplinkSlot{}.toString() == "none");
+        CHECK(slot.toString() == "2/4 (10 ms)");
+    }
+
+    SECTION("Next start")
+    {
+        CHECK(slot.nextStart(0ms) == 20ms);
+        CHECK(slot.nextStart(20ms) == 20ms);
+        CHECK(slot.nextStart(21ms) == 60ms);
+        CHECK(slot.nextStart(1005ms) == 1020ms);
+        CHECK(slot.nextStart(-15ms) == 20ms);
+        CHECK(slot.nextStart(-25ms) == -20ms);
+
+        CHECK(slot.nextStart(0ms, true) == 0ms);
+        CHECK(slot.nextStart(1ms, true) == 40ms);
+        CHECK(slot.nextStart(39ms, true) == 40ms);
+
+        CHECK(UplinkSlot{}.nextStart(123ms) == 123ms);
+    }
+}
+
+TEST_CASE("Slot scheduler", "[SlotScheduler]")
+{
+    using Clock = SlotScheduler::Clock;
+    auto now = Clock::now();
+
+    SECTION("Invalid parameters")
+    {
+        CHECK_THROWS(SlotScheduler{{.frameLen = 1}});
+        CHECK_THROWS(SlotScheduler{{.slotLen = 0ms}});
+    }
+
+    SECTION("Assignment and renewal")
+    {
+        SlotScheduler sched{{.slotLen = 20ms, .frameLen = 3}};
+
+        auto slot1 = sched.assign(ADDR1, now);
+        auto slot2 = sched.assign(ADDR2, now);
+        CHECK(slot1 == UplinkSlot{.idx = 1, .frameLen = 3, .slotLen = 20ms});
+        CHECK(slot2.idx == 2);
+        CHECK(sched.assign(ADDR1, now) == slot1);
+        CHECK(sched.assignedCnt() == 2);
+
+        // Frame is full, least loaded slot is shared
+        CHECK(sched.assign(ADDR3, now).idx == 1);
+        CHECK(sched.slotLoad(1) == 2);
+        CHECK(sched.slotLoad(0) == 0);
+        CHECK(sched.slotLoad(3) == 0);
+
+        sched.release(ADDR2);
+        sched.release(ADDR2);
+        CHECK(sched.slotLoad(2) == 0);
+        CHECK(sched.assign(ADDR2, now).idx == 2);
+    }
+
+    SECTION("Expiration")
+    {
+        SlotScheduler sched{{.lease = 100ms}};
+        sched.assign(ADDR1, now);
+        sched.assign(ADDR2, now);
+
+        // Renewal extends lease
+        sched.assign(ADDR1, now + 60ms);
+        CHECK(sched.expire(now + 99ms) == 0);
+        CHECK(sched.expire(now + 100ms) == 1);
+        CHECK(sched.assignedCnt() == 1);
+        CHECK(sched.slotLoad(2) == 0);
+
+        // Freed slot is reused
+        CHECK(sched.assign(ADDR3, now + 100ms).idx == 2);
+    }
+
+    SECTION("Attach to responses")
+    {
+        SlotScheduler sched;
+        LocalMsg resp = {.type = LocalMsgType::PROBE_RES, .addr = ADDR1};
+        REQUIRE(sched.attach(resp, now) == ErrCode::SUCCESS);
+        CHECK(resp.uplinkSlot.assigned());
+        CHECK(resp.toString().find("slot 1/32") != std::string::npos);
+
+        LocalMsg ok = {.type = LocalMsgType::OK, .addr = ADDR1};
+        REQUIRE(sched.attach(ok, now) == ErrCode::SUCCESS);
+        CHECK(ok.uplinkSlot == resp.uplinkSlot);
+
+        LocalMsg data = {.type = LocalMsgType::SUB_DATA, .addr = ADDR1};
+        CHECK(sched.attach(data, now) == ErrCode::INVALID_ARG);
+        LocalMsg noAddr = {.type = LocalMsgType::OK};
+        CHECK(sched.attach(noAddr, now) == ErrCode::INVALID_ARG);
+        CHECK(sched.assignedCnt() == 1);
+    }
+}
+
+TEST_CASE("Slotted access on shared medium", "[SlotScheduler]")
+{
+    // Each client publishes once per frame at random time, message is
+    // 8 ms long. Clock of each client is off by up to 1 ms.
+    constexpr size_t CLIENTS = 200;
+    constexpr size_t FRAMES = 20;
+    constexpr auto AIRTIME = 8ms;
+
+    SlotScheduler sched{{.slotLen = 10ms, .frameLen = CLIENTS + 1}};
+    const std::chrono::milliseconds frame = 10ms * (CLIENTS + 1);
+
+    std::mt19937 rng{42};
+    std::uniform_int_distribution<int64_t> genDist{0, frame.count() - 1};
+    std::uniform_int_distribution<int> errDist{-1, 1};
+
+    std::vector<Tx> aloha, slotted;
+    for (size_t c = 0; c < CLIENTS; c++) {
+        auto slot = sched.assign(clientAddr(c));
+        auto clockErr = std::chrono::milliseconds(errDist(rng));
+        auto busyUntil = 0ms;
+
+        for (size_t f = 0; f < FRAMES; f++) {
+            std::chrono::milliseconds gen =
+                frame * f + std::chrono::milliseconds(genDist(rng));
+            aloha.push_back({gen, gen + AIRTIME});
+
+            // Deferred to own slot (as seen by client's clock)
+            auto start = slot.nextStart(std::max(gen, busyUntil) + clockErr) -
+                         clockErr;
+            slotted.push_back({start, start + AIRTIME});
+            busyUntil = start + AIRTIME;
+        }
+    }
+
+    auto alohaDelivered = countDelivered(aloha);
+    auto slottedDelivered = countDelivered(slotted);
+    INFO("unslotted " << alohaDelivered << ", slotted " << slottedDelivered);
+
+    CHECK(slottedDelivered == CLIENTS * FRAMES);
+    CHECK(alohaDelivered < CLIENTS * FRAMES / 2);
+    CHECK(slottedDelivered >= 3 * alohaDelivered);
+}
@@ -0,0 +1,436 @@
+/**
+ * @file stream.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @copyright Copyright (c) 2024
+ */
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <string>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "kvik/errors.hpp"
+#include "kvik/stream.hpp"
+
+using namespace kvik;
+using namespace std::chrono_literals;
+
+namespace
+{
+    /**
+     * @brief Generates deterministic test data
+     * @param len Length
+     * @return Data
+     */
+    std::string testData(size_t len)
+    {
+        std::string data(len, '\0');
+        for (size_t i = 0; i < len; i++) {
+            data[i] = static_cast<char>((i * 31 + 7) & 0xFF);
+        }
+        return data;
+    }
+
+    /**
+     * @brief Simulated link between stream sender and receiver
+     *
+     * Chunks are delivered in order, selected ones are dropped.
+     */
+    struct StreamLink
+    {
+        std::deque<std::string> chunks;
+        std::function<bool(size_t)> drop = [](size_t) { return false; };
+        size_t sentCnt = 0;
+
+        StreamSender::SendFn sendFn()
+        {
+            return [this](const std::string &payload) {
+                if (!drop(sentCnt++)) {
+                    chunks.push_back(payload);
+                }
+                return ErrCode::SUCCESS;
+            };
+        }
+
+        /**
+         * @brief Delivers queued chunks and returns acknowledgements
+         * @param sender Sender
+         * @param receiver Receiver
+         */
+        void deliver(StreamSender &sender, StreamReceiver &receiver)
+        {
+            while (!chunks.empty()) {
+                StreamChunk chunk;
+                REQUIRE(StreamChunk::decode(chunks.front(), chunk) ==
+                        ErrCode::SUCCESS);
+                chunks.pop_front();
+
+                StreamAck ack;
+                REQUIRE(receiver.processChunk(chunk, ack) == ErrCode::SUCCESS);
+                REQUIRE(sender.processAck(ack) == ErrCode::SUCCESS);
+            }
+        }
+    };
+} // namespace
+
+TEST_CASE("Stream chunk encoding", "[Stream]")
+{
+    StreamChunk chunk;
+    chunk.transferId = 0xDEADBEEF;
+    chunk.totalLen = 1000;
+    chunk.idx = 4;
+    chunk.chunkSize = 200;
+    chunk.data = testData(200);
+
+    StreamChunk decoded;
+    REQUIRE(StreamChunk::decode(chunk.encode(), decoded) == ErrCode::SUCCESS);
+    CHECK(decoded.transferId == chunk.transferId);
+    CHECK(decoded.totalLen == chunk.totalLen);
+    CHECK(decoded.idx == chunk.idx);
+    CHECK(decoded.chunkSize == chunk.chunkSize);
+    CHECK(decoded.data == chunk.data);
+    CHECK(decoded.chunkCnt() == 5);
+
+    SECTION("Invalid payloads")
+    {
+        CHECK(StreamChunk::decode("", decoded) == ErrCode::INVALID_ARG);
+        CHECK(StreamChunk::decode("hello world, not a chunk", decoded) ==
+              ErrCode::INVALID_ARG);
+
+        chunk.data += "x";
+        CHECK(StreamChunk::decode(chunk.encode(), decoded) ==
+              ErrCode::INVALID_SIZE);
+    }
+
+    SECTION("Chunk count")
+    {
+        CHECK(StreamChunk{0, 0, 0, 10, ""}.chunkCnt() == 1);
+        CHECK(StreamChunk{0, 10, 0, 10, ""}.chunkCnt() == 1);
+        CHECK(StreamChunk{0, 11, 0, 10, ""}.chunkCnt() == 2);
+        CHECK(StreamChunk{0, 11, 0, 0, ""}.chunkCnt() == 0);
+    }
+}
+
+TEST_CASE("Stream acknowledgement encoding", "[Stream]")
+{
+    StreamAck ack{42, 7, 0x8000000000000005, false};
+    StreamAck decoded;
+    REQUIRE(StreamAck::decode(ack.encode(), decoded) == ErrCode::SUCCESS);
+    CHECK(decoded == ack);
+
+    ack.complete = true;
+    ack.lossRate = 200;
+    REQUIRE(StreamAck::decode(ack.encode(), decoded) == ErrCode::SUCCESS);
+    CHECK(decoded == ack);
+
+    StreamChunk chunk{42, 0, 0, 10, ""};
+    CHECK(StreamAck::decode(chunk.encode(), decoded) == ErrCode::INVALID_ARG);
+}
+
+TEST_CASE("Stream transfer", "[Stream]")
+{
+    std::string data = testData(10000);
+    std::string received;
+    size_t completeCnt = 0;
+    StreamReceiver receiver([&](uint32_t transferId, const std::string &d) {
+        CHECK(transferId == 1);
+        received = d;
+        completeCnt++;
+    });
+
+    StreamLink link;
+    StreamSender sender(1, data, 100, 8, 100ms, link.sendFn());
+    CHECK(sender.chunkCnt() == 100);
+
+    SECTION("Lossless")
+    {
+        REQUIRE(sender.start() == ErrCode::SUCCESS);
+
+        // Window limits chunks in flight
+        CHECK(link.chunks.size() == 8);
+
+        link.deliver(sender, receiver);
+        CHECK(sender.done());
+        CHECK(sender.ackedCnt() == 100);
+        CHECK(sender.retransmits() == 0);
+        CHECK(link.sentCnt == 100);
+    }
+
+    SECTION("Lossy link")
+    {
+        // Every 7th transmission is lost
+        link.drop = [](size_t i) { return i % 7 == 3; };
+        REQUIRE(sender.start() == ErrCode::SUCCESS);
+
+        auto now = std::chrono::steady_clock::now();
+        for (int round = 0; round < 100 && !sender.done(); round++) {
+            link.deliver(sender, receiver);
+
+            // Only tail losses need retransmission timeout
+            now += 100ms;
+            REQUIRE(sender.tick(now) == ErrCode::SUCCESS);
+        }
+
+        CHECK(sender.done());
+
+        // Only lost chunks are retransmitted
+        size_t lost = (link.sentCnt + 3) / 7;
+        CHECK(sender.retransmits() <= lost + 8);
+        CHECK(link.sentCnt < 130);
+    }
+
+    SECTION("Lost acknowledgements")
+    {
+        REQUIRE(sender.start() == ErrCode::SUCCESS);
+        while (!link.chunks.empty()) {
+            // Acknowledgements are dropped
+            StreamChunk chunk;
+            REQUIRE(StreamChunk::decode(link.chunks.front(), chunk) ==
+                    ErrCode::SUCCESS);
+            link.chunks.pop_front();
+            StreamAck ack;
+            REQUIRE(receiver.processChunk(chunk, ack) == ErrCode::SUCCESS);
+        }
+        CHECK_FALSE(sender.done());
+
+        REQUIRE(sender.tick(std::chrono::steady_clock::now() + 1s) ==
+                ErrCode::SUCCESS);
+        CHECK(link.chunks.size() == 8);
+        link.deliver(sender, receiver);
+        CHECK(sender.done());
+        CHECK(sender.retransmits() == 8);
+    }
+
+    CHECK(completeCnt == (sender.done() ? 1 : 0));
+    if (sender.done()) {
+        CHECK(received == data);
+        CHECK(receiver.transferCnt() == 0);
+    }
+}
+
+TEST_CASE("Stream parity chunk encoding", "[Stream]")
+{
+    StreamChunk chunk{5, 1000, 16, 100, testData(100), 8, 2};
+    StreamChunk decoded;
+    REQUIRE(StreamChunk::decode(chunk.encode(), decoded) == ErrCode::SUCCESS);
+    CHECK(decoded.idx == 16);
+    CHECK(decoded.fecK == 8);
+    CHECK(decoded.fecIdx == 2);
+    CHECK(decoded.data == chunk.data);
+
+    // Parity is always padded to chunk size
+    chunk.data.pop_back();
+    CHECK(StreamChunk::decode(chunk.encode(), decoded) ==
+          ErrCode::INVALID_SIZE);
+}
+
+TEST_CASE("Stream transfer with FEC", "[Stream]")
+{
+    std::string data = testData(20000);
+
+    /**
+     * @brief Runs transfer over link losing ~10 % of frames
+     * @param fecGroup FEC group size (0 disables FEC)
+     * @param rounds Number of retransmission timeouts (modified in-place)
+     * @return Sender after completed transfer
+     */
+    auto run = [&data](size_t fecGroup, int &rounds) {
+        std::string received;
+        StreamReceiver receiver(
+            [&](uint32_t, const std::string &d) { received = d; });
+
+        // Deterministic pseudo-random losses (LCG)
+        uint64_t state = 7;
+        StreamLink link;
+        link.drop = [&state](size_t) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            return (state >> 33) % 10 == 0;
+        };
+
+        auto sender = std::make_unique<StreamSender>(
+            1, data, 100, 16, 100ms, link.sendFn(), fecGroup, 4);
+        REQUIRE(sender->start() == ErrCode::SUCCESS);
+
+        auto now = std::chrono::steady_clock::now();
+        for (rounds = 0; rounds < 200 && !sender->done(); rounds++) {
+            link.deliver(*sender, receiver);
+            if (sender->done()) {
+                break;
+            }
+            now += 100ms;
+            REQUIRE(sender->tick(now) == ErrCode::SUCCESS);
+        }
+
+        REQUIRE(sender->done());
+        CHECK(received == data);
+        CHECK(receiver.lossRate() > 0.02);
+        return sender;
+    };
+
+    int plainRounds, fecRounds;
+    auto plain = run(0, plainRounds);
+    auto fec = run(8, fecRounds);
+
+    CHECK(plain->paritySent() == 0);
+    CHECK(fec->paritySent() > 0);
+    CHECK(fec->lossRate() > 0.02);
+
+    // Lost chunks are recovered instead of retransmitted
+    CHECK(fec->retransmits() * 4 < plain->retransmits());
+    CHECK(fecRounds <= plainRounds);
+}
+
+TEST_CASE("Stream resumption", "[Stream]")
+{
+    std::string data = testData(2000);
+    std::string received;
+    StreamReceiver receiver(
+        [&](uint32_t, const std::string &d) { received = d; });
+
+    // First window is delivered, then sender "reboots" before
+    // acknowledgements arrive
+    {
+        StreamLink link;
+        StreamSender sender(7, data, 100, 10, 100ms, link.sendFn());
+        REQUIRE(sender.start() == ErrCode::SUCCESS);
+        for (const auto &payload : link.chunks) {
+            StreamChunk chunk;
+            StreamAck ack;
+            REQUIRE(StreamChunk::decode(payload, chunk) == ErrCode::SUCCESS);
+            REQUIRE(receiver.processChunk(chunk, ack) == ErrCode::SUCCESS);
+        }
+    }
+
+    StreamAck ack;
+    REQUIRE(receiver.getAck(7, ack) == ErrCode::SUCCESS);
+    CHECK(ack.cumAck == 10);
+    CHECK_FALSE(ack.complete);
+
+    StreamLink link;
+    StreamSender sender(7, data, 100, 10, 100ms, link.sendFn());
+
+    SECTION("Resumed")
+    {
+        REQUIRE(sender.start(true) == ErrCode::SUCCESS);
+        CHECK(link.chunks.size() == 1);
+        link.deliver(sender, receiver);
+
+        CHECK(sender.done());
+        CHECK(received == data);
+
+        // Probe and missing chunks only
+        CHECK(link.sentCnt == 1 + 10);
+    }
+
+    SECTION("Lost probe")
+    {
+        REQUIRE(sender.start(true) == ErrCode::SUCCESS);
+        link.chunks.clear();
+        REQUIRE(sender.tick(std::chrono::steady_clock::now() + 1s) ==
+                ErrCode::SUCCESS);
+        link.deliver(sender, receiver);
+        CHECK(sender.done());
+        CHECK(link.sentCnt == 2 + 10);
+    }
+
+    SECTION("Aborted")
+    {
+        CHECK(receiver.abort(7));
+        CHECK_FALSE(receiver.abort(7));
+        CHECK(receiver.getAck(7, ack) == ErrCode::NOT_FOUND);
+
+        REQUIRE(sender.start(true) == ErrCode::SUCCESS);
+        link.deliver(sender, receiver);
+        CHECK(sender.done());
+        CHECK(received == data);
+        CHECK(link.sentCnt == 1 + 20);
+    }
+}
+
+TEST_CASE("Stream receiver limits", "[Stream]")
+{
+    size_t completeCnt = 0;
+    StreamReceiver receiver([&](uint32_t, const std::string &) { completeCnt++; },
+                            2, 1000);
+    StreamAck ack;
+
+    SECTION("Too long")
+    {
+        CHECK(receiver.processChunk({1, 1001, 0, 100, testData(100)}, ack) ==
+              ErrCode::INVALID_SIZE);
+    }
+
+    SECTION("Too many transfers")
+    {
+        CHECK(receiver.processChunk({1, 200, 0, 100, testData(100)}, ack) ==
+              ErrCode::SUCCESS);
+        CHECK(receiver.processChunk({2, 200, 0, 100, testData(100)}, ack) ==
+              ErrCode::SUCCESS);
+        CHECK(receiver.processChunk({3, 200, 0, 100, testData(100)}, ack) ==
+              ErrCode::QUEUE_FULL);
+        CHECK(receiver.transferCnt() == 2);
+    }
+
+    SECTION("Idle transfers")
+    {
+        auto now = std::chrono::steady_clock::now();
+        CHECK(receiver.processChunk({1, 200, 0, 100, testData(100)}, ack,
+                                    now) == ErrCode::SUCCESS);
+        CHECK(receiver.processChunk({2, 200, 0, 100, testData(100)}, ack,
+                                    now + std::chrono::minutes(3)) ==
+              ErrCode::SUCCESS);
+        CHECK(receiver.processChunk({3, 200, 0, 100, testData(100)}, ack,
+                                    now + std::chrono::minutes(4)) ==
+              ErrCode::QUEUE_FULL);
+        CHECK(receiver.expireIdle(now + std::chrono::minutes(4)) == 0);
+
+        // Abandoned transfer makes room for new one
+        CHECK(receiver.processChunk({3, 200, 0, 100, testData(100)}, ack,
+                                    now + std::chrono::minutes(5)) ==
+              ErrCode::SUCCESS);
+        CHECK(receiver.transferCnt() == 2);
+        CHECK(receiver.expireIdle(now + std::chrono::minutes(8)) == 1);
+        CHECK(receiver.transferCnt() == 1);
+    }
+
+    SECTION("Inconsistent chunks")
+    {
+        CHECK(receiver.processChunk({1, 250, 0, 100, testData(100)}, ack) ==
+              ErrCode::SUCCESS);
+        CHECK(receiver.processChunk({1, 250, 1, 50, testData(50)}, ack) ==
+              ErrCode::INVALID_ARG);
+        CHECK(receiver.processChunk({1, 250, 3, 100, testData(50)}, ack) ==
+              ErrCode::INVALID_ARG);
+        CHECK(receiver.processChunk({1, 250, 2, 100, testData(100)}, ack) ==
+              ErrCode::INVALID_SIZE);
+        CHECK(receiver.processChunk({1, 250, 2, 100, testData(50)}, ack) ==
+              ErrCode::SUCCESS);
+        CHECK(ack.cumAck == 1);
+        CHECK(ack.sack == 1);
+        CHECK_FALSE(ack.complete);
+
+        // Skipped chunk counts as lost
+        CHECK(ack.lossRate > 0);
+    }
+
+    SECTION("Duplicates")
+    {
+        CHECK(receiver.processChunk({1, 100, 0, 100, testData(100)}, ack) ==
+              ErrCode::SUCCESS);
+        CHECK(ack.complete);
+        CHECK(receiver.processChunk({1, 100, 0, 100, testData(100)}, ack) ==
+              ErrCode::SUCCESS);
+        CHECK(ack.complete);
+        CHECK(completeCnt == 1);
+    }
+
+    SECTION("Empty transfer")
+    {
+        CHECK(receiver.processChunk({1, 0, 0, 100, ""}, ack) ==
+              ErrCode::SUCCESS);
+        CHECK(ack.complete);
+        CHECK(completeCnt == 1);
+    }
+}
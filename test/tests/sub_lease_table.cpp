@@ -0,0 +1,187 @@
+/**
+ * @file sub_lease_table.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @copyright Copyright (c) 2024
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "kvik/errors.hpp"
+#include "kvik/sub_lease_table.hpp"
+
+using namespace kvik;
+using namespace std::chrono_literals;
+
+using Consumers = std::vector<SubLeaseTable::ConsumerId>;
+
+TEST_CASE("Subscription leases", "[SubLeaseTable]")
+{
+    std::vector<std::vector<std::string>> batches;
+    SubLeaseTable table(
+        10s, [&](const std::vector<std::string> &b) { batches.push_back(b); },
+        2);
+    auto start = std::chrono::steady_clock::now();
+    bool newUpstream;
+    Consumers consumers;
+
+    REQUIRE(table.subscribe(1, "a/#", start, newUpstream) == ErrCode::SUCCESS);
+    CHECK(newUpstream);
+    REQUIRE(table.subscribe(2, "a/#", start, newUpstream) == ErrCode::SUCCESS);
+    CHECK_FALSE(newUpstream);
+    REQUIRE(table.subscribe(2, "$share/g/b", start, newUpstream) ==
+            ErrCode::SUCCESS);
+    CHECK(newUpstream);
+    CHECK(table.subscribe(2, "$share//b", start, newUpstream) ==
+          ErrCode::INVALID_ARG);
+    CHECK(table.size() == 3);
+    CHECK(table.upstreamCnt() == 2);
+
+    table.match("a/x", consumers);
+    CHECK(consumers.size() == 2);
+
+    SECTION("Expiration")
+    {
+        CHECK(table.tick(start + 9s) == 0);
+        CHECK(table.tick(start + 12s) == 3);
+        CHECK(table.size() == 0);
+        CHECK(table.upstreamCnt() == 0);
+
+        table.match("a/x", consumers);
+        CHECK(consumers.empty());
+
+        REQUIRE(batches.size() == 1);
+        auto batch = batches[0];
+        std::sort(batch.begin(), batch.end());
+        CHECK(batch == std::vector<std::string>{"a/#", "b"});
+    }
+
+    SECTION("Renewal")
+    {
+        REQUIRE(table.subscribe(1, "a/#", start + 5s, newUpstream) ==
+                ErrCode::SUCCESS);
+        CHECK_FALSE(newUpstream);
+        CHECK(table.size() == 3);
+
+        CHECK(table.tick(start + 12s) == 2);
+        CHECK(batches.size() == 1);
+        CHECK(batches[0] == std::vector<std::string>{"b"});
+        table.match("a/x", consumers);
+        CHECK(consumers == Consumers{1});
+
+        CHECK(table.renewAll(1, start + 14s) == 1);
+        CHECK(table.renewAll(2, start + 14s) == 0);
+        CHECK(table.tick(start + 20s) == 0);
+        CHECK(table.tick(start + 25s) == 1);
+        CHECK(batches.size() == 2);
+    }
+
+    SECTION("Unsubscription")
+    {
+        CHECK(table.unsubscribe(1, "a/#") == ErrCode::SUCCESS);
+        CHECK(table.unsubscribe(1, "a/#") == ErrCode::NOT_FOUND);
+        CHECK(table.upstreamCnt() == 2);
+
+        table.removeConsumer(2);
+        CHECK(table.size() == 0);
+        CHECK(table.upstreamCnt() == 0);
+
+        // Emitted with next tick
+        CHECK(batches.empty());
+        CHECK(table.tick(start + 1s) == 0);
+        CHECK(batches.size() == 1);
+    }
+
+    SECTION("Resubscription before tick")
+    {
+        table.removeConsumer(2);
+        REQUIRE(table.subscribe(3, "b", start, newUpstream) ==
+                ErrCode::SUCCESS);
+
+        // Still subscribed upstream
+        CHECK_FALSE(newUpstream);
+        CHECK(table.tick(start + 1s) == 0);
+        CHECK(batches.empty());
+    }
+
+    SECTION("Export and restore")
+    {
+        std::vector<std::string> filters;
+        table.upstreamFilters(filters);
+        std::sort(filters.begin(), filters.end());
+        CHECK(filters == std::vector<std::string>{"a/#", "b"});
+
+        REQUIRE(table.subscribeUntil(3, "c", start + 3s, newUpstream) ==
+                ErrCode::SUCCESS);
+        CHECK(newUpstream);
+
+        size_t cnt = 0;
+        table.forEach([&](SubLeaseTable::ConsumerId consumer,
+                          const std::string &filter,
+                          std::chrono::steady_clock::time_point expiry) {
+            cnt++;
+            if (consumer == 3) {
+                CHECK(filter == "c");
+                CHECK(expiry >= start + 3s);
+                CHECK(expiry < start + 4s);
+            } else {
+                CHECK(expiry >= start + 10s);
+            }
+        });
+        CHECK(cnt == 4);
+
+        CHECK(table.tick(start + 5s) == 1);
+        CHECK(batches[0] == std::vector<std::string>{"c"});
+    }
+
+    SECTION("Batches")
+    {
+        for (int i = 0; i < 5; i++) {
+            REQUIRE(table.subscribe(3, "c/" + std::to_string(i), start + 1s,
+                                    newUpstream) == ErrCode::SUCCESS);
+        }
+        CHECK(table.tick(start + 20s) == 8);
+
+        // 7 upstream filters in batches of 2
+        REQUIRE(batches.size() == 4);
+        CHECK(batches[0].size() == 2);
+        CHECK(batches[3].size() == 1);
+    }
+}
+
+TEST_CASE("Expiration with 100k leases", "[SubLeaseTable][.benchmark]")
+{
+    constexpr size_t CNT = 100000;
+
+    size_t unsubCnt = 0;
+    SubLeaseTable table(
+        15min, [&](const std::vector<std::string> &b) { unsubCnt += b.size(); },
+        64);
+    auto start = std::chrono::steady_clock::now();
+
+    bool newUpstream;
+    for (size_t i = 0; i < CNT; i++) {
+        auto now = start + std::chrono::milliseconds(i * 10);
+        REQUIRE(table.subscribe(i % 1000, "t/" + std::to_string(i), now,
+                                newUpstream) == ErrCode::SUCCESS);
+    }
+
+    // No lease expires yet
+    BENCHMARK("Idle tick")
+    {
+        return table.tick(start + 500s);
+    };
+
+    BENCHMARK("Renewal")
+    {
+        return table.renewAll(7, start + 500s);
+    };
+
+    CHECK(table.tick(start + 32min) == CNT);
+    CHECK(unsubCnt == CNT);
+}
@@ -0,0 +1,145 @@
+/**
+ * @file timing_wheel.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @copyright Copyright (c) 2024
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "kvik/errors.hpp"
+#include "kvik/timing_wheel.hpp"
+
+using namespace kvik;
+
+TEST_CASE("Timing wheel expiration", "[TimingWheel]")
+{
+    TimingWheel<int> wheel;
+    std::vector<int> expired;
+
+    SECTION("Single level")
+    {
+        wheel.schedule(1, 5);
+        wheel.schedule(2, 10);
+        CHECK(wheel.size() == 2);
+
+        wheel.advance(4, expired);
+        CHECK(expired.empty());
+        wheel.advance(5, expired);
+        CHECK(expired == std::vector<int>{1});
+        wheel.advance(20, expired);
+        CHECK(expired == std::vector<int>{1, 2});
+        CHECK(wheel.empty());
+        CHECK(wheel.now() == 20);
+    }
+
+    SECTION("Upper levels")
+    {
+        wheel.schedule(1, 100);
+        wheel.schedule(2, 5000);
+        wheel.schedule(3, 300000);
+
+        wheel.advance(99, expired);
+        CHECK(expired.empty());
+        wheel.advance(100, expired);
+        CHECK(expired == std::vector<int>{1});
+        wheel.advance(4999, expired);
+        CHECK(expired.size() == 1);
+        wheel.advance(5000, expired);
+        CHECK(expired.size() == 2);
+        wheel.advance(299999, expired);
+        CHECK(expired.size() == 2);
+        wheel.advance(300000, expired);
+        CHECK(expired == std::vector<int>{1, 2, 3});
+    }
+
+    SECTION("Beyond range")
+    {
+        uint64_t far = (uint64_t(1) << 24) * 3 + 17;
+        wheel.schedule(1, far);
+        wheel.advance(far - 1, expired);
+        CHECK(expired.empty());
+        wheel.advance(far, expired);
+        CHECK(expired == std::vector<int>{1});
+    }
+
+    SECTION("Renewal and cancellation")
+    {
+        wheel.schedule(1, 10);
+        wheel.schedule(2, 10);
+        wheel.schedule(1, 1000);
+        CHECK(wheel.cancel(2) == ErrCode::SUCCESS);
+        CHECK(wheel.cancel(2) == ErrCode::NOT_FOUND);
+
+        uint64_t expiry;
+        REQUIRE(wheel.getExpiry(1, expiry) == ErrCode::SUCCESS);
+        CHECK(expiry == 1000);
+        CHECK(wheel.getExpiry(2, expiry) == ErrCode::NOT_FOUND);
+
+        wheel.advance(999, expired);
+        CHECK(expired.empty());
+        wheel.advance(1000, expired);
+        CHECK(expired == std::vector<int>{1});
+    }
+
+    SECTION("Past expiration")
+    {
+        wheel.advance(50, expired);
+        wheel.schedule(1, 10);
+        wheel.advance(50, expired);
+        CHECK(expired.empty());
+        wheel.advance(51, expired);
+        CHECK(expired == std::vector<int>{1});
+    }
+}
+
+TEST_CASE("Timing wheel against reference", "[TimingWheel]")
+{
+    TimingWheel<uint32_t> wheel(12345);
+    std::map<uint32_t, uint64_t> reference;
+    std::vector<uint32_t> expired;
+
+    // Deterministic pseudo-random schedule (LCG)
+    uint64_t state = 42;
+    auto next = [&state]() {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return state >> 33;
+    };
+
+    uint64_t now = 12345;
+    for (int round = 0; round < 2000; round++) {
+        for (int i = 0; i < 5; i++) {
+            uint32_t key = next() % 500;
+            uint64_t delta = 1 + next() % (next() % 2 ? 100 : 300000);
+            wheel.schedule(key, now + delta);
+            reference[key] = now + delta;
+        }
+        if (next() % 4 == 0) {
+            uint32_t key = next() % 500;
+            CHECK((wheel.cancel(key) == ErrCode::SUCCESS) ==
+                  (reference.erase(key) == 1));
+        }
+
+        now += 1 + next() % 1000;
+        expired.clear();
+        wheel.advance(now, expired);
+
+        std::vector<uint32_t> expected;
+        for (auto it = reference.begin(); it != reference.end();) {
+            if (it->second <= now) {
+                expected.push_back(it->first);
+                it = reference.erase(it);
+            } else {
+                it++;
+            }
+        }
+
+        std::sort(expired.begin(), expired.end());
+        REQUIRE(expired == expected);
+        REQUIRE(wheel.size() == reference.size());
+    }
+}
@@ -0,0 +1,108 @@
+/**
+ * @file topic.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @copyright Copyright (c) 2024
+ */
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "kvik/hash.hpp"
+#include "kvik/topic.hpp"
+
+using namespace kvik;
+
+using Levels = std::vector<std::string>;
+
+TEST_CASE("Topic construction", "[Topic]")
+{
+    SECTION("Valid")
+    {
+        Topic topic("abc/def/g");
+        CHECK(topic.str() == "abc/def/g");
+        CHECK(topic.levels() == Levels{"abc", "def", "g"});
+        CHECK(topic.hash() == fnv1a64(std::string("abc/def/g")));
+    }
+
+    SECTION("Empty levels")
+    {
+        CHECK(Topic("/a//").levels() == Levels{"", "a", "", ""});
+    }
+
+    SECTION("Custom separators")
+    {
+        Topic topic("a::b", {.levelSeparator = "::"});
+        CHECK(topic.levels() == Levels{"a", "b"});
+        CHECK(topic.usesSeparators("::", "+", "#"));
+        CHECK(!topic.usesSeparators("/", "+", "#"));
+    }
+
+    SECTION("Invalid")
+    {
+        CHECK_THROWS(Topic(""));
+        CHECK_THROWS(Topic("a/+/b"));
+        CHECK_THROWS(Topic("a/#"));
+        CHECK_THROWS(Topic("a/b+c"));
+        CHECK_THROWS(Topic("a", {.levelSeparator = ""}));
+        CHECK(!Topic::isValid("a/#"));
+        CHECK(Topic::isValid("a/b"));
+    }
+}
+
+TEST_CASE("Filter construction", "[Topic]")
+{
+    SECTION("Plain")
+    {
+        Filter filter("a/b");
+        CHECK(filter.levels() == Levels{"a", "b"});
+        CHECK(!filter.hasWildcard());
+    }
+
+    SECTION("Wildcards")
+    {
+        Filter filter("a/+/#");
+        CHECK(filter.hasWildcard());
+        CHECK(filter.hasSingleLevelWildcard());
+        CHECK(filter.hasMultiLevelWildcard());
+        CHECK(!Filter("+").hasMultiLevelWildcard());
+    }
+
+    SECTION("Invalid")
+    {
+        CHECK_THROWS(Filter(""));
+        CHECK_THROWS(Filter("a/#/b"));
+        CHECK_THROWS(Filter("a/b+"));
+        CHECK_THROWS(Filter("a/#b"));
+        CHECK(!Filter::isValid("#/a"));
+        CHECK(Filter::isValid("#"));
+    }
+}
+
+TEST_CASE("Filter matching", "[Topic]")
+{
+    Filter filter("a/+/c/#");
+
+    CHECK(filter.matches(Topic("a/b/c/d")));
+    CHECK(filter.matches(Topic("a/x/c/d/e")));
+    CHECK(!filter.matches(Topic("a/b/c")));
+    CHECK(!filter.matches(Topic("a/b/x/d")));
+    CHECK(!filter.matches(Topic("a")));
+
+    CHECK(Filter("a/b").matches(Topic("a/b")));
+    CHECK(!Filter("a/b").matches(Topic("a/b/c")));
+    CHECK(!Filter("a/+").matches(Topic("a")));
+    CHECK(Filter("#").matches(Topic("a/b")));
+}
+
+TEST_CASE("Topic equality and hashing", "[Topic]")
+{
+    CHECK(Topic("a/b") == Topic("a/b"));
+    CHECK(Topic("a/b") != Topic("a/c"));
+
+    std::unordered_set<Topic> topics = {Topic("a/b"), Topic("a/b"),
+                                        Topic("c")};
+    CHECK(topics.size() == 2);
+}
@@ -0,0 +1,269 @@
+/**
+ * @file topic_acl.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @copyright Copyright (c) 2024
+ */
+
+#include <string>
+#include <vector>
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "kvik/errors.hpp"
+#include "kvik/local_addr.hpp"
+#include "kvik/topic_acl.hpp"
+
+using namespace kvik;
+
+static const LocalAddr ADDR1{{0x01, 0x02}};
+static const LocalAddr ADDR2{{0x03, 0x04}};
+
+TEST_CASE("Invalid parameters", "[TopicAcl]")
+{
+    REQUIRE_THROWS(TopicAcl(false, 3));
+    REQUIRE_NOTHROW(TopicAcl(false, 0));
+    REQUIRE_THROWS(TopicAcl(false, 256, {.levelSeparator = "+"}));
+
+    TopicAcl acl;
+    CHECK(acl.allow(ADDR1, "", AclAccess::PUB) == ErrCode::INVALID_ARG);
+    CHECK(acl.denyGroup("g", "", AclAccess::PUB) == ErrCode::INVALID_ARG);
+    CHECK(acl.ruleCnt() == 0);
+}
+
+TEST_CASE("Client rules", "[TopicAcl]")
+{
+    TopicAcl acl;
+
+    REQUIRE(acl.allow(ADDR1, "sensors/+/temp", AclAccess::PUB) ==
+            ErrCode::SUCCESS);
+    REQUIRE(acl.allow(ADDR1, "cmd/#", AclAccess::SUB) == ErrCode::SUCCESS);
+    REQUIRE(acl.deny(ADDR1, "cmd/admin/#", AclAccess::PUB_SUB) ==
+            ErrCode::SUCCESS);
+    CHECK(acl.ruleCnt() == 3);
+
+    SECTION("Allowed")
+    {
+        CHECK(acl.authorize(ADDR1, "sensors/room1/temp", AclAccess::PUB));
+        CHECK(acl.authorize(ADDR1, "cmd/lights/on", AclAccess::SUB));
+    }
+
+    SECTION("Wrong access type")
+    {
+        CHECK(!acl.authorize(ADDR1, "sensors/room1/temp", AclAccess::SUB));
+        CHECK(!acl.authorize(ADDR1, "cmd/lights", AclAccess::PUB));
+        CHECK(!acl.authorize(ADDR1, "cmd/lights", AclAccess::PUB_SUB));
+    }
+
+    SECTION("Deny takes precedence")
+    {
+        CHECK(!acl.authorize(ADDR1, "cmd/admin/reboot", AclAccess::SUB));
+    }
+
+    SECTION("No matching rule")
+    {
+        CHECK(!acl.authorize(ADDR1, "sensors/room1/hum", AclAccess::PUB));
+        CHECK(!acl.authorize(ADDR2, "sensors/room1/temp", AclAccess::PUB));
+    }
+
+    SECTION("Remove rule")
+    {
+        REQUIRE(acl.removeRule(ADDR1, "cmd/admin/#") == ErrCode::SUCCESS);
+        CHECK(acl.removeRule(ADDR1, "cmd/admin/#") == ErrCode::NOT_FOUND);
+        CHECK(acl.removeRule(ADDR2, "cmd/#") == ErrCode::NOT_FOUND);
+        CHECK(acl.ruleCnt() == 2);
+        CHECK(acl.authorize(ADDR1, "cmd/admin/reboot", AclAccess::SUB));
+    }
+
+    SECTION("Remove client")
+    {
+        acl.removeClient(ADDR1);
+        CHECK(acl.ruleCnt() == 0);
+        CHECK(!acl.authorize(ADDR1, "sensors/room1/temp", AclAccess::PUB));
+    }
+
+    SECTION("Rule for the same filter")
+    {
+        REQUIRE(acl.allow(ADDR1, "sensors/+/temp", AclAccess::SUB) ==
+                ErrCode::SUCCESS);
+        CHECK(acl.ruleCnt() == 3);
+        CHECK(acl.authorize(ADDR1, "sensors/room1/temp", AclAccess::PUB_SUB));
+    }
+}
+
+TEST_CASE("Group rules", "[TopicAcl]")
+{
+    TopicAcl acl;
+
+    REQUIRE(acl.allowGroup("sensors", "data/#", AclAccess::PUB) ==
+            ErrCode::SUCCESS);
+    REQUIRE(acl.denyGroup("restricted", "data/secret", AclAccess::PUB) ==
+            ErrCode::SUCCESS);
+    acl.addToGroup(ADDR1, "sensors");
+    acl.addToGroup(ADDR2, "sensors");
+    acl.addToGroup(ADDR2, "restricted");
+
+    CHECK(acl.authorize(ADDR1, "data/secret", AclAccess::PUB));
+    CHECK(acl.authorize(ADDR2, "data/public", AclAccess::PUB));
+    CHECK(!acl.authorize(ADDR2, "data/secret", AclAccess::PUB));
+
+    SECTION("Remove from group")
+    {
+        REQUIRE(acl.removeFromGroup(ADDR2, "restricted") == ErrCode::SUCCESS);
+        CHECK(acl.removeFromGroup(ADDR2, "restricted") == ErrCode::NOT_FOUND);
+        CHECK(acl.removeFromGroup(ADDR2, "unknown") == ErrCode::NOT_FOUND);
+        CHECK(acl.authorize(ADDR2, "data/secret", AclAccess::PUB));
+    }
+
+    SECTION("Remove group rule")
+    {
+        REQUIRE(acl.removeGroupRule("sensors", "data/#") == ErrCode::SUCCESS);
+        CHECK(acl.removeGroupRule("sensors", "data/#") == ErrCode::NOT_FOUND);
+        CHECK(!acl.authorize(ADDR1, "data/secret", AclAccess::PUB));
+    }
+
+    SECTION("Client deny overrides group allow")
+    {
+        REQUIRE(acl.deny(ADDR1, "data/+", AclAccess::PUB) == ErrCode::SUCCESS);
+        CHECK(!acl.authorize(ADDR1, "data/secret", AclAccess::PUB));
+        CHECK(acl.authorize(ADDR1, "data/a/b", AclAccess::PUB));
+    }
+
+    SECTION("Clear")
+    {
+        acl.clear();
+        CHECK(acl.ruleCnt() == 0);
+        CHECK(!acl.authorize(ADDR1, "data/secret", AclAccess::PUB));
+    }
+}
+
+TEST_CASE("Default allow policy", "[TopicAcl]")
+{
+    TopicAcl acl(true);
+
+    REQUIRE(acl.deny(ADDR1, "private/#", AclAccess::SUB) == ErrCode::SUCCESS);
+
+    CHECK(acl.authorize(ADDR1, "anything", AclAccess::PUB_SUB));
+    CHECK(acl.authorize(ADDR1, "private/x", AclAccess::PUB));
+    CHECK(!acl.authorize(ADDR1, "private/x", AclAccess::SUB));
+    CHECK(acl.authorize(ADDR2, "private/x", AclAccess::SUB));
+}
+
+TEST_CASE("Custom topic separators", "[TopicAcl]")
+{
+    TopicAcl acl(false, 256,
+                 {.levelSeparator = ".",
+                  .singleLevelWildcard = "*",
+                  .multiLevelWildcard = ">"});
+
+    REQUIRE(acl.allow(ADDR1, "sensors.*.temp", AclAccess::PUB) ==
+            ErrCode::SUCCESS);
+    REQUIRE(acl.allowGroup("g", "cmd.>", AclAccess::SUB) == ErrCode::SUCCESS);
+    acl.addToGroup(ADDR1, "g");
+
+    CHECK(acl.authorize(ADDR1, "sensors.room1.temp", AclAccess::PUB));
+    CHECK(!acl.authorize(ADDR1, "sensors/room1/temp", AclAccess::PUB));
+    CHECK(acl.authorize(ADDR1, "cmd.lights.on", AclAccess::SUB));
+    CHECK(!acl.authorize(ADDR1, "cmd/lights", AclAccess::SUB));
+}
+
+TEST_CASE("Authorization cache", "[TopicAcl]")
+{
+    TopicAcl acl(false, 16);
+
+    REQUIRE(acl.allow(ADDR1, "a/+", AclAccess::PUB) == ErrCode::SUCCESS);
+
+    SECTION("Hits and misses")
+    {
+        CHECK(acl.authorize(ADDR1, "a/b", AclAccess::PUB));
+        CHECK(acl.authorize(ADDR1, "a/b", AclAccess::PUB));
+        CHECK(!acl.authorize(ADDR2, "a/b", AclAccess::PUB));
+        CHECK(!acl.authorize(ADDR1, "a/b", AclAccess::SUB));
+
+        auto stats = acl.cacheStats();
+        CHECK(stats.hits == 1);
+        CHECK(stats.misses == 3);
+    }
+
+    SECTION("Invalidation on change")
+    {
+        CHECK(acl.authorize(ADDR1, "a/b", AclAccess::PUB));
+        REQUIRE(acl.deny(ADDR1, "a/b", AclAccess::PUB) == ErrCode::SUCCESS);
+        CHECK(!acl.authorize(ADDR1, "a/b", AclAccess::PUB));
+
+        acl.addToGroup(ADDR2, "g");
+        REQUIRE(acl.allowGroup("g", "a/#", AclAccess::PUB) ==
+                ErrCode::SUCCESS);
+        CHECK(acl.authorize(ADDR2, "a/b", AclAccess::PUB));
+        CHECK(acl.cacheStats().hits == 0);
+    }
+
+    SECTION("Key too long to be cached")
+    {
+        std::string topic = "a/" + std::string(TOPIC_ACL_CACHE_KEY_LEN, 'x');
+        CHECK(acl.authorize(ADDR1, topic, AclAccess::PUB));
+        CHECK(acl.authorize(ADDR1, topic, AclAccess::PUB));
+
+        auto stats = acl.cacheStats();
+        CHECK(stats.hits == 0);
+        CHECK(stats.misses == 0);
+    }
+}
+
+TEST_CASE("Authorization with 10k rules", "[TopicAcl][.benchmark]")
+{
+    constexpr size_t CLIENT_CNT = 500;
+    constexpr size_t GROUP_CNT = 50;
+
+    TopicAcl cachedAcl(false, 1024);
+    TopicAcl uncachedAcl(false, 0);
+
+    std::vector<LocalAddr> clients;
+    for (size_t i = 0; i < CLIENT_CNT; i++) {
+        clients.push_back(LocalAddr{{0xaa, uint8_t(i >> 8), uint8_t(i)}});
+    }
+
+    // 500 clients * 10 rules + 50 groups * 100 rules
+    for (auto acl : {&cachedAcl, &uncachedAcl}) {
+        for (size_t i = 0; i < CLIENT_CNT; i++) {
+            auto &client = clients[i];
+            auto prefix = "site/" + std::to_string(i);
+            for (size_t j = 0; j < 8; j++) {
+                acl->allow(client, prefix + "/dev" + std::to_string(j) + "/+",
+                           AclAccess::PUB);
+            }
+            acl->allow(client, prefix + "/cmd/#", AclAccess::SUB);
+            acl->deny(client, prefix + "/cmd/admin/#", AclAccess::SUB);
+            acl->addToGroup(client, "group" + std::to_string(i % GROUP_CNT));
+        }
+        for (size_t i = 0; i < GROUP_CNT; i++) {
+            auto group = "group" + std::to_string(i);
+            for (size_t j = 0; j < 100; j++) {
+                acl->allowGroup(group, "shared/" + std::to_string(j) + "/#",
+                                AclAccess::PUB_SUB);
+            }
+        }
+        REQUIRE(acl->ruleCnt() == 10000);
+    }
+
+    std::vector<std::string> topics;
+    for (size_t i = 0; i < 64; i++) {
+        topics.push_back("site/" + std::to_string(i) + "/dev3/temp");
+        topics.push_back("shared/" + std::to_string(i) + "/a/b");
+    }
+
+    size_t n = 0;
+    BENCHMARK("Uncached")
+    {
+        n++;
+        return uncachedAcl.authorize(clients[n % 64], topics[n % 128],
+                                     AclAccess::PUB);
+    };
+
+    BENCHMARK("Cached")
+    {
+        n++;
+        return cachedAcl.authorize(clients[n % 64], topics[n % 128],
+                                   AclAccess::PUB);
+    };
+}
@@ -0,0 +1,117 @@
+/**
+ * @file topic_coding.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @copyright Copyright (c) 2024
+ */
+
+#include <string>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "kvik/topic_coding.hpp"
+
+using namespace kvik;
+
+using Topics = std::vector<std::string>;
+
+static Topics roundTrip(const Topics &topics)
+{
+    std::string enc;
+    frontEncodeTopics(topics, enc);
+
+    size_t pos = 0;
+    Topics decoded;
+    REQUIRE(frontDecodeTopics(enc, pos, decoded) == ErrCode::SUCCESS);
+    CHECK(pos == enc.size());
+    return decoded;
+}
+
+TEST_CASE("Front coding of topics", "[TopicCoding]")
+{
+    SECTION("Round trip keeps order")
+    {
+        Topics topics = {
+            "site/42/line/3/m2/temp",
+            "site/42/line/3/m1/temp",
+            "site/42/line/3/m1/rpm",
+            "a",
+            "site/42/line/3/m1/temp",
+            "",
+            "site/42",
+        };
+        CHECK(roundTrip(topics) == topics);
+        CHECK(roundTrip({}) == Topics{});
+        CHECK(roundTrip({"x"}) == Topics{"x"});
+    }
+
+    SECTION("Shared prefixes are stored once")
+    {
+        Topics topics;
+        size_t plainLen = 0;
+        for (int m = 0; m < 4; m++) {
+            for (auto q : {"temp", "rpm", "vib"}) {
+                topics.push_back("site/42/line/3/m" + std::to_string(m) +
+                                 "/" + q);
+                plainLen += 1 + topics.back().size();
+            }
+        }
+
+        std::string enc;
+        frontEncodeTopics(topics, enc);
+        CHECK(enc.size() * 2 < plainLen);
+        CHECK(roundTrip(topics) == topics);
+    }
+
+    SECTION("Embedded in frame")
+    {
+        std::string frame = "hdr";
+        frontEncodeTopics({"a/b", "a/c"}, frame);
+        frame += "payload";
+
+        size_t pos = 3;
+        Topics topics;
+        REQUIRE(frontDecodeTopics(frame, pos, topics) == ErrCode::SUCCESS);
+        CHECK(topics == Topics{"a/b", "a/c"});
+        CHECK(frame.substr(pos) == "payload");
+    }
+
+    SECTION("Malformed input")
+    {
+        std::string enc;
+        frontEncodeTopics({"abc/def", "abc/xyz"}, enc);
+        // 02 | 00 00 07 abc/def | 01 04 03 xyz
+
+        Topics topics = {"untouched"};
+        size_t pos = 0;
+        auto decode = [&](const std::string &in) {
+            pos = 0;
+            return frontDecodeTopics(in, pos, topics);
+        };
+
+        CHECK(decode("") == ErrCode::INVALID_ARG);
+        CHECK(decode(enc.substr(0, enc.size() - 1)) == ErrCode::INVALID_ARG);
+        CHECK(decode(std::string("\xff\xff\xff\x0f", 4)) ==
+              ErrCode::INVALID_ARG);
+
+        auto bad = enc;
+        bad[11] = 0x00; // Duplicate index
+        CHECK(decode(bad) == ErrCode::INVALID_ARG);
+
+        bad = enc;
+        bad[11] = 0x05; // Index out of range
+        CHECK(decode(bad) == ErrCode::INVALID_ARG);
+
+        bad = enc;
+        bad[12] = 0x08; // Prefix longer than previous topic
+        CHECK(decode(bad) == ErrCode::INVALID_ARG);
+
+        bad = enc;
+        bad[2] = 0x01; // Prefix without previous topic
+        CHECK(decode(bad) == ErrCode::INVALID_ARG);
+
+        CHECK(topics == Topics{"untouched"});
+        CHECK(pos == 0);
+        CHECK(decode(enc) == ErrCode::SUCCESS);
+    }
+}
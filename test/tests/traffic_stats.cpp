@@ -0,0 +1,105 @@
+/**
+ * @file traffic_stats.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @copyright Copyright (c) 2024
+ */
+
+#include <chrono>
+#include <cmath>
+#include <string>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "kvik/local_addr.hpp"
+#include "kvik/traffic_stats.hpp"
+
+using namespace kvik;
+using namespace std::chrono_literals;
+
+static const auto T0 = std::chrono::steady_clock::time_point{} + 1h;
+
+TEST_CASE("Decayed rate", "[TrafficStats]")
+{
+    DecayedRate r;
+
+    // 10 events per second for a long time converges to rate 10
+    for (int i = 0; i < 1000; i++) {
+        r.add(1, T0 + i * 100ms, 10s);
+    }
+    auto now = T0 + 999 * 100ms;
+    CHECK(std::fabs(r.rate(now, 10s) - 10.0) < 0.5);
+
+    // Rate halves after half-life
+    CHECK(std::fabs(r.rate(now + 10s, 10s) - r.rate(now, 10s) / 2) < 0.01);
+}
+
+TEST_CASE("Heavy hitters", "[TrafficStats]")
+{
+    HeavyHitters hh(64, 4, 3, 10s);
+
+    SECTION("Estimates never underestimate")
+    {
+        for (int i = 0; i < 200; i++) {
+            hh.record("t" + std::to_string(i % 50), 1, T0);
+        }
+        for (int i = 0; i < 50; i++) {
+            CHECK(hh.estimate("t" + std::to_string(i)) >= 4);
+        }
+    }
+
+    SECTION("Heaviest keys are tracked")
+    {
+        for (int i = 0; i < 1000; i++) {
+            hh.record("noise/" + std::to_string(i), 1, T0);
+            if (i % 2 == 0) {
+                hh.record("heavy/a", 100, T0);
+            }
+            if (i % 4 == 0) {
+                hh.record("heavy/b", 10, T0);
+            }
+        }
+
+        auto top = hh.top(T0);
+        REQUIRE(top.size() == 3);
+        CHECK(top[0].key == "heavy/a");
+        CHECK(top[0].msgs >= 500);
+        CHECK(top[0].bytes >= 50000);
+        CHECK(top[1].key == "heavy/b");
+        CHECK(top[1].msgs >= 250);
+    }
+
+    SECTION("Clear")
+    {
+        hh.record("a", 1, T0);
+        hh.clear();
+        CHECK(hh.top(T0).empty());
+        CHECK(hh.estimate("a") == 0);
+    }
+}
+
+TEST_CASE("Traffic statistics snapshot", "[TrafficStats]")
+{
+    TrafficStats stats(64, 4, 2, 10s);
+    LocalAddr addr1{{0xab, 0x01}}, addr2{{0xcd}};
+
+    stats.record(addr1, "a", 10, T0);
+    stats.record(addr1, "b", 10, T0);
+    stats.record(addr2, "a", 10, T0);
+    stats.record({}, "a", 10, T0);
+
+    auto snap = stats.snapshot(T0);
+    CHECK(snap.msgs == 4);
+    CHECK(snap.bytes == 40);
+    CHECK(snap.msgRate > 0);
+    REQUIRE(snap.topTopics.size() == 2);
+    CHECK(snap.topTopics[0].key == "a");
+    CHECK(snap.topTopics[0].msgs == 3);
+    REQUIRE(snap.topSources.size() == 2);
+    CHECK(snap.topSources[0].key == "ab01");
+    CHECK(snap.topSources[0].msgs == 2);
+
+    stats.clear();
+    snap = stats.snapshot(T0);
+    CHECK(snap.msgs == 0);
+    CHECK(snap.topTopics.empty());
+}
@@ -0,0 +1,207 @@
+/**
+ * @file typed_payload.cpp
+ * @author Dávid Benko (davidbenko@davidbenko.dev)
+ * @copyright Copyright (c) 2024
+ */
+
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "kvik/errors.hpp"
+#include "kvik/pub_sub_struct.hpp"
+#include "kvik/typed_payload.hpp"
+
+using namespace kvik;
+
+TEST_CASE("Payload type detection", "[TypedPayload]")
+{
+    CHECK(typedPayloadType("") == PayloadType::RAW);
+    CHECK(typedPayloadType("-74") == PayloadType::RAW);
+    CHECK(typedPayloadType(typedPayloadFromInt(1)) == PayloadType::INT);
+    CHECK(typedPayloadType(typedPayloadFromFloat(1, true)) ==
+          PayloadType::FLOAT16);
+    CHECK(typedPayloadType(typedPayloadFromFloat(1)) == PayloadType::FLOAT32);
+    CHECK(typedPayloadType(typedPayloadFromBool(true)) == PayloadType::BOOL);
+    CHECK(std::string(payloadTypeToStr(PayloadType::INT_ARRAY)) ==
+          "INT_ARRAY");
+}
+
+TEST_CASE("Integers", "[TypedPayload]")
+{
+    int64_t val = 0;
+
+    SECTION("Compact encoding")
+    {
+        CHECK(typedPayloadFromInt(0) == std::string("\x01\x00", 2));
+        CHECK(typedPayloadFromInt(-1) == std::string("\x01\x01", 2));
+        CHECK(typedPayloadFromInt(1) == std::string("\x01\x02", 2));
+        CHECK(typedPayloadFromInt(63) == std::string("\x01\x7e", 2));
+        CHECK(typedPayloadFromInt(64) == std::string("\x01\x80\x01", 3));
+    }
+
+    SECTION("Round trip")
+    {
+        for (int64_t in : {int64_t{0}, int64_t{-74}, int64_t{300},
+                           std::numeric_limits<int64_t>::min(),
+                           std::numeric_limits<int64_t>::max()}) {
+            REQUIRE(typedPayloadToInt(typedPayloadFromInt(in), val) ==
+                    ErrCode::SUCCESS);
+            CHECK(val == in);
+        }
+    }
+
+    SECTION("Invalid payloads")
+    {
+        CHECK(typedPayloadToInt("12", val) == ErrCode::INVALID_ARG);
+        CHECK(typedPayloadToInt(std::string("\x01", 1), val) ==
+              ErrCode::INVALID_ARG);
+        CHECK(typedPayloadToInt(std::string("\x01\x80", 2), val) ==
+              ErrCode::INVALID_ARG);
+        CHECK(typedPayloadToInt(std::string("\x01\x00\x00", 3), val) ==
+              ErrCode::INVALID_ARG);
+        CHECK(typedPayloadToInt(typedPayloadFromBool(true), val) ==
+              ErrCode::INVALID_ARG);
+    }
+}
+
+TEST_CASE("Floats", "[TypedPayload]")
+{
+    float val = 0;
+
+    SECTION("Single precision")
+    {
+        auto payload = typedPayloadFromFloat(21.37f);
+        CHECK(payload.size() == 5);
+        REQUIRE(typedPayloadToFloat(payload, val) == ErrCode::SUCCESS);
+        CHECK(val == 21.37f);
+    }
+
+    SECTION("Half precision")
+    {
+        auto payload = typedPayloadFromFloat(-1.5f, true);
+        CHECK(payload == std::string("\x02\x00\xbe", 3));
+        REQUIRE(typedPayloadToFloat(payload, val) == ErrCode::SUCCESS);
+        CHECK(val == -1.5f);
+
+        // Rounded to 11 significant bits
+        REQUIRE(typedPayloadToFloat(typedPayloadFromFloat(21.37f, true),
+                                    val) == ErrCode::SUCCESS);
+        CHECK(std::fabs(val - 21.37f) < 0.01f);
+    }
+
+    SECTION("Half precision special values")
+    {
+        REQUIRE(typedPayloadToFloat(typedPayloadFromFloat(1e6f, true), val) ==
+                ErrCode::SUCCESS);
+        CHECK(std::isinf(val));
+
+        REQUIRE(typedPayloadToFloat(typedPayloadFromFloat(NAN, true), val) ==
+                ErrCode::SUCCESS);
+        CHECK(std::isnan(val));
+
+        // Smallest subnormal
+        REQUIRE(typedPayloadToFloat(
+                    typedPayloadFromFloat(std::ldexp(1.0f, -24), true), val) ==
+                ErrCode::SUCCESS);
+        CHECK(val == std::ldexp(1.0f, -24));
+
+        REQUIRE(typedPayloadToFloat(typedPayloadFromFloat(1e-10f, true),
+                                    val) == ErrCode::SUCCESS);
+        CHECK(val == 0.0f);
+    }
+
+    SECTION("Invalid payloads")
+    {
+        CHECK(typedPayloadToFloat("1.5", val) == ErrCode::INVALID_ARG);
+        CHECK(typedPayloadToFloat(std::string("\x03\x00", 2), val) ==
+              ErrCode::INVALID_ARG);
+    }
+}
+
+TEST_CASE("Booleans", "[TypedPayload]")
+{
+    bool val = false;
+    REQUIRE(typedPayloadToBool(typedPayloadFromBool(true), val) ==
+            ErrCode::SUCCESS);
+    CHECK(val);
+    REQUIRE(typedPayloadToBool(typedPayloadFromBool(false), val) ==
+            ErrCode::SUCCESS);
+    CHECK_FALSE(val);
+    CHECK(typedPayloadToBool("true", val) == ErrCode::INVALID_ARG);
+}
+
+TEST_CASE("Arrays", "[TypedPayload]")
+{
+    std::string payload;
+
+    SECTION("Integers")
+    {
+        std::vector<int64_t> in = {-1, 0, 1000, -100000}, out;
+        REQUIRE(typedPayloadFromIntArray(in, payload) == ErrCode::SUCCESS);
+        REQUIRE(typedPayloadToIntArray(payload, out) == ErrCode::SUCCESS);
+        CHECK(out == in);
+
+        payload.pop_back();
+        CHECK(typedPayloadToIntArray(payload, out) == ErrCode::INVALID_ARG);
+    }
+
+    SECTION("Floats")
+    {
+        std::vector<float> in = {0.5f, -2.0f, 1024.0f}, out;
+        REQUIRE(typedPayloadFromFloatArray(in, payload, true) ==
+                ErrCode::SUCCESS);
+        CHECK(payload.size() == 2 + 3 * 2);
+        REQUIRE(typedPayloadToFloatArray(payload, out) == ErrCode::SUCCESS);
+        CHECK(out == in);
+
+        REQUIRE(typedPayloadFromFloatArray(in, payload) == ErrCode::SUCCESS);
+        CHECK(payload.size() == 2 + 3 * 4);
+        REQUIRE(typedPayloadToFloatArray(payload, out) == ErrCode::SUCCESS);
+        CHECK(out == in);
+    }
+
+    SECTION("Booleans")
+    {
+        std::vector<bool> in = {true, false, false, true, true, false, true,
+                                false, true},
+                          out;
+        REQUIRE(typedPayloadFromBoolArray(in, payload) == ErrCode::SUCCESS);
+        CHECK(payload.size() == 2 + 2);
+        REQUIRE(typedPayloadToBoolArray(payload, out) == ErrCode::SUCCESS);
+        CHECK(out == in);
+    }
+
+    SECTION("Empty")
+    {
+        std::vector<int64_t> out = {1};
+        REQUIRE(typedPayloadFromIntArray({}, payload) == ErrCode::SUCCESS);
+        REQUIRE(typedPayloadToIntArray(payload, out) == ErrCode::SUCCESS);
+        CHECK(out.empty());
+    }
+
+    SECTION("Too long")
+    {
+        CHECK(typedPayloadFromIntArray(std::vector<int64_t>(256), payload) ==
+              ErrCode::INVALID_SIZE);
+        CHECK(typedPayloadFromFloatArray(std::vector<float>(256), payload) ==
+              ErrCode::INVALID_SIZE);
+        CHECK(typedPayloadFromBoolArray(std::vector<bool>(256), payload) ==
+              ErrCode::INVALID_SIZE);
+    }
+}
+
+TEST_CASE("Decoding from SubData", "[TypedPayload]")
+{
+    SubData data = {.topic = "t", .payload = typedPayloadFromInt(42)};
+    int64_t i;
+    float f;
+
+    CHECK(data.payloadType() == PayloadType::INT);
+    REQUIRE(data.toInt(i) == ErrCode::SUCCESS);
+    CHECK(i == 42);
+    CHECK(data.toFloat(f) == ErrCode::INVALID_ARG);
+}
@@ -4,11 +4,14 @@
  * @copyright Copyright (c) 2024
  */
 
+#include <algorithm>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
 #include <catch2/catch_test_macros.hpp>
 
+#include "kvik/topic.hpp"
 #include "kvik/wildcard_trie.hpp"
 
 using namespace kvik;
@@ -308,6 +311,110 @@ TEST_CASE("Find in wildcard trie", "[WildcardTrie]")
     }
 }
 
+TEST_CASE("Visit matches in wildcard trie", "[WildcardTrie]")
+{
+    WildcardTrie<int> trie("/", "+", "#");
+
+    trie.insert("abc/#", 2);
+    trie.insert("abc/def", 3);
+    trie.insert("abc/def/g", 4);
+    trie.insert("abc/def/+/h", 5);
+    trie.insert("other/#", 6);
+    trie.insert("if/+/else", 7);
+
+    std::string levelBuf;
+    std::vector<int> visited;
+    auto visitAll = [&visited](const int &value) {
+        visited.push_back(value);
+        return false;
+    };
+
+    SECTION("Visit non-existing")
+    {
+        REQUIRE(!trie.visitMatches("abc", visitAll, levelBuf));
+        REQUIRE(!trie.visitMatches("if/abc/else/aaa", visitAll, levelBuf));
+        REQUIRE(!trie.visitMatches("", visitAll, levelBuf));
+        REQUIRE(visited.empty());
+    }
+
+    SECTION("Visit same values as find")
+    {
+        for (auto key : {"abc/def", "abc/def/g", "if/elseif/else",
+                         "other/123", "abc/def/xyz/h"}) {
+            visited.clear();
+            REQUIRE(!trie.visitMatches(key, visitAll, levelBuf));
+
+            std::vector<int> found;
+            for (auto &[foundKey, value] : trie.find(key)) {
+                found.push_back(value);
+            }
+            std::sort(visited.begin(), visited.end());
+            std::sort(found.begin(), found.end());
+            REQUIRE(visited == found);
+        }
+    }
+
+    SECTION("Stop visiting")
+    {
+        REQUIRE(trie.visitMatches(
+            "abc/def/xyz/h",
+            [&visited](const int &value) {
+                visited.push_back(value);
+                return true;
+            },
+            levelBuf));
+        REQUIRE(visited.size() == 1);
+    }
+}
+
+TEST_CASE("Precompiled topics in wildcard trie", "[WildcardTrie]")
+{
+    WildcardTrie<int> trie("/", "+", "#");
+
+    trie.insert(Filter("abc/#"), 2);
+    trie.insert(Filter("abc/def"), 3);
+    trie[Filter("if/+/else")] = 7;
+
+    SECTION("Find")
+    {
+        REQUIRE(trie.find(Topic("abc/def")) ==
+                FindReturnT{{"abc/#", 2}, {"abc/def", 3}});
+        REQUIRE(trie.find(Topic("if/x/else")) == FindReturnT{{"if/+/else", 7}});
+        REQUIRE(trie.find(Topic("abc/def")) == trie.find("abc/def"));
+    }
+
+    SECTION("Remove")
+    {
+        REQUIRE(trie.remove(Filter("abc/#")));
+        REQUIRE(!trie.remove(Filter("abc/#")));
+        REQUIRE(trie.find("abc/def") == FindReturnT{{"abc/def", 3}});
+    }
+
+    SECTION("Visit matches")
+    {
+        std::vector<int> visited;
+        REQUIRE(!trie.visitMatches(Topic("abc/def"), [&visited](const int &v) {
+            visited.push_back(v);
+            return false;
+        }));
+        std::sort(visited.begin(), visited.end());
+        REQUIRE(visited == std::vector<int>{2, 3});
+    }
+
+    SECTION("Different separators")
+    {
+        WildcardTrie<int> dotTrie(".", "*", ">");
+        dotTrie.insert(Filter("a.*", {".", "*", ">"}), 1);
+
+        // Handle split with other separators is split again
+        dotTrie.insert(Filter("b.c"), 2);
+        REQUIRE(dotTrie.find(Topic("a.b", {".", "*", ">"})) ==
+                FindReturnT{{"a.*", 1}});
+        REQUIRE(dotTrie.find(Topic("b.c")) == FindReturnT{{"b.c", 2}});
+        REQUIRE(dotTrie.find("b.c") == FindReturnT{{"b.c", 2}});
+    }
+}
+
 TEST_CASE("For each and [] in wildcard trie", "[WildcardTrie]")
 {
     WildcardTrie<int> trie("/", "+", "#");